@@ -0,0 +1,210 @@
+#include "BaselineQuality.h"
+
+static uint16_t difference(uint16_t a, uint16_t b) {
+  return a > b ? a - b : b - a;
+}
+
+// 高々 SLOT_COUNT 件なので挿入ソート
+static uint16_t median(uint16_t* values, uint8_t count) {
+  for (uint8_t i = 1; i < count; i++) {
+    uint16_t key = values[i];
+    int j = i - 1;
+    while (j >= 0 && values[j] > key) {
+      values[j + 1] = values[j];
+      j--;
+    }
+    values[j + 1] = key;
+  }
+  return count % 2 == 1 ? values[count / 2] : (uint16_t)((values[count / 2 - 1] + values[count / 2]) / 2);
+}
+
+BaselineQuality::BaselineQuality() :
+  store(nullptr),
+  eco2_drift(0),
+  tvoc_drift(0),
+  saved_eco2_drift(0),
+  saved_tvoc_drift(0),
+  outlier_eco2(0),
+  outlier_tvoc(0),
+  outlier_since(0),
+  has_outlier(false),
+  probation(false),
+  rollback_due(false),
+  probation_start(0),
+  probation_samples(0),
+  floor_samples(0),
+  fallback(),
+  rejects(0),
+  rollbacks(0) {
+}
+
+void BaselineQuality::init(const BaselineStore* baselines) {
+  store = baselines;
+  eco2_drift = 0;
+  tvoc_drift = 0;
+  probation = false;
+  rollback_due = false;
+  has_outlier = false;
+
+  // 古い順にドリフトを求める
+  BaselineRecord previous;
+  BaselineRecord next;
+  for (int index = (int)store->count() - 1; index > 0; index--) {
+    if (store->history(index, previous) && store->history(index - 1, next)) {
+      updateDrift(previous, next);
+    }
+  }
+}
+
+uint8_t BaselineQuality::historyCount() const {
+  // 新しい基準として受け入れた記録まで
+  BaselineRecord record;
+  uint8_t count = 0;
+  while (store != nullptr && store->history(count, record)) {
+    count++;
+    if (record.source == BASELINE_SOURCE_SHIFT) {
+      break;
+    }
+  }
+  return count;
+}
+
+void BaselineQuality::updateDrift(const BaselineRecord& previous, const BaselineRecord& next) {
+  // 時刻の分からない記録と間隔の短い記録は使わない（短い間隔の差はばらつきが大きい）
+  if (next.source == BASELINE_SOURCE_SHIFT || previous.epoch == 0 || next.epoch == 0 || (int32_t)(next.epoch - previous.epoch) < (int32_t)MIN_DRIFT_INTERVAL) {
+    return;
+  }
+  int64_t interval = next.epoch - previous.epoch;
+  int32_t eco2_rate = (int32_t)(((int64_t)next.eco2_base - previous.eco2_base) * 86400 * DRIFT_SCALE / interval);
+  int32_t tvoc_rate = (int32_t)(((int64_t)next.tvoc_base - previous.tvoc_base) * 86400 * DRIFT_SCALE / interval);
+  eco2_drift += (eco2_rate - eco2_drift) / DRIFT_WEIGHT;
+  tvoc_drift += (tvoc_rate - tvoc_drift) / DRIFT_WEIGHT;
+}
+
+uint16_t BaselineQuality::limit(const uint16_t* values, uint8_t count, uint16_t center, int32_t drift, uint32_t age) const {
+  // MAD × 4.5（正規分布の約3σ）
+  uint16_t deviations[BaselineStore::SLOT_COUNT];
+  for (uint8_t i = 0; i < count; i++) {
+    deviations[i] = difference(values[i], center);
+  }
+  uint32_t allowed = (uint32_t)median(deviations, count) * 9 / 2;
+  allowed = allowed < MIN_LIMIT ? MIN_LIMIT : allowed;
+  // 直近の記録からの経過時間に見込まれるドリフト
+  allowed += (uint32_t)((int64_t)(drift < 0 ? -drift : drift) * age / 86400 / DRIFT_SCALE);
+  return (uint16_t)(allowed < MAX_LIMIT ? allowed : MAX_LIMIT);
+}
+
+BaselineScore BaselineQuality::evaluate(uint16_t eco2_base, uint16_t tvoc_base, bool clean_air, uint32_t epoch,
+                                        unsigned long now) {
+  BaselineScore result = {};
+  result.verdict = BASELINE_ACCEPTED;
+  if (!clean_air) {
+    result.verdict = BASELINE_REJECTED_NOT_CLEAN;
+    rejects++;
+    return result;
+  }
+
+  uint8_t count = historyCount();
+  if (count < MIN_HISTORY) {
+    return result;
+  }
+
+  uint16_t eco2_values[BaselineStore::SLOT_COUNT];
+  uint16_t tvoc_values[BaselineStore::SLOT_COUNT];
+  BaselineRecord record;
+  uint32_t age = 0;
+  for (uint8_t i = 0; i < count; i++) {
+    store->history(i, record);
+    eco2_values[i] = record.eco2_base;
+    tvoc_values[i] = record.tvoc_base;
+    if (i == 0 && epoch != 0 && record.epoch != 0 && (int32_t)(epoch - record.epoch) > 0) {
+      age = epoch - record.epoch;
+    }
+  }
+  result.reference_eco2 = median(eco2_values, count);
+  result.reference_tvoc = median(tvoc_values, count);
+  result.limit_eco2 = limit(eco2_values, count, result.reference_eco2, eco2_drift, age);
+  result.limit_tvoc = limit(tvoc_values, count, result.reference_tvoc, tvoc_drift, age);
+
+  uint32_t eco2_score = (uint32_t)difference(eco2_base, result.reference_eco2) * 100 / result.limit_eco2;
+  uint32_t tvoc_score = (uint32_t)difference(tvoc_base, result.reference_tvoc) * 100 / result.limit_tvoc;
+  uint32_t score = eco2_score > tvoc_score ? eco2_score : tvoc_score;
+  result.score = (uint16_t)(score < UINT16_MAX ? score : UINT16_MAX);
+  if (score <= 100) {
+    has_outlier = false;
+    return result;
+  }
+
+  // 外れ値が互いに近い値で続いている間は、その最初の時刻から数える
+  if (!has_outlier || difference(eco2_base, outlier_eco2) > MIN_LIMIT || difference(tvoc_base, outlier_tvoc) > MIN_LIMIT) {
+    outlier_eco2 = eco2_base;
+    outlier_tvoc = tvoc_base;
+    outlier_since = now;
+    has_outlier = true;
+  }
+  if (now - outlier_since >= REGIME_TIME) {
+    Serial.println("Baseline: accepting a persistent shift of the baseline");
+    has_outlier = false;
+    result.shift = true;
+    return result;
+  }
+
+  result.verdict = BASELINE_REJECTED_OUTLIER;
+  rejects++;
+  return result;
+}
+
+void BaselineQuality::onSaved(const BaselineRecord* previous, const BaselineRecord& saved, unsigned long now) {
+  if (previous == nullptr) {
+    return;
+  }
+
+  saved_eco2_drift = eco2_drift;
+  saved_tvoc_drift = tvoc_drift;
+  updateDrift(*previous, saved);
+
+  // 戻す先と変わらない保存（定期的な書き直しなど）は監視しない
+  if (difference(saved.eco2_base, previous->eco2_base) <= BaselineStore::TOLERANCE &&
+      difference(saved.tvoc_base, previous->tvoc_base) <= BaselineStore::TOLERANCE) {
+    return;
+  }
+  // 監視中に保存した場合は、監視を始めたときの戻す先を保つ
+  if (!probation) {
+    fallback = *previous;
+  }
+  probation = true;
+  rollback_due = false;
+  probation_start = now;
+  probation_samples = 0;
+  floor_samples = 0;
+}
+
+void BaselineQuality::observe(uint16_t eco2, uint16_t tvoc, unsigned long now) {
+  if (!probation || rollback_due) {
+    return;
+  }
+
+  probation_samples++;
+  if (eco2 <= 400 && tvoc == 0) {
+    floor_samples++;
+  }
+  if (now - probation_start < PROBATION_TIME) {
+    return;
+  }
+
+  // 測定が半分以上欠けた場合は判定しない
+  probation = false;
+  if (probation_samples >= PROBATION_TIME / 1000 / 2 && floor_samples * 100 >= probation_samples * FLOOR_PERCENT) {
+    Serial.printf("Baseline: %lu of %lu readings at the floor since the last save\n",
+                  (unsigned long)floor_samples, (unsigned long)probation_samples);
+    rollback_due = true;
+  }
+}
+
+void BaselineQuality::onRolledBack() {
+  rollback_due = false;
+  probation = false;
+  eco2_drift = saved_eco2_drift;
+  tvoc_drift = saved_tvoc_drift;
+  rollbacks++;
+}
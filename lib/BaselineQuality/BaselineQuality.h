@@ -0,0 +1,102 @@
+#ifndef BASELINE_QUALITY_H
+#define BASELINE_QUALITY_H
+
+#include <Hal.h>
+#include <BaselineStore.h>
+
+// 保存前の判定
+enum BaselineVerdict : uint8_t {
+  BASELINE_ACCEPTED,
+  BASELINE_REJECTED_OUTLIER,     // 保存済みの履歴から外れている
+  BASELINE_REJECTED_NOT_CLEAN    // クリーンエアでない（手動保存）
+};
+
+// 保存しようとしたベースラインの評価
+struct BaselineScore {
+  BaselineVerdict verdict;
+  uint16_t reference_eco2;   // 履歴の中央値（履歴が足りなければ 0）
+  uint16_t reference_tvoc;
+  uint16_t limit_eco2;       // 中央値との差の許容値
+  uint16_t limit_tvoc;
+  uint16_t score;            // 許容値に対する差の割合 (%)、100 を超えると外れ値
+  bool shift;                // 続いた外れ値を新しい基準として受け入れる（BASELINE_SOURCE_SHIFT で保存する）
+};
+
+// ベースラインの品質管理（センサータスクで使用、メモリは一定）
+//
+// 保存前：BaselineStore の履歴の中央値との差を、履歴のばらつき（MAD）と
+//         記録間のドリフト（1日あたりの変化の指数移動平均）から求めた許容値と比べる
+// 保存後：PROBATION_TIME の間の測定がほぼ下限（eCO2 400 ppm・TVOC 0 ppb）に張り付いたら、
+//         溶剤などを基準に学習したベースラインとみなして保存前の記録へ戻す
+// 外れ値でも互いに近い値が REGIME_TIME 以上続いた場合は、設置場所の変化などとみなして受け入れ、
+// 以降はその記録より新しい履歴のみで判定する
+class BaselineQuality {
+public:
+  static const uint8_t MIN_HISTORY = 3;                  // 外れ値を判定する履歴の件数
+  static const uint16_t MIN_LIMIT = 400;                 // 許容値の範囲（ベースラインの生の値）
+  static const uint16_t MAX_LIMIT = 3000;
+  static const uint32_t MIN_DRIFT_INTERVAL = 3600;       // ドリフトを求める記録の最短の間隔 (s)
+  static const unsigned long PROBATION_TIME = 7200000;   // 保存後に測定を監視する時間 (ms)
+  static const uint8_t FLOOR_PERCENT = 95;               // 戻す判定の下限に張り付いた測定の割合
+  static const unsigned long REGIME_TIME = 259200000;    // 外れ値を受け入れるまでの時間 (ms) - 3日
+
+  BaselineQuality();
+
+  // 保存済みの履歴からドリフトを求める
+  void init(const BaselineStore* store);
+
+  // 保存してよいか（clean_air: 保存の条件を満たす空気か、epoch: UNIX時刻、未設定なら 0）
+  BaselineScore evaluate(uint16_t eco2_base, uint16_t tvoc_base, bool clean_air, uint32_t epoch, unsigned long now);
+
+  // 書き込んだ（previous: それまでの直近の記録）
+  void onSaved(const BaselineRecord* previous, const BaselineRecord& saved, unsigned long now);
+
+  // 測定ごとに呼び出す
+  void observe(uint16_t eco2, uint16_t tvoc, unsigned long now);
+  // 保存前の記録へ戻す必要がある
+  bool rollbackDue() const { return rollback_due; }
+  const BaselineRecord& rollbackTarget() const { return fallback; }
+  void onRolledBack();
+
+  // 1日あたりのドリフト（ベースラインの生の値）
+  int16_t eco2DriftPerDay() const { return (int16_t)(eco2_drift / DRIFT_SCALE); }
+  int16_t tvocDriftPerDay() const { return (int16_t)(tvoc_drift / DRIFT_SCALE); }
+
+  uint32_t rejectCount() const { return rejects; }
+  uint32_t rollbackCount() const { return rollbacks; }
+
+private:
+  static const int32_t DRIFT_SCALE = 16;     // ドリフトの固定小数点
+  static const uint8_t DRIFT_WEIGHT = 4;     // 指数移動平均の重み (1/4)
+
+  const BaselineStore* store;
+
+  // 記録間のドリフト（1日あたり × DRIFT_SCALE）
+  int32_t eco2_drift;
+  int32_t tvoc_drift;
+  int32_t saved_eco2_drift;    // 監視中の保存の前の値（戻す場合に使う）
+  int32_t saved_tvoc_drift;
+
+  // 続けて外れ値になった候補
+  uint16_t outlier_eco2;
+  uint16_t outlier_tvoc;
+  unsigned long outlier_since;
+  bool has_outlier;
+
+  // 保存後の監視
+  bool probation;
+  bool rollback_due;
+  unsigned long probation_start;
+  uint32_t probation_samples;
+  uint32_t floor_samples;
+  BaselineRecord fallback;
+
+  uint32_t rejects;
+  uint32_t rollbacks;
+
+  uint8_t historyCount() const;
+  void updateDrift(const BaselineRecord& previous, const BaselineRecord& next);
+  uint16_t limit(const uint16_t* values, uint8_t count, uint16_t median, int32_t drift, uint32_t age) const;
+};
+
+#endif // BASELINE_QUALITY_H
@@ -0,0 +1,156 @@
+#include "BaselineStore.h"
+#include <DataLogger.h>
+
+static const char* NVS_NAMESPACE = "baseline";
+static const char* LEGACY_NAMESPACE = "sgp30";
+
+static void slotKey(uint8_t slot, char* key) {
+  strcpy(key, "slot0");
+  key[4] = (char)('0' + slot);
+}
+
+static uint32_t recordCrc(const BaselineRecord& record) {
+  return logCrc32(reinterpret_cast<const uint8_t*>(&record), sizeof(record) - sizeof(record.crc));
+}
+
+static uint16_t difference(uint16_t a, uint16_t b) {
+  return a > b ? a - b : b - a;
+}
+
+BaselineStore::BaselineStore() :
+  store(nullptr),
+  sensor(0),
+  records(),
+  valid(),
+  newest(0),
+  has_newest(false),
+  writes(0),
+  skips(0),
+  failures(0) {
+  strcpy(space, NVS_NAMESPACE);
+}
+
+void BaselineStore::init(KeyValueStore* nvs, uint8_t sensor_index) {
+  store = nvs;
+  sensor = sensor_index;
+  has_newest = false;
+  if (sensor == 0) {
+    strcpy(space, NVS_NAMESPACE);
+  } else {
+    snprintf(space, sizeof(space), "%s%u", NVS_NAMESPACE, sensor);
+  }
+
+  bool opened = store->begin(space, true);
+  for (uint8_t slot = 0; slot < SLOT_COUNT; slot++) {
+    char key[8];
+    slotKey(slot, key);
+    BaselineRecord& record = records[slot];
+    // 書き込み途中の電源断などで壊れたスロットは空きとみなす
+    valid[slot] = opened && store->getBytes(key, &record, sizeof(record)) == sizeof(record) &&
+                  record.crc == recordCrc(record) && record.sequence % SLOT_COUNT == slot;
+    if (valid[slot] && (!has_newest || (int32_t)(record.sequence - newest) > 0)) {
+      newest = record.sequence;
+      has_newest = true;
+    }
+  }
+  store->end();
+
+  // 以前の形式は1台構成のものなのでセンサー0のみ
+  if (!has_newest && sensor == 0 && loadLegacy()) {
+    Serial.println("Baseline: using the baseline saved in the previous format");
+  }
+}
+
+bool BaselineStore::loadLegacy() {
+  if (!store->begin(LEGACY_NAMESPACE, true)) {
+    return false;
+  }
+  uint16_t eco2_base = store->getUShort("eco2_base", 0);
+  uint16_t tvoc_base = store->getUShort("tvoc_base", 0);
+  store->end();
+  if (eco2_base == 0 || tvoc_base == 0) {
+    return false;
+  }
+
+  // 通し番号 0 の記録として扱う（書き直さず、次の保存はスロット1へ）
+  BaselineRecord& record = records[0];
+  record = {};
+  record.eco2_base = eco2_base;
+  record.tvoc_base = tvoc_base;
+  record.source = BASELINE_SOURCE_LEGACY;
+  record.crc = recordCrc(record);
+  valid[0] = true;
+  newest = 0;
+  has_newest = true;
+  return true;
+}
+
+bool BaselineStore::history(uint8_t index, BaselineRecord& record) const {
+  if (!has_newest || index >= SLOT_COUNT || index > newest) {
+    return false;
+  }
+  uint32_t sequence = newest - index;
+  uint8_t slot = sequence % SLOT_COUNT;
+  if (!valid[slot] || records[slot].sequence != sequence) {
+    return false;
+  }
+  record = records[slot];
+  return true;
+}
+
+uint8_t BaselineStore::count() const {
+  BaselineRecord record;
+  uint8_t n = 0;
+  while (history(n, record)) {
+    n++;
+  }
+  return n;
+}
+
+BaselineWrite BaselineStore::save(uint16_t eco2_base, uint16_t tvoc_base, BaselineSource source, uint32_t epoch) {
+  // 直近の記録とほぼ同じなら書き込まない（時刻が分かる場合は REFRESH_AGE ごとに書き直す）
+  BaselineRecord last;
+  if (latest(last) && difference(last.eco2_base, eco2_base) <= TOLERANCE &&
+      difference(last.tvoc_base, tvoc_base) <= TOLERANCE &&
+      (epoch == 0 || last.epoch == 0 || epoch - last.epoch < REFRESH_AGE)) {
+    skips++;
+    return BASELINE_UNCHANGED;
+  }
+
+  BaselineRecord record = {};
+  record.sequence = has_newest ? newest + 1 : 1;
+  record.epoch = epoch;
+  record.eco2_base = eco2_base;
+  record.tvoc_base = tvoc_base;
+  record.source = source;
+  record.crc = recordCrc(record);
+
+  uint8_t slot = record.sequence % SLOT_COUNT;
+  char key[8];
+  slotKey(slot, key);
+  bool written = store != nullptr && store->begin(space, false);
+  written = written && store->putBytes(key, &record, sizeof(record)) == sizeof(record);
+  if (store != nullptr) {
+    store->end();
+  }
+  if (!written) {
+    failures++;
+    return BASELINE_FAILED;
+  }
+
+  records[slot] = record;
+  valid[slot] = true;
+  newest = record.sequence;
+  has_newest = true;
+  writes++;
+  return BASELINE_WRITTEN;
+}
+
+void BaselineStore::logStats() const {
+  char label[16] = "Baseline";
+  if (sensor != 0) {
+    snprintf(label, sizeof(label), "Baseline #%u", sensor);
+  }
+  Serial.printf("%s: %u records, %lu writes, %lu unchanged (not written), %lu failures\n", label, count(),
+                (unsigned long)writes, (unsigned long)skips, (unsigned long)failures);
+}
@@ -0,0 +1,83 @@
+#ifndef BASELINE_STORE_H
+#define BASELINE_STORE_H
+
+#include <Hal.h>
+
+// ベースラインを保存した契機
+enum BaselineSource : uint8_t {
+  BASELINE_SOURCE_MANUAL,      // Bボタン
+  BASELINE_SOURCE_CLEAN_AIR,   // クリーンエアの自動判定
+  BASELINE_SOURCE_PERIODIC,    // 12時間ごとの定期保存
+  BASELINE_SOURCE_LEGACY,      // 以前の形式（"sgp30" の2つのキー）から読み込んだもの
+  BASELINE_SOURCE_ROLLBACK,    // 保存後の測定が不自然だったため前の記録へ戻した
+  BASELINE_SOURCE_SHIFT        // 外れ値が続いたため新しい基準として受け入れた（以前の記録は判定に使わない）
+};
+
+// ベースラインの記録（NVSの1スロット）
+struct BaselineRecord {
+  uint32_t sequence;    // 書き込みごとに増える通し番号（以前の形式から読み込んだものは 0）
+  uint32_t epoch;       // 保存したUNIX時刻（時刻未設定なら 0）
+  uint16_t eco2_base;
+  uint16_t tvoc_base;
+  uint8_t source;       // BaselineSource
+  uint8_t reserved[3];
+  uint32_t crc;         // crc より前の CRC-32
+};
+
+// 保存の結果
+enum BaselineWrite : uint8_t {
+  BASELINE_WRITTEN,
+  BASELINE_UNCHANGED,   // 直近の記録と差がないので書き込まなかった
+  BASELINE_FAILED
+};
+
+// ベースラインの保存（センサータスクで使用）
+//
+// 記録は SLOT_COUNT 個のスロット（キー "slot0"〜）へ順に書き込み、同じキーを書き換え続けない。
+// センサーごとに別の名前空間（センサー0は "baseline"、以降は "baseline1"〜）に保存する。
+// 直近の記録との差が TOLERANCE 以内なら REFRESH_AGE が過ぎるまで書き込まない。
+// 残っているスロットが直近 SLOT_COUNT 件の履歴になる（新しい順に history() で参照）
+class BaselineStore {
+public:
+  static const uint8_t SLOT_COUNT = 8;
+  static const uint16_t TOLERANCE = 32;            // 書き込みを省く差（ベースラインの生の値）
+  static const uint32_t REFRESH_AGE = 86400;       // 差がなくても書き直す古さ (s)
+
+  BaselineStore();
+
+  static const size_t NAME_LENGTH = 16;            // NVSの名前空間の最大長（終端込み）
+
+  // スロットを読み込む（センサー0のみ、なければ以前の形式のキーを読み込む）
+  void init(KeyValueStore* store, uint8_t sensor = 0);
+
+  // 直近の記録（なければ false）
+  bool latest(BaselineRecord& record) const { return history(0, record); }
+  // 新しい順に index 番目の記録（index 0 は latest()、通し番号が途切れたところまで）
+  bool history(uint8_t index, BaselineRecord& record) const;
+  uint8_t count() const;
+
+  BaselineWrite save(uint16_t eco2_base, uint16_t tvoc_base, BaselineSource source, uint32_t epoch);
+
+  uint32_t writeCount() const { return writes; }
+  uint32_t skipCount() const { return skips; }
+  uint32_t failureCount() const { return failures; }
+  // 起動以降の書き込み・省略の回数をSerialへ出力
+  void logStats() const;
+
+private:
+  KeyValueStore* store;
+  uint8_t sensor;
+  char space[NAME_LENGTH];              // NVSの名前空間
+  BaselineRecord records[SLOT_COUNT];   // スロットの内容（通し番号 % SLOT_COUNT 番目）
+  bool valid[SLOT_COUNT];
+  uint32_t newest;                      // 直近の記録の通し番号
+  bool has_newest;
+
+  uint32_t writes;
+  uint32_t skips;
+  uint32_t failures;
+
+  bool loadLegacy();
+};
+
+#endif // BASELINE_STORE_H
@@ -0,0 +1,37 @@
+#include "BootProfile.h"
+
+BootProfile::BootProfile() :
+  names(),
+  times(),
+  count(0),
+  first_reading(0),
+  reported(false) {
+}
+
+void BootProfile::mark(const char* name) {
+  uint32_t now = millis();
+  uint32_t previous = count > 0 ? times[count - 1] : 0;
+  Serial.printf("[boot] %s at %lu ms (+%lu ms)\n", name, (unsigned long)now, (unsigned long)(now - previous));
+
+  if (count < MAX_PHASES) {
+    names[count] = name;
+    times[count] = now;
+    count++;
+  }
+}
+
+void BootProfile::firstReading() {
+  if (reported) {
+    return;
+  }
+  reported = true;
+  first_reading = millis();
+
+  Serial.printf("[boot] first reading at %lu ms:", (unsigned long)first_reading);
+  uint32_t previous = 0;
+  for (uint8_t i = 0; i < count; i++) {
+    Serial.printf(" %s +%lu", names[i], (unsigned long)(times[i] - previous));
+    previous = times[i];
+  }
+  Serial.printf(" wait +%lu\n", (unsigned long)(first_reading - previous));
+}
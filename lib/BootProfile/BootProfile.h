@@ -0,0 +1,32 @@
+#ifndef BOOT_PROFILE_H
+#define BOOT_PROFILE_H
+
+#include <Hal.h>
+
+// 起動の各段階の時刻の記録（起動時間の回帰を追うためSerialへ出力）
+// 時刻は millis() なので、ブートローダーの時間は含まない
+class BootProfile {
+public:
+  static const uint8_t MAX_PHASES = 16;
+
+  BootProfile();
+
+  // 段階の終了を記録して "[boot] name at X ms (+Y ms)" を出力（name は文字列リテラル）
+  void mark(const char* name);
+
+  // 最初の有効な測定が描画タスクに届いた時刻を記録し、各段階の一覧を出力（2回目以降は何もしない）
+  void firstReading();
+
+  bool hasFirstReading() const { return reported; }
+  // 最初の有効な測定の時刻 (ms)（まだなら 0）
+  uint32_t firstReadingMillis() const { return first_reading; }
+
+private:
+  const char* names[MAX_PHASES];
+  uint32_t times[MAX_PHASES];
+  uint8_t count;
+  uint32_t first_reading;
+  bool reported;
+};
+
+#endif // BOOT_PROFILE_H
@@ -0,0 +1,336 @@
+#include "DataLogger.h"
+
+static const uint32_t CRC_OFFSET = LOG_BLOCK_SIZE - 4;
+
+static void putU16(uint8_t* p, uint16_t value) {
+  p[0] = value & 0xFF;
+  p[1] = value >> 8;
+}
+
+static void putU32(uint8_t* p, uint32_t value) {
+  putU16(p, value & 0xFFFF);
+  putU16(p + 2, value >> 16);
+}
+
+static uint16_t getU16(const uint8_t* p) {
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t getU32(const uint8_t* p) {
+  return getU16(p) | ((uint32_t)getU16(p + 2) << 16);
+}
+
+uint32_t logCrc32(const uint8_t* data, size_t length) {
+  // 1ブロック（数十秒に1回）なのでテーブルを持たないビット単位の計算
+  uint32_t crc = 0xFFFFFFFF;
+  for (size_t i = 0; i < length; i++) {
+    crc ^= data[i];
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+    }
+  }
+  return ~crc;
+}
+
+// マジック・バージョン・件数・CRCがすべて正しいブロックか
+static bool isValidBlock(const uint8_t* block) {
+  uint8_t count = block[12];
+  return getU32(block) == LOG_BLOCK_MAGIC &&
+         block[13] == LOG_VERSION &&
+         count > 0 && count <= LOG_RECORDS_PER_BLOCK &&
+         getU32(block + CRC_OFFSET) == logCrc32(block, CRC_OFFSET);
+}
+
+// ---- DataLogger ----
+
+DataLogger::DataLogger() :
+  fs(nullptr),
+  utc_offset(0),
+  active(0),
+  file(nullptr),
+  file_day(-1),
+  sequence(0),
+  blocks_written(0),
+  interval_blocks(0),
+  interval_errors(0),
+  max_write_us(0) {
+  dir[0] = '\0';
+  path[0] = '\0';
+  for (Block& block : blocks) {
+    block.count = 0;
+    block.day = -1;
+    block.pending = false;
+  }
+}
+
+bool DataLogger::init(FileSystem* file_system, const char* directory, int32_t offset) {
+  if (!file_system->makeDir(directory)) {
+    Serial.printf("Cannot create log directory %s\n", directory);
+    return false;
+  }
+
+  fs = file_system;
+  strncpy(dir, directory, sizeof(dir) - 1);
+  dir[sizeof(dir) - 1] = '\0';
+  utc_offset = offset;
+  return true;
+}
+
+void DataLogger::append(const LogRecord& record, uint32_t epoch) {
+  if (fs == nullptr) {
+    return;
+  }
+
+  // 日付が変わったら書きかけのブロックを閉じて次のファイルへ
+  int32_t day = epoch != 0 ? (int32_t)(((int64_t)epoch + utc_offset) / 86400) : -1;
+  if (blocks[active].count > 0 && blocks[active].day != day) {
+    seal(active);
+  }
+
+  Block& block = blocks[active];
+  if (block.count == 0) {
+    block.day = day;
+    putU32(block.data + 8, epoch);
+  }
+
+  uint8_t* p = block.data + LOG_HEADER_SIZE + block.count * LOG_RECORD_SIZE;
+  putU32(p, record.timestamp);
+  putU16(p + 4, record.tvoc);
+  putU16(p + 6, record.eco2);
+  putU16(p + 8, record.raw_h2);
+  putU16(p + 10, record.raw_ethanol);
+  block.count++;
+
+  if (block.count >= LOG_RECORDS_PER_BLOCK) {
+    seal(active);
+  }
+}
+
+void DataLogger::seal(uint8_t index) {
+  blocks[index].pending = true;
+  active = (index + 1) % BUFFER_BLOCKS;
+
+  // service() が間に合わなかった場合はここで書き込む
+  if (blocks[active].pending) {
+    writeBlock(blocks[active]);
+  }
+  blocks[active].count = 0;
+}
+
+void DataLogger::service() {
+  // 書き込み待ちは古い順（現在のブロックの次から）
+  for (uint8_t i = 1; i <= BUFFER_BLOCKS; i++) {
+    Block& block = blocks[(active + i) % BUFFER_BLOCKS];
+    if (block.pending) {
+      writeBlock(block);
+    }
+  }
+}
+
+void DataLogger::close() {
+  if (fs == nullptr) {
+    return;
+  }
+
+  if (blocks[active].count > 0) {
+    seal(active);
+  }
+  service();
+  closeFile();
+}
+
+void DataLogger::writeBlock(Block& block) {
+  block.pending = false;
+
+  if (file == nullptr || block.day != file_day) {
+    closeFile();
+    if (!openFile(block.day)) {
+      interval_errors++;
+      return;
+    }
+  }
+
+  uint8_t* data = block.data;
+  putU32(data, LOG_BLOCK_MAGIC);
+  putU32(data + 4, sequence);
+  data[12] = block.count;
+  data[13] = LOG_VERSION;
+  putU16(data + 14, 0);
+  uint32_t used = LOG_HEADER_SIZE + block.count * LOG_RECORD_SIZE;
+  memset(data + used, 0, CRC_OFFSET - used);
+  putU32(data + CRC_OFFSET, logCrc32(data, CRC_OFFSET));
+
+  // ブロックごとにflush()してファイルサイズを確定させる
+  unsigned long start_us = micros();
+  size_t written = file->write(data, LOG_BLOCK_SIZE);
+  file->flush();
+  uint32_t elapsed_us = micros() - start_us;
+
+  if (written != LOG_BLOCK_SIZE) {
+    Serial.printf("Log write failed: %s\n", path);
+    interval_errors++;
+    closeFile();
+    return;
+  }
+
+  sequence++;
+  blocks_written++;
+  interval_blocks++;
+  if (elapsed_us > max_write_us) {
+    max_write_us = elapsed_us;
+  }
+}
+
+bool DataLogger::openFile(int32_t day) {
+  makePath(day, path);
+
+  // 既存のファイルには最後の正しいブロックの続きの通し番号で追記する
+  uint32_t size = 0;
+  FileHandle* existing = fs->open(path, FILE_MODE_READ);
+  if (existing != nullptr) {
+    size = existing->size();
+    uint8_t last[LOG_BLOCK_SIZE];
+    if (size >= LOG_BLOCK_SIZE &&
+        existing->seek((size / LOG_BLOCK_SIZE - 1) * LOG_BLOCK_SIZE) &&
+        existing->read(last, LOG_BLOCK_SIZE) == LOG_BLOCK_SIZE &&
+        isValidBlock(last) && getU32(last + 4) >= sequence) {
+      sequence = getU32(last + 4) + 1;
+    }
+    fs->close(existing);
+  }
+
+  file = fs->open(path, FILE_MODE_APPEND);
+  if (file == nullptr) {
+    Serial.printf("Cannot open log file %s\n", path);
+    return false;
+  }
+  file_day = day;
+
+  // 電源断で書きかけになったブロックの後ろを0で埋めてセクタ境界に揃える
+  uint32_t partial = size % LOG_BLOCK_SIZE;
+  if (partial != 0) {
+    uint8_t padding[LOG_BLOCK_SIZE] = {};
+    file->write(padding, LOG_BLOCK_SIZE - partial);
+    Serial.printf("Log file %s: padded %lu bytes after a torn block\n", path, (unsigned long)(LOG_BLOCK_SIZE - partial));
+  }
+
+  Serial.printf("Logging to %s\n", path);
+  return true;
+}
+
+void DataLogger::closeFile() {
+  if (file != nullptr) {
+    fs->close(file);
+    file = nullptr;
+  }
+  file_day = -1;
+}
+
+void DataLogger::makePath(int32_t day, char* buffer) const {
+  if (day < 0) {
+    snprintf(buffer, PATH_LENGTH, "%s/nodate.tvl", dir);
+    return;
+  }
+
+  // 1970-01-01からの日数を年月日へ（グレゴリオ暦）
+  int32_t z = day + 719468;
+  int32_t era = z / 146097;
+  uint32_t doe = (uint32_t)(z - era * 146097);
+  uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  uint32_t mp = (5 * doy + 2) / 153;
+  uint32_t d = doy - (153 * mp + 2) / 5 + 1;
+  uint32_t m = mp < 10 ? mp + 3 : mp - 9;
+  uint32_t y = yoe + era * 400 + (m <= 2 ? 1 : 0);
+
+  snprintf(buffer, PATH_LENGTH, "%s/%04u%02u%02u.tvl", dir,
+           (unsigned)(y % 10000), (unsigned)(uint8_t)m, (unsigned)(uint8_t)d);
+}
+
+void DataLogger::logStats() {
+  if (fs == nullptr) {
+    return;
+  }
+
+  Serial.printf("Log: %lu blocks to %s (total %lu), max write %lu us, errors %lu\n",
+                (unsigned long)interval_blocks, file != nullptr ? path : "-",
+                (unsigned long)blocks_written, (unsigned long)max_write_us,
+                (unsigned long)interval_errors);
+  interval_blocks = 0;
+  interval_errors = 0;
+  max_write_us = 0;
+}
+
+// ---- LogReader ----
+
+LogReader::LogReader() :
+  file(nullptr),
+  count(0),
+  index(0),
+  block_epoch(0),
+  first_timestamp(0),
+  last_sequence(0),
+  valid_blocks(0),
+  bad_blocks(0),
+  missing_blocks(0) {
+}
+
+bool LogReader::begin(FileHandle* input) {
+  file = input;
+  count = 0;
+  index = 0;
+  valid_blocks = 0;
+  bad_blocks = 0;
+  missing_blocks = 0;
+  return file != nullptr;
+}
+
+bool LogReader::next(LogRecord& record, uint32_t& epoch) {
+  while (index >= count) {
+    if (!readBlock()) {
+      return false;
+    }
+  }
+
+  const uint8_t* p = block + LOG_HEADER_SIZE + index * LOG_RECORD_SIZE;
+  record.timestamp = getU32(p);
+  record.tvoc = getU16(p + 4);
+  record.eco2 = getU16(p + 6);
+  record.raw_h2 = getU16(p + 8);
+  record.raw_ethanol = getU16(p + 10);
+  index++;
+
+  // ブロック内の時刻は先頭の記録からの経過時間で求める
+  epoch = block_epoch != 0 ? block_epoch + (record.timestamp - first_timestamp) / 1000 : 0;
+  return true;
+}
+
+bool LogReader::readBlock() {
+  for (;;) {
+    if (file->read(block, LOG_BLOCK_SIZE) != LOG_BLOCK_SIZE) {
+      return false;
+    }
+
+    // 書きかけのブロックの後ろの詰め物
+    if (getU32(block) == 0) {
+      continue;
+    }
+    if (!isValidBlock(block)) {
+      bad_blocks++;
+      continue;
+    }
+
+    uint32_t seq = getU32(block + 4);
+    if (valid_blocks > 0 && seq > last_sequence + 1) {
+      missing_blocks += seq - last_sequence - 1;
+    }
+    last_sequence = seq;
+    valid_blocks++;
+
+    count = block[12];
+    index = 0;
+    block_epoch = getU32(block + 8);
+    first_timestamp = getU32(block + LOG_HEADER_SIZE);
+    return true;
+  }
+}
@@ -0,0 +1,121 @@
+#ifndef DATA_LOGGER_H
+#define DATA_LOGGER_H
+
+#include <Hal.h>
+
+// 測定履歴のSDカード保存（512バイトのブロック単位、日ごとのファイル）
+//
+//   ブロック（リトルエンディアン、セクタ境界に揃える）
+//     マジック "TVLB" u32 | 通し番号 u32 | 先頭の記録のUNIX時刻 u32（0: 時刻不明）
+//     | 件数 u8 | バージョン u8 | 予約 u16 | 記録 × LOG_RECORDS_PER_BLOCK | CRC-32 u32（先頭から508バイト）
+//
+// ブロックは1回の書き込みで追記するので、電源断で失われるのは書きかけの1ブロックのみ
+// 壊れたブロックはCRCで、欠けたブロックは通し番号の飛びで検出できる
+
+static const uint32_t LOG_BLOCK_SIZE = 512;
+static const uint32_t LOG_BLOCK_MAGIC = 0x424C5654;   // "TVLB"
+static const uint8_t LOG_VERSION = 1;
+static const uint32_t LOG_HEADER_SIZE = 16;
+static const uint32_t LOG_RECORD_SIZE = 12;
+static const uint32_t LOG_RECORDS_PER_BLOCK = (LOG_BLOCK_SIZE - LOG_HEADER_SIZE - 4) / LOG_RECORD_SIZE;
+
+// 1件の記録
+struct LogRecord {
+  uint32_t timestamp;     // 測定時刻 (ms、起動からの時間)
+  uint16_t tvoc;          // TVOC (ppb)
+  uint16_t eco2;          // eCO2 (ppm)
+  uint16_t raw_h2;        // H2の生信号（測定していない場合は 0）
+  uint16_t raw_ethanol;   // エタノールの生信号（測定していない場合は 0）
+};
+
+// CRC-32（IEEE 802.3）
+uint32_t logCrc32(const uint8_t* data, size_t length);
+
+// 測定履歴の書き込み（描画タスクで使用）
+// append() はメモリ上のブロックに追加するだけで、満杯のブロックは service() でまとめて書き込む
+class DataLogger {
+public:
+  DataLogger();
+
+  // dir: 保存先ディレクトリ、utc_offset: ファイル名の日付に使う時差 (s)
+  bool init(FileSystem* fs, const char* dir, int32_t utc_offset);
+
+  // 記録の追加（epoch: 現在のUNIX時刻、0: 不明）
+  void append(const LogRecord& record, uint32_t epoch);
+  // 満杯のブロックをファイルへ書き込む
+  void service();
+  // 書きかけのブロックも書き込んでファイルを閉じる
+  void close();
+
+  bool isEnabled() const { return fs != nullptr; }
+  uint32_t blockCount() const { return blocks_written; }
+
+  // 前回の出力以降の書き込み統計をSerialへ出力
+  void logStats();
+
+private:
+  static const uint8_t BUFFER_BLOCKS = 2;
+  static const size_t DIR_LENGTH = 24;
+  static const size_t PATH_LENGTH = 48;
+
+  struct Block {
+    uint8_t data[LOG_BLOCK_SIZE];
+    uint8_t count;
+    int32_t day;          // ファイルを決める日（-1: 時刻不明）
+    bool pending;         // 書き込み待ち
+  };
+
+  FileSystem* fs;
+  char dir[DIR_LENGTH];
+  int32_t utc_offset;
+
+  Block blocks[BUFFER_BLOCKS];
+  uint8_t active;
+
+  FileHandle* file;
+  char path[PATH_LENGTH];
+  int32_t file_day;       // 開いているファイルの日
+  uint32_t sequence;      // 次に書き込むブロックの通し番号
+
+  // 統計
+  uint32_t blocks_written;
+  uint32_t interval_blocks;
+  uint32_t interval_errors;
+  uint32_t max_write_us;
+
+  void seal(uint8_t index);
+  void writeBlock(Block& block);
+  bool openFile(int32_t day);
+  void closeFile();
+  void makePath(int32_t day, char* buffer) const;
+};
+
+// 測定履歴の読み込み（ホストでのCSV変換など）
+class LogReader {
+public:
+  LogReader();
+
+  bool begin(FileHandle* file);
+  // 次の記録（epoch: 記録のUNIX時刻、0: 不明）。壊れたブロックは読み飛ばす
+  bool next(LogRecord& record, uint32_t& epoch);
+
+  uint32_t validBlocks() const { return valid_blocks; }
+  uint32_t badBlocks() const { return bad_blocks; }
+  uint32_t missingBlocks() const { return missing_blocks; }
+
+private:
+  FileHandle* file;
+  uint8_t block[LOG_BLOCK_SIZE];
+  uint8_t count;
+  uint8_t index;
+  uint32_t block_epoch;
+  uint32_t first_timestamp;
+  uint32_t last_sequence;
+  uint32_t valid_blocks;
+  uint32_t bad_blocks;
+  uint32_t missing_blocks;
+
+  bool readBlock();
+};
+
+#endif // DATA_LOGGER_H
@@ -0,0 +1,89 @@
+#include "EnergyMeter.h"
+
+static const uint64_t US_PER_HOUR = 3600000000ULL;
+
+EnergyMeter::EnergyMeter(ClockFunction clock_us) :
+  now_us(clock_us),
+  last_us(clock_us()),
+  sleeping(false),
+  cpu_ua(0),
+  backlight_ua(0),
+  elapsed_us(0),
+  sleep_us(0),
+  bus_us(),
+  charge_ua_us(0),
+  total_ua_us(0) {
+}
+
+void EnergyMeter::reset() {
+  settle();
+  elapsed_us = 0;
+  sleep_us = 0;
+  for (int i = 0; i < ENERGY_BUS_COUNT; i++) {
+    bus_us[i] = 0;
+  }
+  charge_ua_us = 0;
+}
+
+void EnergyMeter::settle() {
+  // 前回からの経過時間を現在の状態で積算（差分計算なので時計の一周に影響されない）
+  unsigned long now = now_us();
+  uint32_t dt = (uint32_t)(now - last_us);
+  last_us = now;
+
+  elapsed_us += dt;
+  if (sleeping) {
+    sleep_us += dt;
+  }
+
+  uint32_t ua = (sleeping ? SLEEP_UA : cpu_ua) + backlight_ua + SENSOR_UA;
+  addCharge((uint64_t)ua * dt);
+}
+
+void EnergyMeter::addCharge(uint64_t ua_us) {
+  charge_ua_us += ua_us;
+  total_ua_us += ua_us;
+}
+
+void EnergyMeter::setCpuCurrent(uint32_t ua) {
+  settle();
+  cpu_ua = ua;
+}
+
+void EnergyMeter::setBacklightCurrent(uint32_t ua) {
+  settle();
+  backlight_ua = ua;
+}
+
+void EnergyMeter::enterSleep() {
+  settle();
+  sleeping = true;
+}
+
+void EnergyMeter::exitSleep() {
+  settle();
+  sleeping = false;
+}
+
+void EnergyMeter::addBusyTime(EnergyBus bus, uint32_t us) {
+  if (bus >= ENERGY_BUS_COUNT) {
+    return;
+  }
+  bus_us[bus] += us;
+  addCharge((uint64_t)us * (bus == ENERGY_BUS_SPI ? SPI_BUS_UA : I2C_BUS_UA));
+}
+
+EnergyReport EnergyMeter::report() {
+  settle();
+
+  EnergyReport result;
+  result.elapsed_ms = (uint32_t)(elapsed_us / 1000);
+  result.sleep_ms = (uint32_t)(sleep_us / 1000);
+  result.awake_ms = result.elapsed_ms - result.sleep_ms;
+  result.spi_busy_ms = (uint32_t)(bus_us[ENERGY_BUS_SPI] / 1000);
+  result.i2c_busy_ms = (uint32_t)(bus_us[ENERGY_BUS_I2C] / 1000);
+  result.duty_permille = elapsed_us > 0 ? (uint16_t)((elapsed_us - sleep_us) * 1000 / elapsed_us) : 1000;
+  result.average_ua = elapsed_us > 0 ? (uint32_t)(charge_ua_us / elapsed_us) : 0;
+  result.total_uah = (uint32_t)(total_ua_us / US_PER_HOUR);
+  return result;
+}
@@ -0,0 +1,70 @@
+#ifndef ENERGY_METER_H
+#define ENERGY_METER_H
+
+#include <stdint.h>
+
+typedef unsigned long (*ClockFunction)();
+
+// 稼働時間を計上するバス
+enum EnergyBus {
+  ENERGY_BUS_SPI,   // LCD
+  ENERGY_BUS_I2C,   // SGP30
+  ENERGY_BUS_COUNT
+};
+
+// 集計結果（前回のリセット以降）
+struct EnergyReport {
+  uint32_t elapsed_ms;      // 経過時間
+  uint32_t awake_ms;        // CPU稼働時間
+  uint32_t sleep_ms;        // ライトスリープ時間
+  uint32_t spi_busy_ms;     // SPI転送時間
+  uint32_t i2c_busy_ms;     // I2C通信時間（SGP30の測定待ちを含む）
+  uint16_t duty_permille;   // 稼働率（‰）
+  uint32_t average_ua;      // 推定平均電流 (uA)
+  uint32_t total_uah;       // 起動からの推定消費電荷 (uAh)
+};
+
+// 状態ごとの滞在時間と電流モデルから消費電力を推定する（時計は差し替え可能）
+class EnergyMeter {
+public:
+  // 電流モデル (uA)
+  static const uint32_t SLEEP_UA = 800;        // ライトスリープ時のESP32
+  static const uint32_t SENSOR_UA = 48000;     // SGP30（ホットプレートは常時加熱）
+  static const uint32_t SPI_BUS_UA = 10000;    // SPI転送中の追加分
+  static const uint32_t I2C_BUS_UA = 1000;     // I2C通信中の追加分
+
+  EnergyMeter(ClockFunction clock_us);
+
+  // 集計区間のリセット（累積電荷は保持）
+  void reset();
+
+  // 状態の変化（変化までの時間をそれまでの電流で積算）
+  void setCpuCurrent(uint32_t ua);
+  void setBacklightCurrent(uint32_t ua);
+  void enterSleep();
+  void exitSleep();
+  bool isSleeping() const { return sleeping; }
+
+  // バスの稼働時間を加算
+  void addBusyTime(EnergyBus bus, uint32_t us);
+
+  EnergyReport report();
+
+private:
+  ClockFunction now_us;
+  unsigned long last_us;       // 最後に積算した時刻
+  bool sleeping;
+  uint32_t cpu_ua;
+  uint32_t backlight_ua;
+
+  uint64_t elapsed_us;
+  uint64_t sleep_us;
+  uint64_t bus_us[ENERGY_BUS_COUNT];
+  uint64_t charge_ua_us;       // 集計区間の電荷 (uA*us)
+  uint64_t total_ua_us;        // 累積電荷 (uA*us)
+
+  void settle();
+  void addCharge(uint64_t ua_us);
+};
+
+#endif // ENERGY_METER_H
@@ -0,0 +1,210 @@
+#include "ForwardQueue.h"
+
+static void putU16(uint8_t* p, uint16_t value) {
+  p[0] = value & 0xFF;
+  p[1] = value >> 8;
+}
+
+static void putU32(uint8_t* p, uint32_t value) {
+  putU16(p, value & 0xFFFF);
+  putU16(p + 2, value >> 16);
+}
+
+static uint16_t getU16(const uint8_t* p) {
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t getU32(const uint8_t* p) {
+  return getU16(p) | ((uint32_t)getU16(p + 2) << 16);
+}
+
+ForwardQueue::ForwardQueue() :
+  head(0),
+  count(0),
+  fs(nullptr),
+  spool_records(0),
+  spool_read(0),
+  spool_writable(true),
+  peeked_spool(false),
+  peeked(0),
+  dropped_samples(0),
+  spilled_samples(0) {
+  path[0] = '\0';
+}
+
+void ForwardQueue::init(FileSystem* file_system, const char* spool_path) {
+  fs = file_system;
+  if (fs == nullptr) {
+    return;
+  }
+  strncpy(path, spool_path, sizeof(path) - 1);
+  path[sizeof(path) - 1] = '\0';
+
+  // 前回の起動で送れなかった分
+  FileHandle* file = fs->open(path, FILE_MODE_READ);
+  if (file == nullptr) {
+    return;
+  }
+  uint32_t size = file->size();
+  fs->close(file);
+
+  // 書きかけの1件は0で埋めて境界を揃える（読み込み時に読み飛ばす）
+  uint32_t partial = size % QUEUED_SAMPLE_SIZE;
+  if (partial != 0) {
+    file = fs->open(path, FILE_MODE_APPEND);
+    if (file != nullptr) {
+      uint8_t padding[QUEUED_SAMPLE_SIZE] = {};
+      file->write(padding, QUEUED_SAMPLE_SIZE - partial);
+      fs->close(file);
+      size += QUEUED_SAMPLE_SIZE - partial;
+    }
+  }
+  spool_records = size / QUEUED_SAMPLE_SIZE;
+  if (spool_records > 0) {
+    Serial.printf("Forward queue: %lu samples pending in %s\n", (unsigned long)spool_records, path);
+  }
+}
+
+void ForwardQueue::push(const QueuedSample& sample) {
+  if (count == RAM_CAPACITY) {
+    // 送信中の分はスプールへ移せないので、今回の測定を捨てる
+    if (peeked > 0 && !peeked_spool) {
+      dropped_samples++;
+      return;
+    }
+    // スプールへ移せなければ最も古い測定を捨てる
+    if (!spill()) {
+      head = (head + 1) % RAM_CAPACITY;
+      count--;
+      dropped_samples++;
+    }
+  }
+
+  ram[(head + count) % RAM_CAPACITY] = sample;
+  count++;
+}
+
+bool ForwardQueue::spill() {
+  if (fs == nullptr || !spool_writable || spool_records + SPILL_COUNT > SPOOL_CAPACITY) {
+    return false;
+  }
+
+  uint8_t buffer[SPILL_COUNT * QUEUED_SAMPLE_SIZE];
+  for (size_t i = 0; i < SPILL_COUNT; i++) {
+    const QueuedSample& sample = ram[(head + i) % RAM_CAPACITY];
+    uint8_t* p = buffer + i * QUEUED_SAMPLE_SIZE;
+    putU32(p, sample.epoch);
+    putU32(p + 4, sample.timestamp);
+    putU16(p + 8, sample.tvoc);
+    putU16(p + 10, sample.eco2);
+  }
+
+  FileHandle* file = fs->open(path, FILE_MODE_APPEND);
+  if (file == nullptr) {
+    return false;
+  }
+  size_t written = file->write(buffer, sizeof(buffer));
+  file->flush();
+  fs->close(file);
+
+  // 一部だけ書けた場合も件数の境界までは有効（残りは次回の起動時に詰め物になる）
+  // 続きを書くと境界がずれるので、以降はRAMのみで蓄積する
+  size_t moved = written / QUEUED_SAMPLE_SIZE;
+  if (written != sizeof(buffer)) {
+    Serial.printf("Forward queue: spool write failed: %s\n", path);
+    spool_writable = false;
+  }
+
+  spool_records += moved;
+  head = (head + moved) % RAM_CAPACITY;
+  count -= moved;
+  spilled_samples += moved;
+  return moved > 0;
+}
+
+size_t ForwardQueue::peek(QueuedSample* samples, size_t max) {
+  peeked = 0;
+  peeked_spool = spool_read < spool_records;
+  if (peeked_spool) {
+    return readSpool(samples, max);
+  }
+
+  size_t n = count < max ? count : max;
+  for (size_t i = 0; i < n; i++) {
+    samples[i] = ram[(head + i) % RAM_CAPACITY];
+  }
+  peeked = n;
+  return n;
+}
+
+size_t ForwardQueue::readSpool(QueuedSample* samples, size_t max) {
+  uint32_t available = spool_records - spool_read;
+  size_t n = available < max ? available : max;
+  if (n > SPILL_COUNT) {
+    n = SPILL_COUNT;
+  }
+
+  FileHandle* file = fs->open(path, FILE_MODE_READ);
+  if (file == nullptr) {
+    return 0;
+  }
+  uint8_t buffer[SPILL_COUNT * QUEUED_SAMPLE_SIZE];
+  size_t length = 0;
+  if (file->seek(spool_read * QUEUED_SAMPLE_SIZE)) {
+    length = file->read(buffer, n * QUEUED_SAMPLE_SIZE);
+  }
+  fs->close(file);
+
+  // 読めなければ（ファイルの破損）スプールを捨てる
+  if (length < n * QUEUED_SAMPLE_SIZE) {
+    Serial.printf("Forward queue: spool read failed: %s\n", path);
+    dropped_samples += spool_records - spool_read;
+    clearSpool();
+    return 0;
+  }
+
+  size_t result = 0;
+  for (size_t i = 0; i < n; i++) {
+    const uint8_t* p = buffer + i * QUEUED_SAMPLE_SIZE;
+    QueuedSample& sample = samples[result];
+    sample.epoch = getU32(p);
+    sample.timestamp = getU32(p + 4);
+    sample.tvoc = getU16(p + 8);
+    sample.eco2 = getU16(p + 10);
+    // 電源断で書きかけになった1件の詰め物
+    if (sample.epoch == 0 && sample.timestamp == 0) {
+      continue;
+    }
+    result++;
+  }
+  peeked = n;
+  return result;
+}
+
+void ForwardQueue::commit() {
+  if (peeked_spool) {
+    spool_read += peeked;
+    // すべて送ったらスプールを空にする
+    if (spool_read >= spool_records) {
+      clearSpool();
+    }
+  } else {
+    head = (head + peeked) % RAM_CAPACITY;
+    count -= peeked;
+  }
+  peeked = 0;
+}
+
+void ForwardQueue::release() {
+  peeked = 0;
+}
+
+void ForwardQueue::clearSpool() {
+  FileHandle* file = fs->open(path, FILE_MODE_WRITE);
+  if (file != nullptr) {
+    fs->close(file);
+  }
+  spool_read = 0;
+  spool_records = 0;
+  peeked = 0;
+}
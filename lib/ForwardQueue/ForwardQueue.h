@@ -0,0 +1,72 @@
+#ifndef FORWARD_QUEUE_H
+#define FORWARD_QUEUE_H
+
+#include <Hal.h>
+
+// 送信待ちの測定（ファイル上はリトルエンディアンの12バイト）
+struct QueuedSample {
+  uint32_t epoch;       // UNIX時刻（0: 時刻不明）
+  uint32_t timestamp;   // 測定時刻 (ms、起動からの時間)
+  uint16_t tvoc;
+  uint16_t eco2;
+};
+
+static const uint32_t QUEUED_SAMPLE_SIZE = 12;
+
+// 送信待ちの測定の蓄積（古い順に送る）
+//
+// 通常はRAMのリングバッファに溜め、満杯になったら古い SPILL_COUNT 件をSDカードのスプールへ移す
+// 送信はスプール → RAMの順。peek() で読んだ分は送信が確認されるまで commit() しないので、
+// 切断で送信に失敗しても失われない（再起動時はスプールを先頭から送り直すため重複がありうる）
+// すべて描画タスク（SDカードと同じタスク）から呼び出す
+class ForwardQueue {
+public:
+  static const size_t RAM_CAPACITY = 512;            // 約8.5分（1秒ごと）
+  static const size_t SPILL_COUNT = 128;             // 1回にSDカードへ移す件数
+  static const uint32_t SPOOL_CAPACITY = 86400 * 2;  // スプールの上限（約2日、約2MB）
+  static const size_t PATH_LENGTH = 32;
+
+  ForwardQueue();
+
+  // fs: スプールに使うファイルシステム（nullptr ならRAMのみ）
+  void init(FileSystem* fs, const char* path);
+
+  void push(const QueuedSample& sample);
+
+  // 先頭から最大 max 件を取り出さずに読む（スプールとRAMにまたがらない）
+  size_t peek(QueuedSample* samples, size_t max);
+  // 直前の peek() で読んだ分を削除
+  void commit();
+  // 直前の peek() で読んだ分を残したまま送信をやめる（切断時）
+  void release();
+
+  uint32_t size() const { return ramDepth() + spoolDepth(); }
+  uint32_t ramDepth() const { return count; }
+  uint32_t spoolDepth() const { return spool_records - spool_read; }
+  uint32_t dropped() const { return dropped_samples; }
+  uint32_t spilled() const { return spilled_samples; }
+
+private:
+  QueuedSample ram[RAM_CAPACITY];
+  size_t head;            // 最も古い測定の位置
+  size_t count;
+
+  FileSystem* fs;
+  char path[PATH_LENGTH];
+  uint32_t spool_records; // スプールに書いた件数
+  uint32_t spool_read;    // 送信済みの件数
+  bool spool_writable;    // 書き込みに失敗したら false
+
+  // 直前の peek()
+  bool peeked_spool;
+  uint32_t peeked;        // 読んだ件数（スプールは読み飛ばした詰め物を含む）
+
+  uint32_t dropped_samples;
+  uint32_t spilled_samples;
+
+  bool spill();
+  void clearSpool();
+  size_t readSpool(QueuedSample* samples, size_t max);
+};
+
+#endif // FORWARD_QUEUE_H
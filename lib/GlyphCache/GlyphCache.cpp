@@ -0,0 +1,157 @@
+#include "GlyphCache.h"
+
+const char GlyphCache::CHARSET[] = " #-0123456789:CEHOTVabdehmprtw";
+
+GlyphCache::GlyphCache() :
+  masks(),
+  ready(false) {
+  memset(slots, NO_GLYPH, sizeof(slots));
+}
+
+bool GlyphCache::init(Display* display) {
+  static_assert(sizeof(CHARSET) - 1 <= MAX_GLYPHS, "CHARSET exceeds MAX_GLYPHS");
+  const int count = sizeof(CHARSET) - 1;
+
+  // 全文字を1行に描いて読み戻す（8ビットの色深度で十分、確保は起動時の一度だけ）
+  Canvas* canvas = display->createCanvas(count * GLYPH_WIDTH, GLYPH_HEIGHT, 8);
+  if (canvas == nullptr) {
+    Serial.println("Glyph cache allocation failed");
+    return false;
+  }
+  canvas->fill(BLACK);
+  canvas->drawText(0, 0, CHARSET, 1, WHITE);
+
+  for (int i = 0; i < count; i++) {
+    for (int row = 0; row < GLYPH_HEIGHT; row++) {
+      uint8_t bits = 0;
+      for (int col = 0; col < GLYPH_WIDTH; col++) {
+        bits = (uint8_t)(bits << 1);
+        if (canvas->readPixel(i * GLYPH_WIDTH + col, row) != BLACK) {
+          bits |= 1;
+        }
+      }
+      masks[i][row] = bits;
+    }
+    slots[(uint8_t)CHARSET[i] - FIRST_CHAR] = (uint8_t)i;
+  }
+  display->destroyCanvas(canvas);
+
+  ready = true;
+  Serial.printf("Glyph cache: %d glyphs, %u bytes\n", count, (unsigned)sizeof(masks[0]) * count);
+  return true;
+}
+
+const uint8_t* GlyphCache::mask(char c) const {
+  uint8_t code = (uint8_t)c;
+  if (code < FIRST_CHAR || code >= FIRST_CHAR + CHAR_RANGE || slots[code - FIRST_CHAR] == NO_GLYPH) {
+    return nullptr;
+  }
+  return masks[slots[code - FIRST_CHAR]];
+}
+
+bool GlyphCache::covers(const char* text, int length) const {
+  if (!ready) {
+    return false;
+  }
+  for (int i = 0; i < length; i++) {
+    if (mask(text[i]) == nullptr) {
+      return false;
+    }
+  }
+  return true;
+}
+
+int GlyphCache::formatNumber(int32_t value, char* out) {
+  // 下の桁から一時領域に並べて反転
+  char digits[NUMBER_LENGTH];
+  int count = 0;
+  uint32_t magnitude = value < 0 ? 0u - (uint32_t)value : (uint32_t)value;
+  do {
+    digits[count++] = (char)('0' + magnitude % 10);
+    magnitude /= 10;
+  } while (magnitude > 0);
+
+  int length = 0;
+  if (value < 0) {
+    out[length++] = '-';
+  }
+  while (count > 0) {
+    out[length++] = digits[--count];
+  }
+  out[length] = '\0';
+  return length;
+}
+
+int16_t GlyphCache::drawText(Canvas& canvas, int16_t x, int16_t y, const char* text, uint8_t size,
+                             uint16_t color) const {
+  int16_t start = x;
+  for (const char* c = text; *c != '\0'; c++, x += GLYPH_WIDTH * size) {
+    const uint8_t* rows = mask(*c);
+    if (rows == nullptr) {
+      continue;
+    }
+    // 行ごとに点の連続を1回で塗る
+    for (int row = 0; row < GLYPH_HEIGHT; row++) {
+      uint8_t bits = rows[row];
+      int col = 0;
+      while (bits != 0) {
+        while ((bits & 0x20) == 0) {
+          bits = (uint8_t)(bits << 1);
+          col++;
+        }
+        int run = 0;
+        while ((bits & 0x20) != 0) {
+          bits = (uint8_t)((bits << 1) & 0x3F);
+          run++;
+        }
+        canvas.fillRect(x + col * size, y + row * size, run * size, size, color);
+        col += run;
+      }
+    }
+  }
+  return x - start;
+}
+
+int16_t GlyphCache::drawNumber(Canvas& canvas, int16_t x, int16_t y, int32_t value, uint8_t size,
+                               uint16_t color) const {
+  char text[NUMBER_LENGTH];
+  formatNumber(value, text);
+  return drawText(canvas, x, y, text, size, color);
+}
+
+int GlyphCache::blit(Display& display, int16_t x, int16_t y, const char* text, int length, uint8_t size,
+                     uint16_t color, uint16_t bg_color) {
+  const int glyph_w = GLYPH_WIDTH * size;
+  const int glyph_h = GLYPH_HEIGHT * size;
+  const int per_blit = BLIT_PIXELS / (glyph_w * glyph_h);
+  if (per_blit == 0) {
+    return 0;
+  }
+
+  int transfers = 0;
+  for (int first = 0; first < length; first += per_blit) {
+    int count = length - first < per_blit ? length - first : per_blit;
+    int w = count * glyph_w;
+
+    // 1行目の画素を作り、倍率分の行は複製する
+    for (int row = 0; row < GLYPH_HEIGHT; row++) {
+      uint16_t* line = pixels + row * size * w;
+      uint16_t* p = line;
+      for (int i = 0; i < count; i++) {
+        uint8_t bits = mask(text[first + i])[row];
+        for (int col = 0; col < GLYPH_WIDTH; col++) {
+          uint16_t pixel = (bits & (0x20 >> col)) != 0 ? color : bg_color;
+          for (int s = 0; s < size; s++) {
+            *p++ = pixel;
+          }
+        }
+      }
+      for (int s = 1; s < size; s++) {
+        memcpy(line + s * w, line, w * sizeof(uint16_t));
+      }
+    }
+    display.pushImage(x + first * glyph_w, y, w, glyph_h, pixels);
+    transfers++;
+  }
+  return transfers;
+}
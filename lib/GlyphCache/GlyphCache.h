@@ -0,0 +1,56 @@
+#ifndef GLYPH_CACHE_H
+#define GLYPH_CACHE_H
+
+#include <Hal.h>
+
+// 数字・単位・固定の見出しの字形のキャッシュ（ヒープ確保なし）
+//
+// 起動時に一度だけ、LCDと同じフォント（GLCD 6x8）でキャンバスに描いた字形を読み戻し、1文字8バイトの1ビットのマスクにする。
+// 描画はフォントの処理や書式化を通さずにマスクから行う：
+//   キャンバスへは行ごとの点の連続を fillRect で描き（背景は透過）、
+//   LCDへは倍率分に広げた画素を行バッファに並べて1回の pushImage で転送する（文字ごと・点ごとの転送がない）
+class GlyphCache {
+public:
+  static const uint8_t GLYPH_WIDTH = 6;
+  static const uint8_t GLYPH_HEIGHT = 8;
+  static const uint8_t MAX_GLYPHS = 32;
+  static const uint16_t BLIT_PIXELS = 1536;     // LCDへの1回の転送の画素数（倍率2で8文字分）
+  static const uint8_t NUMBER_LENGTH = 12;      // formatNumber() の最大の長さ（終端を含む）
+
+  // キャッシュする文字（ヘッダー・Y軸の目盛り・表示期間とセンサーの見出し）
+  static const char CHARSET[];
+
+  GlyphCache();
+
+  // display のキャンバスで字形を作る（キャンバスを確保できなければ false で、キャッシュは使わない）
+  bool init(Display* display);
+  bool isReady() const { return ready; }
+
+  // text の先頭 length 文字がすべてキャッシュにあるか
+  bool covers(const char* text, int length) const;
+
+  // 整数を10進の文字列にする（printf を通さない）。文字数を返す
+  static int formatNumber(int32_t value, char* out);
+
+  // キャンバスへ背景を透過で描画（キャッシュにない文字は空白として進める）。描画した幅を返す
+  int16_t drawText(Canvas& canvas, int16_t x, int16_t y, const char* text, uint8_t size, uint16_t color) const;
+  int16_t drawNumber(Canvas& canvas, int16_t x, int16_t y, int32_t value, uint8_t size, uint16_t color) const;
+
+  // LCDへ背景色付きで length 文字を描画（covers() の文字のみ）。転送の回数を返す
+  int blit(Display& display, int16_t x, int16_t y, const char* text, int length, uint8_t size,
+           uint16_t color, uint16_t bg_color);
+
+private:
+  static const uint8_t FIRST_CHAR = 0x20;
+  static const uint8_t CHAR_RANGE = 0x60;       // 0x20〜0x7F
+  static const uint8_t NO_GLYPH = 0xFF;
+
+  uint8_t masks[MAX_GLYPHS][GLYPH_HEIGHT];      // 行ごとの6ビット（bit5 が左端）
+  uint8_t slots[CHAR_RANGE];                    // 文字ごとのマスクの位置（NO_GLYPH: なし）
+  uint16_t pixels[BLIT_PIXELS];                 // LCDへの転送の行バッファ
+  bool ready;
+
+  const uint8_t* mask(char c) const;
+};
+
+#endif // GLYPH_CACHE_H
@@ -1,117 +1,466 @@
 #include "GraphManager.h"
 
+// 表示期間ごとのトレンドレベルとラベル
+static const TrendPyramid::Level VIEW_LEVELS[GRAPH_VIEW_COUNT] = {
+  TrendPyramid::LEVEL_MINUTE,  // LIVEでは未使用
+  TrendPyramid::LEVEL_MINUTE,
+  TrendPyramid::LEVEL_QUARTER,
+  TrendPyramid::LEVEL_HOUR,
+  TrendPyramid::LEVEL_MINUTE   // 生信号では未使用
+};
+static const char* const VIEW_LABELS[GRAPH_VIEW_COUNT] = { "5m", "1h", "24h", "7d", "raw" };
+
+// 合成スプライトの高さ候補（RAMが確保できるまで分割数を増やす）
+static const int STRIP_HEIGHTS[] = { 172, 86, 43 };
+
+// Y軸ラベルの文字列と縦位置（毎回の再描画で使うので sprintf を通さない）
+static int axisLabel(const GraphConfig& graph, int index, char* label, int& y_offset) {
+  const int values[3] = { graph.maxValue, graph.midValue, graph.minValue };
+  const int y_offsets[3] = { 3, graph.height / 2, graph.height - 11 };
+  y_offset = y_offsets[index];
+  return GlyphCache::formatNumber(values[index], label);
+}
+
 GraphManager::GraphManager() :
-  tvoc_y_prev(0),
-  eco2_y_prev(0),
-  first_plot(true),
-  last_update_time(0) {
+  renderer(nullptr),
+  plot_canvas(nullptr),
+  strip_height(0),
+  plot_region(-1),
+  view(GRAPH_VIEW_LIVE),
+  needs_redraw(false),
+  frames_stale(false),
+  last_sequence(0),
+  sensor_history(nullptr),
+  sensor_index(-1),
+  last_frame_us(0),
+  frame_count(0),
+  frame_total_us(0),
+  frame_max_us(0) {
 
   // TVOC用グラフ設定
   tvocGraph = {
-    18, 40, 300, 80, 1000, 0, 500, MAGENTA, &graph_tvoc
+    18, 40, 300, 80, 1000, 0, 500, MAGENTA, HISTORY_TVOC, nullptr, -1
   };
 
   // eCO2用グラフ設定
   eco2Graph = {
-    18, 130, 300, 80, 5000, 400, 2700, CYAN, &graph_eco2
+    18, 130, 300, 80, 5000, 400, 2700, CYAN, HISTORY_ECO2, nullptr, -1
   };
 }
 
 GraphManager::~GraphManager() {
   // スプライトの解放
-  graph_tvoc.deleteSprite();
-  graph_eco2.deleteSprite();
+  if (renderer != nullptr) {
+    renderer->destroyCanvas(tvocGraph.sprite);
+    renderer->destroyCanvas(eco2Graph.sprite);
+    renderer->destroyCanvas(plot_canvas);
+  }
 }
 
-void GraphManager::init() {
+void GraphManager::init(LcdRenderer* lcd_renderer) {
+  renderer = lcd_renderer;
+
   // スプライトの初期化
-  setupGraph(tvocGraph);
-  setupGraph(eco2Graph);
+  if (GRAPH_COMPOSITE) {
+    setupComposite();
+  } else {
+    setupGraph(tvocGraph);
+    setupGraph(eco2Graph);
+  }
 }
 
 void GraphManager::setupGraph(GraphConfig& graph) {
-  graph.sprite->setColorDepth(8);
-  graph.sprite->createSprite(graph.width, graph.height);
-  graph.sprite->fillSprite(TFT_BLACK);
+  graph.sprite = renderer->createCanvas(graph.width, graph.height, 8);
+  if (graph.sprite == nullptr) {
+    Serial.println("Graph sprite allocation failed");
+  } else {
+    graph.sprite->fill(TFT_BLACK);
+  }
+
+  // 枠とY軸ラベルを含む領域を登録
+  graph.region = renderer->registerRegion(0, graph.yPos, graph.xPos + graph.width + 1, graph.height + 2);
+}
+
+void GraphManager::setupComposite() {
+  // 確保できる最大の高さを選ぶ
+  for (size_t i = 0; i < sizeof(STRIP_HEIGHTS) / sizeof(STRIP_HEIGHTS[0]); i++) {
+    plot_canvas = renderer->createCanvas(PLOT_WIDTH, STRIP_HEIGHTS[i], 8);
+    if (plot_canvas != nullptr) {
+      strip_height = STRIP_HEIGHTS[i];
+      break;
+    }
+  }
+
+  if (strip_height == 0) {
+    Serial.println("Graph sprite allocation failed");
+  } else {
+    Serial.printf("Graph composite: %d strip(s) of %dx%d\n", PLOT_HEIGHT / strip_height, PLOT_WIDTH, strip_height);
+  }
+
+  plot_region = renderer->registerRegion(0, PLOT_TOP, PLOT_WIDTH, PLOT_HEIGHT);
 }
 
 void GraphManager::drawFrames() {
+  if (GRAPH_COMPOSITE) {
+    // 枠は合成スプライトに含まれるので次の更新で描画
+    needs_redraw = true;
+    return;
+  }
+
   // グラフフレームの描画
+  renderer->consumeDamage(tvocGraph.region);
   drawGraphFrame(tvocGraph);
+  renderer->consumeDamage(eco2Graph.region);
   drawGraphFrame(eco2Graph);
-
-  // 垂直グリッド線の描画
-  drawVerticalGridLines();
 }
 
 void GraphManager::drawGraphFrame(const GraphConfig& graph) {
   // グラフ枠を描画
-  M5.Lcd.drawRoundRect(graph.xPos - 1, graph.yPos, graph.width + 2, graph.height + 2, 2, WHITE);
+  renderer->drawRoundRect(graph.xPos - 1, graph.yPos, graph.width + 2, graph.height + 2, 2, WHITE);
 
   // Y軸ラベル背景をクリア
-  M5.Lcd.fillRect(0, graph.yPos + 3, 16, 10, BLACK);
-  M5.Lcd.fillRect(0, graph.yPos + graph.height/2, 16, 10, BLACK);
-  M5.Lcd.fillRect(0, graph.yPos + graph.height - 11, 16, 10, BLACK);
-
-  // Y軸ラベルの描画（drawString() の代わりに setCursor() と print() を使用）
-  M5.Lcd.setTextSize(1.5);
-  M5.Lcd.setTextColor(graph.color);
-  M5.Lcd.setCursor(0, graph.yPos + 3);
-  M5.Lcd.print(graph.maxValue);
-  M5.Lcd.setCursor(0, graph.yPos + graph.height / 2);
-  M5.Lcd.print(graph.midValue);
-  M5.Lcd.setCursor(0, graph.yPos + graph.height - 11);
-  M5.Lcd.print(graph.minValue);
+  renderer->fillRect(0, graph.yPos + 3, 16, 10, BLACK);
+  renderer->fillRect(0, graph.yPos + graph.height/2, 16, 10, BLACK);
+  renderer->fillRect(0, graph.yPos + graph.height - 11, 16, 10, BLACK);
+
+  drawAxisLabels(graph, false);
+}
+
+void GraphManager::drawAxisLabels(const GraphConfig& graph, bool clipped_only) {
+  for (int i = 0; i < 3; i++) {
+    char label[GlyphCache::NUMBER_LENGTH];
+    int y_offset;
+    int length = axisLabel(graph, i, label, y_offset);
+
+    // スプライトに上書きされるのはグラフ領域にはみ出したラベルのみ
+    if (clipped_only && length * 6 <= graph.xPos) {
+      continue;
+    }
+    renderer->drawText(0, graph.yPos + y_offset, label, 1, graph.color, BLACK);
+  }
+}
+
+void GraphManager::drawGrid(Canvas& canvas, const GraphConfig& graph, int ox, int oy) {
+  // 枠の上辺（スプライトと重なる行）
+  canvas.drawFastHLine(ox + 1, oy, graph.width - 2, WHITE);
 
   // 水平グリッド線
-  M5.Lcd.drawLine(graph.xPos, graph.yPos + 13, graph.xPos + graph.width, graph.yPos + 13, DARKGREEN);
-  M5.Lcd.drawLine(graph.xPos, graph.yPos + graph.height/2 + 10, graph.xPos + graph.width, graph.yPos + graph.height/2 + 10, DARKGREEN);
-  M5.Lcd.drawLine(graph.xPos, graph.yPos + graph.height - 1, graph.xPos + graph.width, graph.yPos + graph.height - 1, DARKGREEN);
+  canvas.drawFastHLine(ox, oy + 13, graph.width, DARKGREEN);
+  canvas.drawFastHLine(ox, oy + graph.height/2 + 10, graph.width, DARKGREEN);
+  canvas.drawFastHLine(ox, oy + graph.height - 1, graph.width, DARKGREEN);
+
+  // 垂直グリッド線
+  int grid_spacing = graph.width / GRID_COLUMNS;
+  for (int i = 1; i < GRID_COLUMNS; i++) {
+    canvas.drawFastVLine(ox + i * grid_spacing, oy + 1, graph.height - 2, DARKGREEN);
+  }
+}
+
+void GraphManager::flushGraph(const GraphConfig& graph) {
+  // スプライトを画面に描画
+  renderer->pushCanvas(*graph.sprite, graph.xPos, graph.yPos);
+
+  // 枠が消されたか目盛りが変わったら全体を、そうでなければスプライトに隠れたラベルだけを再描画
+  if (renderer->consumeDamage(graph.region) || frames_stale || view == GRAPH_VIEW_SIGNAL) {
+    drawGraphFrame(graph);
+  } else {
+    drawAxisLabels(graph, true);
+  }
 }
 
-void GraphManager::update(uint16_t tvoc_value, uint16_t eco2_value) {
-  // 更新間隔チェック
-  if (millis() - last_update_time < GRAPH_UPDATE_INTERVAL) {
+void GraphManager::update(const SensorHistory& history, const TrendPyramid& trend) {
+  // 新しいデータも表示期間の変更も画面の破損もなければ何もしない
+  bool damaged = GRAPH_COMPOSITE
+    ? renderer->isDamaged(plot_region)
+    : (renderer->isDamaged(tvocGraph.region) || renderer->isDamaged(eco2Graph.region));
+  if (!needs_redraw && !damaged && currentSequence(history, trend) == last_sequence) {
     return;
   }
 
-  last_update_time = millis();
+  redraw(history, trend);
+}
+
+void GraphManager::redraw(const SensorHistory& history, const TrendPyramid& trend) {
+  last_sequence = currentSequence(history, trend);
+  needs_redraw = false;
+
+  uint32_t start = micros();
+
+  if (GRAPH_COMPOSITE) {
+    renderComposite(history, trend);
+  } else {
+    renderSeparate(history, trend);
+  }
 
-  // グラフの更新
-  updateGraph(tvocGraph, tvoc_value, tvoc_y_prev);
-  updateGraph(eco2Graph, eco2_value, eco2_y_prev);
+  recordFrameTime(micros() - start);
+}
 
-  // 初回プロットフラグをリセット
-  if (first_plot) {
-    first_plot = false;
+void GraphManager::renderComposite(const SensorHistory& history, const TrendPyramid& trend) {
+  if (strip_height == 0) {
+    return;
   }
 
-  // グラフ枠と目盛りの再描画
-  redrawGraphFrameAndLabels();
+  renderer->consumeDamage(plot_region);
+
+  // 短冊ごとに枠・ラベル・グリッド・グラフを合成して1回で転送
+  for (int strip_y = PLOT_TOP; strip_y < PLOT_TOP + PLOT_HEIGHT; strip_y += strip_height) {
+    plot_canvas->fill(TFT_BLACK);
+    composeGraph(*plot_canvas, tvocGraph, tvocGraph.xPos, tvocGraph.yPos - strip_y, history, trend);
+    composeGraph(*plot_canvas, eco2Graph, eco2Graph.xPos, eco2Graph.yPos - strip_y, history, trend);
+    renderer->pushCanvas(*plot_canvas, 0, strip_y);
+  }
 }
 
-void GraphManager::updateGraph(const GraphConfig& graph, uint16_t value, uint16_t& y_prev) {
-  // グラフスプライトをスクロール
-  graph.sprite->scroll(-1, 0);
+void GraphManager::composeGraph(Canvas& canvas, const GraphConfig& config, int ox, int oy,
+                                const SensorHistory& history, const TrendPyramid& trend) {
+  // この短冊に掛からないグラフは描画しない
+  if (oy + config.height + 2 <= 0 || oy >= strip_height) {
+    return;
+  }
+  GraphConfig graph = view == GRAPH_VIEW_SIGNAL ? signalGraph(config, history) : config;
+
+  // グラフ枠
+  canvas.drawRoundRect(ox - 1, oy, graph.width + 2, graph.height + 2, 2, WHITE);
+  drawGrid(canvas, graph, ox, oy);
+  renderView(canvas, graph, ox, oy, history, trend);
 
-  // 右端の位置
-  const uint16_t Xpos = graph.width - 1;
+  // Y軸ラベル（グラフ領域にはみ出す分もそのまま重ねる）
+  for (int i = 0; i < 3; i++) {
+    char label[GlyphCache::NUMBER_LENGTH];
+    int y_offset;
+    axisLabel(graph, i, label, y_offset);
+    drawCanvasText(canvas, 0, oy + y_offset, label, graph.color);
+  }
+
+  drawViewLabel(canvas, graph, ox, oy);
+}
 
-  // Y位置を計算
-  uint16_t y_pos = calculateYPosition(value, graph);
+void GraphManager::renderSeparate(const SensorHistory& history, const TrendPyramid& trend) {
+  const GraphConfig* graphs[2] = { &tvocGraph, &eco2Graph };
 
-  // 点をプロット
-  if (first_plot) {
-    graph.sprite->fillRect(Xpos, y_pos, 1, 1, graph.color);
+  for (int i = 0; i < 2; i++) {
+    if (graphs[i]->sprite == nullptr) {
+      continue;
+    }
+    GraphConfig graph = view == GRAPH_VIEW_SIGNAL ? signalGraph(*graphs[i], history) : *graphs[i];
+    graph.sprite->fill(TFT_BLACK);
+    drawGrid(*graph.sprite, graph, 0, 0);
+    renderView(*graph.sprite, graph, 0, 0, history, trend);
+    drawViewLabel(*graph.sprite, graph, 0, 0);
+    flushGraph(graph);
+  }
+  frames_stale = false;
+}
+
+void GraphManager::renderView(Canvas& canvas, const GraphConfig& graph, int ox, int oy,
+                              const SensorHistory& history, const TrendPyramid& trend) {
+  // 直近5分の履歴（センサーを選んでいればそのセンサーの履歴）
+  HistorySpan spans[2];
+  if (sensor_history != nullptr) {
+    sensor_history->spans(spans[0], spans[1]);
   } else {
-    graph.sprite->drawLine(Xpos-1, y_prev, Xpos, y_pos, graph.color);
+    history.spans(spans[0], spans[1]);
+  }
+
+  // 表示期間に応じて生データまたは集計データから描画
+  switch (view) {
+    case GRAPH_VIEW_LIVE:
+      renderGraph(canvas, graph, ox, oy, spans, graph.channel, graph.color);
+      break;
+    case GRAPH_VIEW_SIGNAL:
+      // 測定値を下に、処理後の値を重ねる
+      renderGraph(canvas, graph, ox, oy, spans,
+                  graph.channel == HISTORY_H2_FILTERED ? HISTORY_H2 : HISTORY_ETHANOL, DARKGREY);
+      renderGraph(canvas, graph, ox, oy, spans, graph.channel, graph.color);
+      break;
+    default:
+      renderTrend(canvas, graph, ox, oy, trend.level(VIEW_LEVELS[view]));
+      break;
   }
+}
 
-  // 現在のY位置を保存
-  y_prev = y_pos;
+GraphConfig GraphManager::signalGraph(const GraphConfig& graph, const SensorHistory& history) const {
+  // 上のグラフにH2、下のグラフにエタノール
+  GraphConfig signal = graph;
+  signal.channel = graph.channel == HISTORY_TVOC ? HISTORY_H2_FILTERED : HISTORY_ETHANOL_FILTERED;
+  HistoryChannel raw = signal.channel == HISTORY_H2_FILTERED ? HISTORY_H2 : HISTORY_ETHANOL;
 
-  // スプライトを画面に描画
-  graph.sprite->pushSprite(graph.xPos, graph.yPos);
+  // 表示中の測定値・処理後の値（0: 未測定を除く）が収まる目盛り
+  uint16_t low = UINT16_MAX;
+  uint16_t high = 0;
+  for (size_t i = 0; i < history.size(); i++) {
+    uint16_t values[2] = { history.valueAt(raw, i), history.valueAt(signal.channel, i) };
+    for (uint16_t value : values) {
+      if (value == 0) {
+        continue;
+      }
+      low = value < low ? value : low;
+      high = value > high ? value : high;
+    }
+  }
+  if (high == 0) {
+    low = 0;
+    high = SIGNAL_MIN_RANGE;
+  }
+  int min_value = low / SIGNAL_STEP * SIGNAL_STEP;
+  int max_value = (high + SIGNAL_STEP - 1) / SIGNAL_STEP * SIGNAL_STEP;
+  if (max_value - min_value < SIGNAL_MIN_RANGE) {
+    int center = (min_value + max_value) / 2;
+    min_value = center - SIGNAL_MIN_RANGE / 2;
+    max_value = center + SIGNAL_MIN_RANGE / 2;
+    if (min_value < 0) {
+      max_value -= min_value;
+      min_value = 0;
+    }
+  }
+  signal.minValue = min_value;
+  signal.maxValue = max_value;
+  signal.midValue = (min_value + max_value) / 2;
+  return signal;
+}
+
+void GraphManager::recordFrameTime(uint32_t elapsed_us) {
+  last_frame_us = elapsed_us;
+  frame_count++;
+  frame_total_us += elapsed_us;
+  if (elapsed_us > frame_max_us) {
+    frame_max_us = elapsed_us;
+  }
+}
+
+void GraphManager::logFrameStats() {
+  if (frame_count == 0) {
+    return;
+  }
+
+  Serial.printf("Graph frame (%s): avg %lu us, max %lu us over %lu frames\n",
+                GRAPH_COMPOSITE ? "composite" : "separate",
+                (unsigned long)(frame_total_us / frame_count),
+                (unsigned long)frame_max_us,
+                (unsigned long)frame_count);
+  frame_count = 0;
+  frame_total_us = 0;
+  frame_max_us = 0;
+}
+
+void GraphManager::setView(GraphView new_view) {
+  if (new_view != view) {
+    // 生信号の表示との切り替えではY軸ラベルの目盛りが変わる
+    frames_stale = frames_stale || view == GRAPH_VIEW_SIGNAL || new_view == GRAPH_VIEW_SIGNAL;
+    view = new_view;
+    sensor_history = nullptr;
+    needs_redraw = true;
+  }
+}
+
+void GraphManager::setSensor(const SensorPointHistory* history, int8_t index) {
+  setView(GRAPH_VIEW_LIVE);
+  if (history != sensor_history) {
+    sensor_history = history;
+    sensor_index = index;
+    needs_redraw = true;
+  }
+}
+
+void GraphManager::nextView() {
+  setView((GraphView)((view + 1) % GRAPH_VIEW_COUNT));
+}
+
+uint32_t GraphManager::currentSequence(const SensorHistory& history, const TrendPyramid& trend) const {
+  if (view == GRAPH_VIEW_LIVE && sensor_history != nullptr) {
+    return sensor_history->sequence();
+  }
+  if (view == GRAPH_VIEW_LIVE || view == GRAPH_VIEW_SIGNAL) {
+    return history.sequence();
+  }
+  return trend.level(VIEW_LEVELS[view]).sequence();
+}
+
+void GraphManager::renderGraph(Canvas& canvas, const GraphConfig& graph, int ox, int oy, const HistorySpan* spans,
+                               HistoryChannel channel, uint16_t color) {
+  // 最新のサンプルが右端に来るように配置
+  int x = graph.width - (int)(spans[0].length + spans[1].length);
+  bool first_point = true;
+  uint16_t y_prev = 0;
+  // 生信号の 0 は未測定（復元した履歴など）なので線を切る
+  bool skip_zero = channel >= HISTORY_H2;
+
+  for (int s = 0; s < 2; s++) {
+    const uint16_t* values = spans[s].values(channel);
+    for (size_t i = 0; i < spans[s].length; i++, x++) {
+      if (skip_zero && values[i] == 0) {
+        first_point = true;
+        continue;
+      }
+      uint16_t y_pos = calculateYPosition(values[i], graph);
+
+      // 点をプロット
+      if (first_point) {
+        canvas.fillRect(ox + x, oy + y_pos, 1, 1, color);
+        first_point = false;
+      } else {
+        canvas.drawLine(ox + x - 1, oy + y_prev, ox + x, oy + y_pos, color);
+      }
+
+      y_prev = y_pos;
+    }
+  }
+}
+
+void GraphManager::renderTrend(Canvas& canvas, const GraphConfig& graph, int ox, int oy, const TrendLevel& level) {
+  // 最新のバケットが右端に来るように、容量分を幅全体に割り当てる
+  size_t capacity = level.capacity();
+  size_t offset = capacity - level.size();
+  bool tvoc = (graph.channel == HISTORY_TVOC);
+  int x_prev = 0;
+  uint16_t y_prev = 0;
+
+  for (size_t i = 0; i < level.size(); i++) {
+    const TrendBucket& bucket = level.at(i);
+    int x0 = (int)((offset + i) * graph.width / capacity);
+    int x1 = (int)((offset + i + 1) * graph.width / capacity) - 1;
+    int x_mid = (x0 + x1) / 2;
+
+    uint16_t y_top = calculateYPosition(tvoc ? bucket.tvoc_max : bucket.eco2_max, graph);
+    uint16_t y_bottom = calculateYPosition(tvoc ? bucket.tvoc_min : bucket.eco2_min, graph);
+    uint16_t y_mean = calculateYPosition(tvoc ? bucket.tvoc_mean : bucket.eco2_mean, graph);
+
+    // 最小〜最大の範囲を帯で描画
+    canvas.fillRect(ox + x0, oy + y_top, x1 - x0 + 1, y_bottom - y_top + 1, DARKGREY);
+
+    // 平均値を線で結ぶ
+    if (i == 0) {
+      canvas.fillRect(ox + x_mid, oy + y_mean, 1, 1, graph.color);
+    } else {
+      canvas.drawLine(ox + x_prev, oy + y_prev, ox + x_mid, oy + y_mean, graph.color);
+    }
+
+    x_prev = x_mid;
+    y_prev = y_mean;
+  }
+}
+
+void GraphManager::drawViewLabel(Canvas& canvas, const GraphConfig& graph, int ox, int oy) {
+  // 右上に表示期間を描画（生信号はガスの名前も）
+  drawCanvasText(canvas, ox + graph.width - 20, oy + 2, VIEW_LABELS[view], WHITE);
+  if (view == GRAPH_VIEW_SIGNAL) {
+    drawCanvasText(canvas, ox + graph.width - 50, oy + 2, graph.channel == HISTORY_H2_FILTERED ? "H2" : "EtOH", graph.color);
+  } else if (sensor_history != nullptr) {
+    // 表示中のセンサーの番号
+    char label[GlyphCache::NUMBER_LENGTH + 1] = "#";
+    GlyphCache::formatNumber(sensor_index, label + 1);
+    drawCanvasText(canvas, ox + graph.width - 50, oy + 2, label, graph.color);
+  }
+}
+
+void GraphManager::drawCanvasText(Canvas& canvas, int x, int y, const char* text, uint16_t color) {
+  // キャッシュにある文字だけなら字形のマスクから描画
+  const GlyphCache* glyphs = renderer->glyphCache();
+  if (glyphs != nullptr && glyphs->covers(text, strlen(text))) {
+    glyphs->drawText(canvas, x, y, text, 1, color);
+  } else {
+    canvas.drawText(x, y, text, 1, color);
+  }
 }
 
 uint16_t GraphManager::calculateYPosition(uint16_t value, const GraphConfig& graph) {
@@ -130,24 +479,3 @@ uint16_t GraphManager::calculateYPosition(uint16_t value, const GraphConfig& gra
 
   return y_pos;
 }
-
-void GraphManager::drawVerticalGridLines() {
-  // グラフ共通の垂直グリッド線
-  int grid_spacing = tvocGraph.width / 5;
-
-  for (int i = 1; i < 5; i++) {
-    int x = tvocGraph.xPos + i * grid_spacing;
-
-    // TVOC用垂直グリッド線
-    M5.Lcd.drawLine(x, tvocGraph.yPos + 1, x, tvocGraph.yPos + tvocGraph.height - 1, DARKGREEN);
-
-    // eCO2用垂直グリッド線
-    M5.Lcd.drawLine(x, eco2Graph.yPos + 1, x, eco2Graph.yPos + eco2Graph.height - 1, DARKGREEN);
-  }
-}
-
-void GraphManager::redrawGraphFrameAndLabels() {
-  drawGraphFrame(tvocGraph);
-  drawGraphFrame(eco2Graph);
-  drawVerticalGridLines();
-}
@@ -1,7 +1,24 @@
 #ifndef GRAPH_MANAGER_H
 #define GRAPH_MANAGER_H
 
-#include <M5Stack.h>
+#include <Hal.h>
+#include <SensorManager.h>
+#include <LcdRenderer.h>
+
+// 描画方式（1: プロット領域全体を1枚のスプライトに合成、0: グラフごとのスプライト + LCDへ直接枠描画）
+#ifndef GRAPH_COMPOSITE
+#define GRAPH_COMPOSITE 1
+#endif
+
+// グラフの表示期間
+enum GraphView {
+  GRAPH_VIEW_LIVE,   // 直近5分（1秒ごと）
+  GRAPH_VIEW_HOUR,   // 直近1時間（1分ごと）
+  GRAPH_VIEW_DAY,    // 直近24時間（15分ごと）
+  GRAPH_VIEW_WEEK,   // 直近7日（1時間ごと）
+  GRAPH_VIEW_SIGNAL, // 直近5分のH2・エタノールの生信号（灰色: 測定値、色: 処理後）
+  GRAPH_VIEW_COUNT
+};
 
 // グラフ描画用の構造体
 struct GraphConfig {
@@ -13,7 +30,9 @@ struct GraphConfig {
   int minValue;            // 最小値
   int midValue;            // 中間値
   uint16_t color;          // グラフの色
-  TFT_eSprite* sprite;     // グラフスプライト
+  HistoryChannel channel;  // 描画する履歴チャンネル
+  Canvas* sprite;          // グラフスプライト（個別描画時のみ使用）
+  int region;              // 枠とラベルの再描画領域
 };
 
 class GraphManager {
@@ -22,39 +41,89 @@ public:
   ~GraphManager();
 
   // 初期化
-  void init();
+  void init(LcdRenderer* lcd_renderer);
 
   // グラフフレーム描画
   void drawFrames();
 
-  // グラフ更新
-  void update(uint16_t tvoc_value, uint16_t eco2_value);
+  // グラフ更新（新しいサンプルや表示期間の変更があれば履歴から再描画）
+  void update(const SensorHistory& history, const TrendPyramid& trend);
+
+  // 履歴からグラフ全体を再描画
+  void redraw(const SensorHistory& history, const TrendPyramid& trend);
+
+  // 表示期間の切り替え
+  void setView(GraphView view);
+  void nextView();
+  GraphView getView() const { return view; }
+
+  // 複数のセンサーの場合に直近5分を表示するセンサー（history: そのセンサーの履歴、nullptr: 全センサーの集計）
+  // 表示期間を切り替えると集計に戻る
+  void setSensor(const SensorPointHistory* history, int8_t index);
+  int8_t getSensor() const { return sensor_history != nullptr ? sensor_index : -1; }
+
+  // 直近フレームの描画時間（マイクロ秒）
+  uint32_t getLastFrameMicros() const { return last_frame_us; }
+
+  // 前回の出力以降の描画時間をSerialへ出力
+  void logFrameStats();
 
 private:
   // 定数定義
-  static const int GRAPH_UPDATE_INTERVAL = 1000;  // グラフ更新間隔（ミリ秒）
+  static const int GRID_COLUMNS = 5;              // 垂直グリッドの分割数
+  static const int PLOT_TOP = 40;                 // 合成領域の上端
+  static const int PLOT_WIDTH = 320;              // 合成領域の幅
+  static const int PLOT_HEIGHT = 172;             // 合成領域の高さ（両グラフの枠まで）
+  static const int SIGNAL_MIN_RANGE = 200;        // 生信号の目盛りの最小の幅
+  static const int SIGNAL_STEP = 50;              // 生信号の目盛りの刻み
 
-  // グラフスプライト
-  TFT_eSprite graph_tvoc = TFT_eSprite(&M5.Lcd);
-  TFT_eSprite graph_eco2 = TFT_eSprite(&M5.Lcd);
+  LcdRenderer* renderer;
+
+  // 合成スプライト（RAM不足時は短冊状に分割して順に転送）
+  Canvas* plot_canvas;
+  int strip_height;
+  int plot_region;
 
   // グラフ設定
   GraphConfig tvocGraph;
   GraphConfig eco2Graph;
 
   // 内部変数
-  uint16_t tvoc_y_prev;
-  uint16_t eco2_y_prev;
-  bool first_plot;
-  unsigned long last_update_time;
+  GraphView view;          // 表示期間
+  bool needs_redraw;       // 表示期間の変更などで再描画が必要か
+  bool frames_stale;       // 個別描画時：枠のY軸ラベルが表示期間と合っていない
+  uint32_t last_sequence;  // 最後に描画した履歴の通し番号
+  const SensorPointHistory* sensor_history;  // 表示中のセンサーの履歴（nullptr: 集計）
+  int8_t sensor_index;
+
+  // 描画時間の計測
+  uint32_t last_frame_us;
+  uint32_t frame_count;
+  uint32_t frame_total_us;
+  uint32_t frame_max_us;
 
   // 内部メソッド
   void setupGraph(GraphConfig& graph);
+  void setupComposite();
+  void renderComposite(const SensorHistory& history, const TrendPyramid& trend);
+  void renderSeparate(const SensorHistory& history, const TrendPyramid& trend);
+  void composeGraph(Canvas& canvas, const GraphConfig& graph, int ox, int oy,
+                    const SensorHistory& history, const TrendPyramid& trend);
   void drawGraphFrame(const GraphConfig& graph);
-  void updateGraph(const GraphConfig& graph, uint16_t value, uint16_t& y_prev);
+  void drawAxisLabels(const GraphConfig& graph, bool clipped_only);
+  void drawGrid(Canvas& canvas, const GraphConfig& graph, int ox, int oy);
+  void flushGraph(const GraphConfig& graph);
+  void renderView(Canvas& canvas, const GraphConfig& graph, int ox, int oy,
+                  const SensorHistory& history, const TrendPyramid& trend);
+  void renderGraph(Canvas& canvas, const GraphConfig& graph, int ox, int oy, const HistorySpan* spans,
+                   HistoryChannel channel, uint16_t color);
+  GraphConfig signalGraph(const GraphConfig& graph, const SensorHistory& history) const;
+  void renderTrend(Canvas& canvas, const GraphConfig& graph, int ox, int oy, const TrendLevel& level);
+  void drawViewLabel(Canvas& canvas, const GraphConfig& graph, int ox, int oy);
+  void drawCanvasText(Canvas& canvas, int x, int y, const char* text, uint16_t color);
+  void recordFrameTime(uint32_t elapsed_us);
+  uint32_t currentSequence(const SensorHistory& history, const TrendPyramid& trend) const;
   uint16_t calculateYPosition(uint16_t value, const GraphConfig& graph);
-  void drawVerticalGridLines();
-  void redrawGraphFrameAndLabels();
 };
 
-#endif // GRAPH_MANAGER_H
\ No newline at end of file
+#endif // GRAPH_MANAGER_H
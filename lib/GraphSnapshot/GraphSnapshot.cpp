@@ -0,0 +1,228 @@
+#include "GraphSnapshot.h"
+#include <DataLogger.h>
+
+static void putU16(uint8_t* p, uint16_t value) {
+  p[0] = value & 0xFF;
+  p[1] = value >> 8;
+}
+
+static void putU32(uint8_t* p, uint32_t value) {
+  putU16(p, value & 0xFFFF);
+  putU16(p + 2, value >> 16);
+}
+
+static uint16_t getU16(const uint8_t* p) {
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t getU32(const uint8_t* p) {
+  return getU16(p) | ((uint32_t)getU16(p + 2) << 16);
+}
+
+static uint8_t* putBucket(uint8_t* p, const TrendBucket& bucket) {
+  putU32(p, bucket.timestamp);
+  putU16(p + 4, bucket.tvoc_min);
+  putU16(p + 6, bucket.tvoc_max);
+  putU16(p + 8, bucket.tvoc_mean);
+  putU16(p + 10, bucket.eco2_min);
+  putU16(p + 12, bucket.eco2_max);
+  putU16(p + 14, bucket.eco2_mean);
+  return p + GraphSnapshot::BUCKET_SIZE;
+}
+
+static const uint8_t* getBucket(const uint8_t* p, TrendBucket& bucket) {
+  bucket.timestamp = getU32(p);
+  bucket.tvoc_min = getU16(p + 4);
+  bucket.tvoc_max = getU16(p + 6);
+  bucket.tvoc_mean = getU16(p + 8);
+  bucket.eco2_min = getU16(p + 10);
+  bucket.eco2_max = getU16(p + 12);
+  bucket.eco2_mean = getU16(p + 14);
+  return p + GraphSnapshot::BUCKET_SIZE;
+}
+
+static uint8_t* putPending(uint8_t* p, const TrendAccumulator& pending) {
+  putU32(p, pending.timestamp);
+  putU32(p + 4, pending.count);
+  putU32(p + 8, pending.tvoc_sum);
+  putU32(p + 12, pending.eco2_sum);
+  putU16(p + 16, pending.tvoc_min);
+  putU16(p + 18, pending.tvoc_max);
+  putU16(p + 20, pending.eco2_min);
+  putU16(p + 22, pending.eco2_max);
+  return p + GraphSnapshot::PENDING_SIZE;
+}
+
+static const uint8_t* getPending(const uint8_t* p, TrendAccumulator& pending) {
+  pending.timestamp = getU32(p);
+  pending.count = getU32(p + 4);
+  pending.tvoc_sum = getU32(p + 8);
+  pending.eco2_sum = getU32(p + 12);
+  pending.tvoc_min = getU16(p + 16);
+  pending.tvoc_max = getU16(p + 18);
+  pending.eco2_min = getU16(p + 20);
+  pending.eco2_max = getU16(p + 22);
+  return p + GraphSnapshot::PENDING_SIZE;
+}
+
+GraphSnapshot::GraphSnapshot() :
+  fs(nullptr),
+  sequence(0),
+  next_slot(0) {
+  paths[0][0] = '\0';
+  paths[1][0] = '\0';
+}
+
+void GraphSnapshot::init(FileSystem* file_system, const char* path_a, const char* path_b) {
+  fs = file_system;
+  strncpy(paths[0], path_a, PATH_LENGTH - 1);
+  paths[0][PATH_LENGTH - 1] = '\0';
+  strncpy(paths[1], path_b, PATH_LENGTH - 1);
+  paths[1][PATH_LENGTH - 1] = '\0';
+}
+
+bool GraphSnapshot::save(const SensorHistory& history, const TrendPyramid& trend) {
+  if (fs == nullptr) {
+    return false;
+  }
+
+  size_t length = encode(history, trend);
+  FileHandle* file = fs->open(paths[next_slot], FILE_MODE_WRITE);
+  if (file == nullptr) {
+    return false;
+  }
+  size_t written = file->write(buffer, length);
+  file->flush();
+  fs->close(file);
+  if (written != length) {
+    Serial.printf("Graph snapshot write failed: %s\n", paths[next_slot]);
+    return false;
+  }
+
+  // 書き込みに成功した場合のみ交互に切り替える（失敗したファイルは次回も上書きする）
+  sequence++;
+  next_slot ^= 1;
+  return true;
+}
+
+size_t GraphSnapshot::encode(const SensorHistory& history, const TrendPyramid& trend) {
+  putU32(buffer, MAGIC);
+  putU32(buffer + 4, sequence);
+  buffer[8] = VERSION;
+  buffer[9] = 0;
+  putU16(buffer + 10, (uint16_t)history.size());
+  for (int i = 0; i < TrendPyramid::LEVEL_COUNT; i++) {
+    putU16(buffer + 12 + i * 2, (uint16_t)trend.level((TrendPyramid::Level)i).size());
+  }
+  putU16(buffer + 18, 0);
+
+  uint8_t* p = buffer + HEADER_SIZE;
+  for (size_t i = 0; i < history.size(); i++) {
+    putU32(p, history.timestampAt(i));
+    putU16(p + 4, history.tvocAt(i));
+    putU16(p + 6, history.eco2At(i));
+    p += SAMPLE_SIZE;
+  }
+  for (int i = 0; i < TrendPyramid::LEVEL_COUNT; i++) {
+    const TrendLevel& level = trend.level((TrendPyramid::Level)i);
+    p = putPending(p, level.pendingBucket());
+    for (size_t j = 0; j < level.size(); j++) {
+      p = putBucket(p, level.at(j));
+    }
+  }
+
+  size_t length = p - buffer;
+  putU32(p, logCrc32(buffer, length));
+  return length + 4;
+}
+
+size_t GraphSnapshot::load(uint8_t slot, uint32_t& file_sequence) {
+  FileHandle* file = fs->open(paths[slot], FILE_MODE_READ);
+  if (file == nullptr) {
+    return 0;
+  }
+  uint32_t size = file->size();
+  size_t length = 0;
+  if (size >= HEADER_SIZE + 4 && size <= MAX_SIZE) {
+    length = file->read(buffer, size);
+  }
+  fs->close(file);
+  if (length != size || length == 0) {
+    return 0;
+  }
+
+  // 件数から求めた長さ・CRCが一致するものだけを使う
+  if (getU32(buffer) != MAGIC || buffer[8] != VERSION) {
+    return 0;
+  }
+  size_t expected = HEADER_SIZE + getU16(buffer + 10) * SAMPLE_SIZE + TrendPyramid::LEVEL_COUNT * PENDING_SIZE + 4;
+  for (int i = 0; i < TrendPyramid::LEVEL_COUNT; i++) {
+    expected += getU16(buffer + 12 + i * 2) * BUCKET_SIZE;
+  }
+  if (expected != length || getU32(buffer + length - 4) != logCrc32(buffer, length - 4)) {
+    return 0;
+  }
+
+  file_sequence = getU32(buffer + 4);
+  return length;
+}
+
+size_t GraphSnapshot::restore(SensorHistory& history, TrendPyramid& trend, uint32_t now_ms) {
+  if (fs == nullptr || !history.empty()) {
+    return 0;
+  }
+
+  // 通し番号の新しい方（読めなければもう一方）
+  uint32_t sequences[2];
+  bool valid[2];
+  for (uint8_t slot = 0; slot < 2; slot++) {
+    valid[slot] = load(slot, sequences[slot]) > 0;
+  }
+  if (!valid[0] && !valid[1]) {
+    return 0;
+  }
+  uint8_t newest = (valid[0] && (!valid[1] || (int32_t)(sequences[0] - sequences[1]) > 0)) ? 0 : 1;
+  // buffer には最後に読んだ2つ目のファイルが入っている
+  if (newest == 0) {
+    load(0, sequences[0]);
+  }
+  sequence = sequences[newest] + 1;
+  next_slot = newest ^ 1;
+
+  uint16_t samples = getU16(buffer + 10);
+  if (samples > history.capacity()) {
+    return 0;
+  }
+
+  // 最新の測定（なければ分レベルの集計中のバケット）が now_ms の1周期前になるよう時刻をずらす
+  const uint8_t* levels = buffer + HEADER_SIZE + samples * SAMPLE_SIZE;
+  uint32_t newest_time = samples > 0 ? getU32(buffer + HEADER_SIZE + (samples - 1) * SAMPLE_SIZE) : getU32(levels);
+  uint32_t shift = now_ms - SensorManager::SENSOR_UPDATE_INTERVAL - newest_time;
+
+  const uint8_t* p = buffer + HEADER_SIZE;
+  for (uint16_t i = 0; i < samples; i++) {
+    history.push(getU32(p) + shift, getU16(p + 4), getU16(p + 6));
+    p += SAMPLE_SIZE;
+  }
+  for (int i = 0; i < TrendPyramid::LEVEL_COUNT; i++) {
+    TrendLevel& level = trend.level((TrendPyramid::Level)i);
+    uint16_t count = getU16(buffer + 12 + i * 2);
+    TrendAccumulator pending;
+    p = getPending(p, pending);
+    // 容量を超える分（古い方）は読み飛ばす
+    size_t skip = count > level.capacity() ? count - level.capacity() : 0;
+    for (uint16_t j = 0; j < count; j++) {
+      TrendBucket bucket;
+      p = getBucket(p, bucket);
+      if (j >= skip) {
+        bucket.timestamp += shift;
+        level.restore(bucket);
+      }
+    }
+    if (pending.count > 0) {
+      pending.timestamp += shift;
+      level.restorePending(pending);
+    }
+  }
+  return samples;
+}
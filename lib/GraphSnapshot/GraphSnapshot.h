@@ -0,0 +1,52 @@
+#ifndef GRAPH_SNAPSHOT_H
+#define GRAPH_SNAPSHOT_H
+
+#include <Hal.h>
+#include <SensorManager.h>
+
+// グラフの表示データ（直近5分の測定と各集計レベル）のSDカードへの保存（起動直後にグラフを表示するため）
+//
+//   ファイル（リトルエンディアン）
+//     マジック "TVGS" u32 | 通し番号 u32 | バージョン u8 | 予約 u8 | 測定の件数 u16
+//     | 各レベルのバケット数 u16 × 3 | 予約 u16
+//     | 測定 (時刻 u32 | TVOC u16 | eCO2 u16) × 件数
+//     | レベルごとに 集計中のバケット (24バイト) | バケット (16バイト) × バケット数
+//     | CRC-32 u32（先頭から）
+//
+// 2つのファイルに交互に書き込むので、書き込み中の電源断でも前回の分が残る
+class GraphSnapshot {
+public:
+  static const uint32_t MAGIC = 0x53475654;   // "TVGS"
+  static const uint8_t VERSION = 1;
+  static const size_t HEADER_SIZE = 20;
+  static const size_t SAMPLE_SIZE = 8;
+  static const size_t PENDING_SIZE = 24;
+  static const size_t BUCKET_SIZE = 16;
+  static const size_t MAX_SIZE = HEADER_SIZE + SensorHistory::SAMPLES * SAMPLE_SIZE + TrendPyramid::LEVEL_COUNT * PENDING_SIZE +
+                                 (TrendPyramid::MINUTE_CAPACITY + TrendPyramid::QUARTER_CAPACITY +
+                                  TrendPyramid::HOUR_CAPACITY) * BUCKET_SIZE + 4;
+  static const size_t PATH_LENGTH = 64;
+
+  GraphSnapshot();
+
+  void init(FileSystem* fs, const char* path_a, const char* path_b);
+  bool isEnabled() const { return fs != nullptr; }
+
+  bool save(const SensorHistory& history, const TrendPyramid& trend);
+
+  // 新しい方の有効なファイルを空の history・trend へ復元し、復元した測定の件数を返す（なければ 0）
+  // 電源が切れていた時間は分からないので、最新の測定が now_ms の1周期前になるよう時刻をずらす
+  size_t restore(SensorHistory& history, TrendPyramid& trend, uint32_t now_ms);
+
+private:
+  FileSystem* fs;
+  char paths[2][PATH_LENGTH];
+  uint32_t sequence;      // 次に書き込む通し番号
+  uint8_t next_slot;      // 次に書き込むファイル
+  uint8_t buffer[MAX_SIZE];
+
+  size_t encode(const SensorHistory& history, const TrendPyramid& trend);
+  size_t load(uint8_t slot, uint32_t& file_sequence);
+};
+
+#endif // GRAPH_SNAPSHOT_H
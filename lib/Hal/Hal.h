@@ -0,0 +1,21 @@
+#ifndef HAL_H
+#define HAL_H
+
+// プラットフォーム依存部分の入口
+// Arduino API（millis/micros/delay/Serial）は実機ではArduinoコア、ネイティブ環境では仮想時計で提供する
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include <NativeArduino.h>
+#endif
+
+#include "HalDisplay.h"
+#include "HalSensor.h"
+#include "HalStore.h"
+#include "HalFile.h"
+#include "HalNet.h"
+#include "HalWifi.h"
+#include "HalRetained.h"
+#include "HalButtons.h"
+
+#endif // HAL_H
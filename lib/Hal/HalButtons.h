@@ -0,0 +1,27 @@
+#ifndef HAL_BUTTONS_H
+#define HAL_BUTTONS_H
+
+#include <stdint.h>
+
+// 前面の3ボタン（M5Stack Buttonと同じエッジ判定）
+class ButtonInput {
+public:
+  enum Button {
+    BUTTON_A,
+    BUTTON_B,
+    BUTTON_C,
+    BUTTON_COUNT
+  };
+
+  virtual ~ButtonInput() {}
+
+  // 状態の読み取り（以下の判定は直近のupdate()の結果）
+  virtual void update() = 0;
+  virtual bool isPressed(Button button) = 0;
+  virtual bool wasPressed(Button button) = 0;
+  virtual bool wasReleased(Button button) = 0;
+  // hold_ms 以上押してから離した
+  virtual bool wasReleasefor(Button button, uint32_t hold_ms) = 0;
+};
+
+#endif // HAL_BUTTONS_H
@@ -0,0 +1,65 @@
+#ifndef HAL_DISPLAY_H
+#define HAL_DISPLAY_H
+
+#include <stdint.h>
+
+// 色定義（RGB565、M5Stackと同じ値）
+#ifdef ARDUINO
+#include <M5Stack.h>
+#else
+#define BLACK       0x0000
+#define DARKGREEN   0x03E0
+#define DARKGREY    0x7BEF
+#define RED         0xF800
+#define GREEN       0x07E0
+#define CYAN        0x07FF
+#define MAGENTA     0xF81F
+#define YELLOW      0xFFE0
+#define WHITE       0xFFFF
+#define TFT_BLACK   0x0000
+#endif
+
+// オフスクリーンの描画バッファ（TFT_eSprite相当）
+class Canvas {
+public:
+  virtual ~Canvas() {}
+
+  virtual int16_t width() const = 0;
+  virtual int16_t height() const = 0;
+
+  virtual void fill(uint16_t color) = 0;
+  virtual void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) = 0;
+  virtual void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) = 0;
+  virtual void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) = 0;
+  virtual void drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color) = 0;
+  virtual void drawRoundRect(int16_t x, int16_t y, int16_t w, int16_t h, int16_t r, uint16_t color) = 0;
+  // GLCDフォント（6x8）、背景は透過
+  virtual void drawText(int16_t x, int16_t y, const char* text, uint8_t size, uint16_t color) = 0;
+  // 描画済みの画素（色深度に合わせて丸めた色）
+  virtual uint16_t readPixel(int16_t x, int16_t y) = 0;
+};
+
+// 320x240のLCD（TFT_eSPI相当）
+class Display {
+public:
+  virtual ~Display() {}
+
+  virtual int16_t width() const = 0;
+  virtual int16_t height() const = 0;
+
+  virtual void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) = 0;
+  virtual void drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color) = 0;
+  virtual void drawRoundRect(int16_t x, int16_t y, int16_t w, int16_t h, int16_t r, uint16_t color) = 0;
+  // GLCDフォント（6x8）、背景色で塗りつぶす
+  virtual void drawText(int16_t x, int16_t y, const char* text, uint8_t size, uint16_t color, uint16_t bg_color) = 0;
+  // RGB565の画素の配列（w x h、行順）を1回のアドレスウィンドウで転送
+  virtual void pushImage(int16_t x, int16_t y, int16_t w, int16_t h, const uint16_t* pixels) = 0;
+  virtual void setBrightness(uint8_t level) = 0;
+
+  // キャンバスの確保（RAM不足時は nullptr）と転送
+  virtual Canvas* createCanvas(int16_t w, int16_t h, uint8_t color_depth) = 0;
+  virtual void destroyCanvas(Canvas* canvas) = 0;
+  virtual void pushCanvas(Canvas& canvas, int16_t x, int16_t y) = 0;
+};
+
+#endif // HAL_DISPLAY_H
@@ -0,0 +1,42 @@
+#ifndef HAL_FILE_H
+#define HAL_FILE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// 開いているファイル（SD.File相当）
+class FileHandle {
+public:
+  virtual ~FileHandle() {}
+
+  // 読み書きしたバイト数を返す（末尾・失敗時は要求より少ない）
+  virtual size_t read(uint8_t* buffer, size_t length) = 0;
+  virtual size_t write(const uint8_t* buffer, size_t length) = 0;
+  virtual void flush() = 0;
+
+  virtual uint32_t size() = 0;
+  // 読み込み位置の移動（読み込みモードのみ）
+  virtual bool seek(uint32_t position) = 0;
+};
+
+// ファイルを開くモード
+enum FileMode : uint8_t {
+  FILE_MODE_READ,     // 読み込み
+  FILE_MODE_WRITE,    // 新規作成（既存の内容は破棄）
+  FILE_MODE_APPEND    // 末尾に追記
+};
+
+// ファイルシステム（実機ではSDカード）
+class FileSystem {
+public:
+  virtual ~FileSystem() {}
+
+  // 開けなかった場合は nullptr（close() で閉じて解放する）
+  virtual FileHandle* open(const char* path, FileMode mode) = 0;
+  virtual void close(FileHandle* file) = 0;
+  virtual bool exists(const char* path) = 0;
+  // ディレクトリの作成（既にある場合も true）
+  virtual bool makeDir(const char* path) = 0;
+};
+
+#endif // HAL_FILE_H
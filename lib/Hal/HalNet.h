@@ -0,0 +1,49 @@
+#ifndef HAL_NET_H
+#define HAL_NET_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// TCP接続（ブロックしない読み書き）
+class NetClient {
+public:
+  virtual ~NetClient() {}
+
+  // 読み込んだバイト数（0: データなし、-1: 切断）
+  virtual int read(uint8_t* buffer, size_t length) = 0;
+  // 送信バッファに入ったバイト数（満杯なら要求より少ない）
+  virtual size_t write(const uint8_t* data, size_t length) = 0;
+  virtual bool connected() = 0;
+};
+
+// TCPサーバー（接続は固定数のプールから割り当てる）
+class NetServer {
+public:
+  virtual ~NetServer() {}
+
+  virtual bool begin(uint16_t port) = 0;
+  // 新しい接続（なければ nullptr）。使い終わったら close() で切断して返却する
+  virtual NetClient* accept() = 0;
+  virtual void close(NetClient* client) = 0;
+};
+
+// 接続の確立の状態
+enum NetConnectStatus : uint8_t {
+  NET_CONNECT_PENDING,   // 名前解決・接続の確立中
+  NET_CONNECT_DONE,
+  NET_CONNECT_FAILED
+};
+
+// TCPクライアント（接続は固定数のプールから割り当てる、名前解決・接続の確立とも待たずに戻る）
+class NetConnector {
+public:
+  virtual ~NetConnector() {}
+
+  // 接続を始める（空きがない・宛先が不正なら nullptr）。確立したかは pollConnect() で確かめる
+  virtual NetClient* connect(const char* host, uint16_t port) = 0;
+  virtual NetConnectStatus pollConnect(NetClient* client) = 0;
+  // 切断して返却する（確立前・失敗した接続も close() で返却する）
+  virtual void close(NetClient* client) = 0;
+};
+
+#endif // HAL_NET_H
@@ -0,0 +1,28 @@
+#ifndef HAL_RETAINED_H
+#define HAL_RETAINED_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// 直前のリセットの原因
+enum ResetReason : uint8_t {
+  RESET_POWER_ON,     // 電源投入（保持メモリの内容は不定）
+  RESET_SOFTWARE,     // 計画的な再起動（ESP.restart()・OTA）
+  RESET_CRASH,        // パニック・ウォッチドッグ
+  RESET_BROWNOUT,
+  RESET_OTHER
+};
+
+// リセットをまたいで内容が残るRAM（ESP32のRTCメモリ、電源を切ると消える）
+// 内容は壊れている可能性があるので、使う側で検証する
+class RetainedMemory {
+public:
+  static const size_t SIZE = 3072;
+
+  virtual ~RetainedMemory() {}
+
+  virtual uint8_t* data() = 0;
+  virtual ResetReason resetReason() const = 0;
+};
+
+#endif // HAL_RETAINED_H
@@ -0,0 +1,55 @@
+#ifndef HAL_SENSOR_H
+#define HAL_SENSOR_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// I2Cバス（Wire相当、STOPまでを1回の転送とする）
+class I2cBus {
+public:
+  virtual ~I2cBus() {}
+
+  // address へ data を書き込む（アドレス・データがNACKなら false）
+  virtual bool write(uint8_t address, const uint8_t* data, size_t length) = 0;
+  // address から length バイト読む（読めたバイト数、NACKなら 0）
+  virtual size_t read(uint8_t address, uint8_t* data, size_t length) = 0;
+};
+
+// SGP30ガスセンサー（Adafruit_SGP30相当、失敗時は false）
+class SensorDriver {
+public:
+  virtual ~SensorDriver() {}
+
+  virtual bool begin() = 0;
+  virtual bool IAQinit() = 0;
+  virtual bool IAQmeasure() = 0;
+  virtual bool IAQmeasureRaw() = 0;
+  virtual bool getIAQBaseline(uint16_t* eco2_base, uint16_t* tvoc_base) = 0;
+  virtual bool setIAQBaseline(uint16_t eco2_base, uint16_t tvoc_base) = 0;
+  // 湿度補正に使う絶対湿度 (mg/m³、0: 補正なし)
+  virtual bool setHumidity(uint32_t absolute_humidity) = 0;
+
+  // 直近のIAQmeasure()の結果
+  virtual uint16_t tvoc() const = 0;
+  virtual uint16_t eco2() const = 0;
+  // 直近のIAQmeasureRaw()の結果（H2・エタノールの生信号）
+  virtual uint16_t rawH2() const = 0;
+  virtual uint16_t rawEthanol() const = 0;
+
+  // 直近の測定の時刻 (ms)。記録の再生のように millis() と異なる時間軸を持つ場合のみ true
+  virtual bool sampleTime(uint32_t* time_ms) const { return false; }
+};
+
+// 温湿度センサー（SHT3x相当、測定の開始と結果の読み取りを分けて待たない）
+class EnvironmentSensor {
+public:
+  virtual ~EnvironmentSensor() {}
+
+  virtual bool begin() = 0;
+  // 測定を開始する（結果は次の readMeasurement() で読む、測定には最大15 msかかる）
+  virtual bool startMeasurement() = 0;
+  // temperature: 0.01 ℃、humidity: 0.01 %RH（測定が終わっていない・CRC不一致なら false）
+  virtual bool readMeasurement(int16_t* temperature, uint16_t* humidity) = 0;
+};
+
+#endif // HAL_SENSOR_H
@@ -0,0 +1,25 @@
+#ifndef HAL_STORE_H
+#define HAL_STORE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// 名前空間付きの不揮発キーバリューストア（Preferences相当）
+class KeyValueStore {
+public:
+  virtual ~KeyValueStore() {}
+
+  virtual bool begin(const char* name, bool read_only) = 0;
+  virtual void end() = 0;
+
+  virtual uint16_t getUShort(const char* key, uint16_t default_value) = 0;
+  virtual size_t putUShort(const char* key, uint16_t value) = 0;
+
+  // 読み込んだバイト数（なければ 0）
+  virtual size_t getBytes(const char* key, void* buffer, size_t length) = 0;
+  virtual size_t putBytes(const char* key, const void* value, size_t length) = 0;
+
+  virtual bool remove(const char* key) = 0;
+};
+
+#endif // HAL_STORE_H
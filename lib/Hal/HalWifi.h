@@ -0,0 +1,43 @@
+#ifndef HAL_WIFI_H
+#define HAL_WIFI_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// 検索で見つかったアクセスポイント
+struct WifiAccessPoint {
+  char ssid[33];
+  uint8_t bssid[6];
+  uint8_t channel;
+  int8_t rssi;        // (dBm)
+};
+
+// 接続の状態
+enum WifiStatus : uint8_t {
+  WIFI_STATUS_IDLE,         // 未接続（begin() 前・disconnect() 後）
+  WIFI_STATUS_CONNECTING,
+  WIFI_STATUS_CONNECTED,
+  WIFI_STATUS_FAILED        // 接続に失敗した、または接続が切れた
+};
+
+// WiFiのステーション（検索・接続とも待たずに戻り、結果は後から確認する）
+class WifiDriver {
+public:
+  virtual ~WifiDriver() {}
+
+  // 検索を開始（開始できなければ false）
+  virtual bool startScan() = 0;
+  // 検索の結果を最大 max 件書き込み、件数を返す（-1: 検索中、-2: 失敗）
+  virtual int scanResults(WifiAccessPoint* results, int max) = 0;
+
+  // 接続を開始（bssid・channel を指定すると検索を省いてそのアクセスポイントへ接続する）
+  virtual void begin(const char* ssid, const char* password, const uint8_t* bssid, uint8_t channel) = 0;
+  virtual void disconnect() = 0;
+  virtual WifiStatus status() = 0;
+
+  // 接続中のアクセスポイント
+  virtual int8_t rssi() = 0;
+  virtual void connectedAp(uint8_t* bssid, uint8_t& channel) = 0;
+};
+
+#endif // HAL_WIFI_H
@@ -0,0 +1,403 @@
+#include "HalEsp32.h"
+
+#ifdef ARDUINO
+
+#include <esp_system.h>
+#include <Wire.h>
+#include <lwip/dns.h>
+#include <lwip/sockets.h>
+
+RTC_NOINIT_ATTR static uint8_t rtc_retained[RetainedMemory::SIZE];
+
+uint8_t* RtcRetainedMemory::data() {
+  return rtc_retained;
+}
+
+ResetReason RtcRetainedMemory::resetReason() const {
+  switch (esp_reset_reason()) {
+    case ESP_RST_POWERON:
+      return RESET_POWER_ON;
+    case ESP_RST_SW:
+      return RESET_SOFTWARE;
+    case ESP_RST_PANIC:
+    case ESP_RST_INT_WDT:
+    case ESP_RST_TASK_WDT:
+    case ESP_RST_WDT:
+      return RESET_CRASH;
+    case ESP_RST_BROWNOUT:
+      return RESET_BROWNOUT;
+    default:
+      return RESET_OTHER;
+  }
+}
+
+bool WireBus::write(uint8_t address, const uint8_t* data, size_t length) {
+  Wire.beginTransmission(address);
+  Wire.write(data, length);
+  return Wire.endTransmission() == 0;
+}
+
+size_t WireBus::read(uint8_t address, uint8_t* data, size_t length) {
+  size_t received = Wire.requestFrom(address, (uint8_t)length);
+  if (received != length) {
+    // NACK（SGP30の測定中など）は読めたバイトを捨てて 0 とする
+    while (Wire.available()) {
+      Wire.read();
+    }
+    return 0;
+  }
+  for (size_t i = 0; i < length; i++) {
+    data[i] = (uint8_t)Wire.read();
+  }
+  return length;
+}
+
+// SHT3xのCRC-8（多項式 0x31、初期値 0xFF）
+static uint8_t sht3xCrc(const uint8_t* data) {
+  uint8_t crc = 0xFF;
+  for (uint8_t i = 0; i < 2; i++) {
+    crc ^= data[i];
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x31) : (uint8_t)(crc << 1);
+    }
+  }
+  return crc;
+}
+
+bool Sht3xSensor::begin() {
+  Wire.beginTransmission(ADDRESS);
+  return Wire.endTransmission() == 0;
+}
+
+bool Sht3xSensor::startMeasurement() {
+  // 単発測定・高精度・クロックストレッチなし（測定中の読み取りはNACKになる）
+  Wire.beginTransmission(ADDRESS);
+  Wire.write(0x24);
+  Wire.write(0x00);
+  return Wire.endTransmission() == 0;
+}
+
+bool Sht3xSensor::readMeasurement(int16_t* temperature, uint16_t* humidity) {
+  if (Wire.requestFrom(ADDRESS, (uint8_t)6) != 6) {
+    return false;
+  }
+  uint8_t data[6];
+  for (uint8_t i = 0; i < 6; i++) {
+    data[i] = (uint8_t)Wire.read();
+  }
+  if (sht3xCrc(data) != data[2] || sht3xCrc(data + 3) != data[5]) {
+    return false;
+  }
+
+  // T = -45 + 175 × S / 65535、RH = 100 × S / 65535
+  uint32_t raw_temperature = (data[0] << 8) | data[1];
+  uint32_t raw_humidity = (data[3] << 8) | data[4];
+  *temperature = (int16_t)((int32_t)(raw_temperature * 17500 / 65535) - 4500);
+  *humidity = (uint16_t)(raw_humidity * 10000 / 65535);
+  return true;
+}
+
+FileHandle* SdFileSystem::open(const char* path, FileMode mode) {
+  const char* sd_mode = mode == FILE_MODE_READ ? FILE_READ : (mode == FILE_MODE_WRITE ? FILE_WRITE : FILE_APPEND);
+  File file = SD.open(path, sd_mode);
+  if (!file) {
+    return nullptr;
+  }
+  return new SdFileHandle(file);
+}
+
+void SdFileSystem::close(FileHandle* file) {
+  if (file == nullptr) {
+    return;
+  }
+  static_cast<SdFileHandle*>(file)->file.close();
+  delete file;
+}
+
+int WiFiNetClient::read(uint8_t* buffer, size_t length) {
+  int available = client.available();
+  if (available <= 0) {
+    return client.connected() ? 0 : -1;
+  }
+  return client.read(buffer, length < (size_t)available ? length : (size_t)available);
+}
+
+bool WiFiNetServer::begin(uint16_t port) {
+  if (server == nullptr) {
+    server = new WiFiServer(port);
+  }
+  server->begin();
+  server->setNoDelay(true);
+  return true;
+}
+
+NetClient* WiFiNetServer::accept() {
+  if (server == nullptr) {
+    return nullptr;
+  }
+
+  for (WiFiNetClient& slot : clients) {
+    if (slot.in_use) {
+      continue;
+    }
+    WiFiClient client = server->available();
+    if (!client) {
+      return nullptr;
+    }
+    slot.client = client;
+    slot.in_use = true;
+    return &slot;
+  }
+  return nullptr;
+}
+
+void WiFiNetServer::close(NetClient* client) {
+  WiFiNetClient* slot = static_cast<WiFiNetClient*>(client);
+  slot->client.stop();
+  slot->in_use = false;
+}
+
+static void dnsFound(const char* name, const ip_addr_t* address, void* connector) {
+  static_cast<WiFiNetConnector*>(connector)->dnsResolved(address != nullptr ? ip4_addr_get_u32(ip_2_ip4(address)) : 0);
+}
+
+void WiFiNetConnector::dnsResolved(uint32_t address) {
+  dns_address = address;
+  dns_state.store(address != 0 ? DNS_DONE : DNS_FAILED);
+}
+
+bool WiFiNetConnector::resolve(const char* host) {
+  // 同じホストは前回の結果（または解決中の結果）を使う
+  uint8_t state = dns_state.load();
+  if (strcmp(host, dns_host) == 0 && (state == DNS_DONE || state == DNS_PENDING)) {
+    return true;
+  }
+  if (strlen(host) >= sizeof(dns_host)) {
+    return false;
+  }
+  strcpy(dns_host, host);
+
+  in_addr literal;
+  if (inet_pton(AF_INET, host, &literal) == 1) {
+    dnsResolved(literal.s_addr);
+    return true;
+  }
+
+  // キャッシュにあればすぐに、なければ dnsFound() が後から結果を渡す
+  ip_addr_t address;
+  dns_state.store(DNS_PENDING);
+  err_t err = dns_gethostbyname(dns_host, &address, dnsFound, this);
+  if (err == ERR_OK) {
+    dnsResolved(ip4_addr_get_u32(ip_2_ip4(&address)));
+  } else if (err != ERR_INPROGRESS) {
+    dns_state.store(DNS_FAILED);
+    return false;
+  }
+  return true;
+}
+
+NetClient* WiFiNetConnector::connect(const char* host, uint16_t port) {
+  for (WiFiNetClient& slot : clients) {
+    if (slot.in_use) {
+      continue;
+    }
+    if (!resolve(host)) {
+      return nullptr;
+    }
+    slot.in_use = true;
+    slot.resolving = true;
+    slot.pending_fd = -1;
+    slot.port = port;
+    return &slot;
+  }
+  return nullptr;
+}
+
+bool WiFiNetConnector::startConnect(WiFiNetClient& slot) {
+  int fd = lwip_socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return false;
+  }
+  lwip_fcntl(fd, F_SETFL, lwip_fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(slot.port);
+  address.sin_addr.s_addr = dns_address;
+  if (lwip_connect(fd, (sockaddr*)&address, sizeof(address)) < 0 && errno != EINPROGRESS) {
+    lwip_close(fd);
+    return false;
+  }
+  slot.pending_fd = fd;
+  return true;
+}
+
+NetConnectStatus WiFiNetConnector::pollConnect(NetClient* client) {
+  WiFiNetClient* slot = static_cast<WiFiNetClient*>(client);
+  if (slot->resolving) {
+    uint8_t state = dns_state.load();
+    if (state == DNS_PENDING) {
+      return NET_CONNECT_PENDING;
+    }
+    slot->resolving = false;
+    if (state != DNS_DONE || !startConnect(*slot)) {
+      dns_state.store(DNS_NONE);
+      return NET_CONNECT_FAILED;
+    }
+  }
+  if (slot->pending_fd < 0) {
+    return slot->client.connected() ? NET_CONNECT_DONE : NET_CONNECT_FAILED;
+  }
+
+  int fd = slot->pending_fd;
+  fd_set writable;
+  FD_ZERO(&writable);
+  FD_SET(fd, &writable);
+  timeval no_wait = { 0, 0 };
+  int ready = lwip_select(fd + 1, nullptr, &writable, nullptr, &no_wait);
+  if (ready == 0) {
+    return NET_CONNECT_PENDING;
+  }
+  int error = 0;
+  socklen_t length = sizeof(error);
+  if (ready < 0 || lwip_getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) < 0 || error != 0) {
+    // アドレスが変わった可能性があるので次の接続では解決し直す
+    dns_state.store(DNS_NONE);
+    return NET_CONNECT_FAILED;
+  }
+
+  // WiFiClient::connect() と同じくブロックするソケットに戻して渡す
+  lwip_fcntl(fd, F_SETFL, lwip_fcntl(fd, F_GETFL, 0) & ~O_NONBLOCK);
+  slot->pending_fd = -1;
+  slot->client = WiFiClient(fd);
+  slot->client.setNoDelay(true);
+  return NET_CONNECT_DONE;
+}
+
+void WiFiNetConnector::close(NetClient* client) {
+  WiFiNetClient* slot = static_cast<WiFiNetClient*>(client);
+  if (slot->pending_fd >= 0) {
+    lwip_close(slot->pending_fd);
+    slot->pending_fd = -1;
+  }
+  slot->resolving = false;
+  slot->client.stop();
+  slot->in_use = false;
+}
+
+bool EspWifiDriver::startScan() {
+  WiFi.mode(WIFI_STA);
+  WiFi.setAutoReconnect(false);
+  WiFi.scanDelete();
+  return WiFi.scanNetworks(true) == WIFI_SCAN_RUNNING;
+}
+
+int EspWifiDriver::scanResults(WifiAccessPoint* results, int max) {
+  int16_t found = WiFi.scanComplete();
+  if (found == WIFI_SCAN_RUNNING) {
+    return -1;
+  }
+  if (found < 0) {
+    return -2;
+  }
+
+  int count = found < max ? found : max;
+  for (int i = 0; i < count; i++) {
+    WifiAccessPoint& ap = results[i];
+    strncpy(ap.ssid, WiFi.SSID(i).c_str(), sizeof(ap.ssid) - 1);
+    ap.ssid[sizeof(ap.ssid) - 1] = '\0';
+    memcpy(ap.bssid, WiFi.BSSID(i), sizeof(ap.bssid));
+    ap.channel = (uint8_t)WiFi.channel(i);
+    ap.rssi = (int8_t)WiFi.RSSI(i);
+  }
+  WiFi.scanDelete();
+  return count;
+}
+
+void EspWifiDriver::begin(const char* ssid, const char* password, const uint8_t* bssid, uint8_t channel) {
+  WiFi.mode(WIFI_STA);
+  WiFi.setAutoReconnect(false);
+  WiFi.begin(ssid, password, channel, bssid);
+  attempting = true;
+}
+
+void EspWifiDriver::disconnect() {
+  WiFi.disconnect();
+  attempting = false;
+}
+
+WifiStatus EspWifiDriver::status() {
+  wl_status_t status = WiFi.status();
+  if (status == WL_CONNECTED) {
+    return WIFI_STATUS_CONNECTED;
+  }
+  if (!attempting) {
+    return WIFI_STATUS_IDLE;
+  }
+  if (status == WL_CONNECT_FAILED || status == WL_NO_SSID_AVAIL || status == WL_CONNECTION_LOST) {
+    return WIFI_STATUS_FAILED;
+  }
+  // 切断後は WL_DISCONNECTED のまま戻らないことがあるので、期限は呼び出し側で管理する
+  return WIFI_STATUS_CONNECTING;
+}
+
+void EspWifiDriver::connectedAp(uint8_t* bssid, uint8_t& channel) {
+  memcpy(bssid, WiFi.BSSID(), 6);
+  channel = (uint8_t)WiFi.channel();
+}
+
+bool TftCanvas::create(int16_t width, int16_t height, uint8_t color_depth) {
+  sprite.setColorDepth(color_depth);
+  if (sprite.createSprite(width, height) == nullptr) {
+    return false;
+  }
+  w = width;
+  h = height;
+  return true;
+}
+
+void TftCanvas::drawText(int16_t x, int16_t y, const char* text, uint8_t size, uint16_t color) {
+  sprite.setTextSize(size);
+  sprite.setTextColor(color);
+  sprite.setCursor(x, y);
+  sprite.print(text);
+}
+
+void TftDisplay::drawText(int16_t x, int16_t y, const char* text, uint8_t size, uint16_t color, uint16_t bg_color) {
+  lcd->setTextSize(size);
+  lcd->setTextColor(color, bg_color);
+  lcd->setCursor(x, y);
+  lcd->print(text);
+}
+
+void TftDisplay::pushImage(int16_t x, int16_t y, int16_t w, int16_t h, const uint16_t* pixels) {
+  // 配列はCPUのバイト順（リトルエンディアン）なので、転送時に入れ替える
+  bool swap = lcd->getSwapBytes();
+  lcd->setSwapBytes(true);
+  lcd->pushImage(x, y, w, h, const_cast<uint16_t*>(pixels));
+  lcd->setSwapBytes(swap);
+}
+
+Canvas* TftDisplay::createCanvas(int16_t w, int16_t h, uint8_t color_depth) {
+  TftCanvas* canvas = new TftCanvas(lcd);
+  if (!canvas->create(w, h, color_depth)) {
+    delete canvas;
+    return nullptr;
+  }
+  return canvas;
+}
+
+void TftDisplay::pushCanvas(Canvas& canvas, int16_t x, int16_t y) {
+  // このディスプレイが確保したキャンバスのみ
+  static_cast<TftCanvas&>(canvas).raw().pushSprite(x, y);
+}
+
+::Button& M5Buttons::get(Button button) {
+  switch (button) {
+    case BUTTON_A: return M5.BtnA;
+    case BUTTON_B: return M5.BtnB;
+    default:       return M5.BtnC;
+  }
+}
+
+#endif // ARDUINO
@@ -0,0 +1,250 @@
+#ifndef HAL_ESP32_H
+#define HAL_ESP32_H
+
+// M5Stack実機向けのHAL実装
+#ifdef ARDUINO
+
+#include <Hal.h>
+#include <Adafruit_SGP30.h>
+#include <Preferences.h>
+#include <SD.h>
+#include <WiFi.h>
+#include <atomic>
+
+// Adafruit_SGP30
+class Sgp30Driver : public SensorDriver {
+public:
+  bool begin() override { return sgp.begin(); }
+  bool IAQinit() override { return sgp.IAQinit(); }
+  bool IAQmeasure() override { return sgp.IAQmeasure(); }
+  bool IAQmeasureRaw() override { return sgp.IAQmeasureRaw(); }
+  bool getIAQBaseline(uint16_t* eco2_base, uint16_t* tvoc_base) override {
+    return sgp.getIAQBaseline(eco2_base, tvoc_base);
+  }
+  bool setIAQBaseline(uint16_t eco2_base, uint16_t tvoc_base) override {
+    return sgp.setIAQBaseline(eco2_base, tvoc_base);
+  }
+  bool setHumidity(uint32_t absolute_humidity) override { return sgp.setHumidity(absolute_humidity); }
+  uint16_t tvoc() const override { return sgp.TVOC; }
+  uint16_t eco2() const override { return sgp.eCO2; }
+  uint16_t rawH2() const override { return sgp.rawH2; }
+  uint16_t rawEthanol() const override { return sgp.rawEthanol; }
+
+private:
+  Adafruit_SGP30 sgp;
+};
+
+// Wire（SGP30・SHT3x・マルチプレクサと同じI2Cバス）
+class WireBus : public I2cBus {
+public:
+  bool write(uint8_t address, const uint8_t* data, size_t length) override;
+  size_t read(uint8_t address, uint8_t* data, size_t length) override;
+};
+
+// SHT3x（ENV III ユニットなど、SGP30と同じI2Cバス）
+class Sht3xSensor : public EnvironmentSensor {
+public:
+  static const uint8_t ADDRESS = 0x44;
+
+  bool begin() override;
+  bool startMeasurement() override;
+  bool readMeasurement(int16_t* temperature, uint16_t* humidity) override;
+};
+
+// Preferences (NVS)
+class NvsStore : public KeyValueStore {
+public:
+  bool begin(const char* name, bool read_only) override { return prefs.begin(name, read_only); }
+  void end() override { prefs.end(); }
+  uint16_t getUShort(const char* key, uint16_t default_value) override { return prefs.getUShort(key, default_value); }
+  size_t putUShort(const char* key, uint16_t value) override { return prefs.putUShort(key, value); }
+  size_t getBytes(const char* key, void* buffer, size_t length) override { return prefs.getBytes(key, buffer, length); }
+  size_t putBytes(const char* key, const void* value, size_t length) override { return prefs.putBytes(key, value, length); }
+  bool remove(const char* key) override { return prefs.remove(key); }
+
+private:
+  Preferences prefs;
+};
+
+// RTCメモリ（RTC_NOINIT_ATTR、ソフトウェアリセット・ウォッチドッグ・ブラウンアウトで消えない）
+class RtcRetainedMemory : public RetainedMemory {
+public:
+  uint8_t* data() override;
+  ResetReason resetReason() const override;
+};
+
+// SD.File
+class SdFileHandle : public FileHandle {
+public:
+  explicit SdFileHandle(File file) : file(file) {}
+
+  size_t read(uint8_t* buffer, size_t length) override { return file.read(buffer, length); }
+  size_t write(const uint8_t* buffer, size_t length) override { return file.write(buffer, length); }
+  void flush() override { file.flush(); }
+  uint32_t size() override { return file.size(); }
+  bool seek(uint32_t position) override { return file.seek(position); }
+
+private:
+  friend class SdFileSystem;
+  File file;
+};
+
+// SDカード（SD.begin() 済みであること）
+class SdFileSystem : public FileSystem {
+public:
+  FileHandle* open(const char* path, FileMode mode) override;
+  void close(FileHandle* file) override;
+  bool exists(const char* path) override { return SD.exists(path); }
+  bool makeDir(const char* path) override { return SD.exists(path) || SD.mkdir(path); }
+};
+
+// WiFiClient
+class WiFiNetClient : public NetClient {
+public:
+  int read(uint8_t* buffer, size_t length) override;
+  size_t write(const uint8_t* data, size_t length) override { return client.write(data, length); }
+  bool connected() override { return client.connected(); }
+
+private:
+  friend class WiFiNetServer;
+  friend class WiFiNetConnector;
+  WiFiClient client;
+  bool in_use = false;
+
+  // 接続の確立中（WiFiNetConnector）
+  bool resolving = false;   // 名前解決の完了待ち
+  int pending_fd = -1;      // 確立待ちのソケット
+  uint16_t port = 0;
+};
+
+// WiFiServer
+class WiFiNetServer : public NetServer {
+public:
+  static const uint8_t MAX_CLIENTS = 4;
+
+  bool begin(uint16_t port) override;
+  NetClient* accept() override;
+  void close(NetClient* client) override;
+
+private:
+  WiFiServer* server = nullptr;   // ポートはbegin()で決まる
+  WiFiNetClient clients[MAX_CLIENTS];
+};
+
+// 名前解決（lwIPの非同期のDNS）と接続の確立を待たずに進める。
+// 解決したアドレスは覚えておき、接続に失敗するまで次の接続にも使う
+class WiFiNetConnector : public NetConnector {
+public:
+  static const uint8_t MAX_CLIENTS = 2;
+
+  NetClient* connect(const char* host, uint16_t port) override;
+  NetConnectStatus pollConnect(NetClient* client) override;
+  void close(NetClient* client) override;
+
+  // 名前解決の結果（lwIPのタスクから呼ばれる、0: 失敗）
+  void dnsResolved(uint32_t address);
+
+private:
+  enum DnsState : uint8_t {
+    DNS_NONE,
+    DNS_PENDING,
+    DNS_DONE,
+    DNS_FAILED
+  };
+
+  WiFiNetClient clients[MAX_CLIENTS];
+  char dns_host[64] = "";
+  uint32_t dns_address = 0;               // ネットワークバイトオーダー
+  std::atomic<uint8_t> dns_state{DNS_NONE};
+
+  bool resolve(const char* host);
+  bool startConnect(WiFiNetClient& slot);
+};
+
+// WiFi（ステーション、再接続は WifiManager が行う）
+class EspWifiDriver : public WifiDriver {
+public:
+  bool startScan() override;
+  int scanResults(WifiAccessPoint* results, int max) override;
+  void begin(const char* ssid, const char* password, const uint8_t* bssid, uint8_t channel) override;
+  void disconnect() override;
+  WifiStatus status() override;
+  int8_t rssi() override { return WiFi.RSSI(); }
+  void connectedAp(uint8_t* bssid, uint8_t& channel) override;
+
+private:
+  bool attempting = false;    // begin() から disconnect() まで
+};
+
+// TFT_eSprite
+class TftCanvas : public Canvas {
+public:
+  explicit TftCanvas(TFT_eSPI* lcd) : sprite(lcd) {}
+  ~TftCanvas() { sprite.deleteSprite(); }
+
+  bool create(int16_t w, int16_t h, uint8_t color_depth);
+  TFT_eSprite& raw() { return sprite; }
+
+  int16_t width() const override { return w; }
+  int16_t height() const override { return h; }
+  void fill(uint16_t color) override { sprite.fillSprite(color); }
+  void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) override { sprite.fillRect(x, y, w, h, color); }
+  void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) override { sprite.drawFastHLine(x, y, w, color); }
+  void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) override { sprite.drawFastVLine(x, y, h, color); }
+  void drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color) override {
+    sprite.drawLine(x0, y0, x1, y1, color);
+  }
+  void drawRoundRect(int16_t x, int16_t y, int16_t w, int16_t h, int16_t r, uint16_t color) override {
+    sprite.drawRoundRect(x, y, w, h, r, color);
+  }
+  void drawText(int16_t x, int16_t y, const char* text, uint8_t size, uint16_t color) override;
+  uint16_t readPixel(int16_t x, int16_t y) override { return sprite.readPixel(x, y); }
+
+private:
+  TFT_eSprite sprite;
+  int16_t w = 0;
+  int16_t h = 0;
+};
+
+// M5Stack LCD (M5Display)
+class TftDisplay : public Display {
+public:
+  explicit TftDisplay(M5Display* lcd) : lcd(lcd) {}
+
+  int16_t width() const override { return lcd->width(); }
+  int16_t height() const override { return lcd->height(); }
+  void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) override { lcd->fillRect(x, y, w, h, color); }
+  void drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color) override {
+    lcd->drawLine(x0, y0, x1, y1, color);
+  }
+  void drawRoundRect(int16_t x, int16_t y, int16_t w, int16_t h, int16_t r, uint16_t color) override {
+    lcd->drawRoundRect(x, y, w, h, r, color);
+  }
+  void drawText(int16_t x, int16_t y, const char* text, uint8_t size, uint16_t color, uint16_t bg_color) override;
+  void pushImage(int16_t x, int16_t y, int16_t w, int16_t h, const uint16_t* pixels) override;
+  void setBrightness(uint8_t level) override { lcd->setBrightness(level); }
+
+  Canvas* createCanvas(int16_t w, int16_t h, uint8_t color_depth) override;
+  void destroyCanvas(Canvas* canvas) override { delete canvas; }
+  void pushCanvas(Canvas& canvas, int16_t x, int16_t y) override;
+
+private:
+  M5Display* lcd;
+};
+
+// M5.BtnA / BtnB / BtnC
+class M5Buttons : public ButtonInput {
+public:
+  void update() override { M5.update(); }
+  bool isPressed(Button button) override { return get(button).isPressed(); }
+  bool wasPressed(Button button) override { return get(button).wasPressed(); }
+  bool wasReleased(Button button) override { return get(button).wasReleased(); }
+  bool wasReleasefor(Button button, uint32_t hold_ms) override { return get(button).wasReleasefor(hold_ms); }
+
+private:
+  ::Button& get(Button button);
+};
+
+#endif // ARDUINO
+
+#endif // HAL_ESP32_H
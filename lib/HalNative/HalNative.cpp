@@ -0,0 +1,1132 @@
+#include "HalNative.h"
+
+#ifndef ARDUINO
+
+#include <algorithm>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+SimulatedSgp30 sim_sensor;
+SimulatedI2cBus sim_i2c;
+SimulatedSht3x sim_environment;
+MemoryStore sim_store;
+FramebufferDisplay sim_display;
+ScriptedButtons sim_buttons;
+StdioFileSystem sim_files;
+PosixNetServer sim_net;
+PosixNetConnector sim_connector;
+SimulatedWifi sim_wifi;
+FileRetainedMemory sim_retained;
+const char* sim_trace_record = nullptr;
+const char* sim_trace_replay = nullptr;
+bool sim_trace_fast = false;
+const char* sim_log_dir = nullptr;
+uint16_t sim_http_port = 0;
+uint16_t sim_mqtt_port = 0;
+const char* sim_signal_chain = nullptr;
+uint8_t sim_sensor_count = 0;
+const char* sim_sensor_aggregate = nullptr;
+bool sim_sensor_blocking = false;
+uint32_t sim_sensor_delay_us = 0;
+
+// IAQinit() 直後のベースライン（実機の典型値）
+static const uint16_t DEFAULT_ECO2_BASELINE = 0x8A20;
+static const uint16_t DEFAULT_TVOC_BASELINE = 0x8C50;
+
+// ---- SimulatedSgp30 ----
+
+SimulatedSgp30::SimulatedSgp30() :
+  connected(true),
+  tvoc_value(0),
+  eco2_value(400),
+  raw_h2(0),
+  raw_ethanol(0),
+  eco2_baseline(DEFAULT_ECO2_BASELINE),
+  tvoc_baseline(DEFAULT_TVOC_BASELINE),
+  measure_count(0),
+  humidity_count(0),
+  noise_state(2463534242u),
+  cooking_exposure(100) {
+}
+
+void SimulatedSgp30::setPlacement(uint8_t index) {
+  noise_state = 2463534242u + index * 0x9E3779B9u;
+  cooking_exposure = index * 12 < 84 ? (uint8_t)(100 - index * 12) : 16;
+}
+
+bool SimulatedSgp30::loadScript(const char* path) {
+  FILE* file = fopen(path, "r");
+  if (file == nullptr) {
+    return false;
+  }
+
+  script.clear();
+  char line[80];
+  while (fgets(line, sizeof(line), file) != nullptr) {
+    unsigned long time_s, tvoc, eco2;
+    if (sscanf(line, "%lu,%lu,%lu", &time_s, &tvoc, &eco2) == 3) {
+      script.push_back({ (uint32_t)time_s, (uint16_t)tvoc, (uint16_t)eco2 });
+    }
+  }
+  fclose(file);
+  return !script.empty();
+}
+
+bool SimulatedSgp30::IAQinit() {
+  eco2_baseline = DEFAULT_ECO2_BASELINE;
+  tvoc_baseline = DEFAULT_TVOC_BASELINE;
+  return connected;
+}
+
+bool SimulatedSgp30::IAQmeasure() {
+  if (!connected) {
+    return false;
+  }
+
+  uint32_t time_s = millis() / 1000;
+  if (script.empty()) {
+    scenario(time_s);
+  } else {
+    interpolate(time_s);
+  }
+  measure_count++;
+  return true;
+}
+
+bool SimulatedSgp30::IAQmeasureRaw() {
+  if (!connected) {
+    return false;
+  }
+
+  // 生信号は濃度の対数に比例して下がる（データシートの c = c_ref * exp((s_ref - s_out) / 512) を近似）
+  int eco2_excess = eco2_value > 400 ? eco2_value - 400 : 0;
+  raw_h2 = (uint16_t)(13600 - 512 * log(1 + eco2_excess / 100.0));
+  raw_ethanol = (uint16_t)(18500 - 512 * log(1 + tvoc_value / 20.0));
+  return true;
+}
+
+bool SimulatedSgp30::getIAQBaseline(uint16_t* eco2_base, uint16_t* tvoc_base) {
+  *eco2_base = eco2_baseline;
+  *tvoc_base = tvoc_baseline;
+  return connected;
+}
+
+bool SimulatedSgp30::setIAQBaseline(uint16_t eco2_base, uint16_t tvoc_base) {
+  eco2_baseline = eco2_base;
+  tvoc_baseline = tvoc_base;
+  return connected;
+}
+
+bool SimulatedSgp30::setHumidity(uint32_t absolute_humidity) {
+  humidity_count++;
+  return connected;
+}
+
+int SimulatedSgp30::noise(int amplitude) {
+  // xorshift32（実行ごとに同じ系列）
+  noise_state ^= noise_state << 13;
+  noise_state ^= noise_state >> 17;
+  noise_state ^= noise_state << 5;
+  return (int)(noise_state % (2 * amplitude + 1)) - amplitude;
+}
+
+void SimulatedSgp30::scenario(uint32_t time_s) {
+  double hour = (time_s % 86400) / 3600.0;
+
+  // 在室（7時〜23時）でeCO2とTVOCが上昇、夜間はクリーンエア
+  double occupancy = (hour >= 7 && hour < 23) ? sin(M_PI * (hour - 7) / 16) : 0;
+
+  // 12時と19時の調理でTVOCが急上昇して20分程度で減衰
+  double cooking = 0;
+  const double meals[] = { 12, 19 };
+  for (double meal : meals) {
+    double minutes = (hour - meal) * 60;
+    if (minutes >= 0 && minutes < 120) {
+      cooking += 8 * cooking_exposure * exp(-minutes / 20);
+    }
+  }
+
+  int eco2 = 420 + (int)(600 * occupancy) + noise(15);
+  int tvoc = 20 + (int)(80 * occupancy + cooking) + noise(10);
+  eco2_value = eco2 < 400 ? 400 : (uint16_t)eco2;
+  tvoc_value = tvoc < 0 ? 0 : (uint16_t)tvoc;
+}
+
+void SimulatedSgp30::interpolate(uint32_t time_s) {
+  const Keyframe* prev = &script.front();
+  for (const Keyframe& next : script) {
+    if (next.time_s > time_s) {
+      if (next.time_s == prev->time_s || time_s < prev->time_s) {
+        break;
+      }
+      double t = (double)(time_s - prev->time_s) / (next.time_s - prev->time_s);
+      tvoc_value = (uint16_t)(prev->tvoc + t * ((int)next.tvoc - prev->tvoc));
+      eco2_value = (uint16_t)(prev->eco2 + t * ((int)next.eco2 - prev->eco2));
+      return;
+    }
+    prev = &next;
+  }
+
+  tvoc_value = prev->tvoc;
+  eco2_value = prev->eco2;
+}
+
+// ---- SimulatedSgp30Device ----
+
+// SensirionのCRC-8（多項式 0x31、初期値 0xFF）
+static uint8_t sensirionCrc(const uint8_t* data) {
+  uint8_t crc = 0xFF;
+  for (uint8_t i = 0; i < 2; i++) {
+    crc ^= data[i];
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x31) : (uint8_t)(crc << 1);
+    }
+  }
+  return crc;
+}
+
+SimulatedSgp30Device::SimulatedSgp30Device(uint8_t placement) :
+  own_sensor(),
+  sensor(&own_sensor),
+  placement(placement),
+  extra_delay_us(0),
+  words(),
+  word_count(0),
+  ready_us(0) {
+  own_sensor.setPlacement(placement);
+}
+
+SimulatedSgp30Device::SimulatedSgp30Device(SimulatedSgp30* model) :
+  own_sensor(),
+  sensor(model),
+  placement(0),
+  extra_delay_us(0),
+  words(),
+  word_count(0),
+  ready_us(0) {
+}
+
+bool SimulatedSgp30Device::write(const uint8_t* data, size_t length) {
+  // 測定・処理中はアドレスにも応答しない
+  uint64_t now = VirtualClock::nowMicros();
+  if (!sensor->isConnected() || now < ready_us || length < 2 || (length - 2) % 3 != 0) {
+    return false;
+  }
+  uint16_t args[2] = {};
+  size_t arg_count = (length - 2) / 3;
+  for (size_t i = 0; i < arg_count && i < 2; i++) {
+    const uint8_t* arg = data + 2 + i * 3;
+    if (sensirionCrc(arg) != arg[2]) {
+      return false;
+    }
+    args[i] = (uint16_t)((arg[0] << 8) | arg[1]);
+  }
+
+  // コマンドごとの結果と処理時間（データシートの最大値）
+  uint16_t command = (uint16_t)((data[0] << 8) | data[1]);
+  uint32_t busy_ms = 10;
+  word_count = 0;
+  switch (command) {
+    case 0x3682:   // get_serial_id
+      words[0] = 0x0000;
+      words[1] = 0x0100 + placement;
+      words[2] = 0x5A3C;
+      word_count = 3;
+      busy_ms = 1;
+      break;
+    case 0x202F:   // get_feature_set
+      words[0] = 0x0022;
+      word_count = 1;
+      break;
+    case 0x2003:   // iaq_init
+      sensor->IAQinit();
+      break;
+    case 0x2008:   // measure_iaq
+      sensor->IAQmeasure();
+      words[0] = sensor->eco2();
+      words[1] = sensor->tvoc();
+      word_count = 2;
+      busy_ms = 12;
+      break;
+    case 0x2050:   // measure_raw
+      sensor->IAQmeasureRaw();
+      words[0] = sensor->rawH2();
+      words[1] = sensor->rawEthanol();
+      word_count = 2;
+      busy_ms = 25;
+      break;
+    case 0x2015:   // get_iaq_baseline
+      sensor->getIAQBaseline(&words[0], &words[1]);
+      word_count = 2;
+      break;
+    case 0x201E:   // set_iaq_baseline（TVOC・eCO2の順）
+      if (arg_count != 2) {
+        return false;
+      }
+      sensor->setIAQBaseline(args[1], args[0]);
+      break;
+    case 0x2061:   // set_absolute_humidity
+      if (arg_count != 1) {
+        return false;
+      }
+      sensor->setHumidity(args[0]);
+      break;
+    default:
+      return false;
+  }
+  ready_us = now + busy_ms * 1000;
+  if (command == 0x2008 || command == 0x2050) {
+    ready_us += extra_delay_us;
+  }
+  return true;
+}
+
+size_t SimulatedSgp30Device::read(uint8_t* data, size_t length) {
+  if (!sensor->isConnected() || VirtualClock::nowMicros() < ready_us || length == 0 || length > (size_t)word_count * 3) {
+    return 0;
+  }
+  for (size_t i = 0; i * 3 < length; i++) {
+    data[i * 3] = (uint8_t)(words[i] >> 8);
+    data[i * 3 + 1] = (uint8_t)(words[i] & 0xFF);
+    data[i * 3 + 2] = sensirionCrc(data + i * 3);
+  }
+  word_count = 0;
+  return length;
+}
+
+// ---- SimulatedI2cBus ----
+
+void SimulatedI2cBus::attach(uint8_t address, SimulatedI2cDevice* device, int8_t channel) {
+  devices.push_back({ address, channel, device });
+}
+
+void SimulatedI2cBus::setFaults(uint16_t nack_per_mille, uint16_t corrupt_per_mille) {
+  nack_rate = nack_per_mille;
+  corrupt_rate = corrupt_per_mille;
+}
+
+bool SimulatedI2cBus::fault(uint16_t per_mille) {
+  if (per_mille == 0) {
+    return false;
+  }
+  fault_state = fault_state * 1103515245 + 12345;
+  if ((fault_state >> 16) % 1000 >= per_mille) {
+    return false;
+  }
+  faults++;
+  return true;
+}
+
+void SimulatedI2cBus::transferTime(size_t length) {
+  // アドレス 1バイト + データ
+  transactions++;
+  VirtualClock::advance(START_STOP_US + (1 + length) * BYTE_US);
+}
+
+SimulatedI2cDevice* SimulatedI2cBus::find(uint8_t address) {
+  SimulatedI2cDevice* found = nullptr;
+  for (const Attached& attached : devices) {
+    bool reachable = attached.channel < 0 || (mux_address != 0 && (mux_control & (1 << attached.channel)) != 0);
+    if (attached.address != address || !reachable) {
+      continue;
+    }
+    if (found != nullptr) {
+      collisions++;
+      return nullptr;
+    }
+    found = attached.device;
+  }
+  return found;
+}
+
+bool SimulatedI2cBus::write(uint8_t address, const uint8_t* data, size_t length) {
+  transferTime(length);
+  if (mux_address != 0 && address == mux_address) {
+    if (length != 1) {
+      nacks++;
+      return false;
+    }
+    mux_control = data[0];
+    return true;
+  }
+
+  // NACKならコマンドは機器に届かない
+  SimulatedI2cDevice* device = find(address);
+  if (device == nullptr || fault(nack_rate) || !device->write(data, length)) {
+    nacks++;
+    return false;
+  }
+  return true;
+}
+
+size_t SimulatedI2cBus::read(uint8_t address, uint8_t* data, size_t length) {
+  transferTime(length);
+  // NACKなら機器は結果を保持したまま（読み直せる）、データを壊した場合は結果は失われる
+  SimulatedI2cDevice* device = find(address);
+  size_t received = device != nullptr && !fault(nack_rate) ? device->read(data, length) : 0;
+  if (received == 0) {
+    nacks++;
+  } else if (fault(corrupt_rate)) {
+    data[(fault_state >> 8) % received] ^= (uint8_t)(1 << ((fault_state >> 4) & 7));
+  }
+  return received;
+}
+
+static std::vector<SimulatedSgp30Device*> sensors;
+
+void attachSimulatedSensors(uint8_t count, bool mux, uint32_t extra_delay_us) {
+  sim_i2c.setMux(mux ? 0x70 : 0);
+  for (uint8_t i = 0; i < count; i++) {
+    // マルチプレクサなしの1台は sim_sensor のシナリオ・接続の有無に従う
+    sensors.push_back(mux ? new SimulatedSgp30Device(i) : new SimulatedSgp30Device(&sim_sensor));
+    sensors.back()->setExtraDelay(extra_delay_us);
+    sim_i2c.attach(0x58, sensors.back(), mux ? (int8_t)i : -1);
+  }
+}
+
+uint32_t simulatedHumidityCount() {
+  uint32_t count = sim_sensor.humidityCount();
+  for (SimulatedSgp30Device* sensor : sensors) {
+    if (&sensor->model() == &sim_sensor) {
+      continue;
+    }
+    count += sensor->model().humidityCount();
+  }
+  return count;
+}
+
+// ---- SimulatedSht3x ----
+
+bool SimulatedSht3x::startMeasurement() {
+  if (!connected) {
+    return false;
+  }
+  started = true;
+  start_time = millis();
+  return true;
+}
+
+bool SimulatedSht3x::readMeasurement(int16_t* temperature, uint16_t* humidity) {
+  if (!connected || !started || millis() - start_time < MEASURE_TIME) {
+    return false;
+  }
+  started = false;
+
+  // 15時に最も暖かく乾燥し、朝方に冷えて湿度が上がる
+  double hour = (start_time / 1000 % 86400) / 3600.0;
+  double phase = cos(2 * M_PI * (hour - 15) / 24);
+  *temperature = (int16_t)(2200 + 300 * phase);
+  *humidity = (uint16_t)(5000 - 1200 * phase);
+  return true;
+}
+
+// ---- MemoryStore ----
+
+bool MemoryStore::begin(const char* name, bool read_only) {
+  space = name;
+  this->read_only = read_only;
+  return true;
+}
+
+uint16_t MemoryStore::getUShort(const char* key, uint16_t default_value) {
+  std::map<std::string, uint16_t>::const_iterator it = values.find(space + "/" + key);
+  return it == values.end() ? default_value : it->second;
+}
+
+size_t MemoryStore::putUShort(const char* key, uint16_t value) {
+  if (space.empty() || read_only) {
+    return 0;
+  }
+  values[space + "/" + key] = value;
+  writes++;
+  return sizeof(value);
+}
+
+size_t MemoryStore::getBytes(const char* key, void* buffer, size_t length) {
+  std::map<std::string, std::vector<uint8_t>>::const_iterator it = blobs.find(space + "/" + key);
+  if (it == blobs.end() || it->second.size() > length) {
+    return 0;
+  }
+  memcpy(buffer, it->second.data(), it->second.size());
+  return it->second.size();
+}
+
+size_t MemoryStore::putBytes(const char* key, const void* value, size_t length) {
+  if (space.empty() || read_only) {
+    return 0;
+  }
+  const uint8_t* bytes = static_cast<const uint8_t*>(value);
+  blobs[space + "/" + key].assign(bytes, bytes + length);
+  writes++;
+  return length;
+}
+
+bool MemoryStore::remove(const char* key) {
+  if (space.empty() || read_only) {
+    return false;
+  }
+  std::string name = space + "/" + key;
+  bool removed = values.erase(name) + blobs.erase(name) > 0;
+  if (removed) {
+    writes++;
+  }
+  return removed;
+}
+
+// ---- StdioFileSystem ----
+
+size_t StdioFileHandle::write(const uint8_t* buffer, size_t length) {
+  stats->write_calls++;
+  stats->busy_us += StdioFileSystem::CALL_US;
+
+  // 書き込み範囲のセクタを順にキャッシュへ（前のセクタはカードへ書き出す）
+  long position = ftell(file);
+  for (long offset = position; offset < position + (long)length;
+       offset += StdioFileSystem::SECTOR_SIZE - offset % StdioFileSystem::SECTOR_SIZE) {
+    long sector = offset / StdioFileSystem::SECTOR_SIZE;
+    if (sector != cached_sector) {
+      if (dirty) {
+        writeSector();
+      }
+      cached_sector = sector;
+    }
+    dirty = true;
+  }
+  return fwrite(buffer, 1, length, file);
+}
+
+void StdioFileHandle::flush() {
+  // キャッシュ中のセクタとファイルサイズを記録したディレクトリエントリ
+  if (dirty) {
+    writeSector();
+    writeSector();
+    dirty = false;
+  }
+  fflush(file);
+}
+
+uint32_t StdioFileHandle::size() {
+  long position = ftell(file);
+  fseek(file, 0, SEEK_END);
+  long end = ftell(file);
+  fseek(file, position, SEEK_SET);
+  return (uint32_t)end;
+}
+
+void StdioFileHandle::writeSector() {
+  stats->sector_writes++;
+  stats->busy_us += StdioFileSystem::SECTOR_WRITE_US;
+}
+
+FileHandle* StdioFileSystem::open(const char* path, FileMode mode) {
+  const char* stdio_mode = mode == FILE_MODE_READ ? "rb" : (mode == FILE_MODE_WRITE ? "wb" : "ab");
+  FILE* file = fopen(path, stdio_mode);
+  if (file == nullptr) {
+    return nullptr;
+  }
+  if (mode == FILE_MODE_APPEND) {
+    fseek(file, 0, SEEK_END);
+  }
+  return new StdioFileHandle(file, &stats);
+}
+
+void StdioFileSystem::close(FileHandle* file) {
+  if (file == nullptr) {
+    return;
+  }
+  StdioFileHandle* handle = static_cast<StdioFileHandle*>(file);
+  handle->flush();
+  fclose(handle->file);
+  delete handle;
+}
+
+bool StdioFileSystem::exists(const char* path) {
+  FILE* file = fopen(path, "rb");
+  if (file == nullptr) {
+    return false;
+  }
+  fclose(file);
+  return true;
+}
+
+bool StdioFileSystem::makeDir(const char* path) {
+  return mkdir(path, 0755) == 0 || errno == EEXIST;
+}
+
+// ---- MemoryFileSystem ----
+
+size_t MemoryFileHandle::read(uint8_t* buffer, size_t length) {
+  size_t available = position < data->size() ? data->size() - position : 0;
+  size_t n = length < available ? length : available;
+  memcpy(buffer, data->data() + position, n);
+  position += (uint32_t)n;
+  return n;
+}
+
+size_t MemoryFileHandle::write(const uint8_t* buffer, size_t length) {
+  if (position + length > data->size()) {
+    data->resize(position + length);
+  }
+  memcpy(data->data() + position, buffer, length);
+  position += (uint32_t)length;
+  return length;
+}
+
+bool MemoryFileHandle::seek(uint32_t position) {
+  if (position > data->size()) {
+    return false;
+  }
+  this->position = position;
+  return true;
+}
+
+FileHandle* MemoryFileSystem::open(const char* path, FileMode mode) {
+  std::map<std::string, std::vector<uint8_t>>::iterator it = files.find(path);
+  if (mode == FILE_MODE_READ) {
+    return it == files.end() ? nullptr : new MemoryFileHandle(&it->second, 0);
+  }
+  std::vector<uint8_t>& data = files[path];
+  if (mode == FILE_MODE_WRITE) {
+    data.clear();
+  }
+  return new MemoryFileHandle(&data, (uint32_t)data.size());
+}
+
+std::vector<uint8_t>* MemoryFileSystem::contents(const char* path) {
+  std::map<std::string, std::vector<uint8_t>>::iterator it = files.find(path);
+  return it == files.end() ? nullptr : &it->second;
+}
+
+// ---- PosixNetServer ----
+
+int PosixNetClient::read(uint8_t* buffer, size_t length) {
+  ssize_t n = recv(fd, buffer, length, MSG_DONTWAIT);
+  if (n > 0) {
+    return (int)n;
+  }
+  if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+    return 0;
+  }
+  closed = true;
+  return -1;
+}
+
+size_t PosixNetClient::write(const uint8_t* data, size_t length) {
+  ssize_t n = send(fd, data, length, MSG_DONTWAIT | MSG_NOSIGNAL);
+  if (n >= 0) {
+    return (size_t)n;
+  }
+  if (errno != EAGAIN && errno != EWOULDBLOCK) {
+    closed = true;
+  }
+  return 0;
+}
+
+PosixNetServer::~PosixNetServer() {
+  if (listen_fd >= 0) {
+    ::close(listen_fd);
+  }
+}
+
+bool PosixNetServer::begin(uint16_t port) {
+  listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+  if (listen_fd < 0) {
+    return false;
+  }
+
+  int reuse = 1;
+  setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = htons(port);
+  if (bind(listen_fd, (sockaddr*)&address, sizeof(address)) < 0 || listen(listen_fd, 8) < 0) {
+    ::close(listen_fd);
+    listen_fd = -1;
+    return false;
+  }
+  return true;
+}
+
+NetClient* PosixNetServer::accept() {
+  if (listen_fd < 0) {
+    return nullptr;
+  }
+
+  for (PosixNetClient& slot : clients) {
+    if (slot.fd >= 0) {
+      continue;
+    }
+    int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK);
+    if (fd < 0) {
+      return nullptr;
+    }
+    int no_delay = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+    slot.fd = fd;
+    slot.closed = false;
+    return &slot;
+  }
+  return nullptr;
+}
+
+void PosixNetServer::close(NetClient* client) {
+  PosixNetClient* slot = static_cast<PosixNetClient*>(client);
+  ::close(slot->fd);
+  slot->fd = -1;
+  slot->connecting = false;
+}
+
+// ---- PosixNetConnector ----
+
+NetClient* PosixNetConnector::connect(const char* host, uint16_t port) {
+  if (!sim_wifi.isConnected()) {
+    return nullptr;
+  }
+
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  if (strcmp(host, "localhost") == 0) {
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  } else if (inet_pton(AF_INET, host, &address.sin_addr) != 1) {
+    return nullptr;
+  }
+
+  for (PosixNetClient& slot : clients) {
+    if (slot.fd >= 0) {
+      continue;
+    }
+
+    // 実機と同じく確立を待たない（結果は pollConnect() で確かめる）
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (fd < 0) {
+      return nullptr;
+    }
+    if (::connect(fd, (sockaddr*)&address, sizeof(address)) < 0 && errno != EINPROGRESS) {
+      ::close(fd);
+      return nullptr;
+    }
+    int no_delay = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+    slot.fd = fd;
+    slot.closed = false;
+    slot.connecting = true;
+    return &slot;
+  }
+  return nullptr;
+}
+
+NetConnectStatus PosixNetConnector::pollConnect(NetClient* client) {
+  PosixNetClient* slot = static_cast<PosixNetClient*>(client);
+  if (!slot->connecting) {
+    return slot->closed ? NET_CONNECT_FAILED : NET_CONNECT_DONE;
+  }
+
+  pollfd waiting = { slot->fd, POLLOUT, 0 };
+  int ready = poll(&waiting, 1, 0);
+  if (ready == 0) {
+    return NET_CONNECT_PENDING;
+  }
+  int error = 0;
+  socklen_t length = sizeof(error);
+  slot->connecting = false;
+  if (ready < 0 || getsockopt(slot->fd, SOL_SOCKET, SO_ERROR, &error, &length) < 0 || error != 0) {
+    slot->closed = true;
+    return NET_CONNECT_FAILED;
+  }
+  return NET_CONNECT_DONE;
+}
+
+void PosixNetConnector::close(NetClient* client) {
+  PosixNetClient* slot = static_cast<PosixNetClient*>(client);
+  ::close(slot->fd);
+  slot->fd = -1;
+}
+
+// ---- SimulatedWifi ----
+
+void SimulatedWifi::enable() {
+  enabled = true;
+  if (access_points.empty()) {
+    addAccessPoint("sim-home", -70);
+    addAccessPoint("sim-office", -55);
+  }
+}
+
+void SimulatedWifi::addAccessPoint(const char* ssid, int8_t rssi) {
+  WifiAccessPoint ap = {};
+  strncpy(ap.ssid, ssid, sizeof(ap.ssid) - 1);
+  uint8_t index = (uint8_t)access_points.size();
+  const uint8_t bssid[6] = { 0x02, 0x00, 0x5E, 0x00, 0x00, (uint8_t)(index + 1) };
+  memcpy(ap.bssid, bssid, sizeof(bssid));
+  ap.channel = (uint8_t)(1 + (index * 5) % 13);
+  ap.rssi = rssi;
+  access_points.push_back(ap);
+}
+
+void SimulatedWifi::addOutage(unsigned long start_ms, unsigned long duration_ms) {
+  outages.push_back({ start_ms, start_ms + duration_ms });
+}
+
+bool SimulatedWifi::inOutage() const {
+  unsigned long now = millis();
+  for (const Outage& outage : outages) {
+    if (now >= outage.start_ms && now < outage.end_ms) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool SimulatedWifi::startScan() {
+  scanning = true;
+  scan_done = millis() + SCAN_MS;
+  return true;
+}
+
+int SimulatedWifi::scanResults(WifiAccessPoint* results, int max) {
+  if (!scanning) {
+    return -2;
+  }
+  if ((long)(millis() - scan_done) < 0) {
+    return -1;
+  }
+  scanning = false;
+  if (!enabled || inOutage()) {
+    return 0;
+  }
+
+  int count = 0;
+  for (const WifiAccessPoint& ap : access_points) {
+    if (count == max) {
+      break;
+    }
+    results[count++] = ap;
+  }
+  return count;
+}
+
+void SimulatedWifi::begin(const char* ssid, const char* password, const uint8_t* bssid, uint8_t channel) {
+  target = -1;
+  bool direct = false;
+  if (enabled) {
+    for (size_t i = 0; i < access_points.size(); i++) {
+      const WifiAccessPoint& ap = access_points[i];
+      if (strcmp(ap.ssid, ssid) != 0) {
+        continue;
+      }
+      // BSSID指定時はそのアクセスポイントのみ（違えば見つからない）
+      if (bssid != nullptr) {
+        if (memcmp(ap.bssid, bssid, sizeof(ap.bssid)) != 0 || ap.channel != channel) {
+          continue;
+        }
+        direct = true;
+      }
+      target = (int)i;
+      break;
+    }
+  }
+
+  state = WIFI_STATUS_CONNECTING;
+  unsigned long duration = target < 0 ? FAIL_MS : (direct ? FAST_CONNECT_MS : CONNECT_MS);
+  connect_done = millis() + duration;
+}
+
+WifiStatus SimulatedWifi::status() {
+  if (state == WIFI_STATUS_CONNECTING && (long)(millis() - connect_done) >= 0) {
+    state = (target >= 0 && !inOutage()) ? WIFI_STATUS_CONNECTED : WIFI_STATUS_FAILED;
+  } else if (state == WIFI_STATUS_CONNECTED && inOutage()) {
+    state = WIFI_STATUS_FAILED;
+  }
+  return state;
+}
+
+void SimulatedWifi::connectedAp(uint8_t* bssid, uint8_t& channel) {
+  if (target < 0) {
+    return;
+  }
+  memcpy(bssid, access_points[target].bssid, 6);
+  channel = access_points[target].channel;
+}
+
+// ---- FileRetainedMemory ----
+
+FileRetainedMemory::FileRetainedMemory() :
+  path(nullptr),
+  reason(RESET_POWER_ON) {
+  // 電源投入直後のRTCメモリの内容は不定
+  for (size_t i = 0; i < SIZE; i++) {
+    memory[i] = (uint8_t)(i * 167 + 13);
+  }
+}
+
+void FileRetainedMemory::load(const char* file_path) {
+  path = file_path;
+  FILE* file = fopen(path, "rb");
+  if (file == nullptr) {
+    return;
+  }
+  if (fread(memory, 1, SIZE, file) == SIZE) {
+    reason = RESET_CRASH;
+  }
+  fclose(file);
+}
+
+bool FileRetainedMemory::reset() {
+  FILE* file = path != nullptr ? fopen(path, "wb") : nullptr;
+  if (file == nullptr) {
+    return false;
+  }
+  bool written = fwrite(memory, 1, SIZE, file) == SIZE;
+  fclose(file);
+  return written;
+}
+
+void FileRetainedMemory::powerOff() {
+  if (path != nullptr) {
+    unlink(path);
+  }
+}
+
+// ---- PixelBuffer ----
+
+PixelBuffer::PixelBuffer(int16_t w, int16_t h, uint8_t color_depth) :
+  w(w),
+  h(h),
+  depth(color_depth),
+  pixels((size_t)w * h, 0) {
+}
+
+uint16_t PixelBuffer::quantize(uint16_t color) const {
+  if (depth != 8) {
+    return color;
+  }
+
+  // TFT_eSpriteの8bit色（RGB332）と同じ精度に落とす
+  uint8_t r = color >> 13, g = (color >> 8) & 0x07, b = (color >> 3) & 0x03;
+  return (uint16_t)((r << 13) | ((r >> 1) << 11) | (g << 8) | (g << 5) | (g << 2) | (b << 3) | (b << 1) | (b >> 1));
+}
+
+void PixelBuffer::setPixel(int16_t x, int16_t y, uint16_t color) {
+  if (x < 0 || y < 0 || x >= w || y >= h) {
+    return;
+  }
+  pixels[(size_t)y * w + x] = quantize(color);
+}
+
+void PixelBuffer::fillRect(int16_t x, int16_t y, int16_t rw, int16_t rh, uint16_t color) {
+  // 画面外をクリップして行単位で塗りつぶす
+  int x0 = x < 0 ? 0 : x, x1 = x + rw > w ? w : x + rw;
+  int y0 = y < 0 ? 0 : y, y1 = y + rh > h ? h : y + rh;
+  if (x0 >= x1 || y0 >= y1) {
+    return;
+  }
+
+  color = quantize(color);
+  for (int row = y0; row < y1; row++) {
+    uint16_t* line = &pixels[(size_t)row * w];
+    std::fill(line + x0, line + x1, color);
+  }
+}
+
+void PixelBuffer::copyFrom(const PixelBuffer& source, int16_t x, int16_t y) {
+  int x0 = x < 0 ? 0 : x, x1 = x + source.w > w ? w : x + source.w;
+  int y0 = y < 0 ? 0 : y, y1 = y + source.h > h ? h : y + source.h;
+  for (int row = y0; row < y1; row++) {
+    const uint16_t* from = &source.pixels[(size_t)(row - y) * source.w + (x0 - x)];
+    std::copy(from, from + (x1 - x0), &pixels[(size_t)row * w + x0]);
+  }
+}
+
+void PixelBuffer::drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color) {
+  // ブレゼンハムのアルゴリズム
+  int dx = abs(x1 - x0), sx = x0 < x1 ? 1 : -1;
+  int dy = -abs(y1 - y0), sy = y0 < y1 ? 1 : -1;
+  int err = dx + dy;
+  for (;;) {
+    setPixel(x0, y0, color);
+    if (x0 == x1 && y0 == y1) {
+      break;
+    }
+    int e2 = 2 * err;
+    if (e2 >= dy) { err += dy; x0 += sx; }
+    if (e2 <= dx) { err += dx; y0 += sy; }
+  }
+}
+
+void PixelBuffer::drawRoundRect(int16_t x, int16_t y, int16_t rw, int16_t rh, int16_t r, uint16_t color) {
+  fillRect(x + r, y, rw - 2 * r, 1, color);
+  fillRect(x + r, y + rh - 1, rw - 2 * r, 1, color);
+  fillRect(x, y + r, 1, rh - 2 * r, color);
+  fillRect(x + rw - 1, y + r, 1, rh - 2 * r, color);
+
+  // 四隅の1/4円（中点円アルゴリズム）
+  int16_t cx[4] = { (int16_t)(x + r), (int16_t)(x + rw - r - 1), (int16_t)(x + rw - r - 1), (int16_t)(x + r) };
+  int16_t cy[4] = { (int16_t)(y + r), (int16_t)(y + r), (int16_t)(y + rh - r - 1), (int16_t)(y + rh - r - 1) };
+  int8_t sx[4] = { -1, 1, 1, -1 };
+  int8_t sy[4] = { -1, -1, 1, 1 };
+  int f = 1 - r, dd_x = 1, dd_y = -2 * r, px = 0, py = r;
+  while (px <= py) {
+    for (int i = 0; i < 4; i++) {
+      setPixel(cx[i] + sx[i] * px, cy[i] + sy[i] * py, color);
+      setPixel(cx[i] + sx[i] * py, cy[i] + sy[i] * px, color);
+    }
+    if (f >= 0) {
+      py--;
+      dd_y += 2;
+      f += dd_y;
+    }
+    px++;
+    dd_x += 2;
+    f += dd_x;
+  }
+}
+
+// 5x7のASCIIフォント（0x20〜0x7E、1文字5列、各列の下位ビットが上の行）
+static const uint8_t FONT_5X7[95][5] = {
+  { 0x00, 0x00, 0x00, 0x00, 0x00 }, { 0x00, 0x00, 0x5F, 0x00, 0x00 }, { 0x00, 0x07, 0x00, 0x07, 0x00 }, { 0x14, 0x7F, 0x14, 0x7F, 0x14 },
+  { 0x24, 0x2A, 0x7F, 0x2A, 0x12 }, { 0x23, 0x13, 0x08, 0x64, 0x62 }, { 0x36, 0x49, 0x55, 0x22, 0x50 }, { 0x00, 0x05, 0x03, 0x00, 0x00 },
+  { 0x00, 0x1C, 0x22, 0x41, 0x00 }, { 0x00, 0x41, 0x22, 0x1C, 0x00 }, { 0x14, 0x08, 0x3E, 0x08, 0x14 }, { 0x08, 0x08, 0x3E, 0x08, 0x08 },
+  { 0x00, 0x50, 0x30, 0x00, 0x00 }, { 0x08, 0x08, 0x08, 0x08, 0x08 }, { 0x00, 0x60, 0x60, 0x00, 0x00 }, { 0x20, 0x10, 0x08, 0x04, 0x02 },
+  { 0x3E, 0x51, 0x49, 0x45, 0x3E }, { 0x00, 0x42, 0x7F, 0x40, 0x00 }, { 0x42, 0x61, 0x51, 0x49, 0x46 }, { 0x21, 0x41, 0x45, 0x4B, 0x31 },
+  { 0x18, 0x14, 0x12, 0x7F, 0x10 }, { 0x27, 0x45, 0x45, 0x45, 0x39 }, { 0x3C, 0x4A, 0x49, 0x49, 0x30 }, { 0x01, 0x71, 0x09, 0x05, 0x03 },
+  { 0x36, 0x49, 0x49, 0x49, 0x36 }, { 0x06, 0x49, 0x49, 0x29, 0x1E }, { 0x00, 0x36, 0x36, 0x00, 0x00 }, { 0x00, 0x56, 0x36, 0x00, 0x00 },
+  { 0x08, 0x14, 0x22, 0x41, 0x00 }, { 0x14, 0x14, 0x14, 0x14, 0x14 }, { 0x00, 0x41, 0x22, 0x14, 0x08 }, { 0x02, 0x01, 0x51, 0x09, 0x06 },
+  { 0x32, 0x49, 0x79, 0x41, 0x3E }, { 0x7E, 0x11, 0x11, 0x11, 0x7E }, { 0x7F, 0x49, 0x49, 0x49, 0x36 }, { 0x3E, 0x41, 0x41, 0x41, 0x22 },
+  { 0x7F, 0x41, 0x41, 0x22, 0x1C }, { 0x7F, 0x49, 0x49, 0x49, 0x41 }, { 0x7F, 0x09, 0x09, 0x09, 0x01 }, { 0x3E, 0x41, 0x49, 0x49, 0x7A },
+  { 0x7F, 0x08, 0x08, 0x08, 0x7F }, { 0x00, 0x41, 0x7F, 0x41, 0x00 }, { 0x20, 0x40, 0x41, 0x3F, 0x01 }, { 0x7F, 0x08, 0x14, 0x22, 0x41 },
+  { 0x7F, 0x40, 0x40, 0x40, 0x40 }, { 0x7F, 0x02, 0x0C, 0x02, 0x7F }, { 0x7F, 0x04, 0x08, 0x10, 0x7F }, { 0x3E, 0x41, 0x41, 0x41, 0x3E },
+  { 0x7F, 0x09, 0x09, 0x09, 0x06 }, { 0x3E, 0x41, 0x51, 0x21, 0x5E }, { 0x7F, 0x09, 0x19, 0x29, 0x46 }, { 0x46, 0x49, 0x49, 0x49, 0x31 },
+  { 0x01, 0x01, 0x7F, 0x01, 0x01 }, { 0x3F, 0x40, 0x40, 0x40, 0x3F }, { 0x1F, 0x20, 0x40, 0x20, 0x1F }, { 0x3F, 0x40, 0x38, 0x40, 0x3F },
+  { 0x63, 0x14, 0x08, 0x14, 0x63 }, { 0x07, 0x08, 0x70, 0x08, 0x07 }, { 0x61, 0x51, 0x49, 0x45, 0x43 }, { 0x00, 0x7F, 0x41, 0x41, 0x00 },
+  { 0x02, 0x04, 0x08, 0x10, 0x20 }, { 0x00, 0x41, 0x41, 0x7F, 0x00 }, { 0x04, 0x02, 0x01, 0x02, 0x04 }, { 0x40, 0x40, 0x40, 0x40, 0x40 },
+  { 0x00, 0x01, 0x02, 0x04, 0x00 }, { 0x20, 0x54, 0x54, 0x54, 0x78 }, { 0x7F, 0x48, 0x44, 0x44, 0x38 }, { 0x38, 0x44, 0x44, 0x44, 0x20 },
+  { 0x38, 0x44, 0x44, 0x48, 0x7F }, { 0x38, 0x54, 0x54, 0x54, 0x18 }, { 0x08, 0x7E, 0x09, 0x01, 0x02 }, { 0x0C, 0x52, 0x52, 0x52, 0x3E },
+  { 0x7F, 0x08, 0x04, 0x04, 0x78 }, { 0x00, 0x44, 0x7D, 0x40, 0x00 }, { 0x20, 0x40, 0x44, 0x3D, 0x00 }, { 0x7F, 0x10, 0x28, 0x44, 0x00 },
+  { 0x00, 0x41, 0x7F, 0x40, 0x00 }, { 0x7C, 0x04, 0x18, 0x04, 0x78 }, { 0x7C, 0x08, 0x04, 0x04, 0x78 }, { 0x38, 0x44, 0x44, 0x44, 0x38 },
+  { 0x7C, 0x14, 0x14, 0x14, 0x08 }, { 0x08, 0x14, 0x14, 0x18, 0x7C }, { 0x7C, 0x08, 0x04, 0x04, 0x08 }, { 0x48, 0x54, 0x54, 0x54, 0x20 },
+  { 0x04, 0x3F, 0x44, 0x40, 0x20 }, { 0x3C, 0x40, 0x40, 0x20, 0x7C }, { 0x1C, 0x20, 0x40, 0x20, 0x1C }, { 0x3C, 0x40, 0x30, 0x40, 0x3C },
+  { 0x44, 0x28, 0x10, 0x28, 0x44 }, { 0x0C, 0x50, 0x50, 0x50, 0x3C }, { 0x44, 0x64, 0x54, 0x4C, 0x44 }, { 0x00, 0x08, 0x36, 0x41, 0x00 },
+  { 0x00, 0x00, 0x7F, 0x00, 0x00 }, { 0x00, 0x41, 0x36, 0x08, 0x00 }, { 0x10, 0x08, 0x08, 0x10, 0x08 }
+};
+
+void PixelBuffer::drawText(int16_t x, int16_t y, const char* text, uint8_t size, uint16_t color,
+                           bool opaque, uint16_t bg_color) {
+  for (const char* c = text; *c != '\0'; c++, x += 6 * size) {
+    if (opaque) {
+      fillRect(x, y, 6 * size, 8 * size, bg_color);
+    }
+    uint8_t code = (uint8_t)*c;
+    if (code < 0x20 || code > 0x7E) {
+      fillRect(x, y, 5 * size, 7 * size, color);
+      continue;
+    }
+    // Adafruit_GFX の drawChar と同じく、点ごとに size x size を塗る
+    const uint8_t* columns = FONT_5X7[code - 0x20];
+    for (int16_t col = 0; col < 5; col++) {
+      for (int16_t row = 0; row < 8; row++) {
+        if ((columns[col] >> row) & 1) {
+          fillRect(x + col * size, y + row * size, size, size, color);
+        }
+      }
+    }
+  }
+}
+
+// ---- FramebufferDisplay ----
+
+FramebufferDisplay::FramebufferDisplay() :
+  screen(WIDTH, HEIGHT, 16),
+  brightness(0),
+  canvas_limit(0) {
+}
+
+Canvas* FramebufferDisplay::createCanvas(int16_t w, int16_t h, uint8_t color_depth) {
+  size_t bytes = (size_t)w * h * color_depth / 8;
+  if (canvas_limit > 0 && bytes > canvas_limit) {
+    return nullptr;
+  }
+  return new FramebufferCanvas(w, h, color_depth);
+}
+
+void FramebufferDisplay::pushImage(int16_t x, int16_t y, int16_t w, int16_t h, const uint16_t* pixels) {
+  for (int16_t row = 0; row < h; row++) {
+    for (int16_t col = 0; col < w; col++) {
+      screen.setPixel(x + col, y + row, pixels[row * w + col]);
+    }
+  }
+}
+
+void FramebufferDisplay::pushCanvas(Canvas& canvas, int16_t x, int16_t y) {
+  // このディスプレイが確保したキャンバスのみ
+  screen.copyFrom(static_cast<FramebufferCanvas&>(canvas).pixels(), x, y);
+}
+
+bool FramebufferDisplay::dumpPpm(const char* path) const {
+  FILE* file = fopen(path, "wb");
+  if (file == nullptr) {
+    return false;
+  }
+
+  fprintf(file, "P6\n%d %d\n255\n", WIDTH, HEIGHT);
+  const uint16_t* pixels = screen.data();
+  for (size_t i = 0; i < (size_t)WIDTH * HEIGHT; i++) {
+    uint16_t c = pixels[i];
+    uint8_t rgb[3] = {
+      (uint8_t)(((c >> 11) & 0x1F) * 255 / 31),
+      (uint8_t)(((c >> 5) & 0x3F) * 255 / 63),
+      (uint8_t)((c & 0x1F) * 255 / 31)
+    };
+    fwrite(rgb, 1, sizeof(rgb), file);
+  }
+  fclose(file);
+  return true;
+}
+
+// ---- ScriptedButtons ----
+
+ScriptedButtons::ScriptedButtons() {
+  for (int i = 0; i < BUTTON_COUNT; i++) {
+    state[i] = { false, false, 0, 0 };
+  }
+}
+
+void ScriptedButtons::press(Button button, unsigned long at_ms, unsigned long hold_ms) {
+  presses.push_back({ button, at_ms, hold_ms });
+}
+
+void ScriptedButtons::update() {
+  unsigned long now = millis();
+
+  for (int i = 0; i < BUTTON_COUNT; i++) {
+    bool pressed = false;
+    for (const Press& press : presses) {
+      if (press.button == i && now >= press.at_ms && now < press.at_ms + press.hold_ms) {
+        pressed = true;
+        break;
+      }
+    }
+
+    State& s = state[i];
+    s.changed = (pressed != s.pressed);
+    if (s.changed) {
+      if (pressed) {
+        s.pressed_at = now;
+      } else {
+        s.held_ms = now - s.pressed_at;
+      }
+      s.pressed = pressed;
+    }
+  }
+}
+
+#endif // ARDUINO
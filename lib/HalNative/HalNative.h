@@ -0,0 +1,542 @@
+#ifndef HAL_NATIVE_H
+#define HAL_NATIVE_H
+
+// ネイティブ環境（Linux等）向けのHAL実装
+#ifndef ARDUINO
+
+#include <Hal.h>
+#include <map>
+#include <string>
+#include <vector>
+
+// スクリプトで値を与えるSGP30
+class SimulatedSgp30 : public SensorDriver {
+public:
+  // 既定のシナリオ（在室による日内変動と調理時のTVOCピーク）
+  SimulatedSgp30();
+
+  // "秒,TVOC,eCO2" の行から成るCSV（キーフレーム間は線形補間、最後の値を保持）
+  bool loadScript(const char* path);
+  void setConnected(bool connected) { this->connected = connected; }
+  bool isConnected() const { return connected; }
+  // 複数台のうち index 番目の設置場所（調理の影響が離れるほど小さく、雑音の系列も変える）
+  void setPlacement(uint8_t index);
+
+  bool begin() override { return connected; }
+  bool IAQinit() override;
+  bool IAQmeasure() override;
+  bool IAQmeasureRaw() override;
+  bool getIAQBaseline(uint16_t* eco2_base, uint16_t* tvoc_base) override;
+  bool setIAQBaseline(uint16_t eco2_base, uint16_t tvoc_base) override;
+  bool setHumidity(uint32_t absolute_humidity) override;
+  uint16_t tvoc() const override { return tvoc_value; }
+  uint16_t eco2() const override { return eco2_value; }
+  uint16_t rawH2() const override { return raw_h2; }
+  uint16_t rawEthanol() const override { return raw_ethanol; }
+
+  uint32_t measureCount() const { return measure_count; }
+  uint32_t humidityCount() const { return humidity_count; }
+
+private:
+  struct Keyframe {
+    uint32_t time_s;
+    uint16_t tvoc;
+    uint16_t eco2;
+  };
+
+  bool connected;
+  std::vector<Keyframe> script;
+  uint16_t tvoc_value;
+  uint16_t eco2_value;
+  uint16_t raw_h2;
+  uint16_t raw_ethanol;
+  uint16_t eco2_baseline;
+  uint16_t tvoc_baseline;
+  uint32_t measure_count;
+  uint32_t humidity_count;     // setHumidity() の回数
+  uint32_t noise_state;
+  uint8_t cooking_exposure;    // 調理によるTVOCの上昇の割合 (%)
+
+  void scenario(uint32_t time_s);
+  void interpolate(uint32_t time_s);
+  int noise(int amplitude);
+};
+
+// I2Cバスにつながる機器のシミュレーション
+class SimulatedI2cDevice {
+public:
+  virtual ~SimulatedI2cDevice() {}
+
+  // 書き込み・読み取り（NACKなら false / 0）
+  virtual bool write(const uint8_t* data, size_t length) = 0;
+  virtual size_t read(uint8_t* data, size_t length) = 0;
+};
+
+// I2Cのコマンドを受け付けるSGP30（値は SimulatedSgp30 のシナリオ、測定中の読み取りはNACK）
+class SimulatedSgp30Device : public SimulatedI2cDevice {
+public:
+  explicit SimulatedSgp30Device(uint8_t placement);
+  // 既存のモデルを I2C で見せる（--sensor のシナリオ・--no-sensor を分割した測定にも使う）
+  explicit SimulatedSgp30Device(SimulatedSgp30* model);
+
+  bool write(const uint8_t* data, size_t length) override;
+  size_t read(uint8_t* data, size_t length) override;
+
+  SimulatedSgp30& model() { return *sensor; }
+  // 測定をデータシートの最大値より extra_us 遅く終える（測定の遅い個体）
+  void setExtraDelay(uint32_t extra_us) { extra_delay_us = extra_us; }
+
+private:
+  SimulatedSgp30 own_sensor;
+  SimulatedSgp30* sensor;     // own_sensor か外部のモデル
+  uint8_t placement;
+  uint32_t extra_delay_us;
+  uint16_t words[3];          // 次の読み取りで返す値
+  uint8_t word_count;
+  uint64_t ready_us;          // 測定・処理が終わる時刻（これより前の読み取りはNACK）
+};
+
+// 100 kHz のI2Cバス（転送時間だけ仮想時計を進める）とTCA9548A（制御レジスタのビットごとにチャンネルを接続）
+// 同じアドレスの機器が複数応答する場合は衝突としてNACKにする。
+// 機器との転送には雑音による失敗を混ぜられる（NACK、読み取ったデータの1ビットの反転。乱数は固定の系列）
+class SimulatedI2cBus : public I2cBus {
+public:
+  static const uint32_t BYTE_US = 90;        // 1バイト（ACK込み9ビット）の転送時間
+  static const uint32_t START_STOP_US = 10;  // START・STOPの時間
+
+  // マルチプレクサを address に置く（0: なし）
+  void setMux(uint8_t address) { mux_address = address; }
+  // channel: マルチプレクサのチャンネル（-1: マルチプレクサの手前）
+  void attach(uint8_t address, SimulatedI2cDevice* device, int8_t channel = -1);
+  // 機器との転送のうち nack_per_mille ‰ をNACKに、読み取りの corrupt_per_mille ‰ のデータを壊す
+  void setFaults(uint16_t nack_per_mille, uint16_t corrupt_per_mille);
+
+  bool write(uint8_t address, const uint8_t* data, size_t length) override;
+  size_t read(uint8_t address, uint8_t* data, size_t length) override;
+
+  uint32_t transactionCount() const { return transactions; }
+  uint32_t nackCount() const { return nacks; }
+  uint32_t collisionCount() const { return collisions; }
+  // setFaults() で混ぜた失敗（NACK・壊したデータ）
+  uint32_t faultCount() const { return faults; }
+
+private:
+  struct Attached {
+    uint8_t address;
+    int8_t channel;
+    SimulatedI2cDevice* device;
+  };
+
+  std::vector<Attached> devices;
+  uint8_t mux_address = 0;
+  uint8_t mux_control = 0;
+  uint32_t transactions = 0;
+  uint32_t nacks = 0;
+  uint32_t collisions = 0;
+  uint16_t nack_rate = 0;
+  uint16_t corrupt_rate = 0;
+  uint32_t fault_state = 1;
+  uint32_t faults = 0;
+
+  void transferTime(size_t length);
+  // per_mille ‰ の確率で true
+  bool fault(uint16_t per_mille);
+  SimulatedI2cDevice* find(uint8_t address);
+};
+
+// 温湿度センサー（室温 22 ℃・湿度 50 %RH 前後の日内変動）
+class SimulatedSht3x : public EnvironmentSensor {
+public:
+  SimulatedSht3x() : connected(true), started(false), start_time(0) {}
+
+  void setConnected(bool connected) { this->connected = connected; }
+
+  bool begin() override { return connected; }
+  bool startMeasurement() override;
+  bool readMeasurement(int16_t* temperature, uint16_t* humidity) override;
+
+private:
+  static const unsigned long MEASURE_TIME = 15;   // 測定時間 (ms)
+
+  bool connected;
+  bool started;
+  unsigned long start_time;
+};
+
+// メモリ上のキーバリューストア（プロセス終了まで保持）
+class MemoryStore : public KeyValueStore {
+public:
+  bool begin(const char* name, bool read_only) override;
+  void end() override { space.clear(); }
+  uint16_t getUShort(const char* key, uint16_t default_value) override;
+  size_t putUShort(const char* key, uint16_t value) override;
+  size_t getBytes(const char* key, void* buffer, size_t length) override;
+  size_t putBytes(const char* key, const void* value, size_t length) override;
+  bool remove(const char* key) override;
+
+  uint32_t writeCount() const { return writes; }
+
+private:
+  std::map<std::string, uint16_t> values;   // "名前空間/キー"
+  std::map<std::string, std::vector<uint8_t>> blobs;
+  std::string space;
+  bool read_only = false;
+  uint32_t writes = 0;
+};
+
+// SDカードへの書き込みの集計
+struct SdCardStats {
+  uint32_t write_calls;     // write() の呼び出し回数
+  uint32_t sector_writes;   // セクタの書き込み回数（データとディレクトリエントリ）
+  uint64_t busy_us;         // 推定の書き込み時間 (us)
+};
+
+// 標準入出力のファイル（パスはホスト上のパス）
+// SDライブラリと同じく1セクタ分をキャッシュし、セクタが変わるかflush()でカードに書き込んだものとして集計する
+class StdioFileHandle : public FileHandle {
+public:
+  StdioFileHandle(FILE* file, SdCardStats* stats) : file(file), stats(stats), cached_sector(-1), dirty(false) {}
+
+  size_t read(uint8_t* buffer, size_t length) override { return fread(buffer, 1, length, file); }
+  size_t write(const uint8_t* buffer, size_t length) override;
+  void flush() override;
+  uint32_t size() override;
+  bool seek(uint32_t position) override { return fseek(file, position, SEEK_SET) == 0; }
+
+private:
+  friend class StdioFileSystem;
+  FILE* file;
+  SdCardStats* stats;
+  long cached_sector;   // キャッシュ中のセクタ（-1: なし）
+  bool dirty;
+
+  void writeSector();
+};
+
+class StdioFileSystem : public FileSystem {
+public:
+  static const uint32_t SECTOR_SIZE = 512;
+  static const uint32_t CALL_US = 20;            // write() 1回あたりのライブラリの処理時間 (us)
+  static const uint32_t SECTOR_WRITE_US = 1500;  // 1セクタの転送とカードのビジー時間 (us)
+
+  StdioFileSystem() : stats() {}
+
+  FileHandle* open(const char* path, FileMode mode) override;
+  void close(FileHandle* file) override;
+  bool exists(const char* path) override;
+  bool makeDir(const char* path) override;
+
+  const SdCardStats& getStats() const { return stats; }
+  void resetStats() { stats = SdCardStats(); }
+
+private:
+  SdCardStats stats;
+};
+
+// メモリ上のファイル（テスト用、内容はファイルシステムが保持する）
+class MemoryFileHandle : public FileHandle {
+public:
+  MemoryFileHandle(std::vector<uint8_t>* data, uint32_t position) : data(data), position(position) {}
+
+  size_t read(uint8_t* buffer, size_t length) override;
+  size_t write(const uint8_t* buffer, size_t length) override;
+  void flush() override {}
+  uint32_t size() override { return (uint32_t)data->size(); }
+  bool seek(uint32_t position) override;
+
+private:
+  std::vector<uint8_t>* data;
+  uint32_t position;
+};
+
+// メモリ上のファイルシステム（プロセス終了まで保持、ディレクトリは区別しない）
+class MemoryFileSystem : public FileSystem {
+public:
+  FileHandle* open(const char* path, FileMode mode) override;
+  void close(FileHandle* file) override { delete file; }
+  bool exists(const char* path) override { return files.count(path) > 0; }
+  bool makeDir(const char* path) override { return true; }
+
+  // テストで内容を直接書き換える（ファイルがなければ nullptr）
+  std::vector<uint8_t>* contents(const char* path);
+
+private:
+  std::map<std::string, std::vector<uint8_t>> files;
+};
+
+// ループバック（127.0.0.1）のTCPソケット
+class PosixNetClient : public NetClient {
+public:
+  int read(uint8_t* buffer, size_t length) override;
+  size_t write(const uint8_t* data, size_t length) override;
+  bool connected() override { return fd >= 0 && !closed; }
+
+private:
+  friend class PosixNetServer;
+  friend class PosixNetConnector;
+  int fd = -1;
+  bool closed = false;
+  bool connecting = false;   // 接続の確立待ち（PosixNetConnector）
+};
+
+class PosixNetServer : public NetServer {
+public:
+  static const uint8_t MAX_CLIENTS = 4;
+
+  ~PosixNetServer();
+
+  bool begin(uint16_t port) override;
+  NetClient* accept() override;
+  void close(NetClient* client) override;
+
+private:
+  int listen_fd = -1;
+  PosixNetClient clients[MAX_CLIENTS];
+};
+
+// ループバックへの接続（ホスト名は 127.0.0.1 / localhost のみ、WiFiの切断中は失敗する、確立は待たない）
+class PosixNetConnector : public NetConnector {
+public:
+  static const uint8_t MAX_CLIENTS = 2;
+
+  NetClient* connect(const char* host, uint16_t port) override;
+  NetConnectStatus pollConnect(NetClient* client) override;
+  void close(NetClient* client) override;
+
+private:
+  PosixNetClient clients[MAX_CLIENTS];
+};
+
+// WiFiのシミュレーション（有効にした場合のみアクセスポイントが見える、指定した区間は圏外）
+// 接続は検索込みで CONNECT_MS、BSSID・チャンネルを指定すれば FAST_CONNECT_MS で終わる
+class SimulatedWifi : public WifiDriver {
+public:
+  static const unsigned long SCAN_MS = 2500;
+  static const unsigned long CONNECT_MS = 3000;
+  static const unsigned long FAST_CONNECT_MS = 600;
+  static const unsigned long FAIL_MS = 5000;      // 見つからない場合に失敗するまでの時間
+
+  // アクセスポイントを追加していなければ sim-home (-70 dBm) と sim-office (-55 dBm) を置く
+  void enable();
+  void addAccessPoint(const char* ssid, int8_t rssi);
+  void addOutage(unsigned long start_ms, unsigned long duration_ms);
+  bool isEnabled() const { return enabled; }
+  bool isConnected() { return status() == WIFI_STATUS_CONNECTED; }
+
+  bool startScan() override;
+  int scanResults(WifiAccessPoint* results, int max) override;
+  void begin(const char* ssid, const char* password, const uint8_t* bssid, uint8_t channel) override;
+  void disconnect() override { state = WIFI_STATUS_IDLE; }
+  WifiStatus status() override;
+  int8_t rssi() override { return target >= 0 ? access_points[target].rssi : 0; }
+  void connectedAp(uint8_t* bssid, uint8_t& channel) override;
+
+private:
+  bool enabled = false;
+  struct Outage {
+    unsigned long start_ms;
+    unsigned long end_ms;
+  };
+  std::vector<Outage> outages;
+  std::vector<WifiAccessPoint> access_points;
+
+  bool scanning = false;
+  unsigned long scan_done = 0;
+  WifiStatus state = WIFI_STATUS_IDLE;
+  unsigned long connect_done = 0;
+  int target = -1;            // 接続先（access_points の位置、-1: 見つからない）
+
+  bool inOutage() const;
+};
+
+// RGB565のピクセルバッファ（描画の共通実装）
+// RTCメモリのシミュレーション（ファイルに保存して次の実行へ引き継ぐ）
+// ファイルがあれば前回の実行はクラッシュで終わったものとし、なければ電源投入（内容は不定）
+class FileRetainedMemory : public RetainedMemory {
+public:
+  FileRetainedMemory();
+
+  void load(const char* path);
+  // リセットを起こす（内容をファイルへ保存）／電源を切る（ファイルを削除）
+  bool reset();
+  void powerOff();
+
+  uint8_t* data() override { return memory; }
+  ResetReason resetReason() const override { return reason; }
+
+private:
+  const char* path;
+  ResetReason reason;
+  uint8_t memory[SIZE];
+};
+
+class PixelBuffer {
+public:
+  PixelBuffer(int16_t w, int16_t h, uint8_t color_depth);
+
+  int16_t width() const { return w; }
+  int16_t height() const { return h; }
+  uint16_t pixel(int16_t x, int16_t y) const { return pixels[(size_t)y * w + x]; }
+  const uint16_t* data() const { return pixels.data(); }
+
+  void setPixel(int16_t x, int16_t y, uint16_t color);
+  void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+  void drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color);
+  void drawRoundRect(int16_t x, int16_t y, int16_t w, int16_t h, int16_t r, uint16_t color);
+  // 5x7のASCIIフォント（文字セルは6x8、ASCII以外は5x7部分を塗りつぶす）
+  void drawText(int16_t x, int16_t y, const char* text, uint8_t size, uint16_t color, bool opaque, uint16_t bg_color);
+  // 同じ色深度のバッファ（キャンバス）を (x, y) に転送
+  void copyFrom(const PixelBuffer& source, int16_t x, int16_t y);
+
+private:
+  int16_t w;
+  int16_t h;
+  uint8_t depth;
+  std::vector<uint16_t> pixels;
+
+  uint16_t quantize(uint16_t color) const;
+};
+
+// PixelBufferによるキャンバス
+class FramebufferCanvas : public Canvas {
+public:
+  FramebufferCanvas(int16_t w, int16_t h, uint8_t color_depth) : buffer(w, h, color_depth) {}
+
+  const PixelBuffer& pixels() const { return buffer; }
+
+  int16_t width() const override { return buffer.width(); }
+  int16_t height() const override { return buffer.height(); }
+  void fill(uint16_t color) override { buffer.fillRect(0, 0, buffer.width(), buffer.height(), color); }
+  void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) override { buffer.fillRect(x, y, w, h, color); }
+  void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) override { buffer.fillRect(x, y, w, 1, color); }
+  void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) override { buffer.fillRect(x, y, 1, h, color); }
+  void drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color) override {
+    buffer.drawLine(x0, y0, x1, y1, color);
+  }
+  void drawRoundRect(int16_t x, int16_t y, int16_t w, int16_t h, int16_t r, uint16_t color) override {
+    buffer.drawRoundRect(x, y, w, h, r, color);
+  }
+  void drawText(int16_t x, int16_t y, const char* text, uint8_t size, uint16_t color) override {
+    buffer.drawText(x, y, text, size, color, false, 0);
+  }
+  uint16_t readPixel(int16_t x, int16_t y) override {
+    return x >= 0 && y >= 0 && x < buffer.width() && y < buffer.height() ? buffer.pixel(x, y) : 0;
+  }
+
+private:
+  PixelBuffer buffer;
+};
+
+// 320x240のフレームバッファ（PPMで書き出し可能）
+class FramebufferDisplay : public Display {
+public:
+  static const int16_t WIDTH = 320;
+  static const int16_t HEIGHT = 240;
+
+  FramebufferDisplay();
+
+  // キャンバス確保の上限（バイト、0: 無制限）。短冊分割の確認用
+  void setCanvasLimit(size_t bytes) { canvas_limit = bytes; }
+  bool dumpPpm(const char* path) const;
+  uint8_t getBrightness() const { return brightness; }
+  const PixelBuffer& pixels() const { return screen; }
+
+  int16_t width() const override { return WIDTH; }
+  int16_t height() const override { return HEIGHT; }
+  void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) override { screen.fillRect(x, y, w, h, color); }
+  void drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color) override {
+    screen.drawLine(x0, y0, x1, y1, color);
+  }
+  void drawRoundRect(int16_t x, int16_t y, int16_t w, int16_t h, int16_t r, uint16_t color) override {
+    screen.drawRoundRect(x, y, w, h, r, color);
+  }
+  void drawText(int16_t x, int16_t y, const char* text, uint8_t size, uint16_t color, uint16_t bg_color) override {
+    screen.drawText(x, y, text, size, color, true, bg_color);
+  }
+  void pushImage(int16_t x, int16_t y, int16_t w, int16_t h, const uint16_t* pixels) override;
+  void setBrightness(uint8_t level) override { brightness = level; }
+
+  Canvas* createCanvas(int16_t w, int16_t h, uint8_t color_depth) override;
+  void destroyCanvas(Canvas* canvas) override { delete canvas; }
+  void pushCanvas(Canvas& canvas, int16_t x, int16_t y) override;
+
+private:
+  PixelBuffer screen;
+  uint8_t brightness;
+  size_t canvas_limit;
+};
+
+// 押下時刻の一覧で操作するボタン
+class ScriptedButtons : public ButtonInput {
+public:
+  ScriptedButtons();
+
+  // at_ms から hold_ms の間押したままにする
+  void press(Button button, unsigned long at_ms, unsigned long hold_ms);
+
+  void update() override;
+  bool isPressed(Button button) override { return state[button].pressed; }
+  bool wasPressed(Button button) override { return state[button].pressed && state[button].changed; }
+  bool wasReleased(Button button) override { return !state[button].pressed && state[button].changed; }
+  bool wasReleasefor(Button button, uint32_t hold_ms) override {
+    return wasReleased(button) && state[button].held_ms >= hold_ms;
+  }
+
+private:
+  struct Press {
+    Button button;
+    unsigned long at_ms;
+    unsigned long hold_ms;
+  };
+  struct State {
+    bool pressed;
+    bool changed;              // 直近のupdate()で変化したか
+    unsigned long pressed_at;
+    unsigned long held_ms;     // 離した時点の押下時間
+  };
+
+  std::vector<Press> presses;
+  State state[BUTTON_COUNT];
+};
+
+// シミュレーション用の周辺機器（src/main.cpp から参照）
+extern SimulatedSgp30 sim_sensor;
+extern SimulatedI2cBus sim_i2c;
+extern SimulatedSht3x sim_environment;
+extern MemoryStore sim_store;
+extern FramebufferDisplay sim_display;
+extern ScriptedButtons sim_buttons;
+extern StdioFileSystem sim_files;
+extern PosixNetServer sim_net;
+extern PosixNetConnector sim_connector;
+extern SimulatedWifi sim_wifi;
+extern FileRetainedMemory sim_retained;
+
+// センサー記録の設定（コマンドラインで指定、nullptr: 使用しない）
+extern const char* sim_trace_record;   // 記録先
+extern const char* sim_trace_replay;   // 再生するファイル
+extern bool sim_trace_fast;            // 記録時刻を待たずに最高速で再生
+extern const char* sim_log_dir;        // 測定履歴の保存先（nullptr: 保存しない）
+extern uint16_t sim_http_port;         // HTTPサーバーのポート（0: 起動しない）
+extern uint16_t sim_mqtt_port;         // MQTTブローカー（127.0.0.1）のポート（0: 送信しない）
+extern const char* sim_signal_chain;   // 生信号の処理の設定（nullptr: 既定の設定）
+extern uint8_t sim_sensor_count;       // マルチプレクサの先のSGP30の台数（0: マルチプレクサなしの1台）
+extern const char* sim_sensor_aggregate;  // 複数台の集計方法（max / mean、nullptr: max）
+extern bool sim_sensor_blocking;       // SGP30を I2C に置かず、待つ測定（Adafruitのライブラリ相当）で直接使う
+extern uint32_t sim_sensor_delay_us;   // sim_i2c のSGP30の測定の遅れ (us)
+
+// マルチプレクサとSGP30を sim_i2c に置く（チャンネル 0〜count-1、mux が false ならマルチプレクサなしの1台）
+void attachSimulatedSensors(uint8_t count, bool mux, uint32_t extra_delay_us);
+// すべてのシミュレーションのSGP30の湿度補正の設定回数
+uint32_t simulatedHumidityCount();
+
+// シミュレーション開始時のUNIX時刻（2026-01-01 00:00 JST、内蔵シナリオの時刻と合わせる）
+static const uint32_t SIM_EPOCH_START = 1767193200;
+
+// src/main.cpp が実装するシミュレーションの終了判定（記録の再生が終わったら true）と終了処理
+bool simulationFinished();
+void simulationEnd();
+
+#endif // ARDUINO
+
+#endif // HAL_NATIVE_H
@@ -0,0 +1,80 @@
+#include "NativeArduino.h"
+
+#ifndef ARDUINO
+
+#include <stdarg.h>
+
+uint64_t VirtualClock::now_us = 0;
+NativeSerial Serial;
+
+unsigned long millis() {
+  return (unsigned long)(VirtualClock::nowMicros() / 1000);
+}
+
+unsigned long micros() {
+  return (unsigned long)VirtualClock::nowMicros();
+}
+
+void delay(unsigned long ms) {
+  VirtualClock::advance((uint64_t)ms * 1000);
+}
+
+size_t NativeSerial::print(const char* text) {
+  return quiet ? 0 : fputs(text, stdout) >= 0 ? strlen(text) : 0;
+}
+
+size_t NativeSerial::print(char c) {
+  return quiet ? 0 : (fputc(c, stdout) != EOF ? 1 : 0);
+}
+
+size_t NativeSerial::print(long value) {
+  return printf("%ld", value);
+}
+
+size_t NativeSerial::print(unsigned long value) {
+  return printf("%lu", value);
+}
+
+size_t NativeSerial::printf(const char* format, ...) {
+  if (quiet) {
+    return 0;
+  }
+
+  va_list args;
+  va_start(args, format);
+  int written = vprintf(format, args);
+  va_end(args);
+  return written > 0 ? written : 0;
+}
+
+bool NativeSerial::inject(unsigned long at_ms, const char* line) {
+  if (input_count == MAX_INPUTS || strlen(line) >= INPUT_LENGTH) {
+    return false;
+  }
+  Input& input = inputs[input_count++];
+  input.at_ms = at_ms;
+  snprintf(input.text, sizeof(input.text), "%s\n", line);
+  return true;
+}
+
+int NativeSerial::available() {
+  if (input_index == input_count || millis() < inputs[input_index].at_ms) {
+    return 0;
+  }
+  return (int)(strlen(inputs[input_index].text) - input_offset);
+}
+
+int NativeSerial::read() {
+  if (available() == 0) {
+    return -1;
+  }
+  Input& input = inputs[input_index];
+  int c = (uint8_t)input.text[input_offset++];
+  if (input.text[input_offset] == '\0') {
+    input_index++;
+    input_offset = 0;
+  }
+  return c;
+}
+
+#endif // ARDUINO
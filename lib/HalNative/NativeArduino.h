@@ -0,0 +1,71 @@
+#ifndef NATIVE_ARDUINO_H
+#define NATIVE_ARDUINO_H
+
+// ネイティブ環境向けのArduino API（時計は仮想時間）
+#ifndef ARDUINO
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// 仮想時計（delay() とシミュレーションループの待機でのみ進む）
+class VirtualClock {
+public:
+  static uint64_t nowMicros() { return now_us; }
+  static void advance(uint64_t us) { now_us += us; }
+  static void reset() { now_us = 0; }
+
+private:
+  static uint64_t now_us;
+};
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+
+// 標準出力へのシリアル出力（quiet 時は破棄）
+class NativeSerial {
+public:
+  void begin(unsigned long baud) {}
+  void setQuiet(bool enabled) { quiet = enabled; }
+
+  size_t print(const char* text);
+  size_t print(char c);
+  size_t print(long value);
+  size_t print(unsigned long value);
+  size_t print(int value) { return print((long)value); }
+  size_t print(unsigned int value) { return print((unsigned long)value); }
+  size_t println() { return print("\n"); }
+  template <typename T>
+  size_t println(T value) { return print(value) + println(); }
+  size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+  // 受信（at_ms 以降に line と改行が届く、時刻順に追加）
+  bool inject(unsigned long at_ms, const char* line);
+  int available();
+  int read();
+
+private:
+  static const uint8_t MAX_INPUTS = 8;
+  static const uint8_t INPUT_LENGTH = 32;
+
+  struct Input {
+    unsigned long at_ms;
+    char text[INPUT_LENGTH + 1];   // 改行を含む
+  };
+
+  bool quiet = false;
+  Input inputs[MAX_INPUTS];
+  uint8_t input_count = 0;
+  uint8_t input_index = 0;         // 読み取り中の行
+  uint8_t input_offset = 0;        // 読み取り中の行の次の文字
+};
+
+extern NativeSerial Serial;
+
+#endif // ARDUINO
+
+#endif // NATIVE_ARDUINO_H
@@ -0,0 +1,305 @@
+// ネイティブ環境のエントリポイント：仮想時計でsetup()/loop()を実行する
+// （pio test ではテストの main() を使うので含めない）
+#if !defined(ARDUINO) && !defined(PIO_UNIT_TESTING)
+
+#include "HalNative.h"
+#include <chrono>
+#include <thread>
+
+void setup();
+void loop();
+int convertLogToCsv(const char* path, FILE* output);
+int benchmarkHistory(uint32_t samples);
+int benchmarkTrend(uint32_t samples);
+int benchmarkLogWrites(uint32_t samples, const char* path);
+int benchmarkMetrics(uint32_t iterations);
+int benchmarkBaselineWear(uint32_t days);
+int benchmarkHumidity(uint32_t iterations);
+int benchmarkSignals(uint32_t samples);
+int benchmarkSensorArray(uint32_t max_sensors);
+int benchmarkGlyphs(uint32_t iterations);
+int runBroker(uint16_t port, uint32_t drop_every);
+
+static void usage(const char* program) {
+  fprintf(stderr,
+          "usage: %s [options]\n"
+          "  --hours H          simulated duration (default 24, or until the end of --replay)\n"
+          "  --sensor FILE      CSV script \"seconds,tvoc,eco2\" instead of the built-in scenario\n"
+          "  --no-sensor        SGP30 not connected (demo data)\n"
+          "  --no-env           no temperature/humidity sensor (no humidity compensation)\n"
+          "  --sensors N        N SGP30s (1-8) behind a simulated TCA9548A on a 100 kHz I2C bus\n"
+          "  --aggregate MODE   header/graph value over the --sensors: max (default) or mean\n"
+          "  --adafruit         one SGP30 through the blocking driver (Adafruit library) instead of split I2C measurements\n"
+          "  --i2c-delay US     SGP30 measurements on the I2C bus finish US microseconds late\n"
+          "  --i2c-faults N:C   after setup, NACK N and corrupt C per mille of the I2C device transfers\n"
+          "  --signals SPEC     raw signal chain, e.g. hampel:5:30,ema:1,rate:30:300 (off: no raw signals)\n"
+          "  --record FILE      append a sensor trace to FILE\n"
+          "  --replay FILE      drive the sensor from a recorded trace\n"
+          "  --fast             replay without waiting for the recorded timestamps\n"
+          "  --log DIR          write the measurement log (daily .tvl files) to DIR\n"
+          "  --http PORT        serve /metrics and /history on 127.0.0.1:PORT (implies --speed 1)\n"
+          "  --mqtt PORT        publish measurements to the MQTT broker on 127.0.0.1:PORT\n"
+          "  --wifi             simulated WiFi with access points sim-home and sim-office (implied by --mqtt)\n"
+          "  --wifi-ap SSID:DBM add a simulated access point instead of the defaults (repeatable)\n"
+          "  --offline S:DUR    WiFi outage of DUR seconds starting at S seconds (repeatable)\n"
+          "  --speed X          run at X times real time (default: as fast as possible)\n"
+          "  --press B@S[:MS]   press button A/B/C at S seconds for MS ms (default 100)\n"
+          "  --serial S:CMD     send the line CMD on Serial at S seconds, e.g. 3600:prof (repeatable)\n"
+          "  --canvas-limit N   fail canvas allocations larger than N bytes\n"
+          "  --retained FILE    keep the RTC memory in FILE across runs (present: the last run crashed)\n"
+          "  --reset-at S       crash at S seconds instead of powering off (needs --retained)\n"
+          "  --ppm FILE         write the final screen as PPM\n"
+          "  --quiet            suppress Serial output\n"
+          "tools:\n"
+          "  --log-csv FILE     convert a .tvl measurement log to CSV on stdout\n"
+          "  --bench-history N  RAM of the history ring buffers and time per push and read over N samples\n"
+          "  --bench-trend N    RAM of the min/max/mean pyramid and time per 1 Hz sample over N samples\n"
+          "  --bench-log N      compare per-line and block SD writes for N samples\n"
+          "  --bench-metrics N  time N encodes of the OpenMetrics page and print it on stdout\n"
+          "  --bench-baseline D NVS writes and page erases of D days of baseline saves\n"
+          "  --bench-humidity N time N calls of the fixed-point absolute humidity and of exp()\n"
+          "  --bench-signals N  error and time per sample of raw signal chains over N samples\n"
+          "  --bench-sensors N  I2C time per 1 Hz cycle, one by one vs batched vs split, for 1..N sensors behind\n"
+          "                     the mux, then retries and failures of N sensors on a noisy bus\n"
+          "  --bench-glyphs N   us per header/axis label update, font print vs glyph cache, over N updates\n"
+          "  --broker PORT      minimal MQTT broker on 127.0.0.1:PORT, received samples as CSV on stdout\n"
+          "  --broker-drop N    with --broker: drop the connection instead of acking every Nth publish\n",
+          program);
+}
+
+static bool parseOutage(const char* spec) {
+  double start_s;
+  double duration_s;
+  if (sscanf(spec, "%lf:%lf", &start_s, &duration_s) != 2 || start_s < 0 || duration_s <= 0) {
+    return false;
+  }
+  sim_wifi.addOutage((unsigned long)(start_s * 1000), (unsigned long)(duration_s * 1000));
+  return true;
+}
+
+static bool parseAccessPoint(const char* spec) {
+  char ssid[33];
+  int rssi;
+  if (sscanf(spec, "%32[^:]:%d", ssid, &rssi) != 2 || rssi < -100 || rssi > 0) {
+    return false;
+  }
+  sim_wifi.addAccessPoint(ssid, (int8_t)rssi);
+  return true;
+}
+
+static bool parseSerialInput(const char* spec) {
+  double at_s;
+  int offset = 0;
+  if (sscanf(spec, "%lf:%n", &at_s, &offset) != 1 || offset == 0 || at_s < 0) {
+    return false;
+  }
+  return Serial.inject((unsigned long)(at_s * 1000), spec + offset);
+}
+
+static bool parsePress(const char* spec) {
+  char button;
+  double at_s;
+  unsigned long hold_ms = 100;
+  if (sscanf(spec, "%c@%lf:%lu", &button, &at_s, &hold_ms) < 2 || button < 'A' || button > 'C') {
+    return false;
+  }
+  sim_buttons.press((ButtonInput::Button)(button - 'A'), (unsigned long)(at_s * 1000), hold_ms);
+  return true;
+}
+
+int main(int argc, char** argv) {
+  double hours = 0;
+  double speed = 0;
+  const char* ppm_path = nullptr;
+  uint16_t broker_port = 0;
+  uint32_t broker_drop = 0;
+  double reset_at = 0;
+  unsigned nack_per_mille = 0;
+  unsigned corrupt_per_mille = 0;
+
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    const char* value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+
+    if (strcmp(arg, "--hours") == 0 && value) {
+      hours = atof(value);
+      i++;
+    } else if (strcmp(arg, "--sensor") == 0 && value) {
+      if (!sim_sensor.loadScript(value)) {
+        fprintf(stderr, "cannot load sensor script: %s\n", value);
+        return 1;
+      }
+      i++;
+    } else if (strcmp(arg, "--no-sensor") == 0) {
+      sim_sensor.setConnected(false);
+    } else if (strcmp(arg, "--no-env") == 0) {
+      sim_environment.setConnected(false);
+    } else if (strcmp(arg, "--sensors") == 0 && value) {
+      unsigned long count = strtoul(value, nullptr, 10);
+      if (count < 1 || count > 8) {
+        fprintf(stderr, "--sensors must be 1-8\n");
+        return 1;
+      }
+      sim_sensor_count = (uint8_t)count;
+      i++;
+    } else if (strcmp(arg, "--adafruit") == 0) {
+      sim_sensor_blocking = true;
+    } else if (strcmp(arg, "--i2c-delay") == 0 && value) {
+      sim_sensor_delay_us = strtoul(value, nullptr, 10);
+      i++;
+    } else if (strcmp(arg, "--i2c-faults") == 0 && value) {
+      if (sscanf(value, "%u:%u", &nack_per_mille, &corrupt_per_mille) != 2 ||
+          nack_per_mille > 1000 || corrupt_per_mille > 1000) {
+        fprintf(stderr, "--i2c-faults must be N:C per mille\n");
+        return 1;
+      }
+      i++;
+    } else if (strcmp(arg, "--aggregate") == 0 && value) {
+      sim_sensor_aggregate = value;
+      i++;
+    } else if (strcmp(arg, "--signals") == 0 && value) {
+      sim_signal_chain = value;
+      i++;
+    } else if (strcmp(arg, "--record") == 0 && value) {
+      sim_trace_record = value;
+      i++;
+    } else if (strcmp(arg, "--replay") == 0 && value) {
+      sim_trace_replay = value;
+      i++;
+    } else if (strcmp(arg, "--fast") == 0) {
+      sim_trace_fast = true;
+    } else if (strcmp(arg, "--log") == 0 && value) {
+      sim_log_dir = value;
+      i++;
+    } else if (strcmp(arg, "--http") == 0 && value) {
+      sim_http_port = (uint16_t)strtoul(value, nullptr, 10);
+      i++;
+    } else if (strcmp(arg, "--mqtt") == 0 && value) {
+      sim_mqtt_port = (uint16_t)strtoul(value, nullptr, 10);
+      sim_wifi.enable();
+      i++;
+    } else if (strcmp(arg, "--wifi") == 0) {
+      sim_wifi.enable();
+    } else if (strcmp(arg, "--wifi-ap") == 0 && value && parseAccessPoint(value)) {
+      i++;
+    } else if (strcmp(arg, "--offline") == 0 && value && parseOutage(value)) {
+      i++;
+    } else if (strcmp(arg, "--speed") == 0 && value) {
+      speed = atof(value);
+      i++;
+    } else if (strcmp(arg, "--log-csv") == 0 && value) {
+      return convertLogToCsv(value, stdout);
+    } else if (strcmp(arg, "--bench-history") == 0 && value) {
+      return benchmarkHistory(strtoul(value, nullptr, 10));
+    } else if (strcmp(arg, "--bench-trend") == 0 && value) {
+      return benchmarkTrend(strtoul(value, nullptr, 10));
+    } else if (strcmp(arg, "--bench-log") == 0 && value) {
+      return benchmarkLogWrites(strtoul(value, nullptr, 10), "bench_log.tmp");
+    } else if (strcmp(arg, "--bench-metrics") == 0 && value) {
+      return benchmarkMetrics(strtoul(value, nullptr, 10));
+    } else if (strcmp(arg, "--bench-humidity") == 0 && value) {
+      return benchmarkHumidity(strtoul(value, nullptr, 10));
+    } else if (strcmp(arg, "--bench-signals") == 0 && value) {
+      return benchmarkSignals(strtoul(value, nullptr, 10));
+    } else if (strcmp(arg, "--bench-sensors") == 0 && value) {
+      return benchmarkSensorArray(strtoul(value, nullptr, 10));
+    } else if (strcmp(arg, "--bench-glyphs") == 0 && value) {
+      return benchmarkGlyphs(strtoul(value, nullptr, 10));
+    } else if (strcmp(arg, "--bench-baseline") == 0 && value) {
+      return benchmarkBaselineWear(strtoul(value, nullptr, 10));
+    } else if (strcmp(arg, "--broker") == 0 && value) {
+      broker_port = (uint16_t)strtoul(value, nullptr, 10);
+      i++;
+    } else if (strcmp(arg, "--broker-drop") == 0 && value) {
+      broker_drop = strtoul(value, nullptr, 10);
+      i++;
+    } else if (strcmp(arg, "--press") == 0 && value && parsePress(value)) {
+      i++;
+    } else if (strcmp(arg, "--serial") == 0 && value && parseSerialInput(value)) {
+      i++;
+    } else if (strcmp(arg, "--canvas-limit") == 0 && value) {
+      sim_display.setCanvasLimit(strtoul(value, nullptr, 10));
+      i++;
+    } else if (strcmp(arg, "--retained") == 0 && value) {
+      sim_retained.load(value);
+      i++;
+    } else if (strcmp(arg, "--reset-at") == 0 && value) {
+      reset_at = atof(value);
+      i++;
+    } else if (strcmp(arg, "--ppm") == 0 && value) {
+      ppm_path = value;
+      i++;
+    } else if (strcmp(arg, "--quiet") == 0) {
+      Serial.setQuiet(true);
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (broker_port != 0) {
+    return runBroker(broker_port, broker_drop);
+  }
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  // 再生時は既定で記録の終わりまで実行する
+  if (hours <= 0) {
+    hours = sim_trace_replay != nullptr ? 24 * 365 : 24;
+  }
+  uint64_t end_us = (uint64_t)(hours * 3600e6);
+  if (reset_at > 0 && reset_at * 1e6 < end_us) {
+    end_us = (uint64_t)(reset_at * 1e6);
+  } else {
+    reset_at = 0;
+  }
+  // HTTPクライアントから見て測定が1秒ごとに進むよう実時間に合わせる
+  if (speed <= 0 && sim_http_port != 0) {
+    speed = 1;
+  }
+  uint64_t iterations = 0;
+
+  if (sim_sensor_count > 0) {
+    attachSimulatedSensors(sim_sensor_count, true, sim_sensor_delay_us);
+  } else if (!sim_sensor_blocking) {
+    attachSimulatedSensors(1, false, sim_sensor_delay_us);
+  }
+  setup();
+  // 起動時の検出は通し、測定中の雑音だけを確かめる
+  sim_i2c.setFaults((uint16_t)nack_per_mille, (uint16_t)corrupt_per_mille);
+  while (VirtualClock::nowMicros() < end_us && !simulationFinished()) {
+    loop();
+    iterations++;
+
+    if (speed > 0) {
+      std::this_thread::sleep_until(start + std::chrono::microseconds((uint64_t)(VirtualClock::nowMicros() / speed)));
+    }
+  }
+  // リセットではRTCメモリのみ残り、SDカードの書きかけのブロックなどは失われる
+  if (reset_at > 0) {
+    if (!sim_retained.reset()) {
+      fprintf(stderr, "--reset-at needs --retained FILE\n");
+      return 1;
+    }
+  } else {
+    simulationEnd();
+    sim_retained.powerOff();
+  }
+
+  double wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  double virtual_s = VirtualClock::nowMicros() / 1e6;
+  fprintf(stderr, "simulated %.0f s in %.2f s (%.0fx), %llu loop iterations, %lu sensor reads, "
+          "%lu humidity updates, %lu NVS writes, %lu SD sector writes, %lu I2C transactions\n",
+          virtual_s, wall_s, wall_s > 0 ? virtual_s / wall_s : 0.0, (unsigned long long)iterations,
+          (unsigned long)sim_sensor.measureCount(), (unsigned long)simulatedHumidityCount(),
+          (unsigned long)sim_store.writeCount(),
+          (unsigned long)sim_files.getStats().sector_writes,
+          (unsigned long)sim_i2c.transactionCount());
+
+  if (ppm_path != nullptr && !sim_display.dumpPpm(ppm_path)) {
+    fprintf(stderr, "cannot write %s\n", ppm_path);
+    return 1;
+  }
+  return 0;
+}
+
+#endif // !ARDUINO && !PIO_UNIT_TESTING
@@ -0,0 +1,991 @@
+// ネイティブ環境のツール：測定履歴のCSV変換、履歴のリングバッファと多段集計の計測、SDカードへの書き込み方式とメトリクスの書き込みの計測、
+// ベースライン保存によるNVSの消耗の見積もりと品質判定の再生、絶対湿度の計算の確認と計測、
+// 生信号の処理の確認と計測、複数のSGP30の測定時間の計測、字形のキャッシュの計測、MQTTブローカーの代わり
+#ifndef ARDUINO
+
+#include "HalNative.h"
+#include <SensorManager.h>
+#include <DataLogger.h>
+#include <OpenMetrics.h>
+#include <HttpServer.h>
+#include <MqttPublisher.h>
+#include <BaselineStore.h>
+#include <HumidityCompensation.h>
+#include <SignalFilter.h>
+#include <SensorArray.h>
+#include <LcdRenderer.h>
+#include <GlyphCache.h>
+#include <memory>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <time.h>
+
+int convertLogToCsv(const char* path, FILE* output) {
+  StdioFileSystem files;
+  FileHandle* input = files.open(path, FILE_MODE_READ);
+  LogReader reader;
+  if (!reader.begin(input)) {
+    fprintf(stderr, "cannot open %s\n", path);
+    return 1;
+  }
+
+  fprintf(output, "unix_time,utc,uptime_ms,tvoc,eco2,raw_h2,raw_ethanol\n");
+
+  LogRecord record;
+  uint32_t epoch;
+  uint32_t records = 0;
+  while (reader.next(record, epoch)) {
+    char utc[24] = "";
+    if (epoch != 0) {
+      time_t seconds = epoch;
+      struct tm parts;
+      gmtime_r(&seconds, &parts);
+      strftime(utc, sizeof(utc), "%Y-%m-%dT%H:%M:%SZ", &parts);
+    }
+    fprintf(output, "%lu,%s,%lu,%u,%u,%u,%u\n",
+            (unsigned long)epoch, utc, (unsigned long)record.timestamp,
+            record.tvoc, record.eco2, record.raw_h2, record.raw_ethanol);
+    records++;
+  }
+  files.close(input);
+
+  fprintf(stderr, "%s: %lu records in %lu blocks, %lu corrupt blocks, %lu missing blocks\n", path,
+          (unsigned long)records, (unsigned long)reader.validBlocks(),
+          (unsigned long)reader.badBlocks(), (unsigned long)reader.missingBlocks());
+  return 0;
+}
+
+int benchmarkHistory(uint32_t samples) {
+  if (samples == 0) {
+    samples = 1;
+  }
+  // 静的領域に置く（実機と同じくスタックに載せない）
+  static SensorHistory history;
+  static SensorPointHistory points;
+  fprintf(stderr, "RAM: SensorHistory %lu bytes (%lu samples x %d channels), SensorPointHistory %lu bytes\n",
+          (unsigned long)sizeof(history), (unsigned long)SensorHistory::SAMPLES, HISTORY_CHANNEL_COUNT,
+          (unsigned long)sizeof(points));
+
+  // 1サンプルの追加（全チャンネル、折り返しを含む）
+  uint16_t values[HISTORY_CHANNEL_COUNT];
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < samples; i++) {
+    for (int channel = 0; channel < HISTORY_CHANNEL_COUNT; channel++) {
+      values[channel] = (uint16_t)(i + channel);
+    }
+    history.push(i * 1000, values);
+  }
+  double push_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  // 満杯の履歴の2区間の走査（グラフの再描画と同じ読み方）と添字による読み出し
+  uint32_t passes = samples / SensorHistory::SAMPLES + 1;
+  volatile uint32_t sink = 0;
+  start = std::chrono::steady_clock::now();
+  for (uint32_t pass = 0; pass < passes; pass++) {
+    HistorySpan spans[2];
+    history.spans(spans[0], spans[1]);
+    uint32_t sum = 0;
+    for (int s = 0; s < 2; s++) {
+      const uint16_t* tvoc = spans[s].values(HISTORY_TVOC);
+      for (size_t k = 0; k < spans[s].length; k++) {
+        sum += tvoc[k];
+      }
+    }
+    sink = sink + sum;
+  }
+  double span_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  start = std::chrono::steady_clock::now();
+  for (uint32_t pass = 0; pass < passes; pass++) {
+    uint32_t sum = 0;
+    for (size_t k = 0; k < history.size(); k++) {
+      sum += history.tvocAt(k);
+    }
+    sink = sink + sum;
+  }
+  double index_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  double reads = (double)passes * history.size();
+  fprintf(stderr, "%lu samples on this host: push %.2f ns per sample, read %.2f ns (spans) / %.2f ns (index) per sample\n",
+          (unsigned long)samples, push_s * 1e9 / samples, span_s * 1e9 / reads, index_s * 1e9 / reads);
+  return 0;
+}
+
+int benchmarkTrend(uint32_t samples) {
+  if (samples == 0) {
+    samples = 1;
+  }
+  static TrendPyramid pyramid;
+  fprintf(stderr, "RAM: TrendPyramid %lu bytes (%lu minute, %lu quarter, %lu hour buckets)\n",
+          (unsigned long)sizeof(pyramid), (unsigned long)TrendPyramid::MINUTE_CAPACITY,
+          (unsigned long)TrendPyramid::QUARTER_CAPACITY, (unsigned long)TrendPyramid::HOUR_CAPACITY);
+
+  // 1秒ごとの追加（分・15分・時間のバケットの確定を含む）
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < samples; i++) {
+    pyramid.add(i * 1000, (uint16_t)(100 + (i * 37) % 251), (uint16_t)(400 + i % 2000));
+  }
+  double total_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  fprintf(stderr, "%lu samples on this host: %.2f ns per sample\n", (unsigned long)samples, total_s * 1e9 / samples);
+  for (int level = 0; level < TrendPyramid::LEVEL_COUNT; level++) {
+    const TrendLevel& trend_level = pyramid.level((TrendPyramid::Level)level);
+    fprintf(stderr, "  level %d: %lu buckets closed, %lu kept\n", level, (unsigned long)trend_level.sequence(),
+            (unsigned long)trend_level.size());
+  }
+  return 0;
+}
+
+// 書き込み方式ごとの結果
+static void printBenchmark(const char* method, uint32_t samples, const SdCardStats& stats,
+                           uint64_t bytes, double wall_s) {
+  fprintf(stderr, "%-16s %9llu %9lu %9lu %11.1f %9.1f %9.2f\n", method, (unsigned long long)bytes,
+          (unsigned long)stats.write_calls, (unsigned long)stats.sector_writes,
+          stats.busy_us / 1000.0, (double)stats.busy_us / samples, wall_s * 1000);
+}
+
+static LogRecord benchmarkRecord(uint32_t i) {
+  LogRecord record = { i * 1000, (uint16_t)(20 + i % 300), (uint16_t)(420 + i % 600), 13600, 18500 };
+  return record;
+}
+
+int benchmarkLogWrites(uint32_t samples, const char* path) {
+  StdioFileSystem files;
+  fprintf(stderr, "%lu samples, SD model: %lu us per sector write, %lu us per call\n",
+          (unsigned long)samples, (unsigned long)StdioFileSystem::SECTOR_WRITE_US,
+          (unsigned long)StdioFileSystem::CALL_US);
+  fprintf(stderr, "%-16s %9s %9s %9s %11s %9s %9s\n",
+          "method", "bytes", "calls", "sectors", "SD busy ms", "us/sample", "host ms");
+
+  // 1件ごとにCSVの行を書き込む（flushしないと電源断で最後のセクタまで失われる）
+  for (int flush_each = 1; flush_each >= 0; flush_each--) {
+    files.resetStats();
+    FileHandle* file = files.open(path, FILE_MODE_WRITE);
+    if (file == nullptr) {
+      fprintf(stderr, "cannot create %s\n", path);
+      return 1;
+    }
+
+    uint64_t bytes = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < samples; i++) {
+      LogRecord record = benchmarkRecord(i);
+      char line[48];
+      int length = snprintf(line, sizeof(line), "%lu,%u,%u,%u,%u\n", (unsigned long)record.timestamp,
+                            record.tvoc, record.eco2, record.raw_h2, record.raw_ethanol);
+      bytes += file->write((const uint8_t*)line, length);
+      if (flush_each) {
+        file->flush();
+      }
+    }
+    files.close(file);
+    double wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printBenchmark(flush_each ? "line + flush" : "line", samples, files.getStats(), bytes, wall_s);
+  }
+
+  // DataLogger（512バイトのブロックごとに書き込んでflush）
+  files.resetStats();
+  remove(path);
+  char dir[64];
+  snprintf(dir, sizeof(dir), "%s.d", path);
+  DataLogger logger;
+  if (!logger.init(&files, dir, 0)) {
+    return 1;
+  }
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < samples; i++) {
+    logger.append(benchmarkRecord(i), 0);
+    logger.service();
+  }
+  logger.close();
+  double wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  printBenchmark("block", samples, files.getStats(), (uint64_t)logger.blockCount() * LOG_BLOCK_SIZE, wall_s);
+
+  char log_path[80];
+  snprintf(log_path, sizeof(log_path), "%s/nodate.tvl", dir);
+  remove(log_path);
+  remove(dir);
+  remove(path);
+  return 0;
+}
+
+int benchmarkMetrics(uint32_t iterations) {
+  // 1日分程度の件数を持つ代表的な状態
+  static const uint32_t bounds[] = { 50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000 };
+  MetricsHistogram sensor_loop(bounds, sizeof(bounds) / sizeof(bounds[0]));
+  MetricsHistogram render_loop(bounds, sizeof(bounds) / sizeof(bounds[0]));
+  MetricsHistogram mqtt_latency(bounds, sizeof(bounds) / sizeof(bounds[0]));
+  MetricsHistogram wifi_connect(bounds, sizeof(bounds) / sizeof(bounds[0]));
+  for (uint32_t i = 0; i < 86400; i++) {
+    sensor_loop.observe(200 + i % 900);
+    render_loop.observe(1000 + (i * 7919) % 60000);
+  }
+  for (uint32_t i = 0; i < 8640; i++) {
+    mqtt_latency.observe(5000 + (i * 104729) % 90000);
+  }
+  for (uint32_t i = 0; i < 4; i++) {
+    wifi_connect.observe(600000 + i * 2500000);
+  }
+
+  DeviceMetrics metrics = {};
+  metrics.sample = { 86400000, 123, 876, 13523, 18321, 13517, 18309, -42, -18, false, 2, 37, 35360, 35920, 14, 1, 52, 2, 0, -6, 3, true, 2215, 4870, 9404, 9310, false, 600 };
+  metrics.sensor_connected = true;
+  metrics.uptime_ms = 86400123;
+  metrics.boot_first_reading_ms = 15420;
+  metrics.sensor_loop = &sensor_loop;
+  metrics.render_loop = &render_loop;
+  metrics.wifi_connected = true;
+  metrics.wifi_rssi = -67;
+  metrics.wifi_reconnects = 3;
+  metrics.wifi_offline_ms = 184250;
+  metrics.wifi_connect_time = &wifi_connect;
+  metrics.mqtt_latency = &mqtt_latency;
+  metrics.mqtt_connected = true;
+  metrics.mqtt_queue_ram = 17;
+  metrics.mqtt_queue_sd = 1280;
+  metrics.mqtt_dropped = 0;
+  metrics.mqtt_published = 84123;
+  // センサーが最も多い構成（8台）
+  SensorPoint points[SensorArray::MAX_SENSORS];
+  for (uint8_t i = 0; i < SensorArray::MAX_SENSORS; i++) {
+    points[i] = { 86400000, i, i != 5, false, (uint16_t)(90 + 37 * i), (uint16_t)(700 + 53 * i), 35360, 35920 };
+  }
+  metrics.sensor_points = points;
+  metrics.sensor_count = SensorArray::MAX_SENSORS;
+  metrics.sensor_cycle_us = 51842;
+  // 分割した測定の統計は雑音のあるバスで実際に測定して作る
+  SimulatedI2cBus bus;
+  std::vector<std::unique_ptr<SimulatedSgp30Device>> sensors;
+  uint8_t channels[SensorArray::MAX_SENSORS];
+  bus.setMux(I2cMux::DEFAULT_ADDRESS);
+  for (uint8_t i = 0; i < SensorArray::MAX_SENSORS; i++) {
+    sensors.emplace_back(new SimulatedSgp30Device(i));
+    bus.attach(Sgp30Device::ADDRESS, sensors.back().get(), (int8_t)i);
+    channels[i] = i;
+  }
+  SensorArray array;
+  array.init(&bus, I2cMux::DEFAULT_ADDRESS, channels, SensorArray::MAX_SENSORS);
+  bus.setFaults(20, 5);
+  for (uint32_t i = 0; i < 100; i++) {
+    array.measure(true);
+  }
+  metrics.iaq_latency = &array.latency(false);
+  metrics.raw_latency = &array.latency(true);
+  metrics.measure_retries = &array.retries();
+  metrics.i2c_nacks = array.nackCount();
+  metrics.i2c_crc_errors = array.crcErrorCount();
+  metrics.measure_failures = array.failureCount();
+
+  char page[HttpServer::PAGE_BUFFER];
+  size_t length = 0;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < iterations; i++) {
+    metrics.sample.tvoc = (uint16_t)(i % 1000);
+    length = encodeDeviceMetrics(metrics, page, sizeof(page));
+  }
+  double wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  if (length == 0) {
+    fprintf(stderr, "metrics page does not fit in %u bytes\n", (unsigned)sizeof(page));
+    return 1;
+  }
+  fwrite(page, 1, length, stdout);
+  fprintf(stderr, "%lu encodes, %u bytes per page, %.2f us per encode on this host\n",
+          (unsigned long)iterations, (unsigned)length, iterations > 0 ? wall_s * 1e6 / iterations : 0.0);
+  return 0;
+}
+
+// ESP32のNVSパーティションの書き込みと消去の見積もり（値の保存は MemoryStore）
+//
+// NVSは4KBのページに32バイトのエントリを追記していき、上書きした古いエントリは無効として残る。
+// 予備の空きページまで使うと、最も古いページの有効なエントリをそのページへ移してから消去する。
+// エントリ数は ESP-IDF と同じく、u16 の値は1、blob は見出しと索引の2 + データ32バイトごとに1
+class NvsFlashModel : public MemoryStore {
+public:
+  static const uint8_t PAGE_COUNT = 5;          // 20KB（Arduinoの既定のパーティション）
+  static const uint16_t ENTRIES_PER_PAGE = 126;
+  static const uint32_t ERASE_CYCLES = 100000;  // フラッシュの書き換え寿命
+
+  NvsFlashModel() : active(0), used(0), entries_written(0), pages(), space_name() {
+    for (uint8_t page = 1; page < PAGE_COUNT; page++) {
+      free_pages.push_back(page);
+    }
+  }
+
+  bool begin(const char* name, bool read_only) override {
+    space_name = name;
+    return MemoryStore::begin(name, read_only);
+  }
+  size_t putUShort(const char* key, uint16_t value) override {
+    size_t written = MemoryStore::putUShort(key, value);
+    if (written > 0) {
+      append(space_name + "/" + key, 1);
+    }
+    return written;
+  }
+  size_t putBytes(const char* key, const void* value, size_t length) override {
+    size_t written = MemoryStore::putBytes(key, value, length);
+    if (written > 0) {
+      append(space_name + "/" + key, 2 + (uint16_t)((length + 31) / 32));
+    }
+    return written;
+  }
+
+  uint32_t entriesWritten() const { return entries_written; }
+  uint32_t totalErases() const {
+    uint32_t total = 0;
+    for (uint8_t page = 0; page < PAGE_COUNT; page++) {
+      total += pages[page].erases;
+    }
+    return total;
+  }
+  uint32_t maxErases() const {
+    uint32_t most = 0;
+    for (uint8_t page = 0; page < PAGE_COUNT; page++) {
+      most = pages[page].erases > most ? pages[page].erases : most;
+    }
+    return most;
+  }
+
+private:
+  struct Item {
+    uint8_t page;
+    uint16_t entries;
+  };
+  struct Page {
+    uint16_t live;     // 有効なエントリ数
+    uint32_t erases;
+  };
+
+  uint8_t active;
+  uint16_t used;                      // 書き込み中のページで使ったエントリ数
+  uint32_t entries_written;
+  Page pages[PAGE_COUNT];
+  std::vector<uint8_t> full_pages;    // 古い順
+  std::vector<uint8_t> free_pages;
+  std::map<std::string, Item> items;
+  std::string space_name;
+
+  void append(const std::string& name, uint16_t entries) {
+    std::map<std::string, Item>::iterator it = items.find(name);
+    if (it != items.end()) {
+      pages[it->second.page].live -= it->second.entries;
+    }
+    if (used + entries > ENTRIES_PER_PAGE) {
+      nextPage();
+    }
+    used += entries;
+    pages[active].live += entries;
+    entries_written += entries;
+    items[name] = { active, entries };
+  }
+
+  void nextPage() {
+    full_pages.push_back(active);
+    active = free_pages.front();
+    free_pages.erase(free_pages.begin());
+    used = 0;
+    if (!free_pages.empty()) {
+      return;
+    }
+
+    // 予備のページを使った：最も古いページの有効なエントリを移して消去する
+    uint8_t oldest = full_pages.front();
+    full_pages.erase(full_pages.begin());
+    for (std::map<std::string, Item>::iterator it = items.begin(); it != items.end(); ++it) {
+      if (it->second.page == oldest) {
+        it->second.page = active;
+        used += it->second.entries;
+        pages[active].live += it->second.entries;
+        entries_written += it->second.entries;
+      }
+    }
+    pages[oldest].live = 0;
+    pages[oldest].erases++;
+    free_pages.push_back(oldest);
+  }
+};
+
+// ベースラインの生の値のランダムウォーク（xorshift32）
+static uint16_t driftBaseline(uint16_t value, uint32_t& random_state, uint16_t step) {
+  random_state ^= random_state << 13;
+  random_state ^= random_state >> 17;
+  random_state ^= random_state << 5;
+  return (uint16_t)(value + (int)(random_state % (2 * step + 1)) - step);
+}
+
+static void printBaselineBenchmark(const char* method, uint32_t saves, uint32_t writes,
+                                   const NvsFlashModel& flash, uint32_t days) {
+  double years = days / 365.0;
+  double erases_per_year = flash.maxErases() / years;
+  fprintf(stderr, "%-16s %8lu %8lu %9lu %8lu %13.1f %14.0f\n", method, (unsigned long)saves, (unsigned long)writes,
+          (unsigned long)flash.entriesWritten(), (unsigned long)flash.totalErases(), erases_per_year,
+          erases_per_year > 0 ? NvsFlashModel::ERASE_CYCLES / erases_per_year : 0.0);
+}
+
+int benchmarkBaselineWear(uint32_t days) {
+  // 毎晩6時間クリーンエア（10分ごとに保存）と12時間ごとの定期保存、10分ごとにベースラインが数カウント動く
+  static const uint32_t TICK_S = 600;
+  static const uint32_t TICKS_PER_DAY = 86400 / TICK_S;
+  static const uint32_t CLEAN_FROM = 1 * 3600 / TICK_S;    // 1:00〜7:00
+  static const uint32_t CLEAN_TO = 7 * 3600 / TICK_S;
+  static const uint32_t PERIODIC_TICKS = 43200 / TICK_S;
+  if (days == 0) {
+    return 1;
+  }
+
+  NvsFlashModel legacy_flash;
+  NvsFlashModel slot_flash;
+  BaselineStore store;
+  store.init(&slot_flash);
+
+  uint32_t random_state = 2463534242u;
+  uint16_t eco2_base = 35187;
+  uint16_t tvoc_base = 35553;
+  uint32_t saves = 0;
+  uint32_t legacy_writes = 0;
+  for (uint32_t tick = 0; tick < days * TICKS_PER_DAY; tick++) {
+    eco2_base = driftBaseline(eco2_base, random_state, 3);
+    tvoc_base = driftBaseline(tvoc_base, random_state, 3);
+    uint32_t hour_tick = tick % TICKS_PER_DAY;
+    bool clean_air = hour_tick > CLEAN_FROM && hour_tick < CLEAN_TO;
+    bool periodic = tick > 0 && tick % PERIODIC_TICKS == 0;
+    if (!clean_air && !periodic) {
+      continue;
+    }
+    BaselineSource source = clean_air ? BASELINE_SOURCE_CLEAN_AIR : BASELINE_SOURCE_PERIODIC;
+    uint32_t epoch = SIM_EPOCH_START + tick * TICK_S;
+    saves++;
+
+    // 以前の方式：2つのキーを毎回書き込む
+    legacy_flash.begin("sgp30", false);
+    legacy_flash.putUShort("eco2_base", eco2_base);
+    legacy_flash.putUShort("tvoc_base", tvoc_base);
+    legacy_flash.end();
+    legacy_writes += 2;
+
+    store.save(eco2_base, tvoc_base, source, epoch);
+  }
+
+  fprintf(stderr, "%lu days, %lu save requests, NVS model: %u pages of %u entries, %lu erase cycles\n",
+          (unsigned long)days, (unsigned long)saves, NvsFlashModel::PAGE_COUNT, NvsFlashModel::ENTRIES_PER_PAGE,
+          (unsigned long)NvsFlashModel::ERASE_CYCLES);
+  fprintf(stderr, "%-16s %8s %8s %9s %8s %13s %14s\n",
+          "method", "requests", "writes", "entries", "erases", "erases/page/y", "years to wear");
+  printBaselineBenchmark("two keys", saves, legacy_writes, legacy_flash, days);
+  printBaselineBenchmark("slots", saves, store.writeCount(), slot_flash, days);
+
+  BaselineRecord record;
+  for (uint8_t i = 0; store.history(i, record); i++) {
+    fprintf(stderr, "  history %u: #%lu eCO2=%u TVOC=%u source=%u epoch=%lu\n", i, (unsigned long)record.sequence,
+            record.eco2_base, record.tvoc_base, record.source, (unsigned long)record.epoch);
+  }
+  return 0;
+}
+
+int benchmarkHumidity(uint32_t iterations) {
+  // 1回あたりの時間（入力は室内の範囲を巡回、結果を足して最適化で消えないようにする）
+  // 浮動小数点の式との誤差は test/test_humidity_compensation で確認する
+  if (iterations == 0) {
+    iterations = 1;
+  }
+  volatile uint32_t sink = 0;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < iterations; i++) {
+    sink = sink + absoluteHumidity((int16_t)(1500 + i % 1500), (uint16_t)(2000 + i % 6000));
+  }
+  double fixed_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  volatile double double_sink = 0;
+  start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < iterations; i++) {
+    double_sink = double_sink + absoluteHumidityReference((1500 + i % 1500) / 100.0, (2000 + i % 6000) / 100.0);
+  }
+  double float_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  fprintf(stderr, "%lu calls on this host: fixed point %.2f ns, exp() %.2f ns per call\n", (unsigned long)iterations,
+          fixed_s * 1e9 / iterations, float_s * 1e9 / iterations);
+  return 0;
+}
+
+// 生信号の処理の確認用の入力：ゆっくりした変化 + ±4 のノイズ + 97サンプルごとのスパイク
+// + 2000サンプルごとの急な低下（60サンプルで600下がり、500サンプル後に同じ速さで戻る）
+// clean: スパイク・ノイズを除いた値
+static uint16_t signalInput(uint32_t i, uint32_t& random_state, uint16_t* clean) {
+  random_state ^= random_state << 13;
+  random_state ^= random_state >> 17;
+  random_state ^= random_state << 5;
+  double base = 13500 + 300 * sin(i * 2 * M_PI / 600);
+  // ガスの濃度の急な上昇と低下
+  uint32_t phase = i % 2000;
+  if (phase >= 1000 && phase < 1060) {
+    base -= (phase - 1000) * 10.0;
+  } else if (phase >= 1060 && phase < 1500) {
+    base -= 600;
+  } else if (phase >= 1500 && phase < 1560) {
+    base -= (1560 - phase) * 10.0;
+  }
+  uint16_t value = (uint16_t)lround(base);
+  if (clean != nullptr) {
+    *clean = value;
+  }
+  value = (uint16_t)(value + (int)(random_state % 9) - 4);
+  if (i % 97 == 50) {
+    value = (uint16_t)(value + (i % 2 == 0 ? 400 : -400));
+  }
+  return value;
+}
+
+int benchmarkSignals(uint32_t samples) {
+  // 設定ごとの誤差（スパイク・ノイズを除いた値との差の二乗平均と最大）と1サンプルあたりの時間
+  static const char* const specs[] = {
+    "none", "ema:2", "ema:3", "median:5", "median:9", "hampel:5:30", "hampel:7:30", "hampel:5:30,ema:2", SIGNAL_CHAIN_DEFAULT,
+    "hampel:7:30,median:5,ema:2",
+  };
+  if (samples == 0) {
+    samples = 1;
+  }
+  std::vector<uint16_t> input(samples);
+  std::vector<uint16_t> clean(samples);
+  uint32_t random_state = 88172645;
+  for (uint32_t i = 0; i < samples; i++) {
+    input[i] = signalInput(i, random_state, &clean[i]);
+  }
+
+  fprintf(stderr, "%-30s %10s %10s %8s %8s %10s\n", "chain", "rms error", "max error", "spikes", "changes", "ns/sample");
+  for (const char* spec : specs) {
+    SignalChainConfig config = {};
+    parseSignalChain(spec, config);
+    SignalChain chain;
+    chain.configure(config);
+
+    double squared = 0;
+    double worst = 0;
+    for (uint32_t i = 0; i < samples; i++) {
+      double error = (double)chain.apply(i * 1000, input[i]) - clean[i];
+      squared += error * error;
+      worst = fabs(error) > worst ? fabs(error) : worst;
+    }
+    uint32_t spikes = chain.spikes();
+    uint32_t changes = chain.rate().events();
+
+    // 時間は結果を足して最適化で消えないようにする
+    chain.configure(config);
+    volatile uint32_t sink = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < samples; i++) {
+      sink = sink + chain.apply(i * 1000, input[i]);
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    fprintf(stderr, "%-30s %10.2f %10.0f %8lu %8lu %10.1f\n", spec, sqrt(squared / samples), worst, (unsigned long)spikes,
+            (unsigned long)changes, elapsed * 1e9 / samples);
+  }
+  return 0;
+}
+
+// 1周期分の測定（TVOC・eCO2と生信号）にかかったI2Cの時間 (us、仮想時計)
+static uint32_t sensorCycleMicros(SensorArray& array, bool batched, uint32_t& mismatches) {
+  uint64_t start = VirtualClock::nowMicros();
+  if (batched) {
+    array.measure(true);
+  }
+  for (uint8_t i = 0; i < array.size(); i++) {
+    Sgp30Device& device = array.device(i);
+    if (!device.IAQmeasure() || !device.IAQmeasureRaw()) {
+      mismatches++;
+    }
+  }
+  return (uint32_t)(VirtualClock::nowMicros() - start);
+}
+
+// 分割した測定の1周期のうち、呼び出し元に戻らずにI2Cを使っていた時間 (us、仮想時計)
+// 待ち時間は poll() の返した時間だけ仮想時計を進める（タスクが他のジョブを実行するか眠る間）
+static uint32_t splitCycleMicros(SensorArray& array, uint32_t& mismatches) {
+  uint64_t start = VirtualClock::nowMicros();
+  array.startCycle(true);
+  uint64_t busy_us = VirtualClock::nowMicros() - start;
+  for (;;) {
+    start = VirtualClock::nowMicros();
+    unsigned long wait_ms = array.poll();
+    busy_us += VirtualClock::nowMicros() - start;
+    if (wait_ms == 0) {
+      break;
+    }
+    VirtualClock::advance(wait_ms * 1000);
+  }
+  for (uint8_t i = 0; i < array.size(); i++) {
+    Sgp30Device& device = array.device(i);
+    if (!device.IAQmeasure() || !device.IAQmeasureRaw()) {
+      mismatches++;
+    }
+  }
+  return (uint32_t)busy_us;
+}
+
+// 雑音のあるバスでの分割した測定（測定の遅いセンサー、NACKと壊れたデータ）
+static uint32_t benchmarkNoisyBus(uint8_t count) {
+  static const uint32_t CYCLES = 200;
+  static const uint16_t NACK_PER_MILLE = 50;
+  static const uint16_t CORRUPT_PER_MILLE = 20;
+  static const uint32_t EXTRA_DELAY_US = 3000;
+
+  SimulatedI2cBus bus;
+  std::vector<std::unique_ptr<SimulatedSgp30Device>> sensors;
+  uint8_t channels[SensorArray::MAX_SENSORS];
+  bus.setMux(I2cMux::DEFAULT_ADDRESS);
+  for (uint8_t i = 0; i < count; i++) {
+    sensors.emplace_back(new SimulatedSgp30Device(i));
+    sensors.back()->setExtraDelay(EXTRA_DELAY_US);
+    bus.attach(Sgp30Device::ADDRESS, sensors.back().get(), (int8_t)i);
+    channels[i] = i;
+  }
+  SensorArray array;
+  array.init(&bus, I2cMux::DEFAULT_ADDRESS, channels, count);
+  uint32_t errors = 0;
+  for (uint8_t i = 0; i < count; i++) {
+    if (!array.device(i).begin()) {
+      errors++;
+    }
+  }
+  bus.setFaults(NACK_PER_MILLE, CORRUPT_PER_MILLE);
+
+  // 読めた結果は必ずセンサーの最新の測定と一致し（壊れたデータを通さない）、読めなかった測定は失敗として数える
+  uint64_t busy_us = 0;
+  uint32_t lost = 0;
+  for (uint32_t cycle = 0; cycle < CYCLES; cycle++) {
+    uint64_t start = VirtualClock::nowMicros();
+    array.startCycle(true);
+    unsigned long wait_ms;
+    while ((wait_ms = array.poll()) > 0) {
+      busy_us += VirtualClock::nowMicros() - start;
+      VirtualClock::advance(wait_ms * 1000);
+      start = VirtualClock::nowMicros();
+    }
+    busy_us += VirtualClock::nowMicros() - start;
+    for (uint8_t i = 0; i < count; i++) {
+      SimulatedSgp30& model = sensors[i]->model();
+      Sgp30Device& device = array.device(i);
+      if (!device.IAQmeasure()) {
+        lost++;
+      } else if (device.eco2() != model.eco2() || device.tvoc() != model.tvoc()) {
+        errors++;
+      }
+      if (!device.IAQmeasureRaw()) {
+        lost++;
+      } else if (device.rawH2() != model.rawH2() || device.rawEthanol() != model.rawEthanol()) {
+        errors++;
+      }
+    }
+  }
+  if (lost != array.failureCount()) {
+    errors++;
+  }
+  errors += bus.collisionCount();
+
+  const MetricsHistogram& retries = array.retries();
+  fprintf(stderr, "\n%u sensors, measurements %lu us late, %u per mille NACK, %u per mille corrupted, %lu cycles\n",
+          count, (unsigned long)EXTRA_DELAY_US, NACK_PER_MILLE, CORRUPT_PER_MILLE, (unsigned long)CYCLES);
+  fprintf(stderr, "injected faults %lu, NACKs %lu, CRC errors %lu, failed measurements %lu of %lu\n",
+          (unsigned long)bus.faultCount(), (unsigned long)array.nackCount(), (unsigned long)array.crcErrorCount(),
+          (unsigned long)array.failureCount(), (unsigned long)retries.count());
+  fprintf(stderr, "retries per measurement:");
+  for (uint8_t i = 0; i <= retries.bucketCount(); i++) {
+    fprintf(stderr, "  %s%lu: %lu", i < retries.bucketCount() ? "" : ">", (unsigned long)retries.bound(
+            i < retries.bucketCount() ? i : retries.bucketCount() - 1), (unsigned long)retries.bucket(i));
+  }
+  fprintf(stderr, "\nmean latency iaq %.1f ms, raw %.1f ms, I2C busy %.1f ms per cycle%s\n",
+          array.latency(false).sum() / 1000.0 / array.latency(false).count(),
+          array.latency(true).sum() / 1000.0 / array.latency(true).count(),
+          busy_us / 1000.0 / CYCLES, errors > 0 ? "  (errors)" : "");
+  return errors;
+}
+
+int benchmarkSensorArray(uint32_t max_sensors) {
+  static const uint32_t CYCLES = 20;
+  static const uint32_t CYCLE_US = SensorManager::SENSOR_UPDATE_INTERVAL * 1000;
+  if (max_sensors < 1 || max_sensors > SensorArray::MAX_SENSORS) {
+    fprintf(stderr, "sensors must be 1-%u\n", SensorArray::MAX_SENSORS);
+    return 1;
+  }
+
+  fprintf(stderr, "I2C time per 1 Hz cycle (measure_iaq + measure_raw, 100 kHz, TCA9548A)\n");
+  fprintf(stderr, "sensors  one by one       batched         split (busy)\n");
+  uint32_t failures = 0;
+  for (uint8_t count = 1; count <= max_sensors; count++) {
+    // 台数ごとに新しいバスとセンサー（チャンネル 0〜count-1）
+    SimulatedI2cBus bus;
+    std::vector<std::unique_ptr<SimulatedSgp30Device>> sensors;
+    uint8_t channels[SensorArray::MAX_SENSORS];
+    bus.setMux(I2cMux::DEFAULT_ADDRESS);
+    for (uint8_t i = 0; i < count; i++) {
+      sensors.emplace_back(new SimulatedSgp30Device(i));
+      bus.attach(Sgp30Device::ADDRESS, sensors.back().get(), (int8_t)i);
+      channels[i] = i;
+    }
+    SensorArray array;
+    array.init(&bus, I2cMux::DEFAULT_ADDRESS, channels, count);
+    for (uint8_t i = 0; i < count; i++) {
+      if (!array.device(i).begin()) {
+        failures++;
+      }
+    }
+
+    // 1台ずつ（Adafruit_SGP30と同じ待ち方）とまとめた測定を交互に
+    uint64_t sequential_us = 0;
+    uint64_t batched_us = 0;
+    uint64_t split_us = 0;
+    uint32_t mismatches = 0;
+    for (uint32_t cycle = 0; cycle < CYCLES; cycle++) {
+      sequential_us += sensorCycleMicros(array, false, mismatches);
+      batched_us += sensorCycleMicros(array, true, mismatches);
+      split_us += splitCycleMicros(array, mismatches);
+      // まとめた測定の結果が各センサーの最新の測定と一致すること
+      for (uint8_t i = 0; i < count; i++) {
+        SimulatedSgp30& model = sensors[i]->model();
+        Sgp30Device& device = array.device(i);
+        if (device.eco2() != model.eco2() || device.tvoc() != model.tvoc() ||
+            device.rawH2() != model.rawH2() || device.rawEthanol() != model.rawEthanol()) {
+          mismatches++;
+        }
+      }
+    }
+    for (uint8_t i = 0; i < count; i++) {
+      mismatches += array.device(i).nackCount() + array.device(i).crcErrorCount();
+    }
+    failures += mismatches + bus.collisionCount();
+
+    double sequential_ms = sequential_us / 1000.0 / CYCLES;
+    double batched_ms = batched_us / 1000.0 / CYCLES;
+    double split_ms = split_us / 1000.0 / CYCLES;
+    fprintf(stderr, "%7u  %6.1f ms %4.1f %%  %6.1f ms %4.1f %%  %6.1f ms %4.1f %%%s\n", count,
+            sequential_ms, sequential_ms * 100000 / CYCLE_US, batched_ms, batched_ms * 100000 / CYCLE_US,
+            split_ms, split_ms * 100000 / CYCLE_US, mismatches + bus.collisionCount() > 0 ? "  (errors)" : "");
+  }
+  failures += benchmarkNoisyBus((uint8_t)max_sensors);
+  return failures > 0 ? 1 : 0;
+}
+
+static bool samePixels(const PixelBuffer& a, const PixelBuffer& b) {
+  return a.width() == b.width() && a.height() == b.height() &&
+         memcmp(a.data(), b.data(), (size_t)a.width() * a.height() * sizeof(uint16_t)) == 0;
+}
+
+// ヘッダーの値の1回の更新（print: sprintf とフォントでの描画、cache: 字形のキャッシュ）
+static void updateHeader(LcdRenderer& renderer, LcdTextField& field, bool full, bool cached,
+                         uint16_t tvoc, uint16_t eco2) {
+  char buffer[LcdTextField::MAX_LENGTH + 1];
+  if (cached) {
+    int length = 0;
+    memcpy(buffer, "TVOC:", 5);
+    length = 5 + GlyphCache::formatNumber(tvoc, buffer + 5);
+    memcpy(buffer + length, "ppb eCO2:", 9);
+    length += 9;
+    length += GlyphCache::formatNumber(eco2, buffer + length);
+    memcpy(buffer + length, "ppm", 4);
+  } else {
+    snprintf(buffer, sizeof(buffer), "TVOC:%dppb eCO2:%dppm", tvoc, eco2);
+  }
+  if (full) {
+    renderer.resetTextField(field);
+  }
+  renderer.drawTextDiff(field, buffer);
+}
+
+int benchmarkGlyphs(uint32_t iterations) {
+  static const int AXIS_VALUES[6] = { 1000, 500, 0, 5000, 2700, 400 };
+  if (iterations == 0) {
+    iterations = 1;
+  }
+
+  // 同じ更新を両方の方式で描き、画素が一致することを確かめる
+  FramebufferDisplay print_display;
+  FramebufferDisplay cache_display;
+  GlyphCache glyphs;
+  if (!glyphs.init(&cache_display)) {
+    return 1;
+  }
+  LcdRenderer print_renderer;
+  LcdRenderer cache_renderer;
+  print_renderer.init(&print_display);
+  cache_renderer.init(&cache_display);
+  cache_renderer.setGlyphCache(&glyphs);
+
+  fprintf(stderr, "%-22s %12s %12s %14s %14s  %s\n", "update", "print us", "cache us", "print SPI tx", "cache SPI tx",
+          "pixels");
+  uint32_t failures = 0;
+  for (int full = 0; full < 2; full++) {
+    LcdTextField fields[2];
+    print_renderer.initTextField(fields[0], 5, 5, 2, WHITE, BLACK);
+    cache_renderer.initTextField(fields[1], 5, 5, 2, WHITE, BLACK);
+    double elapsed_us[2];
+    uint32_t transactions[2];
+    for (int cached = 0; cached < 2; cached++) {
+      LcdRenderer& renderer = cached ? cache_renderer : print_renderer;
+      uint32_t start_transactions = renderer.getTotalTransactions();
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      for (uint32_t i = 0; i < iterations; i++) {
+        // 1秒ごとの測定のように下の桁ほどよく変わる値
+        updateHeader(renderer, fields[cached], full, cached, (uint16_t)(120 + (i * 7) % 900), (uint16_t)(400 + (i * 13) % 1600));
+      }
+      elapsed_us[cached] = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+      transactions[cached] = renderer.getTotalTransactions() - start_transactions;
+    }
+    bool same = samePixels(print_display.pixels(), cache_display.pixels());
+    failures += same ? 0 : 1;
+    fprintf(stderr, "%-22s %12.2f %12.2f %14.1f %14.1f  %s\n", full ? "header (full redraw)" : "header (changed chars)",
+            elapsed_us[0] / iterations, elapsed_us[1] / iterations, (double)transactions[0] / iterations,
+            (double)transactions[1] / iterations, same ? "same" : "DIFFERENT");
+  }
+
+  // 合成スプライトへのY軸の目盛り（6個）
+  Canvas* canvases[2] = { print_display.createCanvas(320, 172, 8), cache_display.createCanvas(320, 172, 8) };
+  double elapsed_us[2];
+  for (int cached = 0; cached < 2; cached++) {
+    Canvas& canvas = *canvases[cached];
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < iterations; i++) {
+      for (int label = 0; label < 6; label++) {
+        int y = (label / 3) * 90 + (label % 3) * 40;
+        if (cached) {
+          glyphs.drawNumber(canvas, 0, y, AXIS_VALUES[label], 1, CYAN);
+        } else {
+          char text[GlyphCache::NUMBER_LENGTH];
+          snprintf(text, sizeof(text), "%d", AXIS_VALUES[label]);
+          canvas.drawText(0, y, text, 1, CYAN);
+        }
+      }
+    }
+    elapsed_us[cached] = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+  }
+  bool same = samePixels(static_cast<FramebufferCanvas*>(canvases[0])->pixels(),
+                         static_cast<FramebufferCanvas*>(canvases[1])->pixels());
+  failures += same ? 0 : 1;
+  fprintf(stderr, "%-22s %12.2f %12.2f %14s %14s  %s\n", "axis labels (6)", elapsed_us[0] / iterations,
+          elapsed_us[1] / iterations, "-", "-", same ? "same" : "DIFFERENT");
+  print_display.destroyCanvas(canvases[0]);
+  cache_display.destroyCanvas(canvases[1]);
+  return failures > 0 ? 1 : 0;
+}
+
+// MQTTブローカーの代わり（1接続、QoS 1のPUBLISHに応答し、受け取った測定をCSVで出力）
+// drop_every: N件のPUBLISHごとにPUBACKを返さず切断する（0: 切断しない）
+int runBroker(uint16_t port, uint32_t drop_every) {
+  PosixNetServer server;
+  if (!server.begin(port)) {
+    fprintf(stderr, "cannot listen on 127.0.0.1:%u\n", port);
+    return 1;
+  }
+  fprintf(stderr, "broker listening on 127.0.0.1:%u\n", port);
+  printf("unix_time,uptime_ms,tvoc,eco2\n");
+  fflush(stdout);
+
+  uint8_t packet[1024];
+  size_t length = 0;
+  uint32_t publishes = 0;
+  uint32_t samples = 0;
+  NetClient* client = nullptr;
+
+  while (true) {
+    if (client == nullptr) {
+      client = server.accept();
+      length = 0;
+      if (client == nullptr) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        continue;
+      }
+      fprintf(stderr, "broker: client connected\n");
+    }
+
+    int n = client->read(packet + length, sizeof(packet) - length);
+    if (n < 0) {
+      fprintf(stderr, "broker: client disconnected (%lu batches, %lu samples)\n",
+              (unsigned long)publishes, (unsigned long)samples);
+      server.close(client);
+      client = nullptr;
+      continue;
+    }
+    if (n == 0) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      continue;
+    }
+    length += n;
+
+    // 揃ったパケットを順に処理する
+    while (length >= 2) {
+      size_t remaining = 0;
+      size_t header = 1;
+      uint32_t multiplier = 1;
+      bool complete = false;
+      while (header < length && header < 5) {
+        uint8_t digit = packet[header++];
+        remaining += (digit & 0x7F) * multiplier;
+        multiplier *= 128;
+        if ((digit & 0x80) == 0) {
+          complete = true;
+          break;
+        }
+      }
+      if (!complete || length < header + remaining) {
+        break;
+      }
+
+      uint8_t type = packet[0] >> 4;
+      const uint8_t* body = packet + header;
+      bool drop = false;
+      if (type == 1) {
+        // CONNECT → CONNACK
+        const uint8_t connack[] = { 0x20, 0x02, 0x00, 0x00 };
+        client->write(connack, sizeof(connack));
+      } else if (type == 3 && remaining >= 4) {
+        size_t topic_length = (body[0] << 8) | body[1];
+        const uint8_t* id = body + 2 + topic_length;
+        const uint8_t* payload = id + 2;
+        size_t payload_length = remaining - 4 - topic_length;
+
+        if (drop_every != 0 && (publishes + 1) % drop_every == 0) {
+          publishes++;
+          drop = true;
+        } else {
+          QueuedSample batch[255];
+          int count = decodeSampleBatch(payload, payload_length, batch, 255);
+          if (count < 0) {
+            fprintf(stderr, "broker: malformed batch (%u bytes)\n", (unsigned)payload_length);
+          }
+          for (int i = 0; i < count; i++) {
+            printf("%lu,%lu,%u,%u\n", (unsigned long)batch[i].epoch, (unsigned long)batch[i].timestamp,
+                   batch[i].tvoc, batch[i].eco2);
+          }
+          fflush(stdout);
+          publishes++;
+          samples += count > 0 ? count : 0;
+          const uint8_t puback[] = { 0x40, 0x02, id[0], id[1] };
+          client->write(puback, sizeof(puback));
+        }
+      } else if (type == 12) {
+        // PINGREQ → PINGRESP
+        const uint8_t pingresp[] = { 0xD0, 0x00 };
+        client->write(pingresp, sizeof(pingresp));
+      } else if (type == 14) {
+        drop = true;
+      }
+
+      if (drop) {
+        fprintf(stderr, "broker: dropping connection (%lu batches, %lu samples)\n",
+                (unsigned long)publishes, (unsigned long)samples);
+        server.close(client);
+        client = nullptr;
+        length = 0;
+        break;
+      }
+      memmove(packet, packet + header + remaining, length - header - remaining);
+      length -= header + remaining;
+    }
+    if (client != nullptr && length == sizeof(packet)) {
+      fprintf(stderr, "broker: packet too large\n");
+      server.close(client);
+      client = nullptr;
+    }
+  }
+}
+
+#endif // ARDUINO
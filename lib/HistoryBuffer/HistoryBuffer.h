@@ -0,0 +1,115 @@
+#ifndef HISTORY_BUFFER_H
+#define HISTORY_BUFFER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// 履歴のチャンネル
+enum HistoryChannel {
+  HISTORY_TVOC,              // TVOC値 (ppb)
+  HISTORY_ECO2,              // eCO2値 (ppm)
+  HISTORY_H2,                // H2の生信号（0: 未測定）
+  HISTORY_ETHANOL,           // エタノールの生信号
+  HISTORY_H2_FILTERED,       // 処理後のH2の生信号
+  HISTORY_ETHANOL_FILTERED,  // 処理後のエタノールの生信号
+  HISTORY_CHANNEL_COUNT
+};
+
+// 履歴データの連続区間（リングバッファの折り返しで最大2区間に分かれる）
+struct HistorySpan {
+  const uint16_t* channels[HISTORY_CHANNEL_COUNT];
+  const uint32_t* timestamp;   // 取得時刻 (ms)
+  size_t length;               // 要素数
+
+  const uint16_t* values(HistoryChannel channel) const {
+    return channels[channel];
+  }
+};
+
+// 固定容量のリングバッファ（ヒープ確保なし、チャンネルごとの配列に格納）
+// CHANNELS: 先頭から何チャンネル分を持つか（持たないチャンネルは 0 として読める）
+template <size_t CAPACITY, int CHANNELS = HISTORY_CHANNEL_COUNT>
+class HistoryBuffer {
+public:
+  static const size_t SAMPLES = CAPACITY;
+  static const size_t BYTES = CAPACITY * (sizeof(uint16_t) * CHANNELS + sizeof(uint32_t));
+
+  HistoryBuffer() : head(0), count(0), total(0) {}
+
+  // サンプル追加（満杯時は最古のサンプルを上書き、生信号は 0）
+  void push(uint32_t timestamp, uint16_t tvoc, uint16_t eco2) {
+    uint16_t values[HISTORY_CHANNEL_COUNT] = { tvoc, eco2 };
+    push(timestamp, values);
+  }
+
+  // values: HistoryChannel の順に CHANNELS 分
+  void push(uint32_t timestamp, const uint16_t* values) {
+    for (int channel = 0; channel < CHANNELS; channel++) {
+      data[channel][head] = values[channel];
+    }
+    timestamp_data[head] = timestamp;
+
+    if (++head == CAPACITY) {
+      head = 0;
+    }
+    if (count < CAPACITY) {
+      count++;
+    }
+    total++;
+  }
+
+  void clear() {
+    head = 0;
+    count = 0;
+    total = 0;
+  }
+
+  size_t size() const { return count; }
+  size_t capacity() const { return CAPACITY; }
+  bool empty() const { return count == 0; }
+  bool full() const { return count == CAPACITY; }
+
+  // clear() 以降に追加されたサンプルの通し番号（最新サンプルの次の番号）
+  uint32_t sequence() const { return total; }
+
+  // 古い順に index 番目のサンプル
+  uint16_t tvocAt(size_t index) const { return data[HISTORY_TVOC][physicalIndex(index)]; }
+  uint16_t eco2At(size_t index) const { return data[HISTORY_ECO2][physicalIndex(index)]; }
+  uint32_t timestampAt(size_t index) const { return timestamp_data[physicalIndex(index)]; }
+  uint16_t valueAt(HistoryChannel channel, size_t index) const {
+    return channel < CHANNELS ? data[channel][physicalIndex(index)] : 0;
+  }
+
+  // 古い順に並んだ連続区間を取得（second は折り返しがなければ長さ0、持たないチャンネルは nullptr）
+  void spans(HistorySpan& first, HistorySpan& second) const {
+    size_t start = (head + CAPACITY - count) % CAPACITY;
+    size_t first_length = count;
+    if (start + count > CAPACITY) {
+      first_length = CAPACITY - start;
+    }
+
+    for (int channel = 0; channel < HISTORY_CHANNEL_COUNT; channel++) {
+      first.channels[channel] = channel < CHANNELS ? data[channel] + start : nullptr;
+      second.channels[channel] = channel < CHANNELS ? data[channel] : nullptr;
+    }
+    first.timestamp = timestamp_data + start;
+    first.length = first_length;
+
+    second.timestamp = timestamp_data;
+    second.length = count - first_length;
+  }
+
+private:
+  uint16_t data[CHANNELS][CAPACITY];
+  uint32_t timestamp_data[CAPACITY];
+  size_t head;     // 次の書き込み位置
+  size_t count;    // 保持しているサンプル数
+  uint32_t total;  // 追加されたサンプルの総数
+
+  size_t physicalIndex(size_t index) const {
+    size_t pos = head + CAPACITY - count + index;
+    return pos >= CAPACITY ? pos - CAPACITY : pos;
+  }
+};
+
+#endif // HISTORY_BUFFER_H
@@ -0,0 +1,528 @@
+#include "HttpServer.h"
+
+// チャンクの長さ（4桁の16進数 + CRLF）と末尾（CRLF + 終端チャンク）
+static const size_t CHUNK_PREFIX = 6;
+static const size_t CHUNK_SUFFIX = 2 + 5;
+// 履歴1件の最大長（"," + "[4294967295,65535,65535]"）
+static const size_t MAX_ITEM = 32;
+
+// クエリ文字列から name の値を取り出す
+static bool queryValue(const char* query, const char* name, char* value, size_t size) {
+  size_t name_length = strlen(name);
+  const char* p = query;
+  while (p != nullptr && *p != '\0') {
+    const char* end = strchr(p, '&');
+    size_t length = end != nullptr ? (size_t)(end - p) : strlen(p);
+    if (length > name_length && strncmp(p, name, name_length) == 0 && p[name_length] == '=') {
+      size_t value_length = length - name_length - 1;
+      if (value_length >= size) {
+        value_length = size - 1;
+      }
+      memcpy(value, p + name_length + 1, value_length);
+      value[value_length] = '\0';
+      return true;
+    }
+    p = end != nullptr ? end + 1 : nullptr;
+  }
+  return false;
+}
+
+static bool queryNumber(const char* query, const char* name, uint32_t* number) {
+  char value[16];
+  if (!queryValue(query, name, value, sizeof(value))) {
+    return false;
+  }
+  *number = strtoul(value, nullptr, 10);
+  return true;
+}
+
+static const char* statusText(int status) {
+  switch (status) {
+    case 200: return "OK";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    default:  return "Internal Server Error";
+  }
+}
+
+HttpServer::HttpServer() :
+  net(nullptr),
+  history(nullptr),
+  trend(nullptr),
+  metrics(),
+  running(false),
+  restored(),
+  page_encoder(nullptr),
+  page_context(nullptr),
+  page_length(0),
+  requests(0),
+  errors(0),
+  bytes_sent(0),
+  max_poll_us(0) {
+  for (Connection& conn : connections) {
+    conn.client = nullptr;
+    conn.state = STATE_FREE;
+    conn.body = nullptr;
+  }
+}
+
+void HttpServer::init(NetServer* server, const SensorHistory* samples, const TrendPyramid* trends) {
+  net = server;
+  history = samples;
+  trend = trends;
+}
+
+void HttpServer::markRestored() {
+  restored[0] = history->sequence();
+  // 集計中のバケットも復元した測定を含むので、次に確定するバケットまで除く
+  for (int8_t level = 0; level < TrendPyramid::LEVEL_COUNT; level++) {
+    const TrendLevel& trend_level = trend->level((TrendPyramid::Level)level);
+    restored[level + 1] = trend_level.sequence() + (trend_level.pendingBucket().count > 0 ? 1 : 0);
+  }
+}
+
+void HttpServer::setOpenMetrics(MetricsPageEncoder encoder, void* context) {
+  page_encoder = encoder;
+  page_context = context;
+}
+
+bool HttpServer::begin(uint16_t port) {
+  if (running) {
+    return true;
+  }
+
+  running = net->begin(port);
+  if (running) {
+    Serial.printf("HTTP server listening on port %u\n", port);
+  } else {
+    Serial.printf("HTTP server failed to listen on port %u\n", port);
+  }
+  return running;
+}
+
+void HttpServer::poll() {
+  if (!running) {
+    return;
+  }
+
+  unsigned long start_us = micros();
+
+  acceptClients();
+  for (Connection& conn : connections) {
+    if (conn.state == STATE_READING) {
+      readRequest(conn);
+    } else if (conn.state == STATE_SENDING) {
+      send(conn);
+    }
+  }
+
+  uint32_t elapsed_us = micros() - start_us;
+  if (elapsed_us > max_poll_us) {
+    max_poll_us = elapsed_us;
+  }
+}
+
+void HttpServer::acceptClients() {
+  for (Connection& conn : connections) {
+    if (conn.state != STATE_FREE) {
+      continue;
+    }
+
+    // 空きがない間は接続をOSのバックログに待たせる
+    NetClient* client = net->accept();
+    if (client == nullptr) {
+      return;
+    }
+    conn.client = client;
+    conn.state = STATE_READING;
+    conn.last_activity = millis();
+    conn.request_length = 0;
+    conn.request[0] = '\0';
+  }
+}
+
+void HttpServer::readRequest(Connection& conn) {
+  size_t space = REQUEST_BUFFER - 1 - conn.request_length;
+  int n = conn.client->read((uint8_t*)conn.request + conn.request_length, space);
+  if (n < 0) {
+    finish(conn);
+    return;
+  }
+  if (n > 0) {
+    conn.request_length += n;
+    conn.request[conn.request_length] = '\0';
+    conn.last_activity = millis();
+  }
+
+  // ヘッダーの終わりまで待つ（バッファが満杯ならリクエスト行だけで処理する）
+  bool complete = strstr(conn.request, "\r\n\r\n") != nullptr;
+  bool full = conn.request_length >= REQUEST_BUFFER - 1;
+  if (complete || (full && strstr(conn.request, "\r\n") != nullptr)) {
+    handleRequest(conn);
+  } else if (full) {
+    respond(conn, 400, "text/plain", "Request line too long\n");
+  } else if (millis() - conn.last_activity >= REQUEST_TIMEOUT) {
+    finish(conn);
+  }
+}
+
+void HttpServer::handleRequest(Connection& conn) {
+  requests++;
+
+  // Prometheusは Accept ヘッダーでOpenMetricsを要求する
+  bool openmetrics = strstr(conn.request, "application/openmetrics-text") != nullptr;
+
+  // リクエスト行 "GET /path?query HTTP/1.1"
+  *strstr(conn.request, "\r\n") = '\0';
+  char* method = conn.request;
+  char* target = strchr(method, ' ');
+  if (target == nullptr) {
+    respond(conn, 400, "text/plain", "Bad request\n");
+    return;
+  }
+  *target++ = '\0';
+  char* version = strchr(target, ' ');
+  if (version != nullptr) {
+    *version = '\0';
+  }
+
+  if (strcmp(method, "GET") != 0) {
+    respond(conn, 405, "text/plain", "Only GET is supported\n");
+    return;
+  }
+
+  char* query = strchr(target, '?');
+  if (query != nullptr) {
+    *query++ = '\0';
+  } else {
+    query = target + strlen(target);
+  }
+
+  char format[12] = "";
+  queryValue(query, "format", format, sizeof(format));
+  if (strcmp(format, "openmetrics") == 0) {
+    openmetrics = true;
+  }
+
+  if (strcmp(target, "/metrics") == 0 && openmetrics && page_encoder != nullptr) {
+    respondOpenMetrics(conn);
+  } else if (strcmp(target, "/metrics") == 0) {
+    respondMetrics(conn);
+  } else if (strcmp(target, "/history") == 0) {
+    startHistory(conn, query);
+  } else {
+    respond(conn, 404, "text/plain", "Not found (try /metrics or /history)\n");
+  }
+}
+
+void HttpServer::respond(Connection& conn, int status, const char* content_type, const char* body) {
+  if (status != 200) {
+    errors++;
+  }
+
+  int length = snprintf(conn.response, RESPONSE_BUFFER,
+                        "HTTP/1.1 %d %s\r\n"
+                        "Content-Type: %s\r\n"
+                        "Content-Length: %u\r\n"
+                        "Access-Control-Allow-Origin: *\r\n"
+                        "Connection: close\r\n"
+                        "\r\n"
+                        "%s",
+                        status, statusText(status), content_type, (unsigned)strlen(body), body);
+  conn.response_length = (size_t)length < RESPONSE_BUFFER ? length : RESPONSE_BUFFER - 1;
+  conn.response_sent = 0;
+  conn.body = nullptr;
+  conn.streaming = false;
+  conn.state = STATE_SENDING;
+  conn.last_activity = millis();
+}
+
+void HttpServer::respondMetrics(Connection& conn) {
+  const SensorSample& s = metrics.sample;
+  char body[448];
+  snprintf(body, sizeof(body),
+           "{\"uptime_ms\":%lu,\"time\":%lu,\"sensor_connected\":%s,"
+           "\"sample_time\":%lu,\"tvoc\":%u,\"eco2\":%u,\"raw_h2\":%u,\"raw_ethanol\":%u,"
+           "\"filtered\":{\"h2\":%u,\"ethanol\":%u,\"h2_rate\":%d,\"ethanol_rate\":%d,\"change\":%s},"
+           "\"baseline\":{\"eco2\":%u,\"tvoc\":%u},"
+           "\"clean_air\":{\"detected\":%s,\"remaining_s\":%u},"
+           "\"next\":%lu}\n",
+           (unsigned long)millis(), (unsigned long)metrics.sample_epoch,
+           metrics.sensor_connected ? "true" : "false",
+           (unsigned long)s.timestamp, s.tvoc, s.eco2, s.raw_h2, s.raw_ethanol,
+           s.h2_filtered, s.ethanol_filtered, s.h2_rate, s.ethanol_rate, s.signal_change ? "true" : "false",
+           s.eco2_base, s.tvoc_base,
+           s.clean_air_detected ? "true" : "false", s.clean_air_remaining,
+           (unsigned long)history->sequence());
+  respond(conn, 200, "application/json", body);
+}
+
+bool HttpServer::pageInUse() const {
+  for (const Connection& conn : connections) {
+    if (conn.state == STATE_SENDING && conn.body == page) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void HttpServer::respondOpenMetrics(Connection& conn) {
+  // 送信中のページがあればそれを共有する（最大でもpoll数回分の古さ）
+  if (!pageInUse()) {
+    page_length = page_encoder(page, PAGE_BUFFER, page_context);
+  }
+  if (page_length == 0) {
+    respond(conn, 500, "text/plain", "Metrics page too large\n");
+    return;
+  }
+
+  int length = snprintf(conn.response, RESPONSE_BUFFER,
+                        "HTTP/1.1 200 OK\r\n"
+                        "Content-Type: application/openmetrics-text; version=1.0.0; charset=utf-8\r\n"
+                        "Content-Length: %u\r\n"
+                        "Connection: close\r\n"
+                        "\r\n",
+                        (unsigned)page_length);
+  conn.response_length = length;
+  conn.response_sent = 0;
+  conn.body = page;
+  conn.body_length = page_length;
+  conn.body_sent = 0;
+  conn.streaming = false;
+  conn.state = STATE_SENDING;
+  conn.last_activity = millis();
+}
+
+void HttpServer::startHistory(Connection& conn, const char* query) {
+  uint32_t since = 0;
+  bool has_since = queryNumber(query, "since", &since);
+  conn.from = 0;
+  conn.to = UINT32_MAX;
+  conn.step = 1000;
+  queryNumber(query, "from", &conn.from);
+  queryNumber(query, "to", &conn.to);
+  queryNumber(query, "step", &conn.step);
+
+  char format[8] = "";
+  queryValue(query, "format", format, sizeof(format));
+  conn.csv = (strcmp(format, "csv") == 0);
+
+  // 間隔に合う最も粗い集計（1分未満は1秒ごとの履歴）
+  conn.source = SOURCE_RAW;
+  for (int8_t level = 0; level < TrendPyramid::LEVEL_COUNT; level++) {
+    if (sourcePeriod(level) <= conn.step) {
+      conn.source = level;
+    }
+  }
+
+  // 応答の範囲はリクエスト時点までに追加されたもの
+  uint32_t sequence = sourceSequence(conn.source);
+  uint32_t oldest = sourceOldest(conn.source);
+  conn.end = sequence;
+  conn.cursor = oldest;
+  if (has_since) {
+    conn.cursor = since < oldest ? oldest : (since > sequence ? sequence : since);
+  }
+  conn.started = false;
+  conn.first_item = true;
+  conn.next_time = 0;
+
+  int length = snprintf(conn.response, RESPONSE_BUFFER,
+                        "HTTP/1.1 200 OK\r\n"
+                        "Content-Type: %s\r\n"
+                        "Transfer-Encoding: chunked\r\n"
+                        "X-Next-Since: %lu\r\n"
+                        "Access-Control-Allow-Origin: *\r\n"
+                        "Connection: close\r\n"
+                        "\r\n",
+                        conn.csv ? "text/csv" : "application/json", (unsigned long)conn.end);
+  conn.response_length = length;
+  conn.response_sent = 0;
+  conn.streaming = true;
+  conn.state = STATE_SENDING;
+  conn.last_activity = millis();
+}
+
+bool HttpServer::fillChunk(Connection& conn) {
+  char* body = conn.response + CHUNK_PREFIX;
+  size_t capacity = RESPONSE_BUFFER - CHUNK_PREFIX - CHUNK_SUFFIX;
+  size_t length = 0;
+
+  if (!conn.started) {
+    if (conn.csv) {
+      length += snprintf(body, capacity, "timestamp,tvoc,eco2\n");
+    } else {
+      static const char* SOURCE_NAMES[] = { "minute", "quarter", "hour" };
+      length += snprintf(body, capacity, "{\"source\":\"%s\",\"period\":%lu,\"next\":%lu,\"samples\":[",
+                         conn.source == SOURCE_RAW ? "raw" : SOURCE_NAMES[conn.source],
+                         (unsigned long)sourcePeriod(conn.source), (unsigned long)conn.end);
+    }
+    conn.started = true;
+  }
+
+  // 送信中に上書きされた古いものは飛ばして、通し番号で位置を追う
+  uint32_t period = sourcePeriod(conn.source);
+  while (conn.cursor < conn.end && length + MAX_ITEM < capacity) {
+    uint32_t oldest = sourceSequence(conn.source) - sourceSize(conn.source);
+    if (conn.cursor < oldest) {
+      conn.cursor = oldest;
+      continue;
+    }
+
+    uint32_t timestamp;
+    uint16_t tvoc, eco2;
+    sourceAt(conn.source, conn.cursor - oldest, timestamp, tvoc, eco2);
+    conn.cursor++;
+
+    if (timestamp < conn.from) {
+      continue;
+    }
+    if (timestamp > conn.to) {
+      conn.cursor = conn.end;
+      break;
+    }
+    if (!conn.first_item && timestamp < conn.next_time) {
+      continue;
+    }
+
+    // 測定間隔の揺らぎで間引きすぎないよう周期の半分まで許容する
+    conn.next_time = timestamp + conn.step - period / 2;
+    if (conn.csv) {
+      length += snprintf(body + length, capacity - length, "%lu,%u,%u\n", (unsigned long)timestamp, tvoc, eco2);
+    } else {
+      length += snprintf(body + length, capacity - length, "%s[%lu,%u,%u]",
+                         conn.first_item ? "" : ",", (unsigned long)timestamp, tvoc, eco2);
+    }
+    conn.first_item = false;
+  }
+
+  bool done = conn.cursor >= conn.end;
+  if (done && !conn.csv) {
+    length += snprintf(body + length, capacity - length, "]}\n");
+  }
+
+  size_t total = 0;
+  if (length > 0) {
+    char prefix[CHUNK_PREFIX + 1];
+    snprintf(prefix, sizeof(prefix), "%04X\r\n", (unsigned)length);
+    memcpy(conn.response, prefix, CHUNK_PREFIX);
+    total = CHUNK_PREFIX + length;
+    memcpy(conn.response + total, "\r\n", 2);
+    total += 2;
+  }
+  if (done) {
+    memcpy(conn.response + total, "0\r\n\r\n", 5);
+    total += 5;
+    conn.streaming = false;
+  }
+
+  conn.response_length = total;
+  conn.response_sent = 0;
+  return true;
+}
+
+// data の未送信分を予算の範囲で送り、すべて送れたら true
+bool HttpServer::sendPart(Connection& conn, const char* data, size_t length, size_t& sent, size_t& budget) {
+  size_t pending = length - sent;
+  size_t chunk = pending < budget ? pending : budget;
+  size_t written = conn.client->write((const uint8_t*)data + sent, chunk);
+  sent += written;
+  budget -= written;
+  bytes_sent += written;
+  if (written > 0) {
+    conn.last_activity = millis();
+  }
+  return written == pending;
+}
+
+void HttpServer::send(Connection& conn) {
+  size_t budget = POLL_BUDGET;
+
+  while (budget > 0) {
+    // ヘッダー（またはチャンク）→ 共有のページ → 次のチャンクの順
+    if (conn.response_sent < conn.response_length) {
+      if (!sendPart(conn, conn.response, conn.response_length, conn.response_sent, budget)) {
+        break;   // 送信バッファが満杯か予算切れ
+      }
+      continue;
+    }
+    if (conn.body != nullptr && conn.body_sent < conn.body_length) {
+      if (!sendPart(conn, conn.body, conn.body_length, conn.body_sent, budget)) {
+        break;
+      }
+      continue;
+    }
+
+    if (!conn.streaming) {
+      finish(conn);
+      return;
+    }
+    fillChunk(conn);
+  }
+
+  if (!conn.client->connected() || millis() - conn.last_activity >= SEND_TIMEOUT) {
+    finish(conn);
+  }
+}
+
+void HttpServer::finish(Connection& conn) {
+  net->close(conn.client);
+  conn.client = nullptr;
+  conn.state = STATE_FREE;
+  conn.body = nullptr;
+}
+
+uint32_t HttpServer::sourceSequence(int8_t source) const {
+  return source == SOURCE_RAW ? history->sequence() : trend->level((TrendPyramid::Level)source).sequence();
+}
+
+uint32_t HttpServer::sourceSize(int8_t source) const {
+  return source == SOURCE_RAW ? history->size() : trend->level((TrendPyramid::Level)source).size();
+}
+
+uint32_t HttpServer::sourceOldest(int8_t source) const {
+  // 復元した分より後のもののみ
+  uint32_t oldest = sourceSequence(source) - sourceSize(source);
+  return oldest > restored[source + 1] ? oldest : restored[source + 1];
+}
+
+uint32_t HttpServer::sourcePeriod(int8_t source) const {
+  return source == SOURCE_RAW ? SensorManager::SENSOR_UPDATE_INTERVAL
+                              : trend->level((TrendPyramid::Level)source).period();
+}
+
+void HttpServer::sourceAt(int8_t source, size_t index, uint32_t& timestamp, uint16_t& tvoc, uint16_t& eco2) const {
+  if (source == SOURCE_RAW) {
+    timestamp = history->timestampAt(index);
+    tvoc = history->tvocAt(index);
+    eco2 = history->eco2At(index);
+    return;
+  }
+
+  const TrendBucket& bucket = trend->level((TrendPyramid::Level)source).at(index);
+  timestamp = bucket.timestamp;
+  tvoc = bucket.tvoc_mean;
+  eco2 = bucket.eco2_mean;
+}
+
+void HttpServer::logStats() {
+  if (!running) {
+    return;
+  }
+
+  uint8_t open = 0;
+  for (const Connection& conn : connections) {
+    if (conn.state != STATE_FREE) {
+      open++;
+    }
+  }
+
+  Serial.printf("HTTP: %lu requests, %lu errors, %lu bytes sent, %u open, max poll %lu us\n",
+                (unsigned long)requests, (unsigned long)errors, (unsigned long)bytes_sent,
+                open, (unsigned long)max_poll_us);
+  requests = 0;
+  errors = 0;
+  bytes_sent = 0;
+  max_poll_us = 0;
+}
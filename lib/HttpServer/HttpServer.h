@@ -0,0 +1,142 @@
+#ifndef HTTP_SERVER_H
+#define HTTP_SERVER_H
+
+#include <Hal.h>
+#include <SensorManager.h>
+#include <TrendPyramid.h>
+
+// /metrics の内容（新しいサンプルごとに描画タスクが更新）
+struct HttpMetrics {
+  SensorSample sample;      // 最新の測定
+  uint32_t sample_epoch;    // 測定時のUNIX時刻（0: 不明）
+  bool sensor_connected;
+};
+
+// OpenMetricsのページを buffer に書き込み、長さを返す（バッファ不足なら 0）
+typedef size_t (*MetricsPageEncoder)(char* buffer, size_t size, void* context);
+
+// 測定値を公開するHTTPサーバー（描画タスクの poll() で少しずつ処理する）
+//
+//   GET /metrics   最新の測定値・生信号（処理前後）・ベースライン・クリーンエア判定（JSON）
+//                  Accept: application/openmetrics-text（Prometheus）か ?format=openmetrics の場合は
+//                  setOpenMetrics() のページ（OpenMetricsのテキスト形式）
+//   GET /history   ?from=&to=  時刻の範囲 (ms、起動からの時間)
+//                  &step=      間隔 (ms)。1分未満は1秒ごとの履歴（直近300秒）、
+//                              以上は1分・15分・1時間の集計（平均値）から返す
+//                  &since=     前回の応答の next（以降に追加されたものだけを返す）
+//                  &format=csv CSVで返す（既定はJSON）
+//
+// 履歴はチャンク形式で送信バッファの空きに合わせて生成するので、応答全体をメモリに持たない
+class HttpServer {
+public:
+  static const uint16_t DEFAULT_PORT = 80;
+  static const uint8_t MAX_CONNECTIONS = 4;
+  static const size_t REQUEST_BUFFER = 512;
+  static const size_t RESPONSE_BUFFER = 640;
+  static const size_t PAGE_BUFFER = 16384;             // OpenMetricsのページ（センサー8台で約12KB）
+  static const size_t POLL_BUDGET = 2048;              // 1回のpoll()で1接続に送る最大バイト数
+  static const unsigned long REQUEST_TIMEOUT = 5000;   // リクエスト受信の期限 (ms)
+  static const unsigned long SEND_TIMEOUT = 10000;     // 送信が進まない場合の期限 (ms)
+
+  HttpServer();
+
+  void init(NetServer* net, const SensorHistory* history, const TrendPyramid* trend);
+  bool begin(uint16_t port);
+  bool isRunning() const { return running; }
+
+  void setMetrics(const HttpMetrics& metrics) { this->metrics = metrics; }
+  void setOpenMetrics(MetricsPageEncoder encoder, void* context);
+
+  // 現在の履歴を前回の起動から復元したものとして /history の対象から除く
+  // （復元した測定の時刻は起動後の時刻へずらした推定値のため）
+  void markRestored();
+
+  // 接続の受け付け・リクエストの読み取り・応答の送信（ブロックしない）
+  void poll();
+
+  // 前回の出力以降の統計をSerialへ出力
+  void logStats();
+
+private:
+  enum State : uint8_t {
+    STATE_FREE,
+    STATE_READING,
+    STATE_SENDING
+  };
+
+  // 履歴の取得元（TrendPyramid::Level または 1秒ごとの履歴）
+  static const int8_t SOURCE_RAW = -1;
+
+  struct Connection {
+    NetClient* client;
+    State state;
+    unsigned long last_activity;
+
+    char request[REQUEST_BUFFER];
+    size_t request_length;
+
+    char response[RESPONSE_BUFFER];
+    size_t response_length;
+    size_t response_sent;
+
+    // 応答の本文（response の後に送る共有のページ、なければ nullptr）
+    const char* body;
+    size_t body_length;
+    size_t body_sent;
+
+    // /history のストリーミング
+    bool streaming;
+    bool csv;
+    bool started;          // 先頭（JSONの開始・CSVの見出し）を送信済み
+    bool first_item;
+    int8_t source;
+    uint32_t cursor;       // 次に読む通し番号
+    uint32_t end;          // リクエスト時点の通し番号（これより前まで）
+    uint32_t from;
+    uint32_t to;
+    uint32_t step;
+    uint32_t next_time;    // 次に出力する時刻
+  };
+
+  NetServer* net;
+  const SensorHistory* history;
+  const TrendPyramid* trend;
+  HttpMetrics metrics;
+  bool running;
+  uint32_t restored[TrendPyramid::LEVEL_COUNT + 1];   // 復元した分の通し番号（[0] は測定、以降は各レベル）
+
+  // OpenMetricsのページ（送信中の接続がなくなるまで作り直さず、同時のスクレイプで共有する）
+  MetricsPageEncoder page_encoder;
+  void* page_context;
+  char page[PAGE_BUFFER];
+  size_t page_length;
+  Connection connections[MAX_CONNECTIONS];
+
+  // 統計
+  uint32_t requests;
+  uint32_t errors;
+  uint32_t bytes_sent;
+  uint32_t max_poll_us;
+
+  void acceptClients();
+  void readRequest(Connection& conn);
+  void handleRequest(Connection& conn);
+  void send(Connection& conn);
+  bool sendPart(Connection& conn, const char* data, size_t length, size_t& sent, size_t& budget);
+  void finish(Connection& conn);
+
+  void respond(Connection& conn, int status, const char* content_type, const char* body);
+  void respondMetrics(Connection& conn);
+  void respondOpenMetrics(Connection& conn);
+  bool pageInUse() const;
+  void startHistory(Connection& conn, const char* query);
+  bool fillChunk(Connection& conn);
+
+  uint32_t sourceSequence(int8_t source) const;
+  uint32_t sourceSize(int8_t source) const;
+  uint32_t sourceOldest(int8_t source) const;   // /history で返す最も古い通し番号
+  void sourceAt(int8_t source, size_t index, uint32_t& timestamp, uint16_t& tvoc, uint16_t& eco2) const;
+  uint32_t sourcePeriod(int8_t source) const;
+};
+
+#endif // HTTP_SERVER_H
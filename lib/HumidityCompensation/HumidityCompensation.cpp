@@ -0,0 +1,163 @@
+#include "HumidityCompensation.h"
+#include <math.h>
+
+// -40〜85 ℃の1 ℃ごとの飽和水蒸気量 (mg/m³)
+// 216.7 × 6.112 × exp(17.62 × T / (243.12 + T)) / (273.15 + T) × 1000
+static const int16_t TABLE_MIN = -40;
+static const int16_t TABLE_MAX = 85;
+static const uint32_t SATURATION[TABLE_MAX - TABLE_MIN + 1] = {
+  177, 195, 215, 237, 261, 287, 316, 347,
+  380, 417, 456, 499, 545, 595, 650, 708,
+  772, 840, 914, 993, 1078, 1170, 1269, 1375,
+  1489, 1611, 1741, 1882, 2032, 2192, 2364, 2547,
+  2743, 2952, 3174, 3412, 3665, 3934, 4220, 4525,
+  4849, 5193, 5558, 5945, 6356, 6792, 7253, 7741,
+  8258, 8805, 9383, 9994, 10639, 11320, 12039, 12797,
+  13597, 14439, 15326, 16260, 17243, 18277, 19364, 20507,
+  21707, 22968, 24291, 25680, 27136, 28663, 30264, 31941,
+  33697, 35535, 37459, 39471, 41576, 43775, 46074, 48475,
+  50983, 53600, 56332, 59181, 62152, 65250, 68478, 71841,
+  75343, 78990, 82785, 86734, 90842, 95113, 99553, 104168,
+  108962, 113941, 119111, 124478, 130048, 135826, 141819, 148033,
+  154475, 161150, 168066, 175230, 182649, 190328, 198277, 206502,
+  215010, 223809, 232907, 242312, 252032, 262075, 272449, 283162,
+  294224, 305643, 317427, 329587, 342130, 355066
+};
+
+uint32_t absoluteHumidity(int16_t temperature, uint16_t humidity) {
+  if (temperature < TABLE_MIN * 100) {
+    temperature = TABLE_MIN * 100;
+  } else if (temperature > TABLE_MAX * 100) {
+    temperature = TABLE_MAX * 100;
+  }
+  if (humidity > 10000) {
+    humidity = 10000;
+  }
+
+  uint32_t offset = (uint32_t)(temperature - TABLE_MIN * 100);
+  uint32_t index = offset / 100;
+  uint32_t fraction = offset % 100;
+  uint32_t saturation = SATURATION[index];
+  if (fraction > 0) {
+    saturation += (SATURATION[index + 1] - saturation) * fraction / 100;
+  }
+  // 最大 355066 × 10000 なので32ビットに収まる
+  return (saturation * humidity + 5000) / 10000;
+}
+
+double absoluteHumidityReference(double temperature_c, double humidity_percent) {
+  double vapor_pressure = humidity_percent / 100 * 6.112 * exp(17.62 * temperature_c / (243.12 + temperature_c));
+  return 216.7 * vapor_pressure / (273.15 + temperature_c) * 1000;
+}
+
+HumidityCompensation::HumidityCompensation() :
+  environment(nullptr),
+  source(nullptr),
+  sensor(nullptr),
+  started(false),
+  reading_valid(false),
+  failures(0),
+  temperature_value(0),
+  humidity_value(0),
+  absolute_value(0),
+  applied_value(0),
+  updates(0) {
+}
+
+void HumidityCompensation::init(EnvironmentSensor* environment_sensor, SensorDriver* gas_sensor) {
+  sensor = gas_sensor;
+  environment = environment_sensor;
+  source = nullptr;
+  started = false;
+  reading_valid = false;
+  failures = 0;
+  applied_value = 0;
+
+  if (environment != nullptr && !environment->begin()) {
+    Serial.println("Environment sensor not found, humidity compensation off");
+    environment = nullptr;
+  }
+}
+
+void HumidityCompensation::initShared(const HumidityCompensation* shared, SensorDriver* gas_sensor) {
+  sensor = gas_sensor;
+  environment = nullptr;
+  source = shared;
+  started = false;
+  reading_valid = false;
+  failures = 0;
+  applied_value = 0;
+}
+
+void HumidityCompensation::update() {
+  if (source != nullptr) {
+    updateShared();
+    return;
+  }
+  if (environment == nullptr) {
+    return;
+  }
+
+  // 前回開始した測定を読む
+  if (started) {
+    int16_t temperature_read;
+    uint16_t humidity_read;
+    if (environment->readMeasurement(&temperature_read, &humidity_read)) {
+      temperature_value = temperature_read;
+      humidity_value = humidity_read;
+      absolute_value = absoluteHumidity(temperature_read, humidity_read);
+      reading_valid = true;
+      failures = 0;
+      applyReading();
+    } else {
+      fail();
+    }
+  }
+
+  started = environment->startMeasurement();
+  if (!started) {
+    fail();
+  }
+}
+
+void HumidityCompensation::updateShared() {
+  // 共有元が補正を止めたら（読めなくなったら）こちらも止める
+  if (!source->reading_valid) {
+    if (reading_valid || applied_value != 0) {
+      reading_valid = false;
+      apply(0);
+    }
+    return;
+  }
+  temperature_value = source->temperature_value;
+  humidity_value = source->humidity_value;
+  absolute_value = source->absolute_value;
+  reading_valid = true;
+  applyReading();
+}
+
+void HumidityCompensation::applyReading() {
+  uint32_t difference = absolute_value > applied_value ? absolute_value - applied_value : applied_value - absolute_value;
+  if (applied_value == 0 || difference >= DEADBAND) {
+    apply(absolute_value);
+  }
+}
+
+void HumidityCompensation::fail() {
+  if (failures >= MAX_FAILURES || ++failures < MAX_FAILURES) {
+    return;
+  }
+  Serial.println("Environment sensor not responding, humidity compensation off");
+  reading_valid = false;
+  apply(0);
+}
+
+void HumidityCompensation::apply(uint32_t value) {
+  // 0 は補正なし（SGP30の仕様）
+  value = value < MAX_HUMIDITY ? value : MAX_HUMIDITY;
+  if (!sensor->setHumidity(value)) {
+    return;
+  }
+  applied_value = value;
+  updates++;
+}
@@ -0,0 +1,66 @@
+#ifndef HUMIDITY_COMPENSATION_H
+#define HUMIDITY_COMPENSATION_H
+
+#include <Hal.h>
+
+// 絶対湿度 (mg/m³)
+// temperature: 0.01 ℃（-40〜85 ℃、範囲外は端の値）、humidity: 0.01 %RH
+// 1 ℃ごとの飽和水蒸気量の表を線形補間する（exp() を使わない、Magnusの式との差は 0.2 % 以内）
+uint32_t absoluteHumidity(int16_t temperature, uint16_t humidity);
+
+// 同じ式（Magnusの式）の浮動小数点版（表の確認用）
+double absoluteHumidityReference(double temperature_c, double humidity_percent);
+
+// SGP30の湿度補正（センサータスクで使用）
+//
+// 温湿度センサーの測定を MEASURE_INTERVAL ごとに読み（読んだら次の測定を開始するので待たない）、
+// 絶対湿度が SGP30 に設定した値から DEADBAND 以上変わった場合のみ setHumidity() で設定する。
+// MAX_FAILURES 回続けて読めなければ補正を止める（古い湿度で補正し続けない）
+// 温湿度センサーを複数のSGP30で共有する場合は、1つが温湿度センサーを読み、他はその測定を使う（initShared()）
+class HumidityCompensation {
+public:
+  static const unsigned long MEASURE_INTERVAL = 2000;   // 測定間隔 (ms)
+  static const uint32_t DEADBAND = 250;                 // 設定し直す絶対湿度の差 (mg/m³)
+  static const uint32_t MAX_HUMIDITY = 255996;          // setHumidity() の上限（8.8固定小数点の g/m³）
+  static const uint8_t MAX_FAILURES = 5;
+
+  HumidityCompensation();
+
+  // environment: 温湿度センサー（nullptr なら補正しない）
+  void init(EnvironmentSensor* environment, SensorDriver* sensor);
+  // source の測定で sensor を補正する（温湿度センサーは読まない、source の update() の後に update() を呼ぶ）
+  void initShared(const HumidityCompensation* source, SensorDriver* sensor);
+  bool isEnabled() const { return environment != nullptr || source != nullptr; }
+
+  // MEASURE_INTERVAL ごとに呼び出す
+  void update();
+
+  // 直近の測定（hasReading() が false なら未測定・読み取り失敗中）
+  bool hasReading() const { return reading_valid; }
+  int16_t temperature() const { return temperature_value; }
+  uint16_t humidity() const { return humidity_value; }
+  uint32_t absolute() const { return absolute_value; }
+  // SGP30に設定中の絶対湿度（0: 補正なし）
+  uint32_t applied() const { return applied_value; }
+  uint32_t updateCount() const { return updates; }
+
+private:
+  EnvironmentSensor* environment;
+  const HumidityCompensation* source;   // 測定を共有する元（nullptr: 自分で読む）
+  SensorDriver* sensor;
+  bool started;               // 測定を開始済み
+  bool reading_valid;
+  uint8_t failures;           // 続けて読めなかった回数
+  int16_t temperature_value;
+  uint16_t humidity_value;
+  uint32_t absolute_value;
+  uint32_t applied_value;
+  uint32_t updates;
+
+  void fail();
+  void apply(uint32_t value);
+  void applyReading();
+  void updateShared();
+};
+
+#endif // HUMIDITY_COMPENSATION_H
@@ -0,0 +1,228 @@
+#include "LcdRenderer.h"
+
+// GLCDフォントの1文字あたりのサイズ（倍率1）
+static const int GLYPH_WIDTH = 6;
+static const int GLYPH_HEIGHT = 8;
+
+LcdRenderer::LcdRenderer() :
+  lcd(nullptr),
+  glyphs(nullptr),
+  region_count(0),
+  frame_bytes(0),
+  frame_transactions(0),
+  last_frame_bytes(0),
+  last_frame_transactions(0),
+  total_bytes(0),
+  total_transactions(0),
+  interval_bytes(0),
+  interval_transactions(0),
+  interval_frames(0),
+  interval_max_bytes(0) {
+}
+
+void LcdRenderer::init(Display* display) {
+  lcd = display;
+}
+
+void LcdRenderer::beginFrame() {
+  frame_bytes = 0;
+  frame_transactions = 0;
+}
+
+void LcdRenderer::endFrame() {
+  // 描画のあったフレームのみ集計
+  if (frame_transactions > 0) {
+    last_frame_bytes = frame_bytes;
+    last_frame_transactions = frame_transactions;
+    interval_bytes += frame_bytes;
+    interval_transactions += frame_transactions;
+    interval_frames++;
+    if (frame_bytes > interval_max_bytes) {
+      interval_max_bytes = frame_bytes;
+    }
+  }
+}
+
+void LcdRenderer::logStats() {
+  if (interval_frames == 0) {
+    return;
+  }
+
+  Serial.printf("LCD SPI: %lu frames, avg %lu bytes / %lu transactions per frame, max %lu bytes\n",
+                (unsigned long)interval_frames,
+                (unsigned long)(interval_bytes / interval_frames),
+                (unsigned long)(interval_transactions / interval_frames),
+                (unsigned long)interval_max_bytes);
+
+  interval_bytes = 0;
+  interval_transactions = 0;
+  interval_frames = 0;
+  interval_max_bytes = 0;
+}
+
+int LcdRenderer::registerRegion(int16_t x, int16_t y, int16_t w, int16_t h) {
+  if (region_count >= MAX_REGIONS) {
+    return -1;
+  }
+
+  // 未描画の領域は最初に必ず描画させる
+  regions[region_count] = { x, y, w, h, true };
+  return region_count++;
+}
+
+void LcdRenderer::invalidate(int16_t x, int16_t y, int16_t w, int16_t h) {
+  for (int i = 0; i < region_count; i++) {
+    Region& r = regions[i];
+    if (x < r.x + r.w && r.x < x + w && y < r.y + r.h && r.y < y + h) {
+      r.damaged = true;
+    }
+  }
+}
+
+void LcdRenderer::invalidateAll() {
+  for (int i = 0; i < region_count; i++) {
+    regions[i].damaged = true;
+  }
+}
+
+bool LcdRenderer::consumeDamage(int region) {
+  if (region < 0 || region >= region_count) {
+    return true;
+  }
+
+  bool damaged = regions[region].damaged;
+  regions[region].damaged = false;
+  return damaged;
+}
+
+bool LcdRenderer::isDamaged(int region) const {
+  if (region < 0 || region >= region_count) {
+    return true;
+  }
+  return regions[region].damaged;
+}
+
+void LcdRenderer::account(uint32_t pixels, uint32_t transactions) {
+  // 1トランザクションごとにアドレスウィンドウ設定 + 16bit/ピクセル
+  uint32_t bytes = transactions * WINDOW_BYTES + pixels * 2;
+  frame_bytes += bytes;
+  frame_transactions += transactions;
+  total_bytes += bytes;
+  total_transactions += transactions;
+}
+
+void LcdRenderer::fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+  lcd->fillRect(x, y, w, h, color);
+  account((uint32_t)w * h, 1);
+}
+
+void LcdRenderer::clear(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+  // 他の所有者の領域を消去するため、重なる領域を再描画対象にする
+  fillRect(x, y, w, h, color);
+  invalidate(x, y, w, h);
+}
+
+void LcdRenderer::drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color) {
+  lcd->drawLine(x0, y0, x1, y1, color);
+
+  int16_t dx = abs(x1 - x0);
+  int16_t dy = abs(y1 - y0);
+  if (dx == 0 || dy == 0) {
+    // 水平・垂直線は1回のウィンドウ転送
+    account(dx + dy + 1, 1);
+  } else {
+    // 斜め線はピクセルごとのウィンドウ転送
+    uint32_t pixels = (dx > dy ? dx : dy) + 1;
+    account(pixels, pixels);
+  }
+}
+
+void LcdRenderer::drawRoundRect(int16_t x, int16_t y, int16_t w, int16_t h, int16_t r, uint16_t color) {
+  lcd->drawRoundRect(x, y, w, h, r, color);
+
+  // 4辺の直線 + 角のピクセル
+  account(2 * (w - 2 * r) + 2 * (h - 2 * r), 4);
+  account(4 * r, 4 * r);
+}
+
+void LcdRenderer::drawText(int16_t x, int16_t y, const char* text, uint8_t size, uint16_t color, uint16_t bg_color) {
+  uint32_t glyph_pixels = (uint32_t)GLYPH_WIDTH * size * GLYPH_HEIGHT * size;
+  uint32_t length = strlen(text);
+
+  // 背景色付きで描画するので事前の消去は不要
+  if (glyphs != nullptr && glyphs->covers(text, length)) {
+    int transfers = glyphs->blit(*lcd, x, y, text, length, size, color, bg_color);
+    if (transfers > 0) {
+      account(glyph_pixels * length, transfers);
+      return;
+    }
+  }
+  lcd->drawText(x, y, text, size, color, bg_color);
+  account(glyph_pixels * length, length);
+}
+
+void LcdRenderer::pushCanvas(Canvas& canvas, int16_t x, int16_t y) {
+  lcd->pushCanvas(canvas, x, y);
+  account((uint32_t)canvas.width() * canvas.height(), 1);
+}
+
+Canvas* LcdRenderer::createCanvas(int16_t w, int16_t h, uint8_t color_depth) {
+  return lcd->createCanvas(w, h, color_depth);
+}
+
+void LcdRenderer::destroyCanvas(Canvas* canvas) {
+  if (canvas != nullptr) {
+    lcd->destroyCanvas(canvas);
+  }
+}
+
+void LcdRenderer::initTextField(LcdTextField& field, int16_t x, int16_t y, uint8_t size, uint16_t color, uint16_t bg_color) {
+  field.x = x;
+  field.y = y;
+  field.size = size;
+  field.color = color;
+  field.bg_color = bg_color;
+  resetTextField(field);
+}
+
+void LcdRenderer::resetTextField(LcdTextField& field) {
+  field.length = 0;
+  field.text[0] = '\0';
+}
+
+void LcdRenderer::drawTextRun(LcdTextField& field, int start, const char* text, int length) {
+  char run[LcdTextField::MAX_LENGTH + 1];
+  memcpy(run, text + start, length);
+  run[length] = '\0';
+  drawText(field.x + start * GLYPH_WIDTH * field.size, field.y, run, field.size, field.color, field.bg_color);
+}
+
+void LcdRenderer::drawTextDiff(LcdTextField& field, const char* text) {
+  int new_length = strlen(text);
+  if (new_length > LcdTextField::MAX_LENGTH) {
+    new_length = LcdTextField::MAX_LENGTH;
+  }
+
+  // 前回と異なる文字の連続区間ごとに描画
+  int run_start = -1;
+  for (int i = 0; i <= new_length; i++) {
+    bool changed = (i < new_length) && (i >= field.length || text[i] != field.text[i]);
+    if (changed && run_start < 0) {
+      run_start = i;
+    } else if (!changed && run_start >= 0) {
+      drawTextRun(field, run_start, text, i - run_start);
+      run_start = -1;
+    }
+  }
+
+  // 短くなった分の末尾を消去
+  if (new_length < field.length) {
+    int cell_width = GLYPH_WIDTH * field.size;
+    fillRect(field.x + new_length * cell_width, field.y,
+             (field.length - new_length) * cell_width, GLYPH_HEIGHT * field.size, field.bg_color);
+  }
+
+  memcpy(field.text, text, new_length);
+  field.text[new_length] = '\0';
+  field.length = new_length;
+}
@@ -0,0 +1,102 @@
+#ifndef LCD_RENDERER_H
+#define LCD_RENDERER_H
+
+#include <Hal.h>
+#include <GlyphCache.h>
+
+// 差分描画用のテキストフィールド（GLCDフォント固定幅）
+struct LcdTextField {
+  static const int MAX_LENGTH = 40;
+
+  int16_t x;
+  int16_t y;
+  uint8_t size;
+  uint16_t color;
+  uint16_t bg_color;
+  uint8_t length;                // 画面上に描画済みの文字数
+  char text[MAX_LENGTH + 1];     // 画面上に描画済みの文字列
+};
+
+// 画面更新の差分管理とSPI転送量の計測を行う描画レイヤー
+class LcdRenderer {
+public:
+  static const int MAX_REGIONS = 16;
+
+  LcdRenderer();
+
+  void init(Display* display);
+  // 字形のキャッシュ（全文字がキャッシュにある文字列はフォントを通さず1回の転送で描画）
+  void setGlyphCache(GlyphCache* cache) { glyphs = cache; }
+  const GlyphCache* glyphCache() const { return glyphs; }
+
+  // フレーム境界（フレームごとのSPI転送量を集計）
+  void beginFrame();
+  void endFrame();
+
+  // 領域の登録と再描画判定
+  int registerRegion(int16_t x, int16_t y, int16_t w, int16_t h);
+  void invalidate(int16_t x, int16_t y, int16_t w, int16_t h);
+  void invalidateAll();
+  bool consumeDamage(int region);
+  bool isDamaged(int region) const;
+
+  // 描画（SPI転送量を計上）
+  void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+  void clear(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+  void drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color);
+  void drawRoundRect(int16_t x, int16_t y, int16_t w, int16_t h, int16_t r, uint16_t color);
+  void drawText(int16_t x, int16_t y, const char* text, uint8_t size, uint16_t color, uint16_t bg_color);
+  void pushCanvas(Canvas& canvas, int16_t x, int16_t y);
+
+  // オフスクリーンキャンバスの確保（RAM不足時は nullptr）と解放
+  Canvas* createCanvas(int16_t w, int16_t h, uint8_t color_depth);
+  void destroyCanvas(Canvas* canvas);
+
+  // 変化した文字だけを描画
+  void initTextField(LcdTextField& field, int16_t x, int16_t y, uint8_t size, uint16_t color, uint16_t bg_color);
+  void resetTextField(LcdTextField& field);
+  void drawTextDiff(LcdTextField& field, const char* text);
+
+  // SPI統計（getFrameBytes は描画のなかったフレームも含む直近フレームの転送量）
+  uint32_t getFrameBytes() const { return frame_bytes; }
+  uint32_t getLastFrameBytes() const { return last_frame_bytes; }
+  uint32_t getLastFrameTransactions() const { return last_frame_transactions; }
+  uint32_t getTotalBytes() const { return total_bytes; }
+  uint32_t getTotalTransactions() const { return total_transactions; }
+
+  // 前回の出力以降のSPI統計をSerialへ出力
+  void logStats();
+
+private:
+  static const uint32_t WINDOW_BYTES = 11;           // CASET/RASET/RAMWR コマンドとパラメータ
+
+  struct Region {
+    int16_t x;
+    int16_t y;
+    int16_t w;
+    int16_t h;
+    bool damaged;
+  };
+
+  Display* lcd;
+  GlyphCache* glyphs;
+  Region regions[MAX_REGIONS];
+  int region_count;
+
+  // SPI統計
+  uint32_t frame_bytes;
+  uint32_t frame_transactions;
+  uint32_t last_frame_bytes;
+  uint32_t last_frame_transactions;
+  uint32_t total_bytes;
+  uint32_t total_transactions;
+  uint32_t interval_bytes;
+  uint32_t interval_transactions;
+  uint32_t interval_frames;
+  uint32_t interval_max_bytes;
+
+  void account(uint32_t pixels, uint32_t transactions);
+  void drawTextRun(LcdTextField& field, int start, const char* text, int length);
+};
+
+#endif // LCD_RENDERER_H
@@ -0,0 +1,116 @@
+#include "LoopProfiler.h"
+
+#ifndef ARDUINO
+#include <chrono>
+#endif
+
+LoopProfiler::LoopProfiler(const char* const* names, uint8_t count) :
+  names(names),
+  phase_count(count < MAX_PHASES ? count : MAX_PHASES),
+  reset_at(0),
+  reset_pending(0),
+  phases() {
+}
+
+#ifdef ARDUINO
+uint32_t LoopProfiler::cycles() {
+  return ESP.getCycleCount();
+}
+
+uint32_t LoopProfiler::cyclesToNanos(uint32_t cycles) {
+  return (uint32_t)((uint64_t)cycles * 1000 / getCpuFrequencyMhz());
+}
+#else
+uint32_t LoopProfiler::cycles() {
+  return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint32_t LoopProfiler::cyclesToNanos(uint32_t cycles) {
+  return cycles;
+}
+#endif
+
+uint8_t LoopProfiler::bucketIndex(uint32_t nanos) {
+  if (nanos < (1UL << MIN_SHIFT)) {
+    return 0;
+  }
+  // 最上位ビットでオクターブ、その下の2ビットでオクターブ内の位置
+  uint8_t msb = 31 - __builtin_clz(nanos);
+  uint8_t sub = (nanos >> (msb - 2)) & (SUB_BUCKETS - 1);
+  return 1 + (msb - MIN_SHIFT) * SUB_BUCKETS + sub;
+}
+
+uint32_t LoopProfiler::bucketUpper(uint8_t index) {
+  if (index == 0) {
+    return 1UL << MIN_SHIFT;
+  }
+  uint8_t msb = MIN_SHIFT + (index - 1) / SUB_BUCKETS;
+  uint8_t sub = (index - 1) % SUB_BUCKETS;
+  uint64_t upper = (uint64_t)(SUB_BUCKETS + sub + 1) << (msb - 2);
+  return upper > UINT32_MAX ? UINT32_MAX : (uint32_t)upper;
+}
+
+void LoopProfiler::record(uint8_t phase, uint32_t elapsed_cycles) {
+  if (phase >= phase_count) {
+    return;
+  }
+  uint32_t nanos = cyclesToNanos(elapsed_cycles);
+  Phase& stats = phases[phase];
+  // 消去は記録するタスクだけが行う（他のタスクの reset() と書き込みが重ならない）
+  uint8_t bit = 1u << phase;
+  if (reset_pending.load() & bit) {
+    memset(&stats, 0, sizeof(stats));
+    reset_pending.fetch_and((uint8_t)~bit);
+  }
+  stats.buckets[bucketIndex(nanos)]++;
+  stats.count++;
+  stats.total_ns += nanos;
+  if (nanos > stats.max_ns) {
+    stats.max_ns = nanos;
+    stats.max_at = millis();
+  }
+}
+
+void LoopProfiler::reset() {
+  reset_at = millis();
+  reset_pending.store((uint8_t)((1u << phase_count) - 1));
+}
+
+uint32_t LoopProfiler::percentile(uint8_t phase, uint8_t percent) const {
+  const Phase& stats = phases[phase];
+  if (stats.count == 0 || resetPending(phase)) {
+    return 0;
+  }
+  // 小さい方から数えて count × percent / 100 件目（切り上げ）を含むバケット
+  uint32_t rank = (uint32_t)(((uint64_t)stats.count * percent + 99) / 100);
+  uint32_t seen = 0;
+  for (uint8_t i = 0; i < BUCKET_COUNT; i++) {
+    seen += stats.buckets[i];
+    if (seen >= rank && seen > 0) {
+      uint32_t upper = bucketUpper(i);
+      return upper < stats.max_ns ? upper : stats.max_ns;
+    }
+  }
+  return stats.max_ns;
+}
+
+void LoopProfiler::dump() const {
+#if LOOP_PROFILER
+  Serial.printf("Loop profile since %lu ms (us):\n", (unsigned long)reset_at);
+  Serial.printf("  %-12s %8s %9s %9s %9s %9s  %s\n", "phase", "count", "mean", "p50", "p99", "max", "max at");
+  for (uint8_t i = 0; i < phase_count; i++) {
+    if (resetPending(i)) {
+      Serial.printf("  %-12s %8lu\n", names[i], 0UL);
+      continue;
+    }
+    const Phase& stats = phases[i];
+    Serial.printf("  %-12s %8lu %9.1f %9.1f %9.1f %9.1f  %lu ms\n", names[i], (unsigned long)stats.count,
+                  stats.count > 0 ? stats.total_ns / 1000.0 / stats.count : 0.0,
+                  percentile(i, 50) / 1000.0, percentile(i, 99) / 1000.0, stats.max_ns / 1000.0,
+                  (unsigned long)stats.max_at);
+  }
+#else
+  Serial.println("Loop profiler disabled (LOOP_PROFILER=0)");
+#endif
+}
@@ -0,0 +1,90 @@
+#ifndef LOOP_PROFILER_H
+#define LOOP_PROFILER_H
+
+#include <Hal.h>
+#include <atomic>
+
+// 区間ごとの処理時間の計測（0: プローブをすべて取り除く）
+#ifndef LOOP_PROFILER
+#define LOOP_PROFILER 1
+#endif
+
+// 区間ごとの処理時間の分布と最悪値（ヒープ確保なし）
+//
+// 実機はCPUのサイクルカウンタ、ネイティブ環境は std::chrono::steady_clock（実時間）で測る。
+// 低消費電力モードでCPUの周波数が変わるので、記録するたびにその時点の周波数で ns に換算する。
+// 分布は対数の固定バケット（1オクターブを4分割、64 ns〜4.3 s）で、百分位数はバケットの上限を返すので実際より最大25%大きい。
+// 各区間は1つのタスクだけが記録する（別のタスクから dump() すると記録中の1件がずれることがある）。
+// reset() は区間ごとに消去を要求するだけで、消去は記録するタスクが次の record() で行う
+class LoopProfiler {
+public:
+  static const uint8_t MAX_PHASES = 8;
+  static const uint8_t SUB_BUCKETS = 4;        // 1オクターブの分割数
+  static const uint8_t MIN_SHIFT = 6;          // 最初のオクターブ（2^6 ns）
+  static const uint8_t BUCKET_COUNT = 1 + (32 - MIN_SHIFT) * SUB_BUCKETS;   // 先頭は 2^MIN_SHIFT ns 未満
+
+  // names: 区間の名前（文字列リテラル、count 個）
+  LoopProfiler(const char* const* names, uint8_t count);
+
+  // 現在のサイクル数（ネイティブ環境は ns）
+  static uint32_t cycles();
+  // サイクル数の差を ns に換算
+  static uint32_t cyclesToNanos(uint32_t cycles);
+
+  void record(uint8_t phase, uint32_t elapsed_cycles);
+  // すべての区間の消去を要求する（どのタスクからでも呼べる、消去までの区間は空として扱う）
+  void reset();
+
+  // 区間ごとの件数・p50・p99・最大（時刻）をSerialへ出力
+  void dump() const;
+
+  uint32_t count(uint8_t phase) const { return resetPending(phase) ? 0 : phases[phase].count; }
+  // 百分位数 (ns、バケットの上限、最大値を超えない)
+  uint32_t percentile(uint8_t phase, uint8_t percent) const;
+  uint32_t maxNanos(uint8_t phase) const { return resetPending(phase) ? 0 : phases[phase].max_ns; }
+
+private:
+  struct Phase {
+    uint32_t buckets[BUCKET_COUNT];
+    uint32_t count;
+    uint64_t total_ns;
+    uint32_t max_ns;
+    uint32_t max_at;       // 最大を記録した時刻 (ms)
+  };
+
+  const char* const* names;
+  uint8_t phase_count;
+  uint32_t reset_at;       // 集計の開始時刻 (ms)
+  std::atomic<uint8_t> reset_pending;   // 消去を要求された区間（ビットごと）
+  Phase phases[MAX_PHASES];
+
+  bool resetPending(uint8_t phase) const { return (reset_pending.load() & (1u << phase)) != 0; }
+
+  static uint8_t bucketIndex(uint32_t nanos);
+  static uint32_t bucketUpper(uint8_t index);
+};
+
+// スコープの終わりまでの処理時間を記録する
+class ProfileProbe {
+public:
+  ProfileProbe(LoopProfiler& profiler, uint8_t phase) :
+    profiler(profiler), phase(phase), start(LoopProfiler::cycles()) {}
+  ~ProfileProbe() { profiler.record(phase, LoopProfiler::cycles() - start); }
+
+private:
+  LoopProfiler& profiler;
+  uint8_t phase;
+  uint32_t start;
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+
+// スコープの処理時間を phase として記録（LOOP_PROFILER が 0 なら何もしない）
+#if LOOP_PROFILER
+#define PROFILE_SCOPE(profiler, phase) ProfileProbe PROFILE_CONCAT(profile_probe_, __LINE__)(profiler, phase)
+#else
+#define PROFILE_SCOPE(profiler, phase) do {} while (0)
+#endif
+
+#endif // LOOP_PROFILER_H
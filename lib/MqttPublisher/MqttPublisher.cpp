@@ -0,0 +1,390 @@
+#include "MqttPublisher.h"
+
+// MQTT 3.1.1 のパケット種別（固定ヘッダーの上位4ビット）
+static const uint8_t MQTT_CONNECT = 0x10;
+static const uint8_t MQTT_CONNACK = 0x20;
+static const uint8_t MQTT_PUBLISH_QOS1 = 0x32;
+static const uint8_t MQTT_PUBACK = 0x40;
+static const uint8_t MQTT_PINGREQ = 0xC0;
+static const uint8_t MQTT_PINGRESP = 0xD0;
+
+// PUBACKまでの時間 (us)
+static const uint32_t LATENCY_BUCKETS_US[] = {
+  5000, 10000, 25000, 50000, 100000, 250000, 500000, 1000000, 2500000, 5000000, 10000000
+};
+
+static void putU16(uint8_t* p, uint16_t value) {
+  p[0] = value & 0xFF;
+  p[1] = value >> 8;
+}
+
+static void putU32(uint8_t* p, uint32_t value) {
+  putU16(p, value & 0xFFFF);
+  putU16(p + 2, value >> 16);
+}
+
+static uint16_t getU16(const uint8_t* p) {
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t getU32(const uint8_t* p) {
+  return getU16(p) | ((uint32_t)getU16(p + 2) << 16);
+}
+
+// MQTTの文字列・パケットIDはビッグエンディアン
+static uint8_t* putMqttU16(uint8_t* p, uint16_t value) {
+  p[0] = value >> 8;
+  p[1] = value & 0xFF;
+  return p + 2;
+}
+
+static uint8_t* putMqttString(uint8_t* p, const char* text) {
+  size_t length = strlen(text);
+  p = putMqttU16(p, (uint16_t)length);
+  memcpy(p, text, length);
+  return p + length;
+}
+
+size_t encodeSampleBatch(const QueuedSample* samples, uint8_t count, uint8_t* buffer, size_t size) {
+  size_t length = MQTT_BATCH_HEADER + (size_t)count * QUEUED_SAMPLE_SIZE;
+  if (length > size) {
+    return 0;
+  }
+
+  buffer[0] = MQTT_BATCH_VERSION;
+  buffer[1] = count;
+  putU16(buffer + 2, 0);
+  uint8_t* p = buffer + MQTT_BATCH_HEADER;
+  for (uint8_t i = 0; i < count; i++) {
+    putU32(p, samples[i].epoch);
+    putU32(p + 4, samples[i].timestamp);
+    putU16(p + 8, samples[i].tvoc);
+    putU16(p + 10, samples[i].eco2);
+    p += QUEUED_SAMPLE_SIZE;
+  }
+  return length;
+}
+
+int decodeSampleBatch(const uint8_t* payload, size_t length, QueuedSample* samples, size_t max) {
+  if (length < MQTT_BATCH_HEADER || payload[0] != MQTT_BATCH_VERSION) {
+    return -1;
+  }
+  uint8_t count = payload[1];
+  if (length != MQTT_BATCH_HEADER + (size_t)count * QUEUED_SAMPLE_SIZE || count > max) {
+    return -1;
+  }
+
+  const uint8_t* p = payload + MQTT_BATCH_HEADER;
+  for (uint8_t i = 0; i < count; i++) {
+    samples[i].epoch = getU32(p);
+    samples[i].timestamp = getU32(p + 4);
+    samples[i].tvoc = getU16(p + 8);
+    samples[i].eco2 = getU16(p + 10);
+    p += QUEUED_SAMPLE_SIZE;
+  }
+  return count;
+}
+
+MqttPublisher::MqttPublisher() :
+  net(nullptr),
+  queue(nullptr),
+  config(),
+  client(nullptr),
+  state(STATE_DISCONNECTED),
+  state_time(0),
+  retry_delay(RETRY_MIN),
+  next_attempt(0),
+  tx_length(0),
+  tx_sent(0),
+  last_send(0),
+  rx_length(0),
+  in_flight(false),
+  packet_id(0),
+  batch_count(0),
+  publish_time(0),
+  last_publish(0),
+  published_samples(0),
+  interval_batches(0),
+  interval_samples(0),
+  max_latency_us(0),
+  publish_latency(LATENCY_BUCKETS_US, sizeof(LATENCY_BUCKETS_US) / sizeof(LATENCY_BUCKETS_US[0])) {
+}
+
+void MqttPublisher::init(NetConnector* connector, ForwardQueue* forward_queue, const MqttConfig& mqtt_config) {
+  net = connector;
+  queue = forward_queue;
+  config = mqtt_config;
+  Serial.printf("MQTT: publishing to %s:%u topic %s every %u s\n",
+                config.host, config.port, config.topic, config.publish_interval);
+}
+
+void MqttPublisher::poll(bool network_up) {
+  if (net == nullptr) {
+    return;
+  }
+
+  unsigned long now = millis();
+  if (!network_up) {
+    if (state != STATE_DISCONNECTED) {
+      disconnect("network down");
+    }
+    // WiFiが戻ったらすぐに接続する
+    retry_delay = RETRY_MIN;
+    next_attempt = now;
+    return;
+  }
+
+  if (state == STATE_DISCONNECTED) {
+    if ((long)(now - next_attempt) >= 0) {
+      connect();
+    }
+    return;
+  }
+
+  // 接続の確立はジョブの周期ごとに確かめ、待たない
+  if (state == STATE_OPENING) {
+    NetConnectStatus status = net->pollConnect(client);
+    if (status == NET_CONNECT_DONE) {
+      sendConnect();
+    } else if (status == NET_CONNECT_FAILED || now - state_time >= CONNECT_TIMEOUT) {
+      connectFailed();
+    }
+    return;
+  }
+
+  receive();
+  if (state == STATE_DISCONNECTED) {
+    return;
+  }
+  flush();
+  if (state == STATE_DISCONNECTED) {
+    return;
+  }
+
+  now = millis();
+  if (state == STATE_CONNECTING) {
+    if (now - state_time >= RESPONSE_TIMEOUT) {
+      disconnect("CONNACK timeout");
+    }
+    return;
+  }
+
+  if (in_flight) {
+    if (now - publish_time >= RESPONSE_TIMEOUT) {
+      disconnect("PUBACK timeout");
+    }
+    return;
+  }
+  if (tx_sent < tx_length) {
+    return;
+  }
+
+  // 滞留分は間隔を詰めて、通常は publish_interval ごとにまとめて送る
+  uint32_t backlog = queue->size();
+  bool drain = backlog >= MAX_BATCH && now - last_publish >= DRAIN_INTERVAL;
+  bool due = backlog > 0 && now - last_publish >= config.publish_interval * 1000UL;
+  if (drain || due) {
+    publishBatch();
+  } else if (now - last_send >= KEEP_ALIVE * 1000UL / 2) {
+    uint8_t ping[2] = { MQTT_PINGREQ, 0 };
+    queuePacket(ping, sizeof(ping));
+    flush();
+  }
+}
+
+void MqttPublisher::connect() {
+  client = net->connect(config.host, config.port);
+  if (client == nullptr) {
+    connectFailed();
+    return;
+  }
+  state = STATE_OPENING;
+  state_time = millis();
+}
+
+void MqttPublisher::connectFailed() {
+  Serial.printf("MQTT: cannot connect to %s:%u (retry in %lu s)\n",
+                config.host, config.port, retry_delay / 1000);
+  if (client != nullptr) {
+    net->close(client);
+    client = nullptr;
+  }
+  state = STATE_DISCONNECTED;
+  next_attempt = millis() + retry_delay;
+  retry_delay = retry_delay * 2 < RETRY_MAX ? retry_delay * 2 : RETRY_MAX;
+}
+
+void MqttPublisher::sendConnect() {
+  // CONNECT（クリーンセッション、ユーザー名・パスワードなし）
+  size_t id_length = strlen(config.client_id);
+  uint8_t packet[2 + 10 + 2 + sizeof(config.client_id)];
+  packet[0] = MQTT_CONNECT;
+  packet[1] = (uint8_t)(10 + 2 + id_length);
+  uint8_t* p = putMqttString(packet + 2, "MQTT");
+  *p++ = 4;       // プロトコルレベル 3.1.1
+  *p++ = 0x02;    // クリーンセッション
+  p = putMqttU16(p, KEEP_ALIVE);
+  p = putMqttString(p, config.client_id);
+
+  rx_length = 0;
+  tx_length = 0;
+  tx_sent = 0;
+  queuePacket(packet, p - packet);
+  state = STATE_CONNECTING;
+  state_time = millis();
+  flush();
+}
+
+void MqttPublisher::disconnect(const char* reason) {
+  Serial.printf("MQTT: disconnected (%s)\n", reason);
+  if (client != nullptr) {
+    net->close(client);
+    client = nullptr;
+  }
+  // PUBACKを受け取っていないまとめはキューに残し、再接続後に送り直す
+  if (in_flight) {
+    queue->release();
+    in_flight = false;
+  }
+  state = STATE_DISCONNECTED;
+  next_attempt = millis() + retry_delay;
+  retry_delay = retry_delay * 2 < RETRY_MAX ? retry_delay * 2 : RETRY_MAX;
+}
+
+void MqttPublisher::receive() {
+  for (;;) {
+    int n = client->read(rx + rx_length, sizeof(rx) - rx_length);
+    if (n < 0) {
+      disconnect("closed by broker");
+      return;
+    }
+    if (n == 0) {
+      return;
+    }
+    rx_length += n;
+
+    // 受信するのは短いパケット（CONNACK・PUBACK・PINGRESP）のみ
+    while (rx_length >= 2) {
+      size_t remaining = rx[1];
+      if (remaining & 0x80 || 2 + remaining > sizeof(rx)) {
+        disconnect("unexpected packet");
+        return;
+      }
+      size_t total = 2 + remaining;
+      if (rx_length < total) {
+        break;
+      }
+      handlePacket(rx[0] & 0xF0, rx + 2, remaining);
+      if (state == STATE_DISCONNECTED) {
+        return;
+      }
+      memmove(rx, rx + total, rx_length - total);
+      rx_length -= total;
+    }
+  }
+}
+
+void MqttPublisher::handlePacket(uint8_t type, const uint8_t* body, size_t length) {
+  if (type == MQTT_CONNACK) {
+    if (length < 2 || body[1] != 0) {
+      disconnect("connection refused");
+      return;
+    }
+    state = STATE_CONNECTED;
+    state_time = millis();
+    retry_delay = RETRY_MIN;
+    Serial.printf("MQTT: connected to %s:%u, %lu samples queued\n",
+                  config.host, config.port, (unsigned long)queue->size());
+  } else if (type == MQTT_PUBACK) {
+    if (!in_flight || length < 2 || ((body[0] << 8) | body[1]) != packet_id) {
+      return;
+    }
+    uint32_t latency_us = (millis() - publish_time) * 1000UL;
+    publish_latency.observe(latency_us);
+    if (latency_us > max_latency_us) {
+      max_latency_us = latency_us;
+    }
+    queue->commit();
+    in_flight = false;
+    published_samples += batch_count;
+    interval_samples += batch_count;
+    interval_batches++;
+  }
+  // PINGRESP などは受け取るだけ
+}
+
+void MqttPublisher::publishBatch() {
+  QueuedSample samples[MAX_BATCH];
+  size_t count = queue->peek(samples, MAX_BATCH);
+  if (count == 0) {
+    queue->commit();   // 読み飛ばした詰め物のみ
+    return;
+  }
+
+  // PUBLISH（QoS 1）：トピック | パケットID | まとめ
+  size_t topic_length = strlen(config.topic);
+  size_t payload_length = MQTT_BATCH_HEADER + count * QUEUED_SAMPLE_SIZE;
+  size_t remaining = 2 + topic_length + 2 + payload_length;
+
+  uint8_t* p = tx;
+  *p++ = MQTT_PUBLISH_QOS1;
+  // 残りの長さ（7ビットずつ、最大 PACKET_BUFFER なので2バイト）
+  *p++ = (uint8_t)((remaining & 0x7F) | (remaining > 0x7F ? 0x80 : 0));
+  if (remaining > 0x7F) {
+    *p++ = (uint8_t)(remaining >> 7);
+  }
+  p = putMqttString(p, config.topic);
+  packet_id = packet_id == 0xFFFF ? 1 : packet_id + 1;
+  p = putMqttU16(p, packet_id);
+  p += encodeSampleBatch(samples, (uint8_t)count, p, tx + sizeof(tx) - p);
+
+  tx_length = p - tx;
+  tx_sent = 0;
+  last_send = millis();
+  in_flight = true;
+  batch_count = (uint8_t)count;
+  publish_time = last_send;
+  last_publish = last_send;
+  flush();
+}
+
+bool MqttPublisher::queuePacket(const uint8_t* packet, size_t length) {
+  if (tx_sent < tx_length || length > sizeof(tx)) {
+    return false;
+  }
+  memcpy(tx, packet, length);
+  tx_length = length;
+  tx_sent = 0;
+  last_send = millis();
+  return true;
+}
+
+void MqttPublisher::flush() {
+  while (tx_sent < tx_length) {
+    size_t written = client->write(tx + tx_sent, tx_length - tx_sent);
+    if (written == 0) {
+      break;   // 送信バッファが満杯（次のpoll()で続き）
+    }
+    tx_sent += written;
+  }
+  if (!client->connected()) {
+    disconnect("send failed");
+  }
+}
+
+void MqttPublisher::logStats() {
+  if (net == nullptr) {
+    return;
+  }
+
+  Serial.printf("MQTT: %s, queue %lu (RAM %lu, SD %lu), sent %lu samples in %lu batches, "
+                "dropped %lu, max latency %lu ms\n",
+                state == STATE_CONNECTED ? "connected" : "disconnected",
+                (unsigned long)queue->size(), (unsigned long)queue->ramDepth(),
+                (unsigned long)queue->spoolDepth(), (unsigned long)interval_samples,
+                (unsigned long)interval_batches, (unsigned long)queue->dropped(),
+                (unsigned long)(max_latency_us / 1000));
+  interval_samples = 0;
+  interval_batches = 0;
+  max_latency_us = 0;
+}
@@ -0,0 +1,109 @@
+#ifndef MQTT_PUBLISHER_H
+#define MQTT_PUBLISHER_H
+
+#include <Hal.h>
+#include <ForwardQueue.h>
+#include <OpenMetrics.h>
+
+// 送信先の設定
+struct MqttConfig {
+  char host[48];
+  uint16_t port;
+  char topic[48];
+  char client_id[24];
+  uint16_t publish_interval;   // まとめて送る間隔 (s)
+};
+
+// 測定のまとめ（MQTTのペイロード、リトルエンディアン）
+//   バージョン u8 | 件数 u8 | 予約 u16 | (UNIX時刻 u32 | 測定時刻 u32 (ms、起動から) | TVOC u16 | eCO2 u16) × 件数
+static const uint8_t MQTT_BATCH_VERSION = 1;
+static const size_t MQTT_BATCH_HEADER = 4;
+
+size_t encodeSampleBatch(const QueuedSample* samples, uint8_t count, uint8_t* buffer, size_t size);
+// 件数を返す（形式が違えば -1）
+int decodeSampleBatch(const uint8_t* payload, size_t length, QueuedSample* samples, size_t max);
+
+// 測定をまとめてMQTT（3.1.1、QoS 1）で送る（描画タスクの poll() で少しずつ処理する）
+//
+// 送信は ForwardQueue から読み、PUBACKを受け取ってから削除する（1件ずつ送信を確認）
+// 切断中の測定はキューに溜まり、再接続後は DRAIN_INTERVAL ごとに MAX_BATCH 件ずつ送る
+class MqttPublisher {
+public:
+  static const uint8_t MAX_BATCH = 32;                  // 1回に送る最大件数
+  static const unsigned long DRAIN_INTERVAL = 250;      // 滞留分を送る間隔 (ms)
+  static const unsigned long RETRY_MIN = 2000;          // 再接続の間隔 (ms)、失敗ごとに倍
+  static const unsigned long RETRY_MAX = 60000;
+  static const unsigned long CONNECT_TIMEOUT = 10000;   // 名前解決・TCP接続の確立の期限 (ms)
+  static const unsigned long RESPONSE_TIMEOUT = 10000;  // CONNACK・PUBACKの期限 (ms)
+  static const uint16_t KEEP_ALIVE = 60;                // (s)
+  static const size_t PACKET_BUFFER = 512;
+
+  MqttPublisher();
+
+  void init(NetConnector* net, ForwardQueue* queue, const MqttConfig& config);
+  bool isEnabled() const { return net != nullptr; }
+  bool isConnected() const { return state == STATE_CONNECTED; }
+
+  // 接続・送受信（network_up: WiFiの接続状態、false なら切断して待つ）
+  void poll(bool network_up);
+
+  uint32_t publishedSamples() const { return published_samples; }
+  const MetricsHistogram& latency() const { return publish_latency; }
+
+  // 前回の出力以降の統計をSerialへ出力
+  void logStats();
+
+private:
+  enum State : uint8_t {
+    STATE_DISCONNECTED,
+    STATE_OPENING,        // 名前解決・TCP接続の確立待ち
+    STATE_CONNECTING,     // CONNACK待ち
+    STATE_CONNECTED
+  };
+
+  NetConnector* net;
+  ForwardQueue* queue;
+  MqttConfig config;
+
+  NetClient* client;
+  State state;
+  unsigned long state_time;     // 状態が変わった時刻
+  unsigned long retry_delay;
+  unsigned long next_attempt;
+
+  // 送信中のパケット
+  uint8_t tx[PACKET_BUFFER];
+  size_t tx_length;
+  size_t tx_sent;
+  unsigned long last_send;
+
+  // 受信中のパケット
+  uint8_t rx[16];
+  size_t rx_length;
+
+  // PUBACK待ちのまとめ
+  bool in_flight;
+  uint16_t packet_id;
+  uint8_t batch_count;
+  unsigned long publish_time;
+  unsigned long last_publish;
+
+  // 統計
+  uint32_t published_samples;
+  uint32_t interval_batches;
+  uint32_t interval_samples;
+  uint32_t max_latency_us;
+  MetricsHistogram publish_latency;
+
+  void connect();
+  void connectFailed();
+  void sendConnect();
+  void disconnect(const char* reason);
+  void receive();
+  void handlePacket(uint8_t type, const uint8_t* body, size_t length);
+  void publishBatch();
+  bool queuePacket(const uint8_t* packet, size_t length);
+  void flush();
+};
+
+#endif // MQTT_PUBLISHER_H
@@ -0,0 +1,345 @@
+#include "OpenMetrics.h"
+
+// ---- MetricsHistogram ----
+
+MetricsHistogram::MetricsHistogram(const uint32_t* bounds, uint8_t bucket_count) :
+  bounds(bounds),
+  bucket_count(bucket_count < MAX_BUCKETS ? bucket_count : MAX_BUCKETS),
+  counts(),
+  total(0),
+  sum_us(0) {
+}
+
+MetricsHistogram::MetricsHistogram() :
+  bounds(nullptr),
+  bucket_count(0),
+  counts(),
+  total(0),
+  sum_us(0) {
+}
+
+void MetricsHistogram::observe(uint32_t value_us) {
+  uint8_t index = 0;
+  while (index < bucket_count && value_us > bounds[index]) {
+    index++;
+  }
+  counts[index]++;
+  total++;
+  sum_us += value_us;
+}
+
+// ---- OpenMetricsWriter ----
+
+OpenMetricsWriter::OpenMetricsWriter(char* buffer, size_t size) :
+  buffer(buffer),
+  size(size),
+  used(0),
+  overflow(false) {
+}
+
+void OpenMetricsWriter::append(const char* text) {
+  size_t length = strlen(text);
+  if (used + length > size) {
+    overflow = true;
+    return;
+  }
+  memcpy(buffer + used, text, length);
+  used += length;
+}
+
+void OpenMetricsWriter::append(char c) {
+  if (used + 1 > size) {
+    overflow = true;
+    return;
+  }
+  buffer[used++] = c;
+}
+
+void OpenMetricsWriter::appendUnsigned(uint64_t value) {
+  // 下の桁から一時バッファに並べて逆順に書き込む
+  char digits[20];
+  uint8_t count = 0;
+  do {
+    digits[count++] = '0' + value % 10;
+    value /= 10;
+  } while (value != 0);
+
+  if (used + count > size) {
+    overflow = true;
+    return;
+  }
+  while (count > 0) {
+    buffer[used++] = digits[--count];
+  }
+}
+
+void OpenMetricsWriter::appendDecimal(uint64_t value, uint8_t decimals) {
+  uint64_t scale = 1;
+  for (uint8_t i = 0; i < decimals; i++) {
+    scale *= 10;
+  }
+  appendUnsigned(value / scale);
+
+  // 小数部は末尾の0を省く
+  uint64_t fraction = value % scale;
+  if (fraction == 0) {
+    return;
+  }
+  append('.');
+  while (fraction != 0) {
+    scale /= 10;
+    append((char)('0' + fraction / scale));
+    fraction %= scale;
+  }
+}
+
+void OpenMetricsWriter::family(const char* name, const char* type, const char* help, const char* unit) {
+  append("# TYPE ");
+  append(name);
+  append(' ');
+  append(type);
+  append('\n');
+  if (unit != nullptr) {
+    append("# UNIT ");
+    append(name);
+    append(' ');
+    append(unit);
+    append('\n');
+  }
+  append("# HELP ");
+  append(name);
+  append(' ');
+  append(help);
+  append('\n');
+}
+
+void OpenMetricsWriter::beginSample(const char* name, const char* suffix, const char* label, const char* label_value) {
+  append(name);
+  if (suffix != nullptr) {
+    append(suffix);
+  }
+  if (label != nullptr) {
+    append('{');
+    append(label);
+    append("=\"");
+    append(label_value);
+    append("\"}");
+  }
+  append(' ');
+}
+
+void OpenMetricsWriter::sample(const char* name, const char* suffix, uint32_t value,
+                               const char* label, const char* label_value) {
+  beginSample(name, suffix, label, label_value);
+  appendUnsigned(value);
+  append('\n');
+}
+
+void OpenMetricsWriter::sampleSigned(const char* name, const char* suffix, int32_t value,
+                                     const char* label, const char* label_value) {
+  beginSample(name, suffix, label, label_value);
+  if (value < 0) {
+    append('-');
+    appendUnsigned((uint64_t)(-(int64_t)value));
+  } else {
+    appendUnsigned((uint64_t)value);
+  }
+  append('\n');
+}
+
+void OpenMetricsWriter::sampleDecimal(const char* name, const char* suffix, uint64_t value, uint8_t decimals,
+                                      const char* label, const char* label_value) {
+  beginSample(name, suffix, label, label_value);
+  appendDecimal(value, decimals);
+  append('\n');
+}
+
+void OpenMetricsWriter::sampleSignedDecimal(const char* name, const char* suffix, int32_t value, uint8_t decimals,
+                                            const char* label, const char* label_value) {
+  beginSample(name, suffix, label, label_value);
+  if (value < 0) {
+    append('-');
+  }
+  appendDecimal(value < 0 ? (uint64_t)(-(int64_t)value) : (uint64_t)value, decimals);
+  append('\n');
+}
+
+void OpenMetricsWriter::histogram(const char* name, const MetricsHistogram& histogram,
+                                  const char* label, const char* label_value, uint8_t decimals) {
+  // 読み取り中に他タスクが追加しても累積値が減らないよう、件数は各バケットの合計とする
+  uint32_t cumulative = 0;
+  for (uint8_t i = 0; i <= histogram.bucketCount(); i++) {
+    cumulative += histogram.bucket(i);
+
+    append(name);
+    append("_bucket{");
+    if (label != nullptr) {
+      append(label);
+      append("=\"");
+      append(label_value);
+      append("\",");
+    }
+    append("le=\"");
+    if (i < histogram.bucketCount()) {
+      appendDecimal(histogram.bound(i), decimals);
+    } else {
+      append("+Inf");
+    }
+    append("\"} ");
+    appendUnsigned(cumulative);
+    append('\n');
+  }
+  sample(name, "_count", cumulative, label, label_value);
+  sampleDecimal(name, "_sum", histogram.sum(), decimals, label, label_value);
+}
+
+size_t OpenMetricsWriter::finish() {
+  append("# EOF\n");
+  return overflow ? 0 : used;
+}
+
+// ---- 装置のメトリクス ----
+
+size_t encodeDeviceMetrics(const DeviceMetrics& metrics, char* buffer, size_t size) {
+  const SensorSample& s = metrics.sample;
+  OpenMetricsWriter writer(buffer, size);
+
+  writer.family("tvoc_ppb", "gauge", "Total volatile organic compounds reported by the SGP30.", "ppb");
+  writer.sample("tvoc_ppb", nullptr, s.tvoc);
+  writer.family("eco2_ppm", "gauge", "Equivalent CO2 reported by the SGP30.", "ppm");
+  writer.sample("eco2_ppm", nullptr, s.eco2);
+
+  writer.family("sgp30_raw_signal", "gauge", "Raw H2 and ethanol signals (0 when raw measurement is off).");
+  writer.sample("sgp30_raw_signal", nullptr, s.raw_h2, "gas", "h2");
+  writer.sample("sgp30_raw_signal", nullptr, s.raw_ethanol, "gas", "ethanol");
+  // 生信号の処理：スパイク除去・平滑化した値と、その変化率
+  writer.family("sgp30_filtered_signal", "gauge", "H2 and ethanol signals after the filter chain (0 when raw measurement is off).");
+  writer.sample("sgp30_filtered_signal", nullptr, s.h2_filtered, "gas", "h2");
+  writer.sample("sgp30_filtered_signal", nullptr, s.ethanol_filtered, "gas", "ethanol");
+  writer.family("sgp30_signal_rate_per_minute", "gauge",
+                "Change of the filtered signals per minute (negative when the gas concentration rises).");
+  writer.sampleSigned("sgp30_signal_rate_per_minute", nullptr, s.h2_rate, "gas", "h2");
+  writer.sampleSigned("sgp30_signal_rate_per_minute", nullptr, s.ethanol_rate, "gas", "ethanol");
+  writer.family("sgp30_signal_change", "gauge", "1 while a fast change of either filtered signal is detected.");
+  writer.sample("sgp30_signal_change", nullptr, s.signal_change ? 1 : 0);
+  writer.family("sgp30_signal_changes", "counter", "Fast changes detected in the filtered signals since boot.");
+  writer.sample("sgp30_signal_changes", "_total", s.signal_changes);
+  writer.family("sgp30_signal_spikes", "counter", "Raw signal samples replaced as spikes since boot.");
+  writer.sample("sgp30_signal_spikes", "_total", s.signal_spikes);
+  writer.family("sgp30_baseline", "gauge", "Last baseline words read from or written to the SGP30 (0 when unknown).");
+  writer.sample("sgp30_baseline", nullptr, s.eco2_base, "signal", "eco2");
+  writer.sample("sgp30_baseline", nullptr, s.tvoc_base, "signal", "tvoc");
+  // 湿度補正：温湿度センサーの測定と、そこから求めてSGP30に設定した絶対湿度
+  if (s.environment_valid) {
+    writer.family("environment_temperature_celsius", "gauge", "Temperature from the humidity sensor.", "celsius");
+    writer.sampleSignedDecimal("environment_temperature_celsius", nullptr, s.temperature, 2);
+    writer.family("environment_relative_humidity_percent", "gauge", "Relative humidity from the humidity sensor.",
+                  "percent");
+    writer.sampleDecimal("environment_relative_humidity_percent", nullptr, s.humidity, 2);
+  }
+  writer.family("absolute_humidity_grams_per_cubic_meter", "gauge",
+                "Absolute humidity measured and applied to the SGP30 compensation (0 when compensation is off).",
+                "grams_per_cubic_meter");
+  writer.sampleDecimal("absolute_humidity_grams_per_cubic_meter", nullptr, s.environment_valid ? s.absolute_humidity : 0,
+                       3, "value", "measured");
+  writer.sampleDecimal("absolute_humidity_grams_per_cubic_meter", nullptr, s.applied_humidity, 3, "value", "applied");
+  writer.family("sgp30_connected", "gauge", "1 when the SGP30 responds, 0 when demo data is shown.");
+  writer.sample("sgp30_connected", nullptr, metrics.sensor_connected ? 1 : 0);
+
+  // 複数のSGP30：上の tvoc_ppb・eco2_ppm は集計値、ここはセンサーごとの値
+  if (metrics.sensor_points != nullptr) {
+    char sensor[4];
+    writer.family("sensor_tvoc_ppb", "gauge", "TVOC reported by each SGP30 behind the multiplexer.", "ppb");
+    for (uint8_t i = 0; i < metrics.sensor_count; i++) {
+      snprintf(sensor, sizeof(sensor), "%u", i);
+      writer.sample("sensor_tvoc_ppb", nullptr, metrics.sensor_points[i].tvoc, "sensor", sensor);
+    }
+    writer.family("sensor_eco2_ppm", "gauge", "Equivalent CO2 reported by each SGP30 behind the multiplexer.", "ppm");
+    for (uint8_t i = 0; i < metrics.sensor_count; i++) {
+      snprintf(sensor, sizeof(sensor), "%u", i);
+      writer.sample("sensor_eco2_ppm", nullptr, metrics.sensor_points[i].eco2, "sensor", sensor);
+    }
+    writer.family("sensor_up", "gauge", "1 when the SGP30 answered its last measurement.");
+    for (uint8_t i = 0; i < metrics.sensor_count; i++) {
+      snprintf(sensor, sizeof(sensor), "%u", i);
+      writer.sample("sensor_up", nullptr, metrics.sensor_points[i].connected ? 1 : 0, "sensor", sensor);
+    }
+    writer.family("sensor_array_cycle_seconds", "gauge", "I2C time of the last batched measurement of all sensors.",
+                  "seconds");
+    writer.sampleDecimal("sensor_array_cycle_seconds", nullptr, metrics.sensor_cycle_us, 6);
+  }
+
+  if (metrics.iaq_latency != nullptr) {
+    writer.family("sgp30_measurement_latency_seconds", "histogram",
+                  "Time from a measure command until its CRC-checked result was read, retries included.", "seconds");
+    writer.histogram("sgp30_measurement_latency_seconds", *metrics.iaq_latency, "command", "iaq");
+    writer.histogram("sgp30_measurement_latency_seconds", *metrics.raw_latency, "command", "raw");
+    writer.family("sgp30_measurement_retries", "histogram", "Retries needed per measurement.");
+    writer.histogram("sgp30_measurement_retries", *metrics.measure_retries, nullptr, nullptr, 0);
+    writer.family("sgp30_measurement_failures", "counter", "Measurements given up after all retries.");
+    writer.sample("sgp30_measurement_failures", "_total", metrics.measure_failures);
+    writer.family("sgp30_i2c_errors", "counter", "I2C transfers to the SGP30s that failed by cause.");
+    writer.sample("sgp30_i2c_errors", "_total", metrics.i2c_nacks, "cause", "nack");
+    writer.sample("sgp30_i2c_errors", "_total", metrics.i2c_crc_errors, "cause", "crc");
+  }
+
+  writer.family("clean_air_detected", "gauge", "1 while the clean-air condition for baseline saving holds.");
+  writer.sample("clean_air_detected", nullptr, s.clean_air_detected ? 1 : 0);
+  writer.family("clean_air_remaining_seconds", "gauge", "Seconds until the clean-air condition is stable.", "seconds");
+  writer.sample("clean_air_remaining_seconds", nullptr, s.clean_air_remaining);
+
+  writer.family("baseline_saves", "counter", "Baseline saves to non-volatile storage by result.");
+  writer.sample("baseline_saves", "_total", s.baseline_saves, "result", "success");
+  writer.sample("baseline_saves", "_total", s.baseline_save_failures, "result", "failure");
+  writer.sample("baseline_saves", "_total", s.baseline_save_skips, "result", "unchanged");
+  writer.sample("baseline_saves", "_total", s.baseline_rejects, "result", "rejected");
+  writer.family("baseline_rollbacks", "counter", "Saved baselines replaced by the previous one after implausible readings.");
+  writer.sample("baseline_rollbacks", "_total", s.baseline_rollbacks);
+  writer.family("baseline_drift_per_day", "gauge", "Average change of the saved baseline words per day.");
+  writer.sampleSigned("baseline_drift_per_day", nullptr, s.eco2_base_drift, "signal", "eco2");
+  writer.sampleSigned("baseline_drift_per_day", nullptr, s.tvoc_base_drift, "signal", "tvoc");
+
+  writer.family("loop_duration_seconds", "histogram", "Time spent in one scheduler pass per task.", "seconds");
+  writer.histogram("loop_duration_seconds", *metrics.sensor_loop, "task", "sensor");
+  writer.histogram("loop_duration_seconds", *metrics.render_loop, "task", "render");
+
+  writer.family("wifi_connected", "gauge", "1 while WiFi is connected.");
+  writer.sample("wifi_connected", nullptr, metrics.wifi_connected ? 1 : 0);
+  if (metrics.wifi_connected) {
+    writer.family("wifi_rssi_dbm", "gauge", "WiFi received signal strength.", "dbm");
+    writer.sampleSigned("wifi_rssi_dbm", nullptr, metrics.wifi_rssi);
+  }
+  writer.family("wifi_reconnects", "counter", "WiFi connections made after the first connection.");
+  writer.sample("wifi_reconnects", "_total", metrics.wifi_reconnects);
+  writer.family("wifi_offline_seconds", "counter", "Time spent disconnected after the first connection.", "seconds");
+  writer.sampleDecimal("wifi_offline_seconds", "_total", metrics.wifi_offline_ms, 3);
+  if (metrics.wifi_connect_time != nullptr) {
+    writer.family("wifi_connect_duration_seconds", "histogram",
+                  "Time from starting a connection attempt until connected.", "seconds");
+    writer.histogram("wifi_connect_duration_seconds", *metrics.wifi_connect_time);
+  }
+
+  if (metrics.mqtt_latency != nullptr) {
+    writer.family("mqtt_connected", "gauge", "1 while connected to the MQTT broker.");
+    writer.sample("mqtt_connected", nullptr, metrics.mqtt_connected ? 1 : 0);
+    writer.family("mqtt_queue_depth", "gauge", "Samples waiting to be published by store.");
+    writer.sample("mqtt_queue_depth", nullptr, metrics.mqtt_queue_ram, "store", "ram");
+    writer.sample("mqtt_queue_depth", nullptr, metrics.mqtt_queue_sd, "store", "sd");
+    writer.family("mqtt_dropped_samples", "counter", "Samples dropped because the offline queue was full.");
+    writer.sample("mqtt_dropped_samples", "_total", metrics.mqtt_dropped);
+    writer.family("mqtt_published_samples", "counter", "Samples acknowledged by the MQTT broker.");
+    writer.sample("mqtt_published_samples", "_total", metrics.mqtt_published);
+    writer.family("mqtt_publish_latency_seconds", "histogram", "Time from PUBLISH to PUBACK.", "seconds");
+    writer.histogram("mqtt_publish_latency_seconds", *metrics.mqtt_latency);
+  }
+
+  if (metrics.boot_first_reading_ms != 0) {
+    writer.family("boot_first_reading_seconds", "gauge", "Time from boot until the first valid reading.", "seconds");
+    writer.sampleDecimal("boot_first_reading_seconds", nullptr, metrics.boot_first_reading_ms, 3);
+  }
+
+  writer.family("uptime_seconds", "gauge", "Time since boot.", "seconds");
+  writer.sampleDecimal("uptime_seconds", nullptr, metrics.uptime_ms, 3);
+
+  return writer.finish();
+}
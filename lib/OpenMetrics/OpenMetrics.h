@@ -0,0 +1,117 @@
+#ifndef OPEN_METRICS_H
+#define OPEN_METRICS_H
+
+#include <Hal.h>
+#include <SensorManager.h>
+
+// 処理時間のヒストグラム（固定の境界、ヒープ確保なし）
+// observe() は計測するタスクのみから呼び出す。他タスクへは計測するタスクで複製して渡す
+class MetricsHistogram {
+public:
+  static const uint8_t MAX_BUCKETS = 12;
+
+  // bounds: 各バケットの上限 (us)、昇順
+  MetricsHistogram(const uint32_t* bounds, uint8_t bucket_count);
+  // 複製の受け取り用（バケットなし）
+  MetricsHistogram();
+
+  void observe(uint32_t value_us);
+
+  uint8_t bucketCount() const { return bucket_count; }
+  uint32_t bound(uint8_t index) const { return bounds[index]; }
+  // index 番目のバケットの件数（累積ではない、bucketCount() 番目は上限超え）
+  uint32_t bucket(uint8_t index) const { return counts[index]; }
+  uint32_t count() const { return total; }
+  uint64_t sum() const { return sum_us; }
+
+private:
+  const uint32_t* bounds;
+  uint8_t bucket_count;
+  uint32_t counts[MAX_BUCKETS + 1];
+  uint32_t total;
+  uint64_t sum_us;
+};
+
+// OpenMetricsのテキスト形式を呼び出し元のバッファへ書き込む（String・ヒープ確保なし）
+// バッファが足りない場合は以降の書き込みを捨て、finish() が 0 を返す
+class OpenMetricsWriter {
+public:
+  OpenMetricsWriter(char* buffer, size_t size);
+
+  // メトリクスファミリーの見出し（type: gauge / counter / histogram、unit: 単位、なければ nullptr）
+  void family(const char* name, const char* type, const char* help, const char* unit = nullptr);
+
+  // 1件の値（name + suffix{label="label_value"} value）
+  void sample(const char* name, const char* suffix, uint32_t value,
+              const char* label = nullptr, const char* label_value = nullptr);
+  void sampleSigned(const char* name, const char* suffix, int32_t value,
+                    const char* label = nullptr, const char* label_value = nullptr);
+  // value × 10^-decimals の小数
+  void sampleDecimal(const char* name, const char* suffix, uint64_t value, uint8_t decimals,
+                     const char* label = nullptr, const char* label_value = nullptr);
+  void sampleSignedDecimal(const char* name, const char* suffix, int32_t value, uint8_t decimals,
+                           const char* label = nullptr, const char* label_value = nullptr);
+
+  // ヒストグラムの値（累積のバケット・件数・合計を出力、decimals: 値の小数点以下の桁数、既定は us を秒で）
+  void histogram(const char* name, const MetricsHistogram& histogram,
+                 const char* label = nullptr, const char* label_value = nullptr, uint8_t decimals = 6);
+
+  // 末尾の "# EOF" を追加して全体の長さを返す（バッファ不足なら 0）
+  size_t finish();
+
+  size_t length() const { return used; }
+  bool overflowed() const { return overflow; }
+
+private:
+  char* buffer;
+  size_t size;
+  size_t used;
+  bool overflow;
+
+  void append(const char* text);
+  void append(char c);
+  void appendUnsigned(uint64_t value);
+  void appendDecimal(uint64_t value, uint8_t decimals);
+  void beginSample(const char* name, const char* suffix, const char* label, const char* label_value);
+};
+
+// /metrics で公開する装置の状態（描画タスクで組み立てる）
+struct DeviceMetrics {
+  SensorSample sample;                     // 最新の測定
+  bool sensor_connected;
+  uint32_t uptime_ms;
+  uint32_t boot_first_reading_ms;          // 起動から最初の有効な測定まで（まだなら 0）
+  const MetricsHistogram* sensor_loop;     // センサータスクの1周期の処理時間
+  const MetricsHistogram* render_loop;     // 描画タスクの1周期の処理時間
+  bool wifi_connected;
+  int8_t wifi_rssi;                        // 受信強度 (dBm)
+  uint32_t wifi_reconnects;                // 最初の接続以降に接続した回数
+  uint32_t wifi_offline_ms;                // 最初の接続以降に未接続だった時間
+  const MetricsHistogram* wifi_connect_time;  // 接続にかかった時間（WiFi無効なら nullptr）
+
+  // MQTTの送信（無効なら mqtt_latency は nullptr）
+  const MetricsHistogram* mqtt_latency;    // PUBACKまでの時間
+  bool mqtt_connected;
+  uint32_t mqtt_queue_ram;                 // 送信待ち（RAM）
+  uint32_t mqtt_queue_sd;                  // 送信待ち（SDカード）
+  uint32_t mqtt_dropped;                   // 蓄積しきれずに捨てた測定
+  uint32_t mqtt_published;                 // 送信した測定
+
+  // マルチプレクサの先の複数のSGP30（1台なら sensor_points は nullptr）
+  const SensorPoint* sensor_points;        // センサーごとの最新の測定
+  uint8_t sensor_count;
+  uint32_t sensor_cycle_us;                // 全センサーをまとめて測定した時間
+
+  // SGP30の分割した測定（SGP30を直接使わない場合は iaq_latency は nullptr）
+  const MetricsHistogram* iaq_latency;     // measure_iaq から結果まで
+  const MetricsHistogram* raw_latency;     // measure_raw から結果まで
+  const MetricsHistogram* measure_retries; // 1回の測定の再試行の回数
+  uint32_t i2c_nacks;
+  uint32_t i2c_crc_errors;
+  uint32_t measure_failures;               // 再試行しても読めなかった測定
+};
+
+// 装置のメトリクスを書き込み、長さを返す（バッファ不足なら 0）
+size_t encodeDeviceMetrics(const DeviceMetrics& metrics, char* buffer, size_t size);
+
+#endif // OPEN_METRICS_H
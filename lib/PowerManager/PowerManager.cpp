@@ -0,0 +1,192 @@
+#include "PowerManager.h"
+#ifdef ARDUINO
+#include <esp_sleep.h>
+#include <driver/gpio.h>
+
+// ボタンA/B/C（押下でLOW）
+static const gpio_num_t BUTTON_PINS[] = { GPIO_NUM_39, GPIO_NUM_38, GPIO_NUM_37 };
+#endif
+
+PowerManager::PowerManager() :
+  display(nullptr),
+  mode(POWER_MODE_NORMAL),
+  last_activity(0),
+  brightness(NORMAL_BRIGHTNESS),
+  lock(0),
+  radio_active(false),
+  pending_spi_us(0),
+  pending_i2c_us(0),
+  dimmed(false),
+  meter(micros),
+  applied_mode(0xFF),
+  applied_brightness(0) {
+}
+
+void PowerManager::init(Display* lcd, PowerMode initial_mode) {
+  display = lcd;
+  mode = initial_mode;
+  last_activity = millis();
+  setBrightness(NORMAL_BRIGHTNESS);
+  applyMode();
+  syncMeter();
+  meter.reset();
+}
+
+void PowerManager::setMode(PowerMode new_mode) {
+  mode = new_mode;
+  last_activity = millis();
+}
+
+void PowerManager::applyMode() {
+  uint8_t current = mode.load();
+  if (current == applied_mode) {
+    return;
+  }
+
+  // SPI/I2CはAPB基準なので80MHzまで下げても転送速度は変わらない
+  bool low = (current == POWER_MODE_LOW);
+  uint32_t cpu_mhz = low ? LOW_CPU_MHZ : NORMAL_CPU_MHZ;
+#ifdef ARDUINO
+  setCpuFrequencyMhz(cpu_mhz);
+  cpu_mhz = getCpuFrequencyMhz();
+#endif
+  meter.setCpuCurrent(low ? LOW_CPU_UA : NORMAL_CPU_UA);
+  applied_mode = current;
+
+  Serial.printf("Power mode: %s (%lu MHz)\n", low ? "low" : "normal", (unsigned long)cpu_mhz);
+}
+
+bool PowerManager::wake() {
+  last_activity = millis();
+  if (!dimmed) {
+    return false;
+  }
+
+  setBrightness(NORMAL_BRIGHTNESS);
+  dimmed = false;
+  return true;
+}
+
+void PowerManager::updateBacklight() {
+  bool idle_timeout = millis() - last_activity.load() >= DIM_TIMEOUT;
+  bool should_dim = (getMode() == POWER_MODE_LOW) && idle_timeout;
+
+  if (should_dim && !dimmed) {
+    setBrightness(DIM_BRIGHTNESS);
+    dimmed = true;
+  } else if (!should_dim && dimmed) {
+    setBrightness(NORMAL_BRIGHTNESS);
+    dimmed = false;
+  }
+}
+
+void PowerManager::setBrightness(uint8_t level) {
+  display->setBrightness(level);
+  brightness = level;
+}
+
+void PowerManager::beginRender() {
+  // スリープ移行中なら復帰を待つ（スリープ中はこのコアも停止している）
+  uint8_t expected = 0;
+  while (!lock.compare_exchange_weak(expected, LOCK_RENDER)) {
+    expected = 0;
+#ifdef ARDUINO
+    vTaskDelay(1);
+#endif
+  }
+}
+
+void PowerManager::endRender() {
+  lock.store(0);
+}
+
+void PowerManager::addSpiBytes(uint32_t bytes) {
+  pending_spi_us.fetch_add((uint32_t)((uint64_t)bytes * 8 * 1000000 / SPI_FREQUENCY));
+}
+
+void PowerManager::addI2cTime(uint32_t us) {
+  pending_i2c_us.fetch_add(us);
+}
+
+void PowerManager::syncMeter() {
+  meter.addBusyTime(ENERGY_BUS_SPI, pending_spi_us.exchange(0));
+  meter.addBusyTime(ENERGY_BUS_I2C, pending_i2c_us.exchange(0));
+
+  uint8_t level = brightness.load();
+  if (level != applied_brightness) {
+    meter.setBacklightCurrent(BACKLIGHT_MAX_UA * level / 255);
+    applied_brightness = level;
+  }
+}
+
+bool PowerManager::canSleep(unsigned long wait_ms) const {
+  // 操作中（点灯中）はボタン読み取りと描画を止めない。WiFiの使用中はモデムスリープに任せる
+  return mode.load() == POWER_MODE_LOW &&
+         !radio_active.load() &&
+         wait_ms >= MIN_SLEEP_TIME &&
+         millis() - last_activity.load() >= DIM_TIMEOUT;
+}
+
+void PowerManager::idle(unsigned long wait_ms) {
+  applyMode();
+  syncMeter();
+
+  uint8_t expected = 0;
+  if (canSleep(wait_ms) && lock.compare_exchange_strong(expected, LOCK_SLEEP)) {
+    lightSleep(wait_ms);
+    lock.store(0);
+    return;
+  }
+
+#ifdef ARDUINO
+  ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait_ms));
+#else
+  delay(wait_ms);
+#endif
+}
+
+void PowerManager::lightSleep(unsigned long wait_ms) {
+#ifndef ARDUINO
+  // ネイティブ環境では仮想時計を進めるだけ
+  meter.enterSleep();
+  delay(wait_ms);
+  meter.exitSleep();
+#else
+  for (gpio_num_t pin : BUTTON_PINS) {
+    gpio_wakeup_enable(pin, GPIO_INTR_LOW_LEVEL);
+  }
+  esp_sleep_enable_gpio_wakeup();
+  esp_sleep_enable_timer_wakeup((uint64_t)wait_ms * 1000);
+
+  meter.enterSleep();
+  esp_light_sleep_start();
+  meter.exitSleep();
+
+  for (gpio_num_t pin : BUTTON_PINS) {
+    gpio_wakeup_disable(pin);
+  }
+
+  // ボタンで起床した場合は減光が解除されるまで起きたままにする
+  if (esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_GPIO) {
+    last_activity = millis();
+  }
+#endif
+}
+
+void PowerManager::logStats() {
+  syncMeter();
+  EnergyReport report = meter.report();
+
+  Serial.printf("Power (%s): awake %lu ms, sleep %lu ms, duty %u.%u%%, SPI %lu ms, I2C %lu ms, "
+                "avg %lu.%lu mA, total %lu.%03lu mAh\n",
+                getMode() == POWER_MODE_LOW ? "low" : "normal",
+                (unsigned long)report.awake_ms,
+                (unsigned long)report.sleep_ms,
+                report.duty_permille / 10, report.duty_permille % 10,
+                (unsigned long)report.spi_busy_ms,
+                (unsigned long)report.i2c_busy_ms,
+                (unsigned long)(report.average_ua / 1000), (unsigned long)(report.average_ua % 1000 / 100),
+                (unsigned long)(report.total_uah / 1000), (unsigned long)(report.total_uah % 1000));
+
+  meter.reset();
+}
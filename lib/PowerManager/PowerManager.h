@@ -0,0 +1,88 @@
+#ifndef POWER_MANAGER_H
+#define POWER_MANAGER_H
+
+#include <Hal.h>
+#include <atomic>
+#include <EnergyMeter.h>
+
+// 動作モード
+enum PowerMode : uint8_t {
+  POWER_MODE_NORMAL,   // 最高クロック、常時点灯
+  POWER_MODE_LOW       // 低クロック、無操作時は減光して測定間にライトスリープ
+};
+
+// CPUクロック・バックライト・ライトスリープの制御と消費電力の集計
+// wake()/updateBacklight()/beginRender()/endRender()/addSpiBytes()/setRadioActive() は描画タスク、
+// idle()/addI2cTime()/logStats() はセンサータスクから呼び出す
+class PowerManager {
+public:
+  static const uint32_t NORMAL_CPU_MHZ = 240;
+  static const uint32_t LOW_CPU_MHZ = 80;
+  static const uint32_t NORMAL_CPU_UA = 50000;     // 240MHz稼働時のESP32 (uA)
+  static const uint32_t LOW_CPU_UA = 20000;        // 80MHz稼働時のESP32 (uA)
+  static const uint32_t BACKLIGHT_MAX_UA = 60000;  // 輝度255でのバックライト (uA)
+  static const uint8_t NORMAL_BRIGHTNESS = 80;     // M5Stackの初期輝度
+  static const uint8_t DIM_BRIGHTNESS = 8;         // 減光時の輝度
+  static const unsigned long DIM_TIMEOUT = 30000;  // 減光までの無操作時間 (ms)
+  static const unsigned long MIN_SLEEP_TIME = 20;  // これより短い待機はスリープしない (ms)
+  static const uint32_t SPI_FREQUENCY = 40000000;  // LCDのSPIクロック (Hz)
+
+  PowerManager();
+
+  // 初期化（タスク起動前に呼び出す）
+  void init(Display* display, PowerMode mode);
+
+  // モード切り替え（クロック変更は次のidle()でセンサータスクが適用）
+  void setMode(PowerMode mode);
+  PowerMode getMode() const { return (PowerMode)mode.load(); }
+
+  // ボタン操作の通知（減光中だった場合は点灯して true を返す）
+  bool wake();
+  // 無操作時間に応じた減光
+  void updateBacklight();
+
+  // 描画中はライトスリープさせない
+  void beginRender();
+  void endRender();
+  // WiFiの接続中・接続済みはライトスリープさせない（無線が止まりアクセスポイントから切断される）
+  void setRadioActive(bool active) { radio_active.store(active); }
+
+  // バス稼働時間の計上
+  void addSpiBytes(uint32_t bytes);
+  void addI2cTime(uint32_t us);
+
+  // 次の期限まで待機（低消費電力モードで無操作ならライトスリープ、wait_ms は TickScheduler::MAX_WAIT 以下）
+  void idle(unsigned long wait_ms);
+
+  // 前回の出力以降の消費電力をSerialへ出力
+  void logStats();
+
+private:
+  static const uint8_t LOCK_RENDER = 0x01;
+  static const uint8_t LOCK_SLEEP = 0x02;
+
+  Display* display;
+  std::atomic<uint8_t> mode;
+  std::atomic<unsigned long> last_activity;   // 最後のボタン操作 (ms)
+  std::atomic<uint8_t> brightness;
+  std::atomic<uint8_t> lock;                  // 描画中 / スリープ中
+  std::atomic<bool> radio_active;             // WiFiの接続中・接続済み
+  std::atomic<uint32_t> pending_spi_us;
+  std::atomic<uint32_t> pending_i2c_us;
+
+  // 描画タスクが所有
+  bool dimmed;
+
+  // センサータスクが所有
+  EnergyMeter meter;
+  uint8_t applied_mode;
+  uint8_t applied_brightness;
+
+  void applyMode();
+  void syncMeter();
+  bool canSleep(unsigned long wait_ms) const;
+  void lightSleep(unsigned long wait_ms);
+  void setBrightness(uint8_t level);
+};
+
+#endif // POWER_MANAGER_H
@@ -0,0 +1,169 @@
+#include "RestartSnapshot.h"
+#include <DataLogger.h>
+#include <atomic>
+
+static_assert(RestartSnapshot::SENSOR_OFFSET + RestartSnapshot::HEADER_SIZE + RestartSnapshot::SENSOR_SIZE <=
+              RestartSnapshot::HISTORY_OFFSET, "sensor state overlaps the history");
+static_assert(RestartSnapshot::TOTAL_SIZE <= RetainedMemory::SIZE, "snapshot does not fit in the retained memory");
+
+static const char* NVS_NAMESPACE = "restart";
+static const char* NVS_KEY_SNAPSHOT = "snapshot";
+
+static void putU16(uint8_t* p, uint16_t value) {
+  p[0] = value & 0xFF;
+  p[1] = value >> 8;
+}
+
+static void putU32(uint8_t* p, uint32_t value) {
+  putU16(p, value & 0xFFFF);
+  putU16(p + 2, value >> 16);
+}
+
+static uint16_t getU16(const uint8_t* p) {
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t getU32(const uint8_t* p) {
+  return getU16(p) | ((uint32_t)getU16(p + 2) << 16);
+}
+
+RestartSnapshot::RestartSnapshot() :
+  memory(nullptr),
+  store(nullptr),
+  from(ORIGIN_NONE) {
+}
+
+void RestartSnapshot::init(RetainedMemory* retained, KeyValueStore* nvs) {
+  memory = retained;
+  store = nvs;
+  from = ORIGIN_NONE;
+
+  // 電源投入直後のRTCメモリは不定なので使わない
+  if (memory->resetReason() != RESET_POWER_ON &&
+      (isValid(SENSOR_OFFSET, SENSOR_SIZE) || isValid(HISTORY_OFFSET, HISTORY_SIZE))) {
+    from = ORIGIN_RTC;
+  }
+
+  if (store != nullptr && store->begin(NVS_NAMESPACE, false)) {
+    // RTCメモリが使えなければ計画的な再起動の前の写しを使う
+    uint8_t* target = memory->data();
+    size_t length = from == ORIGIN_NONE ? store->getBytes(NVS_KEY_SNAPSHOT, target, TOTAL_SIZE) : 0;
+    if (length == TOTAL_SIZE && (isValid(SENSOR_OFFSET, SENSOR_SIZE) || isValid(HISTORY_OFFSET, HISTORY_SIZE))) {
+      from = ORIGIN_NVS;
+    }
+    // 古い写しを後で使わないよう、読んだら（RTCメモリを使う場合も）消す
+    if (length > 0 || from == ORIGIN_RTC) {
+      store->remove(NVS_KEY_SNAPSHOT);
+    }
+    store->end();
+  }
+
+  if (from == ORIGIN_NONE) {
+    putU32(memory->data() + SENSOR_OFFSET, 0);
+    putU32(memory->data() + HISTORY_OFFSET, 0);
+    return;
+  }
+  Serial.printf("Restart snapshot found in %s\n", from == ORIGIN_RTC ? "RTC memory" : "NVS");
+}
+
+bool RestartSnapshot::isValid(size_t offset, size_t length) const {
+  const uint8_t* header = memory->data() + offset;
+  return getU32(header) == MAGIC &&
+         getU16(header + 4) == VERSION &&
+         getU16(header + 6) == length &&
+         getU32(header + 8) == logCrc32(body(offset), length);
+}
+
+void RestartSnapshot::write(size_t offset, const uint8_t* data, size_t length) {
+  uint8_t* header = memory->data() + offset;
+  // マジックを消してから本体を書き、最後にマジックを戻す（途中でリセットされても半端な区画を使わない）
+  putU32(header, 0);
+  std::atomic_signal_fence(std::memory_order_seq_cst);
+  if (data != body(offset)) {
+    memcpy(body(offset), data, length);
+  }
+  putU16(header + 4, VERSION);
+  putU16(header + 6, (uint16_t)length);
+  putU32(header + 8, logCrc32(body(offset), length));
+  std::atomic_signal_fence(std::memory_order_seq_cst);
+  putU32(header, MAGIC);
+}
+
+bool RestartSnapshot::restoreSensorState(uint8_t index, SensorManagerState& state) const {
+  if (from == ORIGIN_NONE || !isValid(SENSOR_OFFSET, SENSOR_SIZE)) {
+    return false;
+  }
+  const uint8_t* p = body(SENSOR_OFFSET);
+  if (index >= p[0] || index >= SensorArray::MAX_SENSORS) {
+    return false;
+  }
+  memcpy(&state, p + 4 + index * STATE_SIZE, STATE_SIZE);
+  return true;
+}
+
+size_t RestartSnapshot::restoreHistory(SensorHistory& history, uint32_t now_ms) const {
+  if (from == ORIGIN_NONE || !isValid(HISTORY_OFFSET, HISTORY_SIZE)) {
+    return 0;
+  }
+  const uint8_t* p = body(HISTORY_OFFSET);
+  uint16_t count = getU16(p);
+  if (count == 0 || count > history.capacity()) {
+    return 0;
+  }
+
+  // SDカードから復元した（より古い）測定を置き換える
+  history.clear();
+  const uint8_t* samples = p + 4;
+  uint32_t newest = getU32(samples + (count - 1) * SAMPLE_SIZE);
+  uint32_t shift = now_ms - SensorManager::SENSOR_UPDATE_INTERVAL - newest;
+  for (uint16_t i = 0; i < count; i++) {
+    const uint8_t* sample = samples + i * SAMPLE_SIZE;
+    history.push(getU32(sample) + shift, getU16(sample + 4), getU16(sample + 6));
+  }
+  return count;
+}
+
+void RestartSnapshot::saveSensorStates(const SensorManagerState* states, uint8_t count) {
+  if (memory == nullptr) {
+    return;
+  }
+  count = count < SensorArray::MAX_SENSORS ? count : SensorArray::MAX_SENSORS;
+  // 本体は保持メモリ上で直接組み立てる（マジックを先に消す、使わない台数分は0にしてCRCを固定する）
+  putU32(memory->data() + SENSOR_OFFSET, 0);
+  uint8_t* p = body(SENSOR_OFFSET);
+  p[0] = count;
+  memset(p + 1, 0, 3);
+  memcpy(p + 4, states, count * STATE_SIZE);
+  memset(p + 4 + count * STATE_SIZE, 0, (SensorArray::MAX_SENSORS - count) * STATE_SIZE);
+  write(SENSOR_OFFSET, p, SENSOR_SIZE);
+}
+
+void RestartSnapshot::saveHistory(const SensorHistory& history) {
+  if (memory == nullptr || history.empty()) {
+    return;
+  }
+  // 本体は保持メモリ上で直接組み立てる（マジックを先に消す）
+  putU32(memory->data() + HISTORY_OFFSET, 0);
+  uint8_t* p = body(HISTORY_OFFSET);
+  putU16(p, (uint16_t)history.size());
+  putU16(p + 2, 0);
+  uint8_t* sample = p + 4;
+  for (size_t i = 0; i < history.size(); i++) {
+    putU32(sample, history.timestampAt(i));
+    putU16(sample + 4, history.tvocAt(i));
+    putU16(sample + 6, history.eco2At(i));
+    sample += SAMPLE_SIZE;
+  }
+  // 件数より後ろは前回の内容のままなので0にしてCRCを固定する
+  memset(sample, 0, (SensorHistory::SAMPLES - history.size()) * SAMPLE_SIZE);
+  write(HISTORY_OFFSET, p, HISTORY_SIZE);
+}
+
+bool RestartSnapshot::persist() {
+  if (memory == nullptr || store == nullptr || !store->begin(NVS_NAMESPACE, false)) {
+    return false;
+  }
+  bool written = store->putBytes(NVS_KEY_SNAPSHOT, memory->data(), TOTAL_SIZE) == TOTAL_SIZE;
+  store->end();
+  return written;
+}
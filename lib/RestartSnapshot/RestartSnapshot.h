@@ -0,0 +1,71 @@
+#ifndef RESTART_SNAPSHOT_H
+#define RESTART_SNAPSHOT_H
+
+#include <Hal.h>
+#include <SensorManager.h>
+#include <SensorArray.h>
+
+// 再起動（OTA・ブラウンアウト・ウォッチドッグ）をまたいだグラフの測定とセンサーの判定状態の引き継ぎ
+//
+// RTCメモリに定期的に書き込み（書き込みによる消耗がない）、計画的な再起動の直前にのみNVSへ写す
+// （ファームウェア更新でRTCメモリの配置が変わっても引き継げるように）。電源を切ると両方とも残らない
+//
+//   保持メモリ
+//     区画（センサーの台数 u8 | 予約 u8 × 3 | センサーごとの状態 × MAX_SENSORS）
+//     | 区画（測定の件数 u16 | 予約 u16 | (時刻 u32 | TVOC u16 | eCO2 u16) × 件数）
+//   区画の先頭
+//     マジック "TVSR" u32 | バージョン u16 | 本体の長さ u16 | 本体の CRC-32 u32
+//
+// 各区画は1つのタスクのみが書き込む（センサーの状態はセンサータスク、測定は描画タスク）。
+// 書き込み中はマジックを消しておくので、途中でリセットされた区画は使われない
+class RestartSnapshot {
+public:
+  static const uint32_t MAGIC = 0x52535654;   // "TVSR"
+  static const uint16_t VERSION = 2;
+  static const size_t HEADER_SIZE = 12;
+  static const size_t SENSOR_OFFSET = 0;
+  static const size_t STATE_SIZE = sizeof(SensorManagerState);
+  static const size_t SENSOR_SIZE = 4 + SensorArray::MAX_SENSORS * STATE_SIZE;
+  static const size_t HISTORY_OFFSET = 112;
+  static const size_t SAMPLE_SIZE = 8;
+  static const size_t HISTORY_SIZE = 4 + SensorHistory::SAMPLES * SAMPLE_SIZE;
+  static const size_t TOTAL_SIZE = HISTORY_OFFSET + HEADER_SIZE + HISTORY_SIZE;
+
+  // 引き継いだ内容の出どころ
+  enum Origin : uint8_t {
+    ORIGIN_NONE,
+    ORIGIN_RTC,
+    ORIGIN_NVS
+  };
+
+  RestartSnapshot();
+
+  // 起動時に呼び出し、引き継げる内容を確認する（NVSの写しは一度読んだら消す）
+  void init(RetainedMemory* memory, KeyValueStore* store);
+  bool isEnabled() const { return memory != nullptr; }
+  Origin origin() const { return from; }
+
+  // 引き継いだ index 番目のセンサーの状態・測定（なければ false / 0）
+  bool restoreSensorState(uint8_t index, SensorManagerState& state) const;
+  // history を置き換え、最新の測定が now_ms の1周期前になるよう時刻をずらす
+  size_t restoreHistory(SensorHistory& history, uint32_t now_ms) const;
+
+  // 定期的な書き込み（センサータスク／描画タスク）
+  // states: センサーごとの状態（count 台分、0番が主）
+  void saveSensorStates(const SensorManagerState* states, uint8_t count);
+  void saveHistory(const SensorHistory& history);
+
+  // 計画的な再起動の直前にRTCメモリの内容をNVSへ写す
+  bool persist();
+
+private:
+  RetainedMemory* memory;
+  KeyValueStore* store;
+  Origin from;
+
+  bool isValid(size_t offset, size_t length) const;
+  void write(size_t offset, const uint8_t* body, size_t length);
+  uint8_t* body(size_t offset) const { return memory->data() + offset + HEADER_SIZE; }
+};
+
+#endif // RESTART_SNAPSHOT_H
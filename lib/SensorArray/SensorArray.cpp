@@ -0,0 +1,509 @@
+#include "SensorArray.h"
+
+// SGP30のコマンド
+static const uint16_t CMD_IAQ_INIT = 0x2003;
+static const uint16_t CMD_MEASURE_IAQ = 0x2008;
+static const uint16_t CMD_GET_BASELINE = 0x2015;
+static const uint16_t CMD_SET_BASELINE = 0x201E;
+static const uint16_t CMD_SET_HUMIDITY = 0x2061;
+static const uint16_t CMD_MEASURE_RAW = 0x2050;
+static const uint16_t CMD_GET_FEATURE_SET = 0x202F;
+static const uint16_t CMD_GET_SERIAL_ID = 0x3682;
+
+static const uint32_t MAX_ABSOLUTE_HUMIDITY = 256000;   // 設定できる絶対湿度の上限 (mg/m³)
+
+// SensirionのCRC-8（多項式 0x31、初期値 0xFF、1語 = 2バイトごと）
+static uint8_t sgp30Crc(const uint8_t* data) {
+  uint8_t crc = 0xFF;
+  for (uint8_t i = 0; i < 2; i++) {
+    crc ^= data[i];
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x31) : (uint8_t)(crc << 1);
+    }
+  }
+  return crc;
+}
+
+// ---- マルチプレクサ ----
+
+I2cMux::I2cMux() :
+  bus(nullptr),
+  address(DEFAULT_ADDRESS),
+  current(NO_CHANNEL),
+  switches(0) {
+}
+
+void I2cMux::init(I2cBus* i2c_bus, uint8_t mux_address) {
+  bus = i2c_bus;
+  address = mux_address;
+  current = NO_CHANNEL;
+}
+
+bool I2cMux::writeControl(uint8_t value) {
+  switches++;
+  return bus->write(address, &value, 1);
+}
+
+bool I2cMux::select(uint8_t channel) {
+  if (channel >= CHANNEL_COUNT) {
+    return false;
+  }
+  if (channel == current) {
+    return true;
+  }
+  // 書き込みに失敗したら接続状態は不明なので次回も書き込む
+  current = writeControl((uint8_t)(1 << channel)) ? channel : NO_CHANNEL;
+  return current == channel;
+}
+
+bool I2cMux::release() {
+  current = NO_CHANNEL;
+  return writeControl(0);
+}
+
+// ---- SGP30 ----
+
+Sgp30Device::Sgp30Device() :
+  bus(nullptr),
+  mux(nullptr),
+  mux_channel(0),
+  tvoc_value(0),
+  eco2_value(0),
+  raw_h2(0),
+  raw_ethanol(0),
+  prefetched(0),
+  prefetch_failed(0),
+  nacks(0),
+  crc_errors(0),
+  last_result(I2C_OK) {
+}
+
+void Sgp30Device::init(I2cBus* i2c_bus, I2cMux* i2c_mux, uint8_t channel) {
+  bus = i2c_bus;
+  mux = i2c_mux;
+  mux_channel = channel;
+}
+
+bool Sgp30Device::sendCommand(uint16_t command, const uint16_t* args, uint8_t arg_count) {
+  last_result = I2C_NACK;
+  if (mux != nullptr && !mux->select(mux_channel)) {
+    nacks++;
+    return false;
+  }
+
+  // コマンド 2バイト | 引数ごとに 2バイト + CRC
+  uint8_t data[2 + MAX_WORDS * 3];
+  size_t length = 0;
+  data[length++] = (uint8_t)(command >> 8);
+  data[length++] = (uint8_t)(command & 0xFF);
+  for (uint8_t i = 0; i < arg_count && i < MAX_WORDS; i++) {
+    data[length] = (uint8_t)(args[i] >> 8);
+    data[length + 1] = (uint8_t)(args[i] & 0xFF);
+    data[length + 2] = sgp30Crc(data + length);
+    length += 3;
+  }
+  if (!bus->write(ADDRESS, data, length)) {
+    nacks++;
+    return false;
+  }
+  last_result = I2C_OK;
+  return true;
+}
+
+bool Sgp30Device::readWords(uint16_t* words, uint8_t count) {
+  last_result = I2C_NACK;
+  if (mux != nullptr && !mux->select(mux_channel)) {
+    nacks++;
+    return false;
+  }
+
+  uint8_t data[MAX_WORDS * 3];
+  size_t length = (size_t)count * 3;
+  if (count > MAX_WORDS || bus->read(ADDRESS, data, length) != length) {
+    nacks++;
+    return false;
+  }
+  for (uint8_t i = 0; i < count; i++) {
+    const uint8_t* word = data + i * 3;
+    if (sgp30Crc(word) != word[2]) {
+      crc_errors++;
+      last_result = I2C_CRC_ERROR;
+      return false;
+    }
+    words[i] = (uint16_t)((word[0] << 8) | word[1]);
+  }
+  last_result = I2C_OK;
+  return true;
+}
+
+bool Sgp30Device::transfer(uint16_t command, unsigned long wait_ms, uint16_t* words, uint8_t count) {
+  if (!sendCommand(command)) {
+    return false;
+  }
+  delay(wait_ms);
+  return readWords(words, count);
+}
+
+bool Sgp30Device::begin() {
+  // シリアル番号が読めて、製品がSGP30（機能セットの上位4ビットが 0）であること
+  uint16_t serial[3];
+  uint16_t features;
+  if (!transfer(CMD_GET_SERIAL_ID, COMMAND_TIME, serial, 3) ||
+      !transfer(CMD_GET_FEATURE_SET, COMMAND_TIME, &features, 1) || (features & 0xF000) != 0) {
+    return false;
+  }
+  return IAQinit();
+}
+
+bool Sgp30Device::IAQinit() {
+  prefetched = 0;
+  if (!sendCommand(CMD_IAQ_INIT)) {
+    return false;
+  }
+  delay(COMMAND_TIME);
+  return true;
+}
+
+bool Sgp30Device::takePrefetched(uint8_t kind, bool& result) {
+  if ((prefetched & kind) == 0) {
+    return false;
+  }
+  prefetched &= ~kind;
+  result = (prefetch_failed & kind) == 0;
+  return true;
+}
+
+bool Sgp30Device::IAQmeasure() {
+  bool result;
+  if (takePrefetched(PREFETCH_IAQ, result)) {
+    return result;
+  }
+
+  uint16_t words[2];
+  if (!transfer(CMD_MEASURE_IAQ, MEASURE_TIME, words, 2)) {
+    return false;
+  }
+  eco2_value = words[0];
+  tvoc_value = words[1];
+  return true;
+}
+
+bool Sgp30Device::IAQmeasureRaw() {
+  bool result;
+  if (takePrefetched(PREFETCH_RAW, result)) {
+    return result;
+  }
+
+  uint16_t words[2];
+  if (!transfer(CMD_MEASURE_RAW, RAW_MEASURE_TIME, words, 2)) {
+    return false;
+  }
+  raw_h2 = words[0];
+  raw_ethanol = words[1];
+  return true;
+}
+
+bool Sgp30Device::startMeasurement(bool raw) {
+  uint8_t kind = raw ? PREFETCH_RAW : PREFETCH_IAQ;
+  prefetched &= ~kind;
+  return sendCommand(raw ? CMD_MEASURE_RAW : CMD_MEASURE_IAQ);
+}
+
+bool Sgp30Device::collectMeasurement(bool raw) {
+  uint8_t kind = raw ? PREFETCH_RAW : PREFETCH_IAQ;
+  uint16_t words[2];
+  bool read = readWords(words, 2);
+  if (read && raw) {
+    raw_h2 = words[0];
+    raw_ethanol = words[1];
+  } else if (read) {
+    eco2_value = words[0];
+    tvoc_value = words[1];
+  }
+
+  prefetched |= kind;
+  prefetch_failed = read ? (prefetch_failed & ~kind) : (prefetch_failed | kind);
+  return read;
+}
+
+void Sgp30Device::failMeasurement(bool raw) {
+  uint8_t kind = raw ? PREFETCH_RAW : PREFETCH_IAQ;
+  prefetched |= kind;
+  prefetch_failed |= kind;
+}
+
+bool Sgp30Device::getIAQBaseline(uint16_t* eco2_base, uint16_t* tvoc_base) {
+  uint16_t words[2];
+  if (!transfer(CMD_GET_BASELINE, COMMAND_TIME, words, 2)) {
+    return false;
+  }
+  *eco2_base = words[0];
+  *tvoc_base = words[1];
+  return true;
+}
+
+bool Sgp30Device::setIAQBaseline(uint16_t eco2_base, uint16_t tvoc_base) {
+  // 引数はTVOC・eCO2の順
+  uint16_t args[2] = { tvoc_base, eco2_base };
+  if (!sendCommand(CMD_SET_BASELINE, args, 2)) {
+    return false;
+  }
+  delay(COMMAND_TIME);
+  return true;
+}
+
+bool Sgp30Device::setHumidity(uint32_t absolute_humidity) {
+  if (absolute_humidity > MAX_ABSOLUTE_HUMIDITY) {
+    return false;
+  }
+
+  // g/m³ の 8.8 固定小数点（0: 補正なし）
+  uint16_t scaled = (uint16_t)(((uint64_t)absolute_humidity * 256 * 16777) >> 24);
+  if (!sendCommand(CMD_SET_HUMIDITY, &scaled, 1)) {
+    return false;
+  }
+  delay(COMMAND_TIME);
+  return true;
+}
+
+// ---- 集計 ----
+
+const char* sensorAggregateName(SensorAggregate mode) {
+  return mode == SENSOR_AGGREGATE_MEAN ? "mean" : "max";
+}
+
+bool aggregatePoints(const SensorPoint* points, uint8_t count, SensorAggregate mode,
+                     uint16_t* tvoc, uint16_t* eco2) {
+  uint8_t used = 0;
+  uint32_t tvoc_total = 0;
+  uint32_t eco2_total = 0;
+  uint16_t tvoc_max = 0;
+  uint16_t eco2_max = 0;
+
+  for (uint8_t i = 0; i < count; i++) {
+    if (!points[i].connected) {
+      continue;
+    }
+    used++;
+    tvoc_total += points[i].tvoc;
+    eco2_total += points[i].eco2;
+    tvoc_max = points[i].tvoc > tvoc_max ? points[i].tvoc : tvoc_max;
+    eco2_max = points[i].eco2 > eco2_max ? points[i].eco2 : eco2_max;
+  }
+  if (used == 0) {
+    return false;
+  }
+
+  if (mode == SENSOR_AGGREGATE_MEAN) {
+    *tvoc = (uint16_t)((tvoc_total + used / 2) / used);
+    *eco2 = (uint16_t)((eco2_total + used / 2) / used);
+  } else {
+    *tvoc = tvoc_max;
+    *eco2 = eco2_max;
+  }
+  return true;
+}
+
+// ---- 複数のセンサー ----
+
+// 測定コマンドから結果までの時間 (us)（measure_iaq は 12 ms、measure_raw は 25 ms 前後）
+static const uint32_t LATENCY_BUCKETS_US[] = {
+  12500, 13000, 15000, 20000, 25500, 26000, 28000, 35000, 50000, 100000
+};
+// 1回の測定の再試行の回数
+static const uint32_t RETRY_BUCKETS[] = { 0, 1, 2, 3 };
+
+SensorArray::SensorArray() :
+  mux(),
+  count(0),
+  phases(),
+  sent(),
+  sent_at(),
+  due_at(),
+  attempts(),
+  cycle_active(false),
+  cycle_raw(false),
+  cycle_start_us(0),
+  cycle_busy_us(0),
+  last_cycle_us(0),
+  cycle_count(0),
+  cycle_total_us(0),
+  cycle_max_us(0),
+  busy_total_us(0),
+  failures(0),
+  iaq_latency(LATENCY_BUCKETS_US, sizeof(LATENCY_BUCKETS_US) / sizeof(LATENCY_BUCKETS_US[0])),
+  raw_latency(LATENCY_BUCKETS_US, sizeof(LATENCY_BUCKETS_US) / sizeof(LATENCY_BUCKETS_US[0])),
+  retry_counts(RETRY_BUCKETS, sizeof(RETRY_BUCKETS) / sizeof(RETRY_BUCKETS[0])) {
+}
+
+void SensorArray::init(I2cBus* bus, uint8_t mux_address, const uint8_t* channels, uint8_t sensor_count) {
+  mux.init(bus, mux_address);
+  if (sensor_count == 0) {
+    count = 0;
+  } else {
+    count = mux_address == 0 ? 1 : (sensor_count < MAX_SENSORS ? sensor_count : MAX_SENSORS);
+  }
+  cycle_active = false;
+  for (uint8_t i = 0; i < count; i++) {
+    devices[i].init(bus, mux_address != 0 ? &mux : nullptr, channels[i]);
+  }
+}
+
+void SensorArray::measure(bool raw) {
+  startCycle(raw);
+  finishCycle();
+}
+
+bool SensorArray::startCycle(bool raw) {
+  if (cycle_active) {
+    return false;
+  }
+
+  uint32_t start_us = micros();
+  cycle_active = true;
+  cycle_raw = raw;
+  cycle_start_us = start_us;
+  cycle_busy_us = 0;
+
+  // 全センサーへ measure_iaq を続けて送る
+  for (uint8_t i = 0; i < count; i++) {
+    phases[i] = PHASE_IAQ;
+    attempts[i] = 0;
+    sent_at[i] = micros();
+    sendPhase(i);
+  }
+  cycle_busy_us += micros() - start_us;
+  return true;
+}
+
+void SensorArray::sendPhase(uint8_t index) {
+  bool raw = phases[index] == PHASE_RAW;
+  sent[index] = devices[index].startMeasurement(raw);
+  // 測定時間はコマンドを受け取ってから
+  unsigned long wait_ms = raw ? Sgp30Device::RAW_MEASURE_TIME : Sgp30Device::MEASURE_TIME;
+  due_at[index] = micros() + (sent[index] ? wait_ms * 1000 : RETRY_INTERVAL_US);
+}
+
+void SensorArray::nextPhase(uint8_t index) {
+  // measure_iaq を読んだセンサーには他のセンサーを待たずに measure_raw を送る
+  if (phases[index] == PHASE_IAQ && cycle_raw) {
+    phases[index] = PHASE_RAW;
+    attempts[index] = 0;
+    sent_at[index] = micros();
+    sendPhase(index);
+  } else {
+    phases[index] = PHASE_IDLE;
+  }
+}
+
+void SensorArray::stepPhase(uint8_t index) {
+  bool raw = phases[index] == PHASE_RAW;
+  Sgp30Device& device = devices[index];
+
+  if (sent[index] && device.collectMeasurement(raw)) {
+    (raw ? raw_latency : iaq_latency).observe(micros() - sent_at[index]);
+    retry_counts.observe(attempts[index]);
+    nextPhase(index);
+    return;
+  }
+
+  if (attempts[index] >= MAX_RETRIES) {
+    // 諦める（次の IAQmeasure() などは失敗を返す）
+    device.failMeasurement(raw);
+    failures++;
+    retry_counts.observe(attempts[index]);
+    nextPhase(index);
+    return;
+  }
+
+  // 送れなかったかCRCエラー（結果は失われた）ならコマンドから送り直し、NACKなら測定の終わりを待って読み直す
+  attempts[index]++;
+  if (!sent[index] || device.lastResult() == I2C_CRC_ERROR) {
+    sendPhase(index);
+  } else {
+    due_at[index] = micros() + RETRY_INTERVAL_US;
+  }
+}
+
+unsigned long SensorArray::poll() {
+  if (!cycle_active) {
+    return 0;
+  }
+
+  uint32_t start_us = micros();
+  bool pending = false;
+  uint32_t next_us = UINT32_MAX;
+  for (uint8_t i = 0; i < count; i++) {
+    if (phases[i] == PHASE_IDLE) {
+      continue;
+    }
+    if ((int32_t)(micros() - due_at[i]) >= 0) {
+      stepPhase(i);
+      if (phases[i] == PHASE_IDLE) {
+        continue;
+      }
+    }
+    pending = true;
+    uint32_t now = micros();
+    uint32_t wait_us = (int32_t)(due_at[i] - now) > 0 ? due_at[i] - now : 0;
+    next_us = wait_us < next_us ? wait_us : next_us;
+  }
+  uint32_t end_us = micros();
+  cycle_busy_us += end_us - start_us;
+
+  if (pending) {
+    // 次の期限まで（ミリ秒単位のスケジューラなので切り上げ、少なくとも 1 ms）
+    unsigned long wait_ms = (next_us + 999) / 1000;
+    return wait_ms > 0 ? wait_ms : 1;
+  }
+
+  cycle_active = false;
+  last_cycle_us = end_us - cycle_start_us;
+  cycle_count++;
+  cycle_total_us += last_cycle_us;
+  busy_total_us += cycle_busy_us;
+  if (last_cycle_us > cycle_max_us) {
+    cycle_max_us = last_cycle_us;
+  }
+  return 0;
+}
+
+void SensorArray::finishCycle() {
+  unsigned long wait;
+  while ((wait = poll()) > 0) {
+    delay(wait);
+  }
+}
+
+uint32_t SensorArray::nackCount() const {
+  uint32_t nacks = 0;
+  for (uint8_t i = 0; i < count; i++) {
+    nacks += devices[i].nackCount();
+  }
+  return nacks;
+}
+
+uint32_t SensorArray::crcErrorCount() const {
+  uint32_t crc_errors = 0;
+  for (uint8_t i = 0; i < count; i++) {
+    crc_errors += devices[i].crcErrorCount();
+  }
+  return crc_errors;
+}
+
+void SensorArray::logStats() {
+  if (cycle_count == 0) {
+    return;
+  }
+
+  Serial.printf("Sensor array (%u sensors): avg %lu us (busy %lu us), max %lu us per cycle\n",
+                count, (unsigned long)(cycle_total_us / cycle_count), (unsigned long)(busy_total_us / cycle_count),
+                (unsigned long)cycle_max_us);
+  Serial.printf("Sensor array since boot: %lu mux switches, %lu NACKs, %lu CRC errors, %lu retried, %lu failed\n",
+                (unsigned long)mux.switchCount(), (unsigned long)nackCount(), (unsigned long)crcErrorCount(),
+                (unsigned long)(retry_counts.count() - retry_counts.bucket(0)), (unsigned long)failures);
+  cycle_count = 0;
+  cycle_total_us = 0;
+  cycle_max_us = 0;
+  busy_total_us = 0;
+}
@@ -0,0 +1,207 @@
+#ifndef SENSOR_ARRAY_H
+#define SENSOR_ARRAY_H
+
+#include <Hal.h>
+#include <SensorManager.h>
+#include <OpenMetrics.h>
+
+// I2Cの転送の結果
+enum I2cResult : uint8_t {
+  I2C_OK,
+  I2C_NACK,        // 応答なし（SGP30は測定・処理中も応答しない）
+  I2C_CRC_ERROR    // 読み取ったデータのCRCが一致しない
+};
+
+// TCA9548A（8チャンネルのI2Cマルチプレクサ、制御レジスタのビットごとにチャンネルを接続）
+class I2cMux {
+public:
+  static const uint8_t DEFAULT_ADDRESS = 0x70;
+  static const uint8_t CHANNEL_COUNT = 8;
+  static const uint8_t NO_CHANNEL = 0xFF;
+
+  I2cMux();
+
+  void init(I2cBus* bus, uint8_t address);
+
+  // channel のみを接続する（接続済みなら書き込まない）
+  bool select(uint8_t channel);
+  // 全チャンネルを切り離す
+  bool release();
+
+  // 制御レジスタへの書き込み回数
+  uint32_t switchCount() const { return switches; }
+
+private:
+  I2cBus* bus;
+  uint8_t address;
+  uint8_t current;     // 接続中のチャンネル（NO_CHANNEL: 不明・なし）
+  uint32_t switches;
+
+  bool writeControl(uint8_t value);
+};
+
+// I2Cで直接コマンドを送るSGP30（マルチプレクサのチャンネルごとに1台、手順は Adafruit_SGP30 と同じ）
+//
+// 測定は startMeasurement() でコマンドを送り、測定時間の後に collectMeasurement() で読み取る形にも分けられる。
+// 読み取った結果は次の IAQmeasure() / IAQmeasureRaw() がI2Cを使わずに返す（SensorManager はそのまま使える）
+class Sgp30Device : public SensorDriver {
+public:
+  static const uint8_t ADDRESS = 0x58;
+  static const unsigned long MEASURE_TIME = 12;       // measure_iaq の測定時間 (ms)
+  static const unsigned long RAW_MEASURE_TIME = 25;   // measure_raw の測定時間 (ms)
+  static const unsigned long COMMAND_TIME = 10;       // その他のコマンドの処理時間 (ms)
+
+  Sgp30Device();
+
+  // mux: nullptr ならマルチプレクサを使わない（channel は無視）
+  void init(I2cBus* bus, I2cMux* mux, uint8_t channel);
+
+  bool begin() override;
+  bool IAQinit() override;
+  bool IAQmeasure() override;
+  bool IAQmeasureRaw() override;
+  bool getIAQBaseline(uint16_t* eco2_base, uint16_t* tvoc_base) override;
+  bool setIAQBaseline(uint16_t eco2_base, uint16_t tvoc_base) override;
+  bool setHumidity(uint32_t absolute_humidity) override;
+  uint16_t tvoc() const override { return tvoc_value; }
+  uint16_t eco2() const override { return eco2_value; }
+  uint16_t rawH2() const override { return raw_h2; }
+  uint16_t rawEthanol() const override { return raw_ethanol; }
+
+  // 分割した測定（raw: 生信号の測定）。コマンドを送れたら true
+  bool startMeasurement(bool raw);
+  // 測定時間の経過後に結果を読み取る（読めなければ次の IAQmeasure() などが false を返す）
+  bool collectMeasurement(bool raw);
+  // 分割した測定を諦める（次の IAQmeasure() などはI2Cを使わずに false を返す）
+  void failMeasurement(bool raw);
+  // 直近の転送の結果
+  I2cResult lastResult() const { return last_result; }
+
+  uint8_t channel() const { return mux_channel; }
+  uint32_t nackCount() const { return nacks; }
+  uint32_t crcErrorCount() const { return crc_errors; }
+
+private:
+  static const uint8_t PREFETCH_IAQ = 0x01;
+  static const uint8_t PREFETCH_RAW = 0x02;
+  static const uint8_t MAX_WORDS = 3;
+
+  I2cBus* bus;
+  I2cMux* mux;
+  uint8_t mux_channel;
+  uint16_t tvoc_value;
+  uint16_t eco2_value;
+  uint16_t raw_h2;
+  uint16_t raw_ethanol;
+  uint8_t prefetched;        // 読み取り済みで未使用の結果（PREFETCH_*）
+  uint8_t prefetch_failed;   // 読み取りに失敗した結果（PREFETCH_*）
+  uint32_t nacks;
+  uint32_t crc_errors;
+  I2cResult last_result;
+
+  bool sendCommand(uint16_t command, const uint16_t* args = nullptr, uint8_t arg_count = 0);
+  bool readWords(uint16_t* words, uint8_t count);
+  // コマンドを送り、wait_ms 待ってから count 語を読む
+  bool transfer(uint16_t command, unsigned long wait_ms, uint16_t* words, uint8_t count);
+  bool takePrefetched(uint8_t kind, bool& result);
+};
+
+// 複数のセンサーの値の集計方法
+enum SensorAggregate : uint8_t {
+  SENSOR_AGGREGATE_MAX,    // 最も高い値（どこか1か所でも悪化していれば分かる）
+  SENSOR_AGGREGATE_MEAN    // 平均（部屋全体の傾向）
+};
+
+const char* sensorAggregateName(SensorAggregate mode);
+
+// 測定できたセンサーの値を集計する（測定できたセンサーがなければ false で tvoc・eco2 は変更しない）
+bool aggregatePoints(const SensorPoint* points, uint8_t count, SensorAggregate mode,
+                     uint16_t* tvoc, uint16_t* eco2);
+
+// マルチプレクサの先の複数のSGP30（センサータスクで使用）
+//
+// 各センサーへ測定コマンドを続けて送り、測定時間の後に順に読み取る。
+// 待ち時間はセンサーの数によらず measure_iaq の 12 ms（生信号も測定するなら measure_raw の 25 ms を加える）で、
+// 1台ずつ測定する場合の (12 + 25) ms × 台数 に比べ、8台でも1秒周期の数%に収まる。
+//
+// 測定は startCycle() / poll() で分割でき、待ち時間の間は呼び出し元に戻る（タスクは他のジョブを実行するか眠れる）。
+// measure_iaq の結果を読んだセンサーには、他のセンサーを待たずに measure_raw を送る。
+// 読み取りがNACKなら測定が終わっていないので少し後に読み直し、CRCエラーなら結果は失われているのでコマンドから送り直す
+class SensorArray {
+public:
+  static const uint8_t MAX_SENSORS = I2cMux::CHANNEL_COUNT;
+  static const uint8_t MAX_RETRIES = 3;               // 1回の測定の再試行の上限
+  static const uint32_t RETRY_INTERVAL_US = 2000;     // NACK・送信の失敗から再試行までの時間
+
+  SensorArray();
+
+  // channels: 各センサーのチャンネル（mux_address が 0 ならマルチプレクサなしの1台のみ、count が 0 なら使わない）
+  void init(I2cBus* bus, uint8_t mux_address, const uint8_t* channels, uint8_t count);
+
+  uint8_t size() const { return count; }
+  Sgp30Device& device(uint8_t index) { return devices[index]; }
+
+  // 全センサーの測定をまとめて行う（結果は各センサーの次の IAQmeasure() / IAQmeasureRaw() が返す）
+  void measure(bool raw);
+
+  // 分割した測定：全センサーへ測定コマンドを送ってすぐに戻る（前の周期が終わっていなければ false）
+  bool startCycle(bool raw);
+  // 測定時間の過ぎたセンサーから結果を読み取る。次に呼び出すまでの時間 (ms) を返す
+  // （0: 周期の完了、結果は各センサーの次の IAQmeasure() / IAQmeasureRaw() が返す）
+  unsigned long poll();
+  // 周期の完了まで待つ（周期の途中で他のコマンドを送る前など）
+  void finishCycle();
+  bool cycleActive() const { return cycle_active; }
+
+  // 直近の周期の最初のコマンドから最後の読み取りまでの時間 (us)
+  uint32_t lastCycleMicros() const { return last_cycle_us; }
+  // 測定コマンドから結果を読み取るまでの時間（再試行を含む）
+  const MetricsHistogram& latency(bool raw) const { return raw ? raw_latency : iaq_latency; }
+  // 1回の測定の再試行の回数
+  const MetricsHistogram& retries() const { return retry_counts; }
+  // 再試行しても読めなかった測定
+  uint32_t failureCount() const { return failures; }
+  uint32_t nackCount() const;
+  uint32_t crcErrorCount() const;
+
+  // 前回の出力以降の測定時間と通信エラーをSerialへ出力
+  void logStats();
+
+private:
+  // センサーごとの周期の段階
+  enum Phase : uint8_t {
+    PHASE_IDLE,
+    PHASE_IAQ,   // measure_iaq の結果待ち
+    PHASE_RAW    // measure_raw の結果待ち
+  };
+
+  I2cMux mux;
+  Sgp30Device devices[MAX_SENSORS];
+  uint8_t count;
+  Phase phases[MAX_SENSORS];
+  bool sent[MAX_SENSORS];             // 測定コマンドを送れたか
+  uint32_t sent_at[MAX_SENSORS];      // 最初に測定コマンドを送った時刻 (us)
+  uint32_t due_at[MAX_SENSORS];       // 次に読み取る（送り直す）時刻 (us)
+  uint8_t attempts[MAX_SENSORS];      // 再試行の回数
+
+  bool cycle_active;
+  bool cycle_raw;
+  uint32_t cycle_start_us;
+  uint32_t cycle_busy_us;             // 周期のうち呼び出し元に戻らずに転送していた時間
+
+  uint32_t last_cycle_us;
+  uint32_t cycle_count;
+  uint64_t cycle_total_us;
+  uint32_t cycle_max_us;
+  uint64_t busy_total_us;
+  uint32_t failures;
+  MetricsHistogram iaq_latency;
+  MetricsHistogram raw_latency;
+  MetricsHistogram retry_counts;
+
+  void sendPhase(uint8_t index);
+  void stepPhase(uint8_t index);
+  void nextPhase(uint8_t index);
+};
+
+#endif // SENSOR_ARRAY_H
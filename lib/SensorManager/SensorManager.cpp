@@ -3,53 +3,147 @@
 
 SensorManager::SensorManager() :
   sgp(nullptr),
-  preferences(nullptr),
+  sensor_index(0),
+  environment(nullptr),
+  humidity_source(nullptr),
+  humidity_compensation(),
+  baselines(),
+  quality(),
+  last_score(),
+  epoch_clock(nullptr),
   tvoc_value(0),
   eco2_value(0),
+  raw_h2(0),
+  raw_ethanol(0),
+  raw_enabled(false),
+  h2_chain(),
+  ethanol_chain(),
+  eco2_baseline(0),
+  tvoc_baseline(0),
+  baseline_read_failures(0),
   condition_flag(false),
   stable_condition_start(0),
-  last_auto_check_time(0),
   last_read_time(0),
   last_baseline_save_time(0),
   demo_phase(0.0) {
 }
 
-bool SensorManager::init(Adafruit_SGP30* sensor, Preferences* prefs) {
+bool SensorManager::init(SensorDriver* sensor, KeyValueStore* prefs, uint8_t index) {
   sgp = sensor;
-  preferences = prefs;
+  sensor_index = index;
+  baselines.init(prefs, index);
+  quality.init(&baselines);
+
+  // 温湿度はSGP30がなくても測る（共有する他のSGP30の補正に使う）
+  if (humidity_source != nullptr) {
+    humidity_compensation.initShared(&humidity_source->humidity_compensation, sgp);
+  } else {
+    humidity_compensation.init(environment, sgp);
+  }
 
   if (!sgp->begin()) {
     return false;
   }
 
   // ベースラインの読み込みを試みる
-  loadBaseline(sgp, preferences);
+  loadBaseline(sgp);
   return true;
 }
 
-void SensorManager::update(bool sensor_connected) {
-  // 1秒ごとにセンサーを更新
-  if (millis() - last_read_time < SENSOR_UPDATE_INTERVAL) {
+bool SensorManager::setSignalChain(const SignalChainConfig& config) {
+  bool valid = h2_chain.configure(config);
+  return ethanol_chain.configure(config) && valid;
+}
+
+void SensorManager::logSignalStats() const {
+  if (!raw_enabled) {
     return;
   }
+  Serial.printf("Signals: H2 %u -> %u (%d/min), ethanol %u -> %u (%d/min), %lu spikes, %lu changes\n",
+                raw_h2, h2_chain.output(), h2_chain.rate().rate(),
+                raw_ethanol, ethanol_chain.output(), ethanol_chain.rate().rate(),
+                (unsigned long)(h2_chain.spikes() + ethanol_chain.spikes()),
+                (unsigned long)(h2_chain.rate().events() + ethanol_chain.rate().events()));
+}
 
+bool SensorManager::update(bool sensor_connected) {
   last_read_time = millis();
 
   if (sensor_connected) {
     // 実際のセンサーから読み取り
     if (!sgp->IAQmeasure()) {
       Serial.println("Measurement failed");
-      return;
+      return false;
     }
-    tvoc_value = sgp->TVOC;
-    eco2_value = sgp->eCO2;
+    tvoc_value = sgp->tvoc();
+    eco2_value = sgp->eco2();
 
-    // 定期的なベースライン保存処理
-    checkPeriodicBaselineSave();
+    // 記録の再生中は記録上の時刻で判定する
+    uint32_t recorded_time;
+    if (sgp->sampleTime(&recorded_time)) {
+      last_read_time = recorded_time;
+    }
+    quality.observe(eco2_value, tvoc_value, last_read_time);
+
+    // 生信号は読めた場合のみ処理する（読めなければ前回の値のまま）
+    if (raw_enabled && sgp->IAQmeasureRaw()) {
+      raw_h2 = sgp->rawH2();
+      raw_ethanol = sgp->rawEthanol();
+      h2_chain.apply(last_read_time, raw_h2);
+      ethanol_chain.apply(last_read_time, raw_ethanol);
+    }
   } else {
     // デモデータの生成
     generateDemoData();
   }
+
+  return true;
+}
+
+SensorSample SensorManager::getLatestSample() const {
+  SensorSample sample;
+  sample.timestamp = last_read_time;
+  sample.tvoc = tvoc_value;
+  sample.eco2 = eco2_value;
+  sample.raw_h2 = raw_h2;
+  sample.raw_ethanol = raw_ethanol;
+  sample.h2_filtered = h2_chain.output();
+  sample.ethanol_filtered = ethanol_chain.output();
+  sample.h2_rate = h2_chain.rate().rate();
+  sample.ethanol_rate = ethanol_chain.rate().rate();
+  sample.signal_change = h2_chain.rate().active() || ethanol_chain.rate().active();
+  sample.signal_changes = h2_chain.rate().events() + ethanol_chain.rate().events();
+  sample.signal_spikes = h2_chain.spikes() + ethanol_chain.spikes();
+  sample.eco2_base = eco2_baseline;
+  sample.tvoc_base = tvoc_baseline;
+  sample.baseline_saves = baselines.writeCount();
+  sample.baseline_save_failures = baseline_read_failures + baselines.failureCount();
+  sample.baseline_save_skips = baselines.skipCount();
+  sample.baseline_rejects = quality.rejectCount();
+  sample.baseline_rollbacks = quality.rollbackCount();
+  sample.eco2_base_drift = quality.eco2DriftPerDay();
+  sample.tvoc_base_drift = quality.tvocDriftPerDay();
+  sample.environment_valid = humidity_compensation.hasReading();
+  sample.temperature = humidity_compensation.temperature();
+  sample.humidity = humidity_compensation.humidity();
+  sample.absolute_humidity = humidity_compensation.absolute();
+  sample.applied_humidity = humidity_compensation.applied();
+  sample.clean_air_detected = condition_flag;
+  sample.clean_air_remaining = getCleanAirRemainingTime();
+  return sample;
+}
+
+SensorPoint SensorManager::getLatestPoint(bool connected) const {
+  SensorPoint point = {};
+  point.timestamp = last_read_time;
+  point.sensor = sensor_index;
+  point.connected = connected;
+  point.clean_air_detected = condition_flag;
+  point.tvoc = tvoc_value;
+  point.eco2 = eco2_value;
+  point.eco2_base = eco2_baseline;
+  point.tvoc_base = tvoc_baseline;
+  return point;
 }
 
 void SensorManager::generateDemoData() {
@@ -63,95 +157,153 @@ void SensorManager::generateDemoData() {
   eco2_value = 1200 + (int)(400 * cos(demo_phase * 0.7));
 }
 
-bool SensorManager::saveBaseline(Adafruit_SGP30* sensor, Preferences* prefs) {
+bool SensorManager::saveBaseline(SensorDriver* sensor, BaselineSource source) {
   uint16_t eco2_base, tvoc_base;
+  last_score = {};
 
-  if (!sensor->getIAQBaseline(&eco2_base, &tvoc_base)) {
+  // 0 は未学習（読み込み時も保存なしとみなす）
+  if (!sensor->getIAQBaseline(&eco2_base, &tvoc_base) || eco2_base == 0 || tvoc_base == 0) {
     Serial.println("Failed to get baseline readings");
+    baseline_read_failures++;
     return false;
   }
 
-  prefs->begin("sgp30", false);
-  prefs->putUShort("eco2_base", eco2_base);
-  prefs->putUShort("tvoc_base", tvoc_base);
-  prefs->end();
+  // 手動保存はクリーンエアの場合のみ（定期保存はセンサーが学習中の値をそのまま控える）
+  uint32_t epoch = epoch_clock != nullptr ? epoch_clock() : 0;
+  bool clean_air = source != BASELINE_SOURCE_MANUAL || isCleanAirCondition();
+  last_score = quality.evaluate(eco2_base, tvoc_base, clean_air, epoch, last_read_time);
+  if (last_score.verdict != BASELINE_ACCEPTED) {
+    if (last_score.verdict == BASELINE_REJECTED_NOT_CLEAN) {
+      Serial.printf("Baseline rejected: eCO2=%u, TVOC=%u (not clean air)\n", eco2_base, tvoc_base);
+    } else {
+      Serial.printf("Baseline rejected: eCO2=%u, TVOC=%u (median %u/%u, score %u%%)\n", eco2_base, tvoc_base,
+                    last_score.reference_eco2, last_score.reference_tvoc, last_score.score);
+    }
+    return false;
+  }
 
-  Serial.println("Baseline saved: eCO2=" + String(eco2_base) + ", TVOC=" + String(tvoc_base));
+  BaselineRecord previous;
+  bool has_previous = baselines.latest(previous);
+  BaselineWrite result = baselines.save(eco2_base, tvoc_base, last_score.shift ? BASELINE_SOURCE_SHIFT : source, epoch);
+  if (result == BASELINE_FAILED) {
+    Serial.println("Failed to write baseline");
+    return false;
+  }
+
+  eco2_baseline = eco2_base;
+  tvoc_baseline = tvoc_base;
+  if (result == BASELINE_UNCHANGED) {
+    Serial.printf("Baseline unchanged: eCO2=%u, TVOC=%u (not written)\n", eco2_base, tvoc_base);
+  } else {
+    BaselineRecord saved;
+    baselines.latest(saved);
+    quality.onSaved(has_previous ? &previous : nullptr, saved, last_read_time);
+    Serial.printf("Baseline saved: eCO2=%u, TVOC=%u (score %u%%)\n", eco2_base, tvoc_base, last_score.score);
+  }
   return true;
 }
 
-bool SensorManager::loadBaseline(Adafruit_SGP30* sensor, Preferences* prefs) {
-  prefs->begin("sgp30", false);
-  uint16_t eco2_base = prefs->getUShort("eco2_base", 0);
-  uint16_t tvoc_base = prefs->getUShort("tvoc_base", 0);
-  prefs->end();
+bool SensorManager::rollbackBaseline(SensorDriver* sensor) {
+  const BaselineRecord& target = quality.rollbackTarget();
+  if (!sensor->setIAQBaseline(target.eco2_base, target.tvoc_base)) {
+    Serial.println("Failed to set baseline values");
+    return false;
+  }
+
+  uint32_t epoch = epoch_clock != nullptr ? epoch_clock() : 0;
+  if (baselines.save(target.eco2_base, target.tvoc_base, BASELINE_SOURCE_ROLLBACK, epoch) == BASELINE_FAILED) {
+    Serial.println("Failed to write baseline");
+  }
+  quality.onRolledBack();
 
-  if (eco2_base == 0 || tvoc_base == 0) {
+  eco2_baseline = target.eco2_base;
+  tvoc_baseline = target.tvoc_base;
+  Serial.printf("Baseline rolled back to #%lu: eCO2=%u, TVOC=%u\n", (unsigned long)target.sequence,
+                target.eco2_base, target.tvoc_base);
+  return true;
+}
+
+bool SensorManager::loadBaseline(SensorDriver* sensor) {
+  BaselineRecord record;
+  if (!baselines.latest(record)) {
     Serial.println("No valid baseline saved");
     return false;
   }
 
-  if (!sensor->setIAQBaseline(eco2_base, tvoc_base)) {
+  if (!sensor->setIAQBaseline(record.eco2_base, record.tvoc_base)) {
     Serial.println("Failed to set baseline values");
     return false;
   }
 
-  Serial.println("Baseline loaded: eCO2=" + String(eco2_base) + ", TVOC=" + String(tvoc_base));
+  eco2_baseline = record.eco2_base;
+  tvoc_baseline = record.tvoc_base;
+  Serial.printf("Baseline loaded: eCO2=%u, TVOC=%u\n", record.eco2_base, record.tvoc_base);
   return true;
 }
 
-bool SensorManager::resetBaseline(Adafruit_SGP30* sensor) {
+bool SensorManager::resetBaseline(SensorDriver* sensor) {
   if (!sensor->IAQinit()) {
     return false;
   }
 
   condition_flag = false;
+  eco2_baseline = 0;
+  tvoc_baseline = 0;
   Serial.println("Baseline reset");
   return true;
 }
 
-bool SensorManager::getBaseline(Adafruit_SGP30* sensor, uint16_t* eco2_base, uint16_t* tvoc_base) {
+bool SensorManager::getBaseline(SensorDriver* sensor, uint16_t* eco2_base, uint16_t* tvoc_base) {
   return sensor->getIAQBaseline(eco2_base, tvoc_base);
 }
 
 void SensorManager::checkAutoBaseline() {
-  // AUTO_CHECK_INTERVALごとに自動ベースラインチェック
-  if (millis() - last_auto_check_time < AUTO_CHECK_INTERVAL) {
-    return;
-  }
-
-  last_auto_check_time = millis();
+  // センサーが学習中のベースラインを控えておく
+  getBaseline(sgp, &eco2_baseline, &tvoc_baseline);
 
   // クリーンエアの条件をチェック
   if (isGoodConditionForBaseline(eco2_value, tvoc_value)) {
-    saveBaseline(sgp, preferences);
+    saveBaseline(sgp, BASELINE_SOURCE_CLEAN_AIR);
   }
 }
 
-void SensorManager::checkPeriodicBaselineSave() {
-  // 12時間ごとに定期保存
-  if (millis() - last_baseline_save_time >= BASELINE_AUTO_SAVE_INTERVAL) {
-    last_baseline_save_time = millis();
-    
-    // ベースラインを保存
-    if (saveBaseline(sgp, preferences)) {
-      Serial.println("Periodic baseline save completed");
-    } else {
-      Serial.println("Periodic baseline save failed");
-    }
+void SensorManager::periodicBaselineSave() {
+  last_baseline_save_time = millis();
+
+  // ベースラインを保存
+  if (saveBaseline(sgp, BASELINE_SOURCE_PERIODIC)) {
+    Serial.println("Periodic baseline save completed");
+  } else {
+    Serial.println("Periodic baseline save failed");
   }
 }
 
+SensorManagerState SensorManager::exportState() const {
+  SensorManagerState state = {};
+  state.clean_air_detected = condition_flag ? 1 : 0;
+  state.clean_air_elapsed = condition_flag ? (uint32_t)(last_read_time - stable_condition_start) : 0;
+  state.since_periodic_save = (uint32_t)(millis() - last_baseline_save_time);
+  return state;
+}
+
+void SensorManager::restoreState(const SensorManagerState& state) {
+  // 再起動にかかった時間は分からないので、止まっていた間も条件が続いていたものとみなさない
+  last_read_time = millis();
+  condition_flag = state.clean_air_detected != 0 && state.clean_air_elapsed < STABLE_TIME;
+  stable_condition_start = condition_flag ? last_read_time - state.clean_air_elapsed : 0;
+  last_baseline_save_time = millis() - state.since_periodic_save;
+}
+
 bool SensorManager::isGoodConditionForBaseline(uint16_t eco2_value, uint16_t tvoc_value) {
   // eCO2が400-500ppmの範囲内かつTVOCが100ppb以下
   bool isCleanNow = (eco2_value >= ECO2_MIN && eco2_value <= ECO2_MAX && tvoc_value <= TVOC_MAX);
 
   if (isCleanNow) {
     if (!condition_flag) {
-      stable_condition_start = millis();
+      stable_condition_start = last_read_time;
       condition_flag = true;
       Serial.println("Clean air condition detected, monitoring stability...");
-    } else if (millis() - stable_condition_start >= STABLE_TIME) {
+    } else if (last_read_time - stable_condition_start >= STABLE_TIME) {
       condition_flag = false; // リセット
       Serial.println("Clean air condition stable for required time");
       return true;
@@ -175,7 +327,7 @@ unsigned long SensorManager::getCleanAirRemainingTime() const {
     return 0;
   }
 
-  unsigned long elapsed = millis() - stable_condition_start;
+  unsigned long elapsed = last_read_time - stable_condition_start;
   if (elapsed >= STABLE_TIME) {
     return 0;
   }
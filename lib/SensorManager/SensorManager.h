@@ -1,30 +1,129 @@
 #ifndef SENSOR_MANAGER_H
 #define SENSOR_MANAGER_H
 
-#include <Adafruit_SGP30.h>
-#include <Preferences.h>
+#include <Hal.h>
+#include <HistoryBuffer.h>
+#include <TrendPyramid.h>
+#include <BaselineStore.h>
+#include <BaselineQuality.h>
+#include <HumidityCompensation.h>
+#include <SignalFilter.h>
+
+// グラフ1画面分（300秒）の測定履歴
+typedef HistoryBuffer<300> SensorHistory;
+// 複数のセンサーを使う場合のセンサーごとの測定履歴（TVOC・eCO2のみ）
+typedef HistoryBuffer<300, HISTORY_ECO2 + 1> SensorPointHistory;
+
+// センサータスクから描画タスクへ渡す測定結果
+struct SensorSample {
+  uint32_t timestamp;            // 取得時刻 (ms)
+  uint16_t tvoc;                 // TVOC (ppb)
+  uint16_t eco2;                 // eCO2 (ppm)
+  uint16_t raw_h2;               // H2の生信号（生信号を測定しない場合は 0）
+  uint16_t raw_ethanol;          // エタノールの生信号（生信号を測定しない場合は 0）
+  uint16_t h2_filtered;          // 処理後のH2の生信号（生信号を測定しない場合は 0）
+  uint16_t ethanol_filtered;
+  int16_t h2_rate;               // 処理後の生信号の変化率（1分あたり、負: ガスの濃度が上昇）
+  int16_t ethanol_rate;
+  bool signal_change;            // いずれかの生信号で変化を検出中か
+  uint32_t signal_changes;       // 変化を検出した回数（H2・エタノールの合計、起動から）
+  uint32_t signal_spikes;        // スパイクとして置き換えた回数（同）
+  uint16_t eco2_base;            // 直近に読み取ったベースライン（0: 未取得）
+  uint16_t tvoc_base;
+  uint32_t baseline_saves;       // ベースラインの保存回数（起動から）
+  uint32_t baseline_save_failures;
+  uint32_t baseline_save_skips;  // 直近の記録と差がなく書き込まなかった回数
+  uint32_t baseline_rejects;     // 品質の判定で保存しなかった回数
+  uint32_t baseline_rollbacks;   // 保存後の測定が不自然で前の記録へ戻した回数
+  int16_t eco2_base_drift;       // 記録間のベースラインの変化（1日あたり）
+  int16_t tvoc_base_drift;
+  bool environment_valid;        // 温湿度を測定できているか（以下の4つ）
+  int16_t temperature;           // 温度 (0.01 ℃)
+  uint16_t humidity;             // 相対湿度 (0.01 %RH)
+  uint32_t absolute_humidity;    // 温湿度から求めた絶対湿度 (mg/m³)
+  uint32_t applied_humidity;     // SGP30の補正に設定中の絶対湿度 (mg/m³、0: 補正なし)
+  bool clean_air_detected;       // クリーンエア判定中か
+  uint16_t clean_air_remaining;  // クリーンエア判定の残り時間 (s)
+};
+
+// 複数のセンサーを使う場合のセンサーごとの測定（センサータスクから描画タスクへ）
+struct SensorPoint {
+  uint32_t timestamp;            // 取得時刻 (ms)
+  uint8_t sensor;                // センサーの番号（0〜）
+  bool connected;                // 測定できたか（false なら値は無効）
+  bool clean_air_detected;
+  uint16_t tvoc;
+  uint16_t eco2;
+  uint16_t eco2_base;
+  uint16_t tvoc_base;
+};
+
+// 再起動をまたいで引き継ぐ判定の状態（時刻は起動ごとに変わるので経過時間で持つ）
+struct SensorManagerState {
+  uint32_t clean_air_elapsed;     // クリーンエア条件が続いている時間 (ms)
+  uint32_t since_periodic_save;   // 前回のベースライン定期保存（または起動）からの時間 (ms)
+  uint8_t clean_air_detected;     // クリーンエア判定中か
+  uint8_t reserved[3];
+};
 
 class SensorManager {
 public:
+  // 実行間隔（スケジューラに登録する）
+  static const unsigned long SENSOR_UPDATE_INTERVAL = 1000; // センサー更新間隔 (ms)
+  static const unsigned long AUTO_CHECK_INTERVAL = 10000; // 自動チェック間隔 (ms)
+  static const unsigned long BASELINE_AUTO_SAVE_INTERVAL = 43200000; // ベースライン自動保存間隔 (ms) - 12時間
+
   SensorManager();
 
-  // センサー初期化
-  bool init(Adafruit_SGP30* sensor, Preferences* prefs);
+  // 湿度補正に使う温湿度センサー（init() の前に設定する、nullptr: 補正しない）
+  void setEnvironmentSensor(EnvironmentSensor* sensor) { environment = sensor; }
+  // 湿度補正に primary の温湿度の測定を使う（温湿度センサーを共有する複数のSGP30、init() の前に設定する）
+  // updateHumidity() は primary の後に呼ぶ
+  void setHumiditySource(const SensorManager* primary) { humidity_source = primary; }
+
+  // センサー初期化（index: 複数のセンサーを使う場合の番号、ベースラインはセンサーごとに保存する）
+  bool init(SensorDriver* sensor, KeyValueStore* prefs, uint8_t index = 0);
+
+  // センサー値の更新（SENSOR_UPDATE_INTERVALごとに呼び出す。新しいサンプルを取得したら true）
+  bool update(bool sensor_connected);
+  // 温湿度を読んでSGP30の湿度補正を更新する（HumidityCompensation::MEASURE_INTERVALごとに呼び出す）
+  void updateHumidity() { humidity_compensation.update(); }
+  bool hasHumidityCompensation() const { return humidity_compensation.isEnabled(); }
+  // H2・エタノールの生信号も測定する（測定ごとにI2Cの読み取りが1回増える）
+  void setRawMeasurement(bool enabled) { raw_enabled = enabled; }
+  // 生信号の処理（H2・エタノールに同じ設定を使う、init() の前後どちらでもよい）
+  bool setSignalChain(const SignalChainConfig& config);
+  // 生信号の処理の統計をSerialへ出力（生信号を測定しない場合は何もしない）
+  void logSignalStats() const;
 
-  // センサー値の更新
-  void update(bool sensor_connected);
+  // ベースラインの記録に付けるUNIX時刻（未設定なら 0 を返す、設定しなければ常に 0）
+  void setEpochClock(uint32_t (*clock)()) { epoch_clock = clock; }
 
   // ベースライン関連
-  bool saveBaseline(Adafruit_SGP30* sensor, Preferences* prefs);
-  bool loadBaseline(Adafruit_SGP30* sensor, Preferences* prefs);
-  bool resetBaseline(Adafruit_SGP30* sensor);
-  bool getBaseline(Adafruit_SGP30* sensor, uint16_t* eco2_base, uint16_t* tvoc_base);
-  void checkAutoBaseline();
-  void checkPeriodicBaselineSave();
+  // 品質の判定で保存しなかった場合も false（理由は lastBaselineScore()）
+  bool saveBaseline(SensorDriver* sensor, BaselineSource source);
+  bool loadBaseline(SensorDriver* sensor);
+  const BaselineScore& lastBaselineScore() const { return last_score; }
+  // 保存後の測定が不自然なので保存前の記録へ戻す必要がある
+  bool baselineRollbackDue() const { return quality.rollbackDue(); }
+  bool rollbackBaseline(SensorDriver* sensor);
+  bool resetBaseline(SensorDriver* sensor);
+  bool getBaseline(SensorDriver* sensor, uint16_t* eco2_base, uint16_t* tvoc_base);
+  void checkAutoBaseline();       // AUTO_CHECK_INTERVALごとに呼び出す
+  void periodicBaselineSave();    // BASELINE_AUTO_SAVE_INTERVALごとに呼び出す
+
+  // 再起動をまたいで引き継ぐ状態（センサータスクから呼び出す）
+  SensorManagerState exportState() const;
+  void restoreState(const SensorManagerState& state);
+
+  // 保存したベースラインの履歴と書き込みの統計
+  const BaselineStore& baselineStore() const { return baselines; }
 
   // センサー値取得
   uint16_t getTVOC() const { return tvoc_value; }
   uint16_t getECO2() const { return eco2_value; }
+  SensorSample getLatestSample() const;
+  SensorPoint getLatestPoint(bool connected) const;
 
   // クリーンエア状態チェック
   bool isCleanAirCondition() const;
@@ -37,23 +136,36 @@ private:
   static const uint16_t ECO2_MAX = 500;      // eCO2最大値 (ppm)
   static const uint16_t TVOC_MAX = 100;      // TVOC最大値 (ppb)
   static const unsigned long STABLE_TIME = 600000; // 条件が満たされるべき時間 (ms) - 10分
-  static const unsigned long AUTO_CHECK_INTERVAL = 10000; // 自動チェック間隔 (ms)
-  static const unsigned long SENSOR_UPDATE_INTERVAL = 1000; // センサー更新間隔 (ms)
-  static const unsigned long BASELINE_AUTO_SAVE_INTERVAL = 43200000; // ベースライン自動保存間隔 (ms) - 12時間
 
   // センサー関連
-  Adafruit_SGP30* sgp;
-  Preferences* preferences;
+  SensorDriver* sgp;
+  uint8_t sensor_index;
+  EnvironmentSensor* environment;
+  const SensorManager* humidity_source;
+  HumidityCompensation humidity_compensation;
+  BaselineStore baselines;
+  BaselineQuality quality;
+  BaselineScore last_score;
+  uint32_t (*epoch_clock)();
 
   // 測定値
   uint16_t tvoc_value;
   uint16_t eco2_value;
+  uint16_t raw_h2;
+  uint16_t raw_ethanol;
+  bool raw_enabled;
+  SignalChain h2_chain;
+  SignalChain ethanol_chain;
+
+  // 直近に読み書きしたベースライン（測定結果と一緒に描画タスクへ渡す）
+  uint16_t eco2_baseline;
+  uint16_t tvoc_baseline;
+  uint32_t baseline_read_failures;   // 保存のためのベースラインの読み取りに失敗した回数
 
   // クリーンエア判定用
   bool condition_flag;
   unsigned long stable_condition_start;
-  unsigned long last_auto_check_time;
-  unsigned long last_read_time;
+  unsigned long last_read_time;    // 直近の測定時刻（記録の再生中は記録上の時刻）
   unsigned long last_baseline_save_time;
 
   // デモ用
@@ -0,0 +1,455 @@
+#include "SensorTrace.h"
+
+static const uint8_t TRACE_MAGIC[4] = { 'S', 'G', 'P', 'T' };
+
+// 符号付きの差分を小さな非負整数へ（0, -1, 1, -2, ... → 0, 1, 2, 3, ...）
+static uint32_t zigzagEncode(int32_t value) {
+  return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static int32_t zigzagDecode(uint32_t value) {
+  return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+// ---- TraceWriter ----
+
+TraceWriter::TraceWriter() :
+  file(nullptr),
+  raw(false),
+  period(0),
+  chunk_length(0),
+  chunk_count(0),
+  previous(),
+  samples(0),
+  bytes(0) {
+}
+
+bool TraceWriter::begin(FileHandle* output, uint16_t period_ms, bool with_raw) {
+  file = output;
+  raw = with_raw;
+  period = period_ms;
+  chunk_count = 0;
+  samples = 0;
+  bytes = 0;
+
+  uint8_t header[8] = {
+    TRACE_MAGIC[0], TRACE_MAGIC[1], TRACE_MAGIC[2], TRACE_MAGIC[3],
+    TRACE_VERSION,
+    (uint8_t)(raw ? TRACE_FLAG_RAW : 0),
+    (uint8_t)(period & 0xFF), (uint8_t)(period >> 8)
+  };
+  return writeBytes(header, sizeof(header));
+}
+
+bool TraceWriter::append(const TraceSample& sample) {
+  if (file == nullptr) {
+    return false;
+  }
+
+  if (chunk_count == 0) {
+    // チャンクの先頭は差分なしで記録する（件数は書き込み時に埋める）
+    chunk_length = 0;
+    chunk[chunk_length++] = TRACE_CHUNK_MARK;
+    chunk[chunk_length++] = 0;
+    putU32(sample.timestamp);
+    putU16(sample.tvoc);
+    putU16(sample.eco2);
+    if (raw) {
+      putU16(sample.raw_h2);
+      putU16(sample.raw_ethanol);
+    }
+  } else {
+    putVarint(zigzagEncode((int32_t)(sample.timestamp - previous.timestamp - period)));
+    putDelta((int32_t)sample.tvoc - previous.tvoc);
+    putDelta((int32_t)sample.eco2 - previous.eco2);
+    if (raw) {
+      putDelta((int32_t)sample.raw_h2 - previous.raw_h2);
+      putDelta((int32_t)sample.raw_ethanol - previous.raw_ethanol);
+    }
+  }
+
+  previous = sample;
+  chunk_count++;
+  samples++;
+
+  if (chunk_count >= TRACE_CHUNK_SAMPLES) {
+    return flush();
+  }
+  return true;
+}
+
+bool TraceWriter::flush() {
+  if (file == nullptr) {
+    return false;
+  }
+
+  if (chunk_count > 0) {
+    chunk[1] = chunk_count;
+    chunk_count = 0;
+    if (!writeBytes(chunk, chunk_length)) {
+      return false;
+    }
+  }
+  file->flush();
+  return true;
+}
+
+void TraceWriter::end() {
+  flush();
+  file = nullptr;
+}
+
+bool TraceWriter::writeBytes(const uint8_t* data, size_t length) {
+  if (file->write(data, length) != length) {
+    Serial.println("Trace write failed, recording stopped");
+    file = nullptr;
+    return false;
+  }
+  bytes += length;
+  return true;
+}
+
+void TraceWriter::putU16(uint16_t value) {
+  chunk[chunk_length++] = value & 0xFF;
+  chunk[chunk_length++] = value >> 8;
+}
+
+void TraceWriter::putU32(uint32_t value) {
+  putU16(value & 0xFFFF);
+  putU16(value >> 16);
+}
+
+void TraceWriter::putVarint(uint32_t value) {
+  // 下位から7ビットずつ、続きがあれば最上位ビットを立てる
+  while (value >= 0x80) {
+    chunk[chunk_length++] = (uint8_t)(value | 0x80);
+    value >>= 7;
+  }
+  chunk[chunk_length++] = (uint8_t)value;
+}
+
+void TraceWriter::putDelta(int32_t delta) {
+  putVarint(zigzagEncode(delta));
+}
+
+// ---- TraceReader ----
+
+TraceReader::TraceReader() :
+  file(nullptr),
+  buffer_length(0),
+  buffer_pos(0),
+  flags(0),
+  period(0),
+  chunk_remaining(0),
+  session_start(false),
+  time_offset(0),
+  previous(),
+  samples(0),
+  sessions(0),
+  skipped(0) {
+}
+
+bool TraceReader::begin(FileHandle* input) {
+  file = input;
+  buffer_length = 0;
+  buffer_pos = 0;
+  chunk_remaining = 0;
+  time_offset = 0;
+  samples = 0;
+  sessions = 0;
+  skipped = 0;
+
+  uint8_t first;
+  return readByte(first) && first == TRACE_MAGIC[0] && readHeader();
+}
+
+bool TraceReader::next(TraceSample& sample) {
+  if (file == nullptr) {
+    return false;
+  }
+
+  while (chunk_remaining == 0) {
+    uint8_t mark;
+    if (!readByte(mark)) {
+      return false;
+    }
+
+    if (mark == TRACE_CHUNK_MARK) {
+      return readChunkStart(sample);
+    }
+    // 追記された記録のヘッダー（読めなければ終端として扱う）
+    if (mark == TRACE_MAGIC[0]) {
+      if (!readHeader()) {
+        return false;
+      }
+      continue;
+    }
+    // 壊れた部分は次のチャンクまで読み飛ばす
+    skipped++;
+  }
+
+  uint32_t time_delta;
+  int32_t tvoc_delta, eco2_delta, h2_delta = 0, ethanol_delta = 0;
+  if (!readVarint(time_delta) || !readDelta(tvoc_delta) || !readDelta(eco2_delta)) {
+    return false;
+  }
+  if (hasRaw() && (!readDelta(h2_delta) || !readDelta(ethanol_delta))) {
+    return false;
+  }
+
+  sample.timestamp = previous.timestamp + period + zigzagDecode(time_delta);
+  sample.tvoc = (uint16_t)(previous.tvoc + tvoc_delta);
+  sample.eco2 = (uint16_t)(previous.eco2 + eco2_delta);
+  sample.raw_h2 = (uint16_t)(previous.raw_h2 + h2_delta);
+  sample.raw_ethanol = (uint16_t)(previous.raw_ethanol + ethanol_delta);
+
+  previous = sample;
+  chunk_remaining--;
+  samples++;
+  return true;
+}
+
+bool TraceReader::readHeader() {
+  // 先頭の 'S' は読み込み済み
+  uint8_t magic[3], version;
+  for (uint8_t& byte : magic) {
+    if (!readByte(byte)) {
+      return false;
+    }
+  }
+  if (magic[0] != TRACE_MAGIC[1] || magic[1] != TRACE_MAGIC[2] || magic[2] != TRACE_MAGIC[3]) {
+    return false;
+  }
+  if (!readByte(version) || version != TRACE_VERSION || !readByte(flags) || !readU16(period)) {
+    return false;
+  }
+
+  session_start = true;
+  sessions++;
+  return true;
+}
+
+bool TraceReader::readChunkStart(TraceSample& sample) {
+  uint8_t count;
+  uint32_t timestamp;
+  if (!readByte(count) || count == 0 || !readU32(timestamp) ||
+      !readU16(sample.tvoc) || !readU16(sample.eco2)) {
+    return false;
+  }
+
+  sample.raw_h2 = 0;
+  sample.raw_ethanol = 0;
+  if (hasRaw() && (!readU16(sample.raw_h2) || !readU16(sample.raw_ethanol))) {
+    return false;
+  }
+
+  // 新しい記録は millis() が0から始まるので、前の記録の直後に続ける
+  if (session_start) {
+    time_offset = samples > 0 ? previous.timestamp + period - timestamp : 0;
+    session_start = false;
+  }
+  sample.timestamp = timestamp + time_offset;
+
+  previous = sample;
+  chunk_remaining = count - 1;
+  samples++;
+  return true;
+}
+
+bool TraceReader::readByte(uint8_t& value) {
+  if (buffer_pos >= buffer_length) {
+    buffer_length = file->read(buffer, READ_BUFFER);
+    buffer_pos = 0;
+    if (buffer_length == 0) {
+      return false;
+    }
+  }
+  value = buffer[buffer_pos++];
+  return true;
+}
+
+bool TraceReader::readU16(uint16_t& value) {
+  uint8_t low, high;
+  if (!readByte(low) || !readByte(high)) {
+    return false;
+  }
+  value = (uint16_t)(low | (high << 8));
+  return true;
+}
+
+bool TraceReader::readU32(uint32_t& value) {
+  uint16_t low, high;
+  if (!readU16(low) || !readU16(high)) {
+    return false;
+  }
+  value = low | ((uint32_t)high << 16);
+  return true;
+}
+
+bool TraceReader::readVarint(uint32_t& value) {
+  value = 0;
+  for (uint8_t shift = 0; shift < 35; shift += 7) {
+    uint8_t byte;
+    if (!readByte(byte)) {
+      return false;
+    }
+    value |= (uint32_t)(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool TraceReader::readDelta(int32_t& delta) {
+  uint32_t value;
+  if (!readVarint(value)) {
+    return false;
+  }
+  delta = zigzagDecode(value);
+  return true;
+}
+
+// ---- TraceReplaySensor ----
+
+TraceReplaySensor::TraceReplaySensor() :
+  end_of_trace(false),
+  fast(false),
+  started(false),
+  origin_ms(0),
+  first_time(0),
+  current(),
+  eco2_baseline(0),
+  tvoc_baseline(0),
+  replayed(0) {
+}
+
+void TraceReplaySensor::fill(TraceReader& reader) {
+  if (end_of_trace.load()) {
+    return;
+  }
+
+  TraceSample sample;
+  while (queue.size() < queue.capacity()) {
+    if (!reader.next(sample)) {
+      end_of_trace = true;
+      return;
+    }
+    queue.push(sample);
+  }
+}
+
+bool TraceReplaySensor::IAQinit() {
+  eco2_baseline = 0;
+  tvoc_baseline = 0;
+  return true;
+}
+
+bool TraceReplaySensor::due() {
+  TraceSample sample;
+  if (!queue.peek(sample)) {
+    return false;
+  }
+
+  if (!started) {
+    origin_ms = millis();
+    first_time = sample.timestamp;
+    started = true;
+  }
+
+  // 等速では再生開始からの経過時間に達した記録のみ
+  return fast || (int32_t)(sample.timestamp - first_time - (millis() - origin_ms)) <= 0;
+}
+
+bool TraceReplaySensor::IAQmeasure() {
+  if (!due()) {
+    return false;
+  }
+
+  // 等速で測定が遅れた場合は経過時間までの記録をまとめて進める
+  TraceSample sample;
+  do {
+    queue.pop(current);
+    replayed++;
+  } while (!fast && queue.peek(sample) &&
+           (int32_t)(sample.timestamp - first_time - (millis() - origin_ms)) <= 0);
+  return true;
+}
+
+bool TraceReplaySensor::getIAQBaseline(uint16_t* eco2_base, uint16_t* tvoc_base) {
+  *eco2_base = eco2_baseline;
+  *tvoc_base = tvoc_baseline;
+  return true;
+}
+
+bool TraceReplaySensor::setIAQBaseline(uint16_t eco2_base, uint16_t tvoc_base) {
+  eco2_baseline = eco2_base;
+  tvoc_baseline = tvoc_base;
+  return true;
+}
+
+bool TraceReplaySensor::sampleTime(uint32_t* time_ms) const {
+  if (!started) {
+    return false;
+  }
+
+  // 再生開始時刻を起点とした記録上の時刻
+  *time_ms = origin_ms + (current.timestamp - first_time);
+  return true;
+}
+
+// ---- ReplayStore ----
+
+bool ReplayStore::begin(const char* name, bool read_only) {
+  strncpy(space, name, sizeof(space) - 1);
+  space[sizeof(space) - 1] = '\0';
+  return true;
+}
+
+ReplayStore::Entry* ReplayStore::find(const char* key, bool create) {
+  char full_key[KEY_LENGTH];
+  snprintf(full_key, sizeof(full_key), "%s/%s", space, key);
+  for (uint8_t i = 0; i < count; i++) {
+    if (strcmp(entries[i].key, full_key) == 0) {
+      return &entries[i];
+    }
+  }
+  if (!create || count >= MAX_KEYS) {
+    return nullptr;
+  }
+  Entry* entry = &entries[count++];
+  strcpy(entry->key, full_key);
+  entry->length = 0;
+  return entry;
+}
+
+uint16_t ReplayStore::getUShort(const char* key, uint16_t default_value) {
+  uint16_t value;
+  return getBytes(key, &value, sizeof(value)) == sizeof(value) ? value : default_value;
+}
+
+size_t ReplayStore::putUShort(const char* key, uint16_t value) {
+  return putBytes(key, &value, sizeof(value));
+}
+
+size_t ReplayStore::getBytes(const char* key, void* buffer, size_t length) {
+  Entry* entry = find(key, false);
+  if (entry == nullptr || entry->length > length) {
+    return 0;
+  }
+  memcpy(buffer, entry->value, entry->length);
+  return entry->length;
+}
+
+size_t ReplayStore::putBytes(const char* key, const void* value, size_t length) {
+  if (length > VALUE_LENGTH) {
+    return 0;
+  }
+  Entry* entry = find(key, true);
+  if (entry == nullptr) {
+    return 0;
+  }
+  memcpy(entry->value, value, length);
+  entry->length = (uint8_t)length;
+  return length;
+}
@@ -0,0 +1,196 @@
+#ifndef SENSOR_TRACE_H
+#define SENSOR_TRACE_H
+
+#include <Hal.h>
+#include <SpscQueue.h>
+#include <atomic>
+
+// センサー記録（トレース）のバイナリ形式（リトルエンディアン）
+//
+//   ヘッダー（記録開始ごと、8バイト）
+//     "SGPT" | バージョン u8 | フラグ u8 | 測定周期 u16 (ms)
+//   チャンク（最大 TRACE_CHUNK_SAMPLES 件）
+//     0xA5 | 件数 u8 | 先頭の測定（時刻 u32, TVOC u16, eCO2 u16, [H2 u16, エタノール u16]）
+//     | 2件目以降は前の測定との差分（時刻は「差 - 測定周期」）をジグザグ符号化した可変長整数
+//
+// 追記でファイルに複数の記録が続いてもよい（再生時は時刻をつなげる）
+// 書き込みはチャンク単位なので、電源断で失われるのは書きかけのチャンクのみ
+
+static const uint8_t TRACE_VERSION = 1;
+static const uint8_t TRACE_FLAG_RAW = 0x01;       // H2・エタノールの生信号を含む
+static const uint8_t TRACE_CHUNK_MARK = 0xA5;
+static const uint8_t TRACE_CHUNK_SAMPLES = 64;
+
+// 1件の測定
+struct TraceSample {
+  uint32_t timestamp;     // 測定時刻 (ms)
+  uint16_t tvoc;          // TVOC (ppb)
+  uint16_t eco2;          // eCO2 (ppm)
+  uint16_t raw_h2;        // H2の生信号（記録していない場合は 0）
+  uint16_t raw_ethanol;   // エタノールの生信号（記録していない場合は 0）
+};
+
+// 記録の書き込み（描画タスクで使用）
+class TraceWriter {
+public:
+  TraceWriter();
+
+  // ヘッダーを書き込んで記録を開始
+  bool begin(FileHandle* file, uint16_t period_ms, bool raw);
+  // チャンクが満杯になったらファイルへ書き込む（書き込みに失敗したら記録を停止して false）
+  bool append(const TraceSample& sample);
+  // 書きかけのチャンクを書き込む
+  bool flush();
+  // flush() して記録を終了（ファイルは呼び出し側が閉じる）
+  void end();
+
+  bool isRecording() const { return file != nullptr; }
+  uint32_t sampleCount() const { return samples; }
+  uint32_t byteCount() const { return bytes; }
+
+private:
+  // 先頭の測定 + 差分（最大5バイトの時刻と3バイトの値4つ）
+  static const size_t CHUNK_BUFFER = 14 + (TRACE_CHUNK_SAMPLES - 1) * 17;
+
+  FileHandle* file;
+  bool raw;
+  uint16_t period;
+  uint8_t chunk[CHUNK_BUFFER];
+  size_t chunk_length;
+  uint8_t chunk_count;
+  TraceSample previous;
+  uint32_t samples;
+  uint32_t bytes;
+
+  bool writeBytes(const uint8_t* data, size_t length);
+  void putU16(uint16_t value);
+  void putU32(uint32_t value);
+  void putVarint(uint32_t value);
+  void putDelta(int32_t delta);
+};
+
+// 記録の読み込み
+class TraceReader {
+public:
+  TraceReader();
+
+  // 先頭のヘッダーを読み込む（トレースでなければ false）
+  bool begin(FileHandle* file);
+  // 次の測定（終端または書きかけのチャンクで false）
+  bool next(TraceSample& sample);
+
+  bool hasRaw() const { return (flags & TRACE_FLAG_RAW) != 0; }
+  uint16_t getPeriod() const { return period; }
+  uint32_t sampleCount() const { return samples; }
+  uint16_t sessionCount() const { return sessions; }
+  uint32_t skippedBytes() const { return skipped; }
+
+private:
+  static const size_t READ_BUFFER = 128;
+
+  FileHandle* file;
+  uint8_t buffer[READ_BUFFER];
+  size_t buffer_length;
+  size_t buffer_pos;
+
+  uint8_t flags;
+  uint16_t period;
+  uint8_t chunk_remaining;    // 現在のチャンクの残り件数
+  bool session_start;         // 新しい記録の先頭チャンクを待っている
+  uint32_t time_offset;       // 追記された記録の時刻を前の記録に続ける補正
+  TraceSample previous;
+  uint32_t samples;
+  uint16_t sessions;
+  uint32_t skipped;
+
+  bool readByte(uint8_t& value);
+  bool readU16(uint16_t& value);
+  bool readU32(uint32_t& value);
+  bool readVarint(uint32_t& value);
+  bool readDelta(int32_t& delta);
+  bool readHeader();
+  bool readChunkStart(TraceSample& sample);
+};
+
+// 記録を再生するセンサー
+// fill() は描画タスク（ファイルの所有者）、それ以外はセンサータスクから呼び出す
+class TraceReplaySensor : public SensorDriver {
+public:
+  TraceReplaySensor();
+
+  // true: 測定ごとに次の記録を返す（最高速）、false: 記録時の間隔どおりに再生（等速）
+  void setFast(bool fast) { this->fast = fast; }
+  bool isFast() const { return fast; }
+
+  // 先読みキューが満杯になるまで記録を読み込む
+  void fill(TraceReader& reader);
+  // 最後の記録まで再生した
+  bool finished() const { return end_of_trace.load() && queue.empty(); }
+  // 次の記録を再生する時刻になった（記録が途切れていた間と先読み待ちの間は false）
+  bool due();
+  uint32_t replayedCount() const { return replayed; }
+
+  bool begin() override { return true; }
+  bool IAQinit() override;
+  bool IAQmeasure() override;
+  bool IAQmeasureRaw() override { return started; }
+  bool getIAQBaseline(uint16_t* eco2_base, uint16_t* tvoc_base) override;
+  bool setIAQBaseline(uint16_t eco2_base, uint16_t tvoc_base) override;
+  // 記録済みの測定なので補正は反映されない
+  bool setHumidity(uint32_t absolute_humidity) override { return true; }
+  uint16_t tvoc() const override { return current.tvoc; }
+  uint16_t eco2() const override { return current.eco2; }
+  uint16_t rawH2() const override { return current.raw_h2; }
+  uint16_t rawEthanol() const override { return current.raw_ethanol; }
+  bool sampleTime(uint32_t* time_ms) const override;
+
+private:
+  static const size_t QUEUE_SIZE = 64;
+
+  SpscQueue<TraceSample, QUEUE_SIZE> queue;
+  std::atomic<bool> end_of_trace;
+
+  // センサータスクが所有
+  bool fast;
+  bool started;
+  uint32_t origin_ms;       // 再生開始時の millis()
+  uint32_t first_time;      // 最初の記録の時刻
+  TraceSample current;
+  uint16_t eco2_baseline;
+  uint16_t tvoc_baseline;
+  uint32_t replayed;
+};
+
+// 再生中のベースライン保存先（実機のNVSに記録由来の値を書き込まない、電源断で消える）
+class ReplayStore : public KeyValueStore {
+public:
+  ReplayStore() : count(0), space() {}
+
+  bool begin(const char* name, bool read_only) override;
+  void end() override {}
+  uint16_t getUShort(const char* key, uint16_t default_value) override;
+  size_t putUShort(const char* key, uint16_t value) override;
+  size_t getBytes(const char* key, void* buffer, size_t length) override;
+  size_t putBytes(const char* key, const void* value, size_t length) override;
+  bool remove(const char* key) override { return false; }
+
+private:
+  // ベースラインの記録（BaselineStore の全スロットと以前の形式のキー）が収まる分
+  static const uint8_t MAX_KEYS = 12;
+  static const size_t KEY_LENGTH = 32;     // "名前空間/キー"
+  static const size_t VALUE_LENGTH = 24;
+
+  struct Entry {
+    char key[KEY_LENGTH];
+    uint8_t value[VALUE_LENGTH];
+    uint8_t length;
+  };
+
+  Entry entries[MAX_KEYS];
+  uint8_t count;
+  char space[16];
+
+  Entry* find(const char* key, bool create);
+};
+
+#endif // SENSOR_TRACE_H
@@ -0,0 +1,351 @@
+#include "SignalFilter.h"
+
+// ---- 処理段 ----
+
+SignalFilter::SignalFilter() :
+  settings(),
+  head(0),
+  count(0),
+  ema_state(0),
+  ema_primed(false),
+  replaced(0) {
+  settings.type = SIGNAL_FILTER_NONE;
+}
+
+bool SignalFilter::configure(const SignalFilterConfig& config) {
+  bool valid = false;
+  switch (config.type) {
+    case SIGNAL_FILTER_NONE:
+      valid = true;
+      break;
+    case SIGNAL_FILTER_HAMPEL:
+    case SIGNAL_FILTER_MEDIAN:
+      valid = config.window >= 3 && config.window <= MAX_WINDOW && (config.window & 1) == 1 &&
+              (config.type == SIGNAL_FILTER_MEDIAN || config.param > 0);
+      break;
+    case SIGNAL_FILTER_EMA:
+      valid = config.param >= 1 && config.param <= MAX_EMA_SHIFT;
+      break;
+  }
+
+  settings = config;
+  if (!valid) {
+    settings.type = SIGNAL_FILTER_NONE;
+  }
+  reset();
+  return valid;
+}
+
+void SignalFilter::reset() {
+  head = 0;
+  count = 0;
+  ema_state = 0;
+  ema_primed = false;
+}
+
+void SignalFilter::insert(uint16_t value) {
+  uint8_t length = count;
+
+  // 満杯なら最古の値を昇順の配列から抜く
+  if (count == settings.window) {
+    uint16_t oldest = ring[head];
+    uint8_t i = 0;
+    while (sorted[i] != oldest) {
+      i++;
+    }
+    for (; i + 1 < count; i++) {
+      sorted[i] = sorted[i + 1];
+    }
+    length--;
+  } else {
+    count++;
+  }
+  ring[head] = value;
+  head = head + 1 == settings.window ? 0 : head + 1;
+
+  // 挿入ソートの1回分
+  uint8_t i = length;
+  while (i > 0 && sorted[i - 1] > value) {
+    sorted[i] = sorted[i - 1];
+    i--;
+  }
+  sorted[i] = value;
+}
+
+uint16_t SignalFilter::medianDeviation(uint16_t center) const {
+  // 昇順の配列では中央値からの距離が中央から両側へ単調に増えるので、
+  // 両側から小さい方を順に取っていけば count / 2 番目がMAD（ソートし直さない）
+  int left = count / 2 - 1;
+  int right = count / 2 + 1;
+  uint16_t deviation = 0;
+  for (uint8_t k = 0; k < count / 2; k++) {
+    uint16_t left_deviation = left >= 0 ? center - sorted[left] : UINT16_MAX;
+    uint16_t right_deviation = right < count ? sorted[right] - center : UINT16_MAX;
+    if (left_deviation <= right_deviation) {
+      deviation = left_deviation;
+      left--;
+    } else {
+      deviation = right_deviation;
+      right++;
+    }
+  }
+  return deviation;
+}
+
+uint16_t SignalFilter::apply(uint16_t value) {
+  switch (settings.type) {
+    case SIGNAL_FILTER_NONE:
+      return value;
+
+    case SIGNAL_FILTER_MEDIAN:
+      insert(value);
+      return median();
+
+    case SIGNAL_FILTER_HAMPEL: {
+      insert(value);
+      // 窓の時間的な中央のサンプルを判定する（最新のサンプルで判定すると変化の途中をスパイクとみなす）
+      uint8_t oldest = count == settings.window ? head : 0;
+      uint8_t middle = oldest + (count - 1) / 2;
+      uint16_t candidate = ring[middle < settings.window ? middle : middle - settings.window];
+      uint16_t center = median();
+      // しきい値 = param / 10 × 1.4826 × MAD（1.4826 ≒ 759 / 512）
+      uint32_t limit = (uint32_t)(((uint64_t)medianDeviation(center) * settings.param * 759) / 5120);
+      if (limit < HAMPEL_MIN_LIMIT) {
+        limit = HAMPEL_MIN_LIMIT;
+      }
+      uint32_t distance = candidate > center ? candidate - center : center - candidate;
+      if (distance > limit) {
+        replaced++;
+        return center;
+      }
+      return candidate;
+    }
+
+    case SIGNAL_FILTER_EMA: {
+      int32_t scaled = (int32_t)value << EMA_FRACTION;
+      if (!ema_primed) {
+        ema_state = scaled;
+        ema_primed = true;
+      } else {
+        ema_state += (scaled - ema_state) / (1 << settings.param);
+      }
+      return (uint16_t)((ema_state + (1 << (EMA_FRACTION - 1))) >> EMA_FRACTION);
+    }
+  }
+  return value;
+}
+
+// ---- 変化率 ----
+
+SignalRate::SignalRate() :
+  window(0),
+  threshold(0),
+  head(0),
+  count(0),
+  current_rate(0),
+  detected(false),
+  event_count(0) {
+}
+
+void SignalRate::configure(uint16_t window_s, uint16_t rate_threshold) {
+  window = window_s < MAX_WINDOW ? (uint8_t)window_s : MAX_WINDOW;
+  threshold = rate_threshold;
+  reset();
+}
+
+void SignalRate::reset() {
+  head = 0;
+  count = 0;
+  current_rate = 0;
+  detected = false;
+}
+
+int16_t SignalRate::update(uint32_t timestamp, uint16_t value) {
+  if (window == 0) {
+    return 0;
+  }
+
+  // リングの容量は window + 1（満杯なら head の位置が最古）
+  uint8_t capacity = window + 1;
+  values[head] = value;
+  timestamps[head] = timestamp;
+  head = head + 1 == capacity ? 0 : head + 1;
+  if (count < capacity) {
+    count++;
+  }
+  if (count < capacity) {
+    current_rate = 0;
+    return 0;
+  }
+
+  uint32_t elapsed = timestamp - timestamps[head];
+  int32_t rate = 0;
+  if (elapsed > 0) {
+    rate = (int32_t)(((int64_t)((int32_t)value - values[head]) * 60000) / (int64_t)elapsed);
+  }
+  if (rate > MAX_RATE) {
+    rate = MAX_RATE;
+  } else if (rate < -MAX_RATE) {
+    rate = -MAX_RATE;
+  }
+  current_rate = (int16_t)rate;
+
+  uint32_t magnitude = rate < 0 ? -rate : rate;
+  if (!detected && threshold > 0 && magnitude >= threshold) {
+    detected = true;
+    event_count++;
+  } else if (detected && magnitude < threshold / 2u) {
+    detected = false;
+  }
+  return current_rate;
+}
+
+// ---- 生信号1つ分 ----
+
+SignalChain::SignalChain() :
+  stage_count(0),
+  rate_detector(),
+  filtered(0) {
+}
+
+bool SignalChain::configure(const SignalChainConfig& config) {
+  bool valid = config.stage_count <= SignalChainConfig::MAX_STAGES;
+  stage_count = valid ? config.stage_count : 0;
+  for (uint8_t i = 0; i < stage_count; i++) {
+    valid = stages[i].configure(config.stages[i]) && valid;
+  }
+  rate_detector.configure(config.rate_window, config.rate_threshold);
+  filtered = 0;
+  return valid;
+}
+
+void SignalChain::reset() {
+  for (uint8_t i = 0; i < stage_count; i++) {
+    stages[i].reset();
+  }
+  rate_detector.reset();
+  filtered = 0;
+}
+
+uint16_t SignalChain::apply(uint32_t timestamp, uint16_t value) {
+  if (value == 0) {
+    return 0;
+  }
+
+  for (uint8_t i = 0; i < stage_count; i++) {
+    value = stages[i].apply(value);
+  }
+  filtered = value;
+  rate_detector.update(timestamp, value);
+  return value;
+}
+
+uint32_t SignalChain::spikes() const {
+  uint32_t total = 0;
+  for (uint8_t i = 0; i < stage_count; i++) {
+    total += stages[i].replacements();
+  }
+  return total;
+}
+
+// ---- 設定の文字列 ----
+
+bool parseSignalChain(const char* spec, SignalChainConfig& config) {
+  SignalChainConfig parsed = {};
+  const char* p = spec;
+
+  while (*p != '\0') {
+    // 1項目（次のカンマまで）
+    char item[24];
+    size_t length = strcspn(p, ",");
+    if (length == 0 || length >= sizeof(item)) {
+      return false;
+    }
+    memcpy(item, p, length);
+    item[length] = '\0';
+    p += length;
+    if (*p == ',') {
+      p++;
+    }
+
+    char name[8];
+    unsigned a = 0;
+    unsigned b = 0;
+    int fields = sscanf(item, "%7[a-z]:%u:%u", name, &a, &b);
+    if (fields < 1) {
+      return false;
+    }
+
+    if (strcmp(name, "none") == 0 && fields == 1) {
+      continue;
+    }
+    if (strcmp(name, "rate") == 0 && fields == 3) {
+      if (a == 0 || a > SignalRate::MAX_WINDOW || b == 0 || b > (unsigned)SignalRate::MAX_RATE) {
+        return false;
+      }
+      parsed.rate_window = (uint16_t)a;
+      parsed.rate_threshold = (uint16_t)b;
+      continue;
+    }
+
+    if (parsed.stage_count == SignalChainConfig::MAX_STAGES) {
+      return false;
+    }
+    SignalFilterConfig stage = {};
+    if (strcmp(name, "hampel") == 0 && fields == 3 && a <= UINT8_MAX && b <= UINT8_MAX) {
+      stage.type = SIGNAL_FILTER_HAMPEL;
+      stage.window = (uint8_t)a;
+      stage.param = (uint8_t)b;
+    } else if (strcmp(name, "median") == 0 && fields == 2) {
+      stage.type = SIGNAL_FILTER_MEDIAN;
+      stage.window = (uint8_t)(a <= UINT8_MAX ? a : 0);
+    } else if (strcmp(name, "ema") == 0 && fields == 2) {
+      stage.type = SIGNAL_FILTER_EMA;
+      stage.param = (uint8_t)(a <= UINT8_MAX ? a : 0);
+    } else {
+      return false;
+    }
+
+    // 範囲の確認は処理段と同じ条件で行う
+    SignalFilter check;
+    if (!check.configure(stage)) {
+      return false;
+    }
+    parsed.stages[parsed.stage_count++] = stage;
+  }
+
+  config = parsed;
+  return true;
+}
+
+void formatSignalChain(const SignalChainConfig& config, char* buffer, size_t size) {
+  size_t used = 0;
+  buffer[0] = '\0';
+
+  for (uint8_t i = 0; i < config.stage_count && used < size; i++) {
+    const SignalFilterConfig& stage = config.stages[i];
+    const char* separator = used > 0 ? "," : "";
+    int length = 0;
+    switch (stage.type) {
+      case SIGNAL_FILTER_HAMPEL:
+        length = snprintf(buffer + used, size - used, "%shampel:%u:%u", separator, stage.window, stage.param);
+        break;
+      case SIGNAL_FILTER_MEDIAN:
+        length = snprintf(buffer + used, size - used, "%smedian:%u", separator, stage.window);
+        break;
+      case SIGNAL_FILTER_EMA:
+        length = snprintf(buffer + used, size - used, "%sema:%u", separator, stage.param);
+        break;
+      default:
+        length = snprintf(buffer + used, size - used, "%snone", separator);
+        break;
+    }
+    used += length > 0 ? (size_t)length : 0;
+  }
+  if (config.rate_window > 0 && used < size) {
+    snprintf(buffer + used, size - used, "%srate:%u:%u", used > 0 ? "," : "", config.rate_window,
+             config.rate_threshold);
+  } else if (used == 0) {
+    snprintf(buffer, size, "none");
+  }
+}
@@ -0,0 +1,140 @@
+#ifndef SIGNAL_FILTER_H
+#define SIGNAL_FILTER_H
+
+#include <Hal.h>
+
+// 生信号（H2・エタノール）の処理段の種類
+enum SignalFilterType : uint8_t {
+  SIGNAL_FILTER_NONE,
+  SIGNAL_FILTER_HAMPEL,   // 窓の中央値から離れすぎた値（スパイク）を中央値に置き換える
+  SIGNAL_FILTER_MEDIAN,   // 窓の中央値
+  SIGNAL_FILTER_EMA       // 指数移動平均
+};
+
+// 処理段1つの設定
+struct SignalFilterConfig {
+  SignalFilterType type;
+  uint8_t window;   // HAMPEL・MEDIAN: 窓の長さ（3〜MAX_WINDOW の奇数）
+  uint8_t param;    // HAMPEL: しきい値 (0.1σ単位、σ = 1.4826 × MAD)、EMA: 新しい値の重み 1/2^param
+};
+
+// 処理段1つ（固定小数点、ヒープ確保なし）
+//
+// 窓は到着順のリングと昇順の配列の両方で持ち、1サンプルごとに最古の値を抜いて新しい値を挿入する。
+// 窓は MAX_WINDOW 以下なので1サンプルあたりの処理量は窓の長さによらず上限がある（O(1)）。
+// HAMPEL は窓の時間的な中央のサンプルを窓の中央値と比べるので、MEDIAN と同じく (窓の長さ - 1) / 2 サンプル遅れる
+class SignalFilter {
+public:
+  static const uint8_t MAX_WINDOW = 9;
+  static const uint8_t EMA_FRACTION = 8;      // EMAの内部状態の小数部のビット数
+  static const uint8_t MAX_EMA_SHIFT = 8;
+  static const uint16_t HAMPEL_MIN_LIMIT = 8;  // 窓がほぼ一定（MAD = 0）でもスパイクとみなさない差
+
+  SignalFilter();
+
+  // 設定が範囲外なら false（SIGNAL_FILTER_NONE として素通しする）
+  bool configure(const SignalFilterConfig& config);
+  void reset();
+
+  uint16_t apply(uint16_t value);
+
+  const SignalFilterConfig& config() const { return settings; }
+  // HAMPEL がスパイクとして置き換えた回数
+  uint32_t replacements() const { return replaced; }
+
+private:
+  SignalFilterConfig settings;
+  uint16_t ring[MAX_WINDOW];     // 到着順
+  uint16_t sorted[MAX_WINDOW];   // 昇順
+  uint8_t head;                  // ring の次の書き込み位置
+  uint8_t count;
+  int32_t ema_state;             // 値 << EMA_FRACTION
+  bool ema_primed;
+  uint32_t replaced;
+
+  void insert(uint16_t value);
+  uint16_t median() const { return sorted[count / 2]; }
+  uint16_t medianDeviation(uint16_t center) const;
+};
+
+// 処理段を順につないだもの（生信号1つ分）と変化率の検出の設定
+struct SignalChainConfig {
+  static const uint8_t MAX_STAGES = 4;
+
+  SignalFilterConfig stages[MAX_STAGES];
+  uint8_t stage_count;
+  uint16_t rate_window;      // 変化率を求める間隔 (s、0: 検出しない)
+  uint16_t rate_threshold;   // 変化を検出する変化率 (生信号/分)
+};
+
+// 設定の文字列を読む（カンマ区切り、前から順に適用）。読めなければ false で config は変更しない
+//   hampel:窓:しきい値  median:窓  ema:シフト  rate:間隔:しきい値  none（何もしない）
+//   例: "hampel:5:30,ema:1,rate:30:300"
+bool parseSignalChain(const char* spec, SignalChainConfig& config);
+// 設定を同じ形式で書き出す（ログ用）
+void formatSignalChain(const SignalChainConfig& config, char* buffer, size_t size);
+
+// 既定の設定（スパイク除去 → 軽い平滑化、30秒で300/分以上の変化を検出）
+// 遅れの少ない組み合わせ（NativeTools の --bench-signals で比較）
+#define SIGNAL_CHAIN_DEFAULT "hampel:5:30,ema:1,rate:30:300"
+
+// 変化率の検出（ヒープ確保なし、1サンプルあたり O(1)）
+//
+// 直近 window_s 個（1秒ごとの測定で window_s 秒分）のサンプルの最古と最新の差と時刻の差から
+// 1分あたりの変化率を求め、しきい値以上になったら検出、
+// しきい値の半分未満に戻ったら解除する（しきい値付近で検出を繰り返さない）。
+// SGP30の生信号はガスの濃度が上がると下がるので、負の変化率が濃度の上昇
+class SignalRate {
+public:
+  static const uint8_t MAX_WINDOW = 60;       // 保持するサンプル数（1秒ごとなら60秒）
+  static const int16_t MAX_RATE = 32767;
+
+  SignalRate();
+
+  void configure(uint16_t window_s, uint16_t threshold);
+  void reset();
+
+  // timestamp: 測定時刻 (ms)。変化率 (生信号/分) を返す（間隔分のサンプルがなければ 0）
+  int16_t update(uint32_t timestamp, uint16_t value);
+
+  int16_t rate() const { return current_rate; }
+  bool active() const { return detected; }
+  // 検出した回数（解除から再び検出するごとに1）
+  uint32_t events() const { return event_count; }
+
+private:
+  uint8_t window;               // 変化率を求めるサンプル数（0: 検出しない）
+  uint16_t threshold;
+  uint16_t values[MAX_WINDOW + 1];       // 到着順（最古と最新の間が window サンプル）
+  uint32_t timestamps[MAX_WINDOW + 1];
+  uint8_t head;
+  uint8_t count;
+  int16_t current_rate;
+  bool detected;
+  uint32_t event_count;
+};
+
+// 生信号1つ分の処理（処理段の列と、その出力の変化率）
+class SignalChain {
+public:
+  SignalChain();
+
+  bool configure(const SignalChainConfig& config);
+  void reset();
+
+  // 生信号を処理した値を返す（0 は未測定なので処理せず 0 を返す）
+  uint16_t apply(uint32_t timestamp, uint16_t value);
+
+  uint16_t output() const { return filtered; }
+  const SignalRate& rate() const { return rate_detector; }
+  // 全段の HAMPEL が置き換えた回数
+  uint32_t spikes() const;
+
+private:
+  SignalFilter stages[SignalChainConfig::MAX_STAGES];
+  uint8_t stage_count;
+  SignalRate rate_detector;
+  uint16_t filtered;
+};
+
+#endif // SIGNAL_FILTER_H
@@ -0,0 +1,66 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+// 単一生産者・単一消費者のロックフリーキュー（固定容量、ヒープ確保なし）
+// push() は生産者タスクのみ、pop() は消費者タスクのみから呼び出すこと
+template <typename T, size_t CAPACITY>
+class SpscQueue {
+  static_assert((CAPACITY & (CAPACITY - 1)) == 0, "CAPACITY must be a power of two");
+
+public:
+  SpscQueue() : head(0), tail(0), dropped(0) {}
+
+  // 満杯の場合は追加せず false を返す
+  bool push(const T& item) {
+    size_t t = tail.load(std::memory_order_relaxed);
+    if (t - head.load(std::memory_order_acquire) >= CAPACITY) {
+      dropped.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    items[t & (CAPACITY - 1)] = item;
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+  // 空の場合は false を返す
+  bool pop(T& item) {
+    size_t h = head.load(std::memory_order_relaxed);
+    if (h == tail.load(std::memory_order_acquire)) {
+      return false;
+    }
+    item = items[h & (CAPACITY - 1)];
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+  // 先頭を取り出さずに参照（消費者タスクのみ、空の場合は false）
+  bool peek(T& item) const {
+    size_t h = head.load(std::memory_order_relaxed);
+    if (h == tail.load(std::memory_order_acquire)) {
+      return false;
+    }
+    item = items[h & (CAPACITY - 1)];
+    return true;
+  }
+
+  size_t size() const {
+    return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+  }
+  bool empty() const { return size() == 0; }
+  size_t capacity() const { return CAPACITY; }
+
+  // 満杯で破棄された件数
+  uint32_t droppedCount() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+  T items[CAPACITY];
+  std::atomic<size_t> head;   // 消費者が次に読む位置
+  std::atomic<size_t> tail;   // 生産者が次に書く位置
+  std::atomic<uint32_t> dropped;
+};
+
+#endif // SPSC_QUEUE_H
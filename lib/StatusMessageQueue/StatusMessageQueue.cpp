@@ -0,0 +1,132 @@
+#include "StatusMessageQueue.h"
+#include <string.h>
+
+StatusMessageQueue::StatusMessageQueue() : next_id(1) {
+  clear();
+}
+
+void StatusMessageQueue::clear() {
+  for (int i = 0; i < CAPACITY; i++) {
+    slots[i].id = 0;
+  }
+}
+
+StatusMessage* StatusMessageQueue::findFreeSlot(uint8_t priority) {
+  StatusMessage* victim = nullptr;
+
+  for (int i = 0; i < CAPACITY; i++) {
+    if (slots[i].id == 0) {
+      return &slots[i];
+    }
+    // 満杯時は優先度が低く古いものを置き換える
+    if (slots[i].priority <= priority &&
+        (victim == nullptr || slots[i].priority < victim->priority ||
+         (slots[i].priority == victim->priority && slots[i].id < victim->id))) {
+      victim = &slots[i];
+    }
+  }
+
+  return victim;
+}
+
+StatusMessage* StatusMessageQueue::find(uint32_t id) {
+  if (id == 0) {
+    return nullptr;
+  }
+  for (int i = 0; i < CAPACITY; i++) {
+    if (slots[i].id == id) {
+      return &slots[i];
+    }
+  }
+  return nullptr;
+}
+
+uint32_t StatusMessageQueue::post(const char* text, uint16_t color, uint8_t priority, unsigned long duration_ms) {
+  // 表示し続けるメッセージは、新しい表示し続けるメッセージで置き換える
+  if (duration_ms == 0) {
+    for (int i = 0; i < CAPACITY; i++) {
+      if (slots[i].id != 0 && slots[i].duration == 0) {
+        slots[i].id = 0;
+      }
+    }
+  }
+
+  StatusMessage* slot = findFreeSlot(priority);
+  if (slot == nullptr) {
+    return 0;
+  }
+
+  slot->id = next_id++;
+  strncpy(slot->text, text, StatusMessage::MAX_TEXT);
+  slot->text[StatusMessage::MAX_TEXT] = '\0';
+  slot->color = color;
+  slot->priority = priority;
+  slot->duration = duration_ms;
+  slot->shown_at = 0;
+  slot->shown = false;
+  slot->revision = 0;
+  return slot->id;
+}
+
+bool StatusMessageQueue::replace(uint32_t id, const char* text) {
+  StatusMessage* slot = find(id);
+  if (slot == nullptr) {
+    return false;
+  }
+  if (strncmp(slot->text, text, StatusMessage::MAX_TEXT) != 0) {
+    strncpy(slot->text, text, StatusMessage::MAX_TEXT);
+    slot->text[StatusMessage::MAX_TEXT] = '\0';
+    slot->revision++;
+  }
+  return true;
+}
+
+void StatusMessageQueue::remove(uint32_t id) {
+  StatusMessage* slot = find(id);
+  if (slot != nullptr) {
+    slot->id = 0;
+  }
+}
+
+bool StatusMessageQueue::isPreferred(const StatusMessage& a, const StatusMessage& b) {
+  if (a.priority != b.priority) {
+    return a.priority > b.priority;
+  }
+  // 表示し続けるメッセージは時間指定のメッセージの後ろに回す
+  bool a_timed = a.duration > 0;
+  bool b_timed = b.duration > 0;
+  if (a_timed != b_timed) {
+    return a_timed;
+  }
+  return a.id < b.id;
+}
+
+const StatusMessage* StatusMessageQueue::current(unsigned long now) {
+  StatusMessage* best = nullptr;
+
+  for (int i = 0; i < CAPACITY; i++) {
+    StatusMessage& msg = slots[i];
+    if (msg.id == 0) {
+      continue;
+    }
+
+    // 表示時間を過ぎたメッセージを削除
+    if (msg.shown && msg.duration > 0 && now - msg.shown_at >= msg.duration) {
+      msg.id = 0;
+      continue;
+    }
+
+    // 優先度が高いもの、同じ優先度なら時間指定のもの、その中で先に投稿されたものを選ぶ
+    if (best == nullptr || isPreferred(msg, *best)) {
+      best = &msg;
+    }
+  }
+
+  // 表示時間は実際に表示され始めてから数える
+  if (best != nullptr && !best->shown) {
+    best->shown = true;
+    best->shown_at = now;
+  }
+
+  return best;
+}
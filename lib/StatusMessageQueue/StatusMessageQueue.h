@@ -0,0 +1,56 @@
+#ifndef STATUS_MESSAGE_QUEUE_H
+#define STATUS_MESSAGE_QUEUE_H
+
+#include <stdint.h>
+
+// メッセージの優先度（高いものが先に表示される）
+enum MessagePriority : uint8_t {
+  MESSAGE_INFO,
+  MESSAGE_WARNING,
+  MESSAGE_ERROR
+};
+
+// ステータス行に表示するメッセージ
+struct StatusMessage {
+  static const int MAX_TEXT = 52;  // ステータス行（幅315px、6px/文字）に収まる文字数
+
+  uint32_t id;                 // 投稿順の通し番号（0 は未使用）
+  char text[MAX_TEXT + 1];
+  uint16_t color;
+  uint8_t priority;
+  unsigned long duration;      // 表示時間（0 は次のメッセージまで表示し続ける）
+  unsigned long shown_at;      // 表示開始時刻
+  bool shown;
+  uint16_t revision;           // replace() で文字列を書き換えた回数
+};
+
+// 優先度と表示期限を持つ固定長のメッセージキュー（ブロックしない）
+class StatusMessageQueue {
+public:
+  static const int CAPACITY = 8;
+
+  StatusMessageQueue();
+
+  // メッセージを投稿し、その番号を返す（満杯で投稿できない場合は 0）
+  uint32_t post(const char* text, uint16_t color, uint8_t priority, unsigned long duration_ms);
+
+  // 投稿済みのメッセージの文字列を書き換える（順番と表示開始時刻はそのまま、削除・置き換え済みなら false）
+  bool replace(uint32_t id, const char* text);
+  // 投稿済みのメッセージを削除（削除・置き換え済みなら何もしない）
+  void remove(uint32_t id);
+
+  // 現在表示すべきメッセージ（期限切れを削除したうえで、なければ nullptr）
+  const StatusMessage* current(unsigned long now);
+
+  void clear();
+
+private:
+  StatusMessage slots[CAPACITY];
+  uint32_t next_id;
+
+  StatusMessage* findFreeSlot(uint8_t priority);
+  StatusMessage* find(uint32_t id);
+  static bool isPreferred(const StatusMessage& a, const StatusMessage& b);
+};
+
+#endif // STATUS_MESSAGE_QUEUE_H
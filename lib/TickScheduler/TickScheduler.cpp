@@ -0,0 +1,218 @@
+#include "TickScheduler.h"
+#include <Hal.h>
+
+TickScheduler::TickScheduler(ClockFunction clock_ms, ClockFunction clock_us) :
+  now_ms(clock_ms),
+  now_us(clock_us),
+  heap_size(0),
+  running_id(-1) {
+  for (int i = 0; i < MAX_JOBS; i++) {
+    jobs[i].active = false;
+    jobs[i].queued = false;
+  }
+}
+
+int TickScheduler::addPeriodic(const char* name, unsigned long period_ms, JobCallback callback, void* context,
+                               unsigned long first_delay_ms) {
+  if (period_ms == 0) {
+    return -1;
+  }
+  return addJob(name, period_ms, first_delay_ms, callback, context);
+}
+
+int TickScheduler::addOneShot(const char* name, unsigned long delay_ms, JobCallback callback, void* context) {
+  return addJob(name, 0, delay_ms, callback, context);
+}
+
+int TickScheduler::addJob(const char* name, unsigned long period_ms, unsigned long delay_ms,
+                          JobCallback callback, void* context) {
+  for (int id = 0; id < MAX_JOBS; id++) {
+    Job& job = jobs[id];
+    if (job.active || job.queued || id == running_id) {
+      continue;
+    }
+
+    job.name = name;
+    job.callback = callback;
+    job.context = context;
+    job.period = period_ms;
+    job.deadline = now_ms() + delay_ms;
+    job.active = true;
+    job.stats = JobStats();
+    push(id);
+    return id;
+  }
+
+  return -1;
+}
+
+void TickScheduler::cancel(int id) {
+  if (id < 0 || id >= MAX_JOBS) {
+    return;
+  }
+
+  // 実行中のジョブは再登録されなくなる
+  jobs[id].active = false;
+  for (int i = 0; i < heap_size; i++) {
+    if (heap[i] == id) {
+      removeAt(i);
+      break;
+    }
+  }
+}
+
+unsigned long TickScheduler::runDue() {
+  while (heap_size > 0) {
+    int id = heap[0];
+    Job& job = jobs[id];
+    unsigned long now = now_ms();
+
+    // 期限前なら待ち時間を返す
+    if ((long)(job.deadline - now) > 0) {
+      unsigned long wait = job.deadline - now;
+      return wait < MAX_WAIT ? wait : MAX_WAIT;
+    }
+
+    popTop();
+
+    uint32_t jitter = now - job.deadline;
+    if (jitter > job.stats.max_jitter_ms) {
+      job.stats.max_jitter_ms = jitter;
+    }
+
+    uint32_t start = now_us();
+    running_id = id;
+    job.callback(job.context);
+    running_id = -1;
+    uint32_t elapsed = now_us() - start;
+
+    job.stats.runs++;
+    job.stats.total_us += elapsed;
+    if (elapsed > job.stats.max_us) {
+      job.stats.max_us = elapsed;
+    }
+
+    if (!job.active) {
+      continue;
+    }
+
+    if (job.period == 0) {
+      job.active = false;
+      continue;
+    }
+
+    // 次回は予定時刻から数える（実行時刻基準にしないので周期がずれない）
+    job.deadline += job.period;
+    now = now_ms();
+    while ((long)(job.deadline - now) <= 0) {
+      job.deadline += job.period;
+      job.stats.skipped++;
+    }
+    push(id);
+  }
+
+  return MAX_WAIT;
+}
+
+unsigned long TickScheduler::timeUntilNext(unsigned long max_wait_ms) const {
+  if (heap_size == 0) {
+    return max_wait_ms;
+  }
+
+  long remaining = (long)(jobs[heap[0]].deadline - now_ms());
+  if (remaining <= 0) {
+    return 0;
+  }
+  return (unsigned long)remaining < max_wait_ms ? (unsigned long)remaining : max_wait_ms;
+}
+
+const JobStats* TickScheduler::stats(int id) const {
+  if (id < 0 || id >= MAX_JOBS) {
+    return nullptr;
+  }
+  return &jobs[id].stats;
+}
+
+void TickScheduler::resetStats() {
+  for (int i = 0; i < MAX_JOBS; i++) {
+    jobs[i].stats = JobStats();
+  }
+}
+
+void TickScheduler::logStats(const char* label) {
+  for (int i = 0; i < MAX_JOBS; i++) {
+    const Job& job = jobs[i];
+    if (!job.active || job.stats.runs == 0) {
+      continue;
+    }
+    Serial.printf("[%s] %-12s runs=%lu avg=%luus max=%luus jitter=%lums skipped=%lu\n",
+                  label, job.name,
+                  (unsigned long)job.stats.runs,
+                  (unsigned long)(job.stats.total_us / job.stats.runs),
+                  (unsigned long)job.stats.max_us,
+                  (unsigned long)job.stats.max_jitter_ms,
+                  (unsigned long)job.stats.skipped);
+  }
+  resetStats();
+}
+
+bool TickScheduler::earlier(int a, int b) const {
+  return (long)(jobs[heap[a]].deadline - jobs[heap[b]].deadline) < 0;
+}
+
+void TickScheduler::push(int id) {
+  heap[heap_size] = id;
+  jobs[id].queued = true;
+  siftUp(heap_size++);
+}
+
+int TickScheduler::popTop() {
+  int id = heap[0];
+  removeAt(0);
+  return id;
+}
+
+void TickScheduler::removeAt(int index) {
+  jobs[heap[index]].queued = false;
+  heap_size--;
+  if (index == heap_size) {
+    return;
+  }
+  heap[index] = heap[heap_size];
+  siftDown(index);
+  siftUp(index);
+}
+
+void TickScheduler::siftUp(int index) {
+  while (index > 0) {
+    int parent = (index - 1) / 2;
+    if (!earlier(index, parent)) {
+      break;
+    }
+    uint8_t tmp = heap[index];
+    heap[index] = heap[parent];
+    heap[parent] = tmp;
+    index = parent;
+  }
+}
+
+void TickScheduler::siftDown(int index) {
+  for (;;) {
+    int smallest = index;
+    int left = index * 2 + 1;
+    int right = left + 1;
+    if (left < heap_size && earlier(left, smallest)) {
+      smallest = left;
+    }
+    if (right < heap_size && earlier(right, smallest)) {
+      smallest = right;
+    }
+    if (smallest == index) {
+      return;
+    }
+    uint8_t tmp = heap[index];
+    heap[index] = heap[smallest];
+    heap[smallest] = tmp;
+    index = smallest;
+  }
+}
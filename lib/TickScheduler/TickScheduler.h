@@ -0,0 +1,71 @@
+#ifndef TICK_SCHEDULER_H
+#define TICK_SCHEDULER_H
+
+#include <stdint.h>
+
+typedef void (*JobCallback)(void* context);
+typedef unsigned long (*ClockFunction)();
+
+// ジョブごとの実行統計
+struct JobStats {
+  uint32_t runs;           // 実行回数
+  uint32_t skipped;        // 遅延により飛ばした周期数
+  uint32_t total_us;       // 合計実行時間 (us)
+  uint32_t max_us;         // 最大実行時間 (us)
+  uint32_t max_jitter_ms;  // 予定時刻からの最大遅れ (ms)
+};
+
+// 期限の最小ヒープによる協調スケジューラ（周期ジョブは予定時刻基準で次回を決めるのでずれない）
+class TickScheduler {
+public:
+  static const int MAX_JOBS = 16;
+  // runDue() が返す待ち時間の上限 (ms)。ジョブがなくても戻り、待機の ms→ティック変換が桁あふれしない
+  static const unsigned long MAX_WAIT = 60000;
+
+  TickScheduler(ClockFunction clock_ms, ClockFunction clock_us);
+
+  // ジョブ登録（失敗時は -1）
+  int addPeriodic(const char* name, unsigned long period_ms, JobCallback callback, void* context,
+                  unsigned long first_delay_ms = 0);
+  int addOneShot(const char* name, unsigned long delay_ms, JobCallback callback, void* context);
+  void cancel(int id);
+
+  // 期限の来たジョブをすべて実行し、次の期限までの時間 (ms、MAX_WAIT 以下、ジョブがなければ MAX_WAIT) を返す
+  unsigned long runDue();
+
+  // 次の期限までの時間 (ms)（ジョブがなければ max_wait_ms）
+  unsigned long timeUntilNext(unsigned long max_wait_ms) const;
+
+  const JobStats* stats(int id) const;
+  void resetStats();
+  void logStats(const char* label);
+
+private:
+  struct Job {
+    const char* name;
+    JobCallback callback;
+    void* context;
+    unsigned long period;    // 0 は一度だけ実行
+    unsigned long deadline;
+    bool active;
+    bool queued;             // ヒープに入っているか
+    JobStats stats;
+  };
+
+  ClockFunction now_ms;
+  ClockFunction now_us;
+  Job jobs[MAX_JOBS];
+  uint8_t heap[MAX_JOBS];
+  int heap_size;
+  int running_id;          // 実行中のジョブ（-1: なし）
+
+  int addJob(const char* name, unsigned long period_ms, unsigned long delay_ms, JobCallback callback, void* context);
+  bool earlier(int a, int b) const;
+  void push(int id);
+  int popTop();
+  void removeAt(int index);
+  void siftUp(int index);
+  void siftDown(int index);
+};
+
+#endif // TICK_SCHEDULER_H
@@ -0,0 +1,123 @@
+#include "TrendPyramid.h"
+
+void TrendAccumulator::reset() {
+  timestamp = 0;
+  count = 0;
+  tvoc_sum = 0;
+  eco2_sum = 0;
+  tvoc_min = UINT16_MAX;
+  tvoc_max = 0;
+  eco2_min = UINT16_MAX;
+  eco2_max = 0;
+}
+
+void TrendAccumulator::add(uint32_t ts, uint16_t tvoc, uint16_t eco2) {
+  if (count == 0) {
+    timestamp = ts;
+  }
+  count++;
+  tvoc_sum += tvoc;
+  eco2_sum += eco2;
+  if (tvoc < tvoc_min) tvoc_min = tvoc;
+  if (tvoc > tvoc_max) tvoc_max = tvoc;
+  if (eco2 < eco2_min) eco2_min = eco2;
+  if (eco2 > eco2_max) eco2_max = eco2;
+}
+
+void TrendAccumulator::merge(const TrendAccumulator& other) {
+  if (other.count == 0) {
+    return;
+  }
+  if (count == 0) {
+    timestamp = other.timestamp;
+  }
+  count += other.count;
+  tvoc_sum += other.tvoc_sum;
+  eco2_sum += other.eco2_sum;
+  if (other.tvoc_min < tvoc_min) tvoc_min = other.tvoc_min;
+  if (other.tvoc_max > tvoc_max) tvoc_max = other.tvoc_max;
+  if (other.eco2_min < eco2_min) eco2_min = other.eco2_min;
+  if (other.eco2_max > eco2_max) eco2_max = other.eco2_max;
+}
+
+void TrendAccumulator::toBucket(TrendBucket& bucket) const {
+  bucket.timestamp = timestamp;
+  bucket.tvoc_min = tvoc_min;
+  bucket.tvoc_max = tvoc_max;
+  bucket.tvoc_mean = count ? tvoc_sum / count : 0;
+  bucket.eco2_min = eco2_min;
+  bucket.eco2_max = eco2_max;
+  bucket.eco2_mean = count ? eco2_sum / count : 0;
+}
+
+TrendLevel::TrendLevel(TrendBucket* storage, size_t capacity, uint32_t period_ms) :
+  buckets(storage),
+  bucket_capacity(capacity),
+  bucket_period(period_ms),
+  head(0),
+  count(0),
+  total(0) {
+  pending.reset();
+}
+
+bool TrendLevel::add(const TrendAccumulator& sample, TrendAccumulator& completed) {
+  bool finished = false;
+
+  // バケットの期間を過ぎたサンプルが来たら確定させる
+  if (pending.count > 0 && sample.timestamp - pending.timestamp >= bucket_period) {
+    pending.toBucket(buckets[head]);
+    if (++head == bucket_capacity) {
+      head = 0;
+    }
+    if (count < bucket_capacity) {
+      count++;
+    }
+    total++;
+
+    completed = pending;
+    pending.reset();
+    finished = true;
+  }
+
+  pending.merge(sample);
+  return finished;
+}
+
+void TrendLevel::restore(const TrendBucket& bucket) {
+  buckets[head] = bucket;
+  if (++head == bucket_capacity) {
+    head = 0;
+  }
+  if (count < bucket_capacity) {
+    count++;
+  }
+  total++;
+}
+
+const TrendBucket& TrendLevel::at(size_t index) const {
+  size_t pos = head + bucket_capacity - count + index;
+  return buckets[pos >= bucket_capacity ? pos - bucket_capacity : pos];
+}
+
+TrendPyramid::TrendPyramid() :
+  levels{
+    TrendLevel(minute_buckets, MINUTE_CAPACITY, 60000UL),
+    TrendLevel(quarter_buckets, QUARTER_CAPACITY, 900000UL),
+    TrendLevel(hour_buckets, HOUR_CAPACITY, 3600000UL)
+  } {
+}
+
+void TrendPyramid::add(uint32_t timestamp, uint16_t tvoc, uint16_t eco2) {
+  TrendAccumulator sample;
+  sample.reset();
+  sample.add(timestamp, tvoc, eco2);
+
+  // 確定したバケットを上位レベルへ伝搬
+  TrendAccumulator completed;
+  for (int i = 0; i < LEVEL_COUNT; i++) {
+    if (!levels[i].add(sample, completed)) {
+      break;
+    }
+    sample = completed;
+  }
+}
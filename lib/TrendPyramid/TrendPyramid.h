@@ -0,0 +1,97 @@
+#ifndef TREND_PYRAMID_H
+#define TREND_PYRAMID_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// 集計済みバケット（最小・最大・平均）
+struct TrendBucket {
+  uint32_t timestamp;   // バケット開始時刻 (ms)
+  uint16_t tvoc_min;
+  uint16_t tvoc_max;
+  uint16_t tvoc_mean;
+  uint16_t eco2_min;
+  uint16_t eco2_max;
+  uint16_t eco2_mean;
+};
+
+// 集計中のバケット
+struct TrendAccumulator {
+  uint32_t timestamp;
+  uint32_t count;
+  uint32_t tvoc_sum;
+  uint32_t eco2_sum;
+  uint16_t tvoc_min;
+  uint16_t tvoc_max;
+  uint16_t eco2_min;
+  uint16_t eco2_max;
+
+  void reset();
+  void add(uint32_t ts, uint16_t tvoc, uint16_t eco2);
+  void merge(const TrendAccumulator& other);
+  void toBucket(TrendBucket& bucket) const;
+};
+
+// 1段分の集計レベル（固定長リングバッファ）
+class TrendLevel {
+public:
+  TrendLevel(TrendBucket* storage, size_t capacity, uint32_t period_ms);
+
+  // 下位レベルの集計結果を追加し、バケットが確定したら true
+  bool add(const TrendAccumulator& sample, TrendAccumulator& completed);
+
+  size_t size() const { return count; }
+  size_t capacity() const { return bucket_capacity; }
+  uint32_t period() const { return bucket_period; }
+  uint32_t sequence() const { return total; }
+
+  // 古い順に index 番目のバケット
+  const TrendBucket& at(size_t index) const;
+  // 集計中のバケット
+  const TrendAccumulator& pendingBucket() const { return pending; }
+
+  // 保存しておいた状態の復元（確定済みのバケットを古い順に追加し、最後に集計中のバケットを設定）
+  void restore(const TrendBucket& bucket);
+  void restorePending(const TrendAccumulator& accumulator) { pending = accumulator; }
+
+private:
+  TrendBucket* buckets;
+  size_t bucket_capacity;
+  uint32_t bucket_period;
+  size_t head;
+  size_t count;
+  uint32_t total;
+  TrendAccumulator pending;
+};
+
+// 秒 → 分 → 15分 → 時間 の多段ダウンサンプリング
+class TrendPyramid {
+public:
+  enum Level {
+    LEVEL_MINUTE,    // 1分バケット × 60  = 1時間
+    LEVEL_QUARTER,   // 15分バケット × 96 = 24時間
+    LEVEL_HOUR,      // 1時間バケット × 168 = 7日
+    LEVEL_COUNT
+  };
+
+  static const size_t MINUTE_CAPACITY = 60;
+  static const size_t QUARTER_CAPACITY = 96;
+  static const size_t HOUR_CAPACITY = 168;
+  static const size_t BYTES = (MINUTE_CAPACITY + QUARTER_CAPACITY + HOUR_CAPACITY) * sizeof(TrendBucket);
+
+  TrendPyramid();
+
+  // 1秒ごとの測定値を追加（O(1)）
+  void add(uint32_t timestamp, uint16_t tvoc, uint16_t eco2);
+
+  const TrendLevel& level(Level index) const { return levels[index]; }
+  TrendLevel& level(Level index) { return levels[index]; }
+
+private:
+  TrendBucket minute_buckets[MINUTE_CAPACITY];
+  TrendBucket quarter_buckets[QUARTER_CAPACITY];
+  TrendBucket hour_buckets[HOUR_CAPACITY];
+  TrendLevel levels[LEVEL_COUNT];
+};
+
+#endif // TREND_PYRAMID_H
@@ -1,132 +1,183 @@
 #include "UIManager.h"
 
-UIManager::UIManager() : last_update_time(0) {
-  // 初期化
+// 文字列を out の length 文字目以降に連結し、連結後の文字数を返す
+static int appendText(char* out, int length, const char* text) {
+  while (*text != '\0') {
+    out[length++] = *text++;
+  }
+  out[length] = '\0';
+  return length;
 }
 
-void UIManager::init() {
-  // タイトル表示
-  setTextStyle(2, WHITE);
-  M5.Lcd.setCursor(80, 0);
-  M5.Lcd.print("TVOC TEST");
-
-  // カウントダウン表示の準備
-  M5.Lcd.setCursor(30, 80);
-  M5.Lcd.print("Initialization...");
+UIManager::UIManager() :
+  renderer(nullptr),
+  header_region(-1),
+  demo_region(-1),
+  label_region(-1),
+  wifi_state(-1),
+  value_label(),
+  label_changed(false),
+  displayed_message_id(0),
+  displayed_revision(0),
+  sensor_error_until(0) {
+  // 初期化
 }
 
-void UIManager::setTextStyle(uint8_t size, uint16_t color) {
-  M5.Lcd.setTextSize(size);
-  M5.Lcd.setTextColor(color);
-}
+void UIManager::init(LcdRenderer* lcd_renderer) {
+  renderer = lcd_renderer;
+
+  // 再描画領域の登録
+  header_region = renderer->registerRegion(0, 0, 319, 25);
+  demo_region = renderer->registerRegion(240, 25, 24, 8);
+  label_region = renderer->registerRegion(280, 25, 36, 8);
+  renderer->initTextField(values_field, 5, 5, 2, WHITE, TFT_BLACK);
 
-void UIManager::updateCountdown(int count) {
-  M5.Lcd.fillRect(20, 120, 60, 30, BLACK);
-  M5.Lcd.drawNumber(count, 20, 120, 2);
+  // タイトル表示
+  printText(80, 0, "TVOC TEST", 2, WHITE);
 }
 
-void UIManager::clearInitArea() {
-  M5.Lcd.fillRect(0, 40, 320, 200, BLACK);
+void UIManager::printText(int16_t x, int16_t y, const char* text, uint8_t size, uint16_t color) {
+  renderer->drawText(x, y, text, size, color, BLACK);
 }
 
 void UIManager::updateValues(uint16_t tvoc, uint16_t eco2, bool sensor_connected, bool clean_air_detected, unsigned long remaining_time, bool wifi_connected) {
-  // 更新間隔チェック（1秒ごとに更新）
-  if (millis() - last_update_time < UI_UPDATE_INTERVAL) {
-    return;
+  // ヘッダーが他の描画で消された（または未描画の）場合のみ全体をクリア
+  if (renderer->consumeDamage(header_region)) {
+    renderer->fillRect(0, 0, 319, 25, TFT_BLACK);
+    renderer->resetTextField(values_field);
+    wifi_state = -1;
   }
 
-  last_update_time = millis();
-
-  // 値の表示エリアをクリア
-  M5.Lcd.fillRect(0, 0, 319, 25, TFT_BLACK);
-
-  // TVOC値とeCO2値を表示
-  char buffer[60];
-  sprintf(buffer, "TVOC:%dppb eCO2:%dppm", tvoc, eco2);
-  setTextStyle(2, WHITE);
-  M5.Lcd.setCursor(5, 5);
-  M5.Lcd.print(buffer);
+  // TVOC値とeCO2値を表示（変化した文字のみ描画、毎秒なので sprintf を通さずに組み立てる）
+  char buffer[LcdTextField::MAX_LENGTH + 1];
+  int length = appendText(buffer, 0, "TVOC:");
+  length += GlyphCache::formatNumber(tvoc, buffer + length);
+  length = appendText(buffer, length, "ppb eCO2:");
+  length += GlyphCache::formatNumber(eco2, buffer + length);
+  appendText(buffer, length, "ppm");
+  renderer->drawTextDiff(values_field, buffer);
+
+  // WiFi接続状態を表示（状態が変わった時のみ）
+  if (wifi_state != (wifi_connected ? 1 : 0)) {
+    wifi_state = wifi_connected ? 1 : 0;
+    renderer->fillRect(300, 5, 15, 15, TFT_BLACK);
+    drawWiFiStatus(wifi_connected, 300, 5);
+  }
 
-  // WiFi接続状態を表示
-  drawWiFiStatus(wifi_connected, 300, 5);
+  // デモモード表示（消された時のみ再描画）
+  if (renderer->consumeDamage(demo_region) && !sensor_connected) {
+    printText(240, 25, "DEMO", 1, YELLOW);
+  }
 
-  // デモモード表示
-  if (!sensor_connected) {
-    setTextStyle(1, YELLOW);
-    M5.Lcd.setCursor(240, 25);
-    M5.Lcd.print("DEMO");
+  // 値の出所（変わった時と消された時のみ再描画）
+  bool label_damaged = renderer->consumeDamage(label_region);
+  if ((label_damaged && value_label[0] != '\0') || label_changed) {
+    renderer->fillRect(280, 25, 36, 8, TFT_BLACK);
+    printText(280, 25, value_label, 1, CYAN);
+    label_changed = false;
   }
 
   // クリーンエア検出中の表示（必要に応じてコメント解除）
   /*
   if (clean_air_detected && sensor_connected) {
-    setTextStyle(1, GREEN);
     char clean_air_msg[50];
     sprintf(clean_air_msg, "Clean air detected: %lu s", remaining_time);
-    M5.Lcd.setCursor(5, 25);
-    M5.Lcd.print(clean_air_msg);
+    printText(5, 25, clean_air_msg, 1, GREEN);
   }
   */
 }
 
-void UIManager::showMessage(const char* message, int delay_ms) {
+void UIManager::setValueLabel(const char* label) {
+  if (strncmp(label, value_label, sizeof(value_label)) == 0) {
+    return;
+  }
+  strncpy(value_label, label, sizeof(value_label) - 1);
+  value_label[sizeof(value_label) - 1] = '\0';
+  label_changed = true;
+}
+
+uint32_t UIManager::showMessage(const char* message, unsigned long duration_ms, uint8_t priority, uint16_t color) {
+  // 表示はupdateStatus()で行う（duration_ms が 0 なら次のメッセージまで表示）
+  return messages.post(message, color, priority, duration_ms);
+}
+
+bool UIManager::updateMessage(uint32_t id, const char* message) {
+  return messages.replace(id, message);
+}
+
+void UIManager::removeMessage(uint32_t id) {
+  messages.remove(id);
+}
+
+void UIManager::updateStatus() {
+  unsigned long now = millis();
+
+  // センサーエラー表示の終了
+  if (sensor_error_until != 0 && (long)(now - sensor_error_until) >= 0) {
+    sensor_error_until = 0;
+    renderer->clear(0, 40, 320, 100, BLACK);
+  }
+
+  // 表示すべきメッセージが変わった時のみ描き換える
+  const StatusMessage* message = messages.current(now);
+  uint32_t message_id = message ? message->id : 0;
+  uint16_t revision = message ? message->revision : 0;
+  if (message_id == displayed_message_id && revision == displayed_revision) {
+    return;
+  }
+
+  displayed_message_id = message_id;
+  displayed_revision = revision;
   clearStatusArea();
-  setTextStyle(1, WHITE);
-  M5.Lcd.setCursor(5, 25);
-  M5.Lcd.print(message);
-  if (delay_ms > 0) {
-    delay(delay_ms);
-    clearStatusArea();
+  if (message) {
+    printText(5, 25, message->text, 1, message->color);
   }
 }
 
 void UIManager::showSensorError() {
-  M5.Lcd.fillRect(0, 40, 320, 60, BLACK);
-  setTextStyle(2, RED);
-  M5.Lcd.setCursor(30, 50);
-  M5.Lcd.print("Sensor not found");
-  M5.Lcd.setCursor(30, 80);
-  M5.Lcd.print("Running in DEMO mode");
-  delay(2000);
-  M5.Lcd.fillRect(0, 40, 320, 100, BLACK);
+  renderer->clear(0, 40, 320, 60, BLACK);
+  printText(30, 50, "Sensor not found", 2, RED);
+  printText(30, 80, "Running in DEMO mode", 2, RED);
+
+  // 一定時間後にupdateStatus()で消去
+  sensor_error_until = millis() + SENSOR_ERROR_DURATION;
+  if (sensor_error_until == 0) {
+    sensor_error_until = 1;
+  }
 }
 
 void UIManager::showButtonGuide() {
-  setTextStyle(1, WHITE);
-  M5.Lcd.setCursor(10, 220);
-  M5.Lcd.print("BtnA: Reset  BtnB: Save Baseline  BtnC: Show Baseline");
+  printText(10, 220, "A: Reset/Hold: Eco  B: Save  C: Baseline/Hold: View", 1, WHITE);
 }
 
 void UIManager::clearStatusArea() {
-  M5.Lcd.fillRect(5, 25, 315, 15, BLACK);
+  renderer->clear(5, 25, 315, 15, BLACK);
 }
 
 void UIManager::showBaselineReset() {
-  clearStatusArea();
-  setTextStyle(1, RED);
-  M5.Lcd.setCursor(5, 25);
-  M5.Lcd.print("Baseline Reset - New calibration needed");
+  showMessage("Baseline Reset - New calibration needed", 0, MESSAGE_WARNING, RED);
 }
 
-void UIManager::showBaselineSaved(bool isCleanAir) {
-  clearStatusArea();
-  setTextStyle(1, isCleanAir ? GREEN : YELLOW);
-  M5.Lcd.setCursor(5, 25);
+void UIManager::showBaselineSaved() {
+  showMessage("Baseline Saved in Good Condition", 0, MESSAGE_INFO, GREEN);
+}
 
-  if (isCleanAir) {
-    M5.Lcd.print("Baseline Saved in Good Condition");
+void UIManager::showBaselineRejected(bool notCleanAir) {
+  if (notCleanAir) {
+    showMessage("Not Clean Air - Baseline Not Saved", 0, MESSAGE_WARNING, YELLOW);
   } else {
-    M5.Lcd.print("Warning: Not Clean Air but Baseline Saved");
+    showMessage("Unusual Baseline - Not Saved", 0, MESSAGE_WARNING, YELLOW);
   }
 }
 
+void UIManager::showBaselineRolledBack() {
+  showMessage("Baseline Restored to Last Good Value", 0, MESSAGE_WARNING, YELLOW);
+}
+
 void UIManager::showBaselineValues(uint16_t eco2_base, uint16_t tvoc_base) {
-  clearStatusArea();
-  setTextStyle(1, YELLOW);
   char baseline_info[60];
   sprintf(baseline_info, "Baseline:eCO2=%uTVOC=%u", eco2_base, tvoc_base);
-  M5.Lcd.setCursor(5, 25);
-  M5.Lcd.print(baseline_info);
+  showMessage(baseline_info, 0, MESSAGE_INFO, YELLOW);
 }
 
 // WiFi接続状態を表示するメソッド
@@ -136,7 +187,7 @@ void UIManager::drawWiFiStatus(bool connected, int x, int y) {
   int color = connected ? GREEN : RED;
 
   // 基本のアイコン枠
-  M5.Lcd.drawRoundRect(x, y, iconSize, iconSize, 2, color);
+  renderer->drawRoundRect(x, y, iconSize, iconSize, 2, color);
 
   if (connected) {
     // 接続時はWiFiシグナルを表示（3本線）
@@ -147,11 +198,11 @@ void UIManager::drawWiFiStatus(bool connected, int x, int y) {
     for (int i = 0; i < 3; i++) {
       int barHeight = (i + 1) * 3;
       int barY = y + iconSize - barHeight - 2;
-      M5.Lcd.fillRect(startX + (i * (barWidth + barSpace)), barY, barWidth, barHeight, color);
+      renderer->fillRect(startX + (i * (barWidth + barSpace)), barY, barWidth, barHeight, color);
     }
   } else {
     // 未接続時はX印を表示
-    M5.Lcd.drawLine(x+3, y+3, x+iconSize-3, y+iconSize-3, color);
-    M5.Lcd.drawLine(x+iconSize-3, y+3, x+3, y+iconSize-3, color);
+    renderer->drawLine(x+3, y+3, x+iconSize-3, y+iconSize-3, color);
+    renderer->drawLine(x+iconSize-3, y+3, x+3, y+iconSize-3, color);
   }
-}
\ No newline at end of file
+}
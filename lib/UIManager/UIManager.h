@@ -1,30 +1,54 @@
 #ifndef UI_MANAGER_H
 #define UI_MANAGER_H
 
-#include <M5Stack.h>
+#include <Hal.h>
+#include <LcdRenderer.h>
+#include <StatusMessageQueue.h>
 
 class UIManager {
 private:
-  static const unsigned long UI_UPDATE_INTERVAL = 1000;  // UI更新間隔（ミリ秒）
-  unsigned long last_update_time;  // 最後の画面更新時間
+  // 描画レイヤーと再描画領域
+  LcdRenderer* renderer;
+  int header_region;
+  int demo_region;
+  int label_region;
+  LcdTextField values_field;   // "TVOC:%dppb eCO2:%dppm"
+  int8_t wifi_state;           // 描画済みのWiFi状態（-1: 未描画）
+  char value_label[8];         // 表示中の値の出所（"max" / "mean" / "#2"、空: 表示しない）
+  bool label_changed;
+
+  // ステータス行（y=25）のメッセージ
+  static const unsigned long SENSOR_ERROR_DURATION = 2000;  // センサーエラー表示時間（ミリ秒）
+  StatusMessageQueue messages;
+  uint32_t displayed_message_id;   // 表示中のメッセージ（0: なし）
+  uint16_t displayed_revision;     // 表示中のメッセージの文字列の版
+  unsigned long sensor_error_until; // センサーエラー表示の終了時刻（0: 非表示）
+
   // 内部ヘルパーメソッド
-  void setTextStyle(uint8_t size, uint16_t color);
+  void printText(int16_t x, int16_t y, const char* text, uint8_t size, uint16_t color);
   void drawWiFiStatus(bool connected, int x, int y);
 
 public:
   UIManager();
 
-  void init();
-  void updateCountdown(int count);
-  void clearInitArea();
+  void init(LcdRenderer* lcd_renderer);
   void updateValues(uint16_t tvoc, uint16_t eco2, bool sensor_connected, bool clean_air_detected, unsigned long remaining_time, bool wifi_connected);
+  // 複数のセンサーの場合の値の出所（集計方法かセンサーの番号、次の updateValues() で表示）
+  void setValueLabel(const char* label);
   void showSensorError();
   void showButtonGuide();
   void clearStatusArea();
   void showBaselineReset();
-  void showBaselineSaved(bool isCleanAir);
+  void showBaselineSaved();
+  void showBaselineRejected(bool notCleanAir);
+  void showBaselineRolledBack();
   void showBaselineValues(uint16_t eco2_base, uint16_t tvoc_base);
-  void showMessage(const char* message, int delay_ms);
+  // メッセージの番号を返す（updateMessage() / removeMessage() で使う、投稿できなければ 0）
+  uint32_t showMessage(const char* message, unsigned long duration_ms, uint8_t priority = MESSAGE_INFO, uint16_t color = WHITE);
+  // 表示中・表示待ちのメッセージの文字列の書き換え（他のメッセージに置き換えられていたら false）
+  bool updateMessage(uint32_t id, const char* message);
+  void removeMessage(uint32_t id);
+  void updateStatus();
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,320 @@
+#include "WifiManager.h"
+
+// 接続を始めてから接続するまでの時間 (us)
+static const uint32_t CONNECT_BUCKETS_US[] = {
+  500000, 1000000, 2000000, 4000000, 8000000, 15000000, 30000000, 60000000, 120000000, 300000000
+};
+
+static const char* NVS_NAMESPACE = "wifi";
+static const char* NVS_KEY_AP = "ap";
+
+WifiManager::WifiManager() :
+  driver(nullptr),
+  store(nullptr),
+  networks(),
+  network_count(0),
+  state(STATE_IDLE),
+  state_time(0),
+  attempt_start(0),
+  retry_delay(RETRY_MIN),
+  backoff_until(0),
+  random_state(1),
+  cached(),
+  cached_valid(false),
+  candidates(),
+  candidate_count(0),
+  candidate_index(0),
+  ever_connected(false),
+  offline_since(0),
+  offline_total(0),
+  connects(0),
+  fast_connects(0),
+  failed_attempts(0),
+  connect_time(CONNECT_BUCKETS_US, sizeof(CONNECT_BUCKETS_US) / sizeof(CONNECT_BUCKETS_US[0])) {
+  connected_ssid[0] = '\0';
+}
+
+void WifiManager::init(WifiDriver* wifi, KeyValueStore* nvs, const WifiNetwork* list, uint8_t count) {
+  driver = wifi;
+  store = nvs;
+  network_count = count < MAX_NETWORKS ? count : MAX_NETWORKS;
+  for (uint8_t i = 0; i < network_count; i++) {
+    networks[i] = list[i];
+  }
+  // 複数台が同時に再接続してもアクセスポイントへの要求が重ならないように
+  random_state = (uint32_t)micros() | 1;
+  loadCache();
+
+  Serial.printf("WiFi: %u networks configured%s\n", network_count,
+                cached_valid ? ", reconnecting to the last access point" : "");
+  setState(STATE_IDLE);
+}
+
+void WifiManager::poll() {
+  if (driver == nullptr) {
+    return;
+  }
+
+  unsigned long now = millis();
+  unsigned long elapsed = now - state_time;
+
+  switch (state) {
+    case STATE_IDLE:
+      attempt_start = now;
+      if (!startFastConnect()) {
+        startScan();
+      }
+      break;
+
+    case STATE_FAST_CONNECT: {
+      WifiStatus status = driver->status();
+      if (status == WIFI_STATUS_CONNECTED) {
+        fast_connects++;
+        onConnected();
+      } else if (status == WIFI_STATUS_FAILED || elapsed >= FAST_CONNECT_TIMEOUT) {
+        // アクセスポイントが変わった・圏外：検索からやり直す
+        driver->disconnect();
+        startScan();
+      }
+      break;
+    }
+
+    case STATE_SCANNING: {
+      WifiAccessPoint found[MAX_SCAN_RESULTS];
+      int count = driver->scanResults(found, MAX_SCAN_RESULTS);
+      if (count == -1 && elapsed < SCAN_TIMEOUT) {
+        break;
+      }
+      if (count < 0) {
+        onFailed("scan failed");
+        break;
+      }
+      chooseCandidates(found, count);
+      if (candidate_count == 0) {
+        onFailed("no configured network found");
+        break;
+      }
+      candidate_index = 0;
+      connectCandidate();
+      break;
+    }
+
+    case STATE_CONNECTING: {
+      WifiStatus status = driver->status();
+      if (status == WIFI_STATUS_CONNECTED) {
+        onConnected();
+      } else if (status == WIFI_STATUS_FAILED || elapsed >= CONNECT_TIMEOUT) {
+        driver->disconnect();
+        Serial.printf("WiFi: cannot connect to %s\n", networks[candidates[candidate_index].network].ssid);
+        // 次に強い候補へ
+        if (++candidate_index < candidate_count) {
+          connectCandidate();
+        } else {
+          onFailed("connect failed");
+        }
+      }
+      break;
+    }
+
+    case STATE_CONNECTED:
+      if (driver->status() != WIFI_STATUS_CONNECTED) {
+        Serial.printf("WiFi: connection to %s lost\n", connected_ssid);
+        driver->disconnect();
+        connected_ssid[0] = '\0';
+        offline_since = now;
+        attempt_start = now;
+        retry_delay = RETRY_MIN;
+        // 一時的な切断が多いので、まず待たずに前回のアクセスポイントへ
+        if (!startFastConnect()) {
+          startScan();
+        }
+      }
+      break;
+
+    case STATE_BACKOFF:
+      if ((long)(now - backoff_until) >= 0) {
+        attempt_start = now;
+        if (!startFastConnect()) {
+          startScan();
+        }
+      }
+      break;
+  }
+}
+
+int8_t WifiManager::rssi() {
+  return state == STATE_CONNECTED ? driver->rssi() : 0;
+}
+
+uint32_t WifiManager::offlineMillis() const {
+  if (!ever_connected || state == STATE_CONNECTED) {
+    return offline_total;
+  }
+  return offline_total + (uint32_t)(millis() - offline_since);
+}
+
+void WifiManager::logStats() {
+  if (driver == nullptr) {
+    return;
+  }
+
+  if (state == STATE_CONNECTED) {
+    Serial.printf("WiFi: connected to %s (%d dBm)", connected_ssid, driver->rssi());
+  } else {
+    Serial.printf("WiFi: disconnected");
+  }
+  Serial.printf(", %lu reconnects (%lu without scanning), %lu failed attempts, offline %lu s total\n",
+                (unsigned long)reconnects(), (unsigned long)fast_connects,
+                (unsigned long)failed_attempts, (unsigned long)(offlineMillis() / 1000));
+}
+
+void WifiManager::setState(State next) {
+  state = next;
+  state_time = millis();
+}
+
+void WifiManager::loadCache() {
+  cached_valid = false;
+  if (store == nullptr || !store->begin(NVS_NAMESPACE, true)) {
+    return;
+  }
+  size_t length = store->getBytes(NVS_KEY_AP, &cached, sizeof(cached));
+  store->end();
+
+  cached.ssid[sizeof(cached.ssid) - 1] = '\0';
+  // 設定から外したネットワークには接続しない
+  cached_valid = length == sizeof(cached) && findNetwork(cached.ssid) >= 0;
+}
+
+void WifiManager::saveCache(const char* ssid) {
+  CachedAp current = {};
+  strncpy(current.ssid, ssid, sizeof(current.ssid) - 1);
+  driver->connectedAp(current.bssid, current.channel);
+
+  // 変わった場合のみ書き込む（NVSの消耗を避ける）
+  if (cached_valid && memcmp(&current, &cached, sizeof(current)) == 0) {
+    return;
+  }
+  cached = current;
+  cached_valid = true;
+  if (store == nullptr || !store->begin(NVS_NAMESPACE, false)) {
+    return;
+  }
+  if (store->putBytes(NVS_KEY_AP, &cached, sizeof(cached)) != sizeof(cached)) {
+    Serial.println("WiFi: failed to save the access point");
+  }
+  store->end();
+}
+
+int WifiManager::findNetwork(const char* ssid) const {
+  for (uint8_t i = 0; i < network_count; i++) {
+    if (strcmp(networks[i].ssid, ssid) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+bool WifiManager::startFastConnect() {
+  if (!cached_valid) {
+    return false;
+  }
+  int network = findNetwork(cached.ssid);
+  driver->begin(cached.ssid, networks[network].password, cached.bssid, cached.channel);
+  setState(STATE_FAST_CONNECT);
+  return true;
+}
+
+void WifiManager::startScan() {
+  if (!driver->startScan()) {
+    onFailed("scan failed");
+    return;
+  }
+  setState(STATE_SCANNING);
+}
+
+void WifiManager::chooseCandidates(const WifiAccessPoint* found, int count) {
+  // ネットワークごとに最も強いアクセスポイント
+  candidate_count = 0;
+  for (int i = 0; i < count; i++) {
+    int network = findNetwork(found[i].ssid);
+    if (network < 0) {
+      continue;
+    }
+    uint8_t slot = 0;
+    while (slot < candidate_count && candidates[slot].network != network) {
+      slot++;
+    }
+    if (slot == candidate_count) {
+      candidate_count++;
+    } else if (candidates[slot].rssi >= found[i].rssi) {
+      continue;
+    }
+    Candidate& candidate = candidates[slot];
+    candidate.network = (uint8_t)network;
+    memcpy(candidate.bssid, found[i].bssid, sizeof(candidate.bssid));
+    candidate.channel = found[i].channel;
+    candidate.rssi = found[i].rssi;
+  }
+
+  // 強い順（候補は高々 MAX_NETWORKS 件なので挿入ソート）
+  for (uint8_t i = 1; i < candidate_count; i++) {
+    Candidate key = candidates[i];
+    int j = i - 1;
+    while (j >= 0 && candidates[j].rssi < key.rssi) {
+      candidates[j + 1] = candidates[j];
+      j--;
+    }
+    candidates[j + 1] = key;
+  }
+}
+
+void WifiManager::connectCandidate() {
+  const Candidate& candidate = candidates[candidate_index];
+  const WifiNetwork& network = networks[candidate.network];
+  Serial.printf("WiFi: connecting to %s (%d dBm, channel %u)\n", network.ssid, candidate.rssi, candidate.channel);
+  driver->begin(network.ssid, network.password, candidate.bssid, candidate.channel);
+  setState(STATE_CONNECTING);
+}
+
+void WifiManager::onConnected() {
+  unsigned long now = millis();
+  const char* ssid = state == STATE_FAST_CONNECT ? cached.ssid : networks[candidates[candidate_index].network].ssid;
+  strncpy(connected_ssid, ssid, sizeof(connected_ssid) - 1);
+  connected_ssid[sizeof(connected_ssid) - 1] = '\0';
+
+  uint32_t duration = (uint32_t)(now - attempt_start);
+  connect_time.observe(duration < UINT32_MAX / 1000 ? duration * 1000 : UINT32_MAX);
+  if (ever_connected) {
+    offline_total += (uint32_t)(now - offline_since);
+  }
+  ever_connected = true;
+  connects++;
+  retry_delay = RETRY_MIN;
+
+  Serial.printf("WiFi: connected to %s (%d dBm) in %lu ms\n", connected_ssid, driver->rssi(), (unsigned long)duration);
+  saveCache(connected_ssid);
+  setState(STATE_CONNECTED);
+}
+
+void WifiManager::onFailed(const char* reason) {
+  driver->disconnect();
+  failed_attempts++;
+
+  // 待ち時間は [retry_delay / 2, retry_delay] の一様分布（同時に切れた機器の再接続を分散する）
+  unsigned long half = retry_delay / 2;
+  unsigned long wait = half + nextRandom() % (half + 1);
+  backoff_until = millis() + wait;
+  Serial.printf("WiFi: %s, retrying in %lu s\n", reason, wait / 1000);
+
+  retry_delay = retry_delay * 2 < RETRY_MAX ? retry_delay * 2 : RETRY_MAX;
+  setState(STATE_BACKOFF);
+}
+
+uint32_t WifiManager::nextRandom() {
+  // xorshift32
+  random_state ^= random_state << 13;
+  random_state ^= random_state >> 17;
+  random_state ^= random_state << 5;
+  return random_state;
+}
@@ -0,0 +1,117 @@
+#ifndef WIFI_MANAGER_H
+#define WIFI_MANAGER_H
+
+#include <Hal.h>
+#include <OpenMetrics.h>
+
+// 接続先の候補（SDカードの設定ファイル）
+struct WifiNetwork {
+  char ssid[33];
+  char password[64];
+};
+
+// WiFiの接続管理（描画タスクの poll() で少しずつ進め、待たない）
+//
+// 起動時・切断時は前回のアクセスポイント（NVSのBSSID・チャンネル）へ検索なしで接続し、
+// 失敗したら検索して候補のうち最も強いものから順に試す。すべて失敗したら
+// ジッター付きの指数バックオフで待ってからやり直す
+class WifiManager {
+public:
+  static const uint8_t MAX_NETWORKS = 4;
+  static const uint8_t MAX_SCAN_RESULTS = 16;
+  static const unsigned long SCAN_TIMEOUT = 15000;         // 検索の期限 (ms)
+  static const unsigned long CONNECT_TIMEOUT = 10000;      // 接続の期限 (ms)
+  static const unsigned long FAST_CONNECT_TIMEOUT = 4000;  // 前回のアクセスポイントへの接続の期限 (ms)
+  static const unsigned long RETRY_MIN = 2000;             // やり直しの間隔 (ms)、失敗ごとに倍
+  static const unsigned long RETRY_MAX = 60000;
+
+  WifiManager();
+
+  // store: 前回のアクセスポイントの保存先（nullptr なら毎回検索する）
+  void init(WifiDriver* driver, KeyValueStore* store, const WifiNetwork* networks, uint8_t count);
+  bool isEnabled() const { return driver != nullptr; }
+  bool isConnected() const { return state == STATE_CONNECTED; }
+  // 接続中・接続済み（ライトスリープで無線を止めると切断される、待機中のみ false）
+  bool isRadioActive() const { return driver != nullptr && state != STATE_BACKOFF; }
+
+  void poll();
+
+  const char* ssid() const { return connected_ssid; }
+  int8_t rssi();
+  // 起動時の接続以降に接続した回数
+  uint32_t reconnects() const { return connects > 0 ? connects - 1 : 0; }
+  // 未接続だった時間の合計（現在の切断を含む、起動時の接続までを除く）
+  uint32_t offlineMillis() const;
+  // 接続を始めてから接続するまでの時間（前回のアクセスポイントへの失敗・検索を含む）
+  const MetricsHistogram& connectTime() const { return connect_time; }
+
+  // 接続状態と起動以降の統計をSerialへ出力
+  void logStats();
+
+private:
+  enum State : uint8_t {
+    STATE_IDLE,
+    STATE_FAST_CONNECT,   // 前回のアクセスポイントへ接続中
+    STATE_SCANNING,
+    STATE_CONNECTING,     // 検索で見つけた候補へ接続中
+    STATE_CONNECTED,
+    STATE_BACKOFF
+  };
+
+  // 前回のアクセスポイント（NVSに保存）
+  struct CachedAp {
+    char ssid[33];
+    uint8_t bssid[6];
+    uint8_t channel;
+  };
+
+  // 検索で見つけた候補
+  struct Candidate {
+    uint8_t network;      // networks の位置
+    uint8_t bssid[6];
+    uint8_t channel;
+    int8_t rssi;
+  };
+
+  WifiDriver* driver;
+  KeyValueStore* store;
+  WifiNetwork networks[MAX_NETWORKS];
+  uint8_t network_count;
+
+  State state;
+  unsigned long state_time;       // 状態が変わった時刻
+  unsigned long attempt_start;    // 今回の接続を始めた時刻
+  unsigned long retry_delay;
+  unsigned long backoff_until;
+  uint32_t random_state;          // ジッターの乱数
+
+  CachedAp cached;
+  bool cached_valid;
+  Candidate candidates[MAX_NETWORKS];
+  uint8_t candidate_count;
+  uint8_t candidate_index;
+  char connected_ssid[33];
+
+  // 統計
+  bool ever_connected;
+  unsigned long offline_since;    // 未接続になった時刻
+  uint32_t offline_total;         // 終わった切断の合計 (ms)
+  uint32_t connects;
+  uint32_t fast_connects;         // 前回のアクセスポイントへ検索なしで接続した回数
+  uint32_t failed_attempts;
+  MetricsHistogram connect_time;
+
+  void setState(State next);
+  void loadCache();
+  void saveCache(const char* ssid);
+  int findNetwork(const char* ssid) const;
+  bool startFastConnect();
+  void startScan();
+  void chooseCandidates(const WifiAccessPoint* found, int count);
+  void connectCandidate();
+  void onConnected();
+  void onFailed(const char* reason);
+  uint32_t nextRandom();
+};
+
+#endif // WIFI_MANAGER_H
@@ -1,28 +1,378 @@
-#include <M5Stack.h>
-#include "Adafruit_SGP30.h"
-#include <Preferences.h>
+#include <Hal.h>
 #include "GraphManager.h"
 #include "SensorManager.h"
 #include "UIManager.h"
+#include "LcdRenderer.h"
+#include "SpscQueue.h"
+#include "TickScheduler.h"
+#include "PowerManager.h"
+#include "SensorTrace.h"
+#include "DataLogger.h"
+#include "HttpServer.h"
+#include "OpenMetrics.h"
+#include "ForwardQueue.h"
+#include "MqttPublisher.h"
+#include "WifiManager.h"
+#include "GraphSnapshot.h"
+#include "BootProfile.h"
+#include "RestartSnapshot.h"
+#include "SensorArray.h"
+#include "LoopProfiler.h"
+#include "GlyphCache.h"
+#ifdef ARDUINO
+#include <HalEsp32.h>
+#include <esp_system.h>
 #include <WiFi.h>
 #include <SD.h>
+#else
+#include <HalNative.h>
+#endif
 
 // 定数定義
-#define INIT_COUNTDOWN 15     // 初期化カウントダウン秒数
+#define SENSOR_WARMUP_TIME 15000  // SGP30の初期化から有効な測定が得られるまでの時間（ミリ秒）
 #define WIFI_CONFIG_FILE "/wifi_config.txt"  // SDカード上の設定ファイル
-#define WIFI_CONNECT_TIMEOUT 10000  // WiFi接続タイムアウト（ミリ秒）
-#define LOOP_DELAY 10         // メインループの遅延（ミリ秒）
 #define SD_CS_PIN 4           // M5Stack標準のSDカードCSピン
+#define VIEW_HOLD_TIME 1000   // グラフ表示期間切り替えの長押し時間（ミリ秒）
+#define POWER_HOLD_TIME 1000  // 動作モード切り替えの長押し時間（ミリ秒）
+#define TRACE_CONFIG_FILE "/trace_config.txt"  // センサー記録の設定ファイル（SDカード）
+#define REPLAY_FAST_INTERVAL 20  // 最高速で再生する場合の測定周期（ミリ秒）
+#define LOG_DIR "/log"          // 測定履歴の保存先（SDカード）
+#define NTP_SERVER "pool.ntp.org"  // 時刻合わせ（測定履歴のファイル名と時刻）
+#define UTC_OFFSET (9 * 3600)   // 日本時間
+#define EPOCH_VALID_AFTER 1600000000  // これより前の時刻は未設定とみなす
+#define MQTT_CONFIG_FILE "/mqtt_config.txt"  // MQTTの送信先の設定ファイル（SDカード）
+#define MQTT_SPOOL_FILE "/mqtt_spool.bin"    // 送信できなかった測定の退避先（SDカード）
+#define MQTT_PUBLISH_INTERVAL 10       // まとめて送る既定の間隔（秒）
+#define GRAPH_SNAPSHOT_A "graph_a.bin"   // グラフの表示データの保存先（LOG_DIR内、交互に書き込む）
+#define GRAPH_SNAPSHOT_B "graph_b.bin"
+#define SIGNAL_CONFIG_FILE "/signal_config.txt"  // 生信号の処理の設定ファイル（SDカード）
+#define SENSOR_CONFIG_FILE "/sensor_config.txt"  // SGP30の接続（マルチプレクサの先の複数台など）の設定ファイル（SDカード）
 
-// グローバル変数
-Adafruit_SGP30 sgp;
-Preferences preferences;
-SensorManager sensor_manager;
+// 起動時の動作モード（POWER_MODE_NORMAL / POWER_MODE_LOW）
+#ifndef POWER_MODE_DEFAULT
+#define POWER_MODE_DEFAULT POWER_MODE_NORMAL
+#endif
+
+// タスク設定
+#define SENSOR_TASK_CORE 0      // センサータスクのコア
+#define RENDER_TASK_CORE 1      // 描画タスクのコア
+#define SENSOR_TASK_STACK 4096  // センサータスクのスタックサイズ
+#define RENDER_TASK_STACK 8192  // 描画タスクのスタックサイズ
+#define SENSOR_TASK_PRIORITY 2  // サンプリングを描画より優先
+#define RENDER_TASK_PRIORITY 1
+#define SAMPLE_QUEUE_SIZE 16    // 測定結果キューの容量
+#define EVENT_QUEUE_SIZE 8      // イベントキューの容量
+#define POINT_QUEUE_SIZE 32     // センサーごとの測定キューの容量（8台で4周期分）
+#define STATS_QUEUE_SIZE 2      // /metrics 用の統計キューの容量
+
+// 描画タスクのジョブ周期（ミリ秒）
+#define BUTTON_POLL_INTERVAL 20     // ボタン読み取り
+#define SERIAL_POLL_INTERVAL 100    // Serialのコマンドの受け付け
+#define STATUS_UPDATE_INTERVAL 100  // ステータス行のメッセージ期限判定
+#define WIFI_CHECK_INTERVAL 100     // WiFiの接続管理（検索・接続の完了確認）
+#define BACKLIGHT_CHECK_INTERVAL 1000  // 無操作時の減光判定
+#define TRACE_FEED_INTERVAL 100     // センサー記録の先読み・書き込み状態の確認
+#define LOG_WRITE_INTERVAL 1000     // 測定履歴の満杯のブロックの書き込み
+#define HTTP_POLL_INTERVAL 20       // HTTPの接続受け付け・送受信
+#define MQTT_POLL_INTERVAL 50       // MQTTの接続・送受信
+#define SNAPSHOT_INTERVAL 300000    // グラフの表示データの保存
+#define RETAIN_INTERVAL 10000       // 再起動に備えたRTCメモリへの書き込み（センサータスクも同じ周期）
+#define SENSOR_COMMAND_OFFSET 500   // SGP30を直接使う場合、測定以外のコマンドを測定の間にずらす（ミリ秒）
+#define STATS_LOG_INTERVAL 60000    // 統計のシリアル出力
+#define STATS_PUBLISH_INTERVAL 1000 // /metrics 用の統計の複製（センサータスク）
+#define CONFIG_LINE_LENGTH 64       // 設定ファイルの1行の最大長
+#define SERIAL_COMMAND_LENGTH 32    // Serialのコマンドの1行の最大長
+
+// 描画タスク → センサータスク：ボタン操作
+enum ButtonEvent : uint8_t {
+  BUTTON_RESET_BASELINE,
+  BUTTON_SAVE_BASELINE,
+  BUTTON_SHOW_BASELINE
+};
+
+// センサータスク → 描画タスク：操作結果の表示
+enum UiEventType : uint8_t {
+  UI_BASELINE_RESET,
+  UI_BASELINE_SAVED,
+  UI_BASELINE_REJECTED,
+  UI_BASELINE_ROLLED_BACK,
+  UI_BASELINE_VALUES
+};
+
+struct UiEvent {
+  UiEventType type;
+  BaselineVerdict verdict;   // UI_BASELINE_REJECTED の理由
+  uint16_t eco2_base;
+  uint16_t tvoc_base;
+};
+
+// センサー記録の動作
+enum TraceMode : uint8_t {
+  TRACE_OFF,
+  TRACE_RECORD,   // 測定結果をSDカードへ記録
+  TRACE_REPLAY    // SGP30の代わりに記録を再生
+};
+
+struct TraceConfig {
+  TraceMode mode;
+  char path[64];
+  bool fast;      // 再生時：記録時刻を待たずに最高速で再生
+};
+
+// SGP30の接続（マルチプレクサの先の複数台など）
+struct SensorArrayConfig {
+  uint8_t mux_address;
+  uint8_t channels[SensorArray::MAX_SENSORS];
+  uint8_t count;
+  SensorAggregate aggregate;   // ヘッダー・グラフ・送信する値の集計方法
+};
+
+// /metrics で公開するセンサータスクの統計（センサータスクが複製してキューで送り、描画タスクは複製のみ読む）
+struct SensorStats {
+  MetricsHistogram loop;           // センサータスクの1周期の処理時間
+  MetricsHistogram iaq_latency;    // 以下は分割した測定
+  MetricsHistogram raw_latency;
+  MetricsHistogram retries;
+  uint32_t cycle_us;
+  uint32_t i2c_nacks;
+  uint32_t crc_errors;
+  uint32_t failures;
+};
+
+// 周辺機器（ネイティブ環境ではシミュレーション）
+#ifdef ARDUINO
+Sgp30Driver sgp;
+WireBus i2c_bus;
+Sht3xSensor environment_sensor;
+NvsStore preferences;
+TftDisplay display(&M5.Lcd);
+M5Buttons buttons;
+SdFileSystem files;
+WiFiNetServer net_server;
+WiFiNetConnector net_connector;
+EspWifiDriver wifi_driver;
+NvsStore wifi_store;      // センサータスクのベースライン保存と同時に使うので別のインスタンス
+NvsStore restart_store;   // 再起動を呼び出したタスクで使う
+RtcRetainedMemory retained_memory;
+#else
+SimulatedSgp30& sgp = sim_sensor;
+SimulatedI2cBus& i2c_bus = sim_i2c;
+SimulatedSht3x& environment_sensor = sim_environment;
+MemoryStore& preferences = sim_store;
+FramebufferDisplay& display = sim_display;
+ScriptedButtons& buttons = sim_buttons;
+StdioFileSystem& files = sim_files;
+PosixNetServer& net_server = sim_net;
+PosixNetConnector& net_connector = sim_connector;
+SimulatedWifi& wifi_driver = sim_wifi;
+MemoryStore& wifi_store = sim_store;
+MemoryStore& restart_store = sim_store;
+FileRetainedMemory& retained_memory = sim_retained;
+#endif
+
+// グローバル変数（複数のSGP30を使う場合は sensor_managers の各要素が1台ずつ担当、0番が主）
+SensorManager sensor_managers[SensorArray::MAX_SENSORS];
+SensorManager& sensor_manager = sensor_managers[0];
+LcdRenderer lcd_renderer;
+GlyphCache glyph_cache;
 GraphManager graph_manager;
 UIManager ui_manager;
+PowerManager power_manager;
 bool sensor_connected = false;
 bool wifi_connected = false;
-unsigned long last_millis = 0;
+bool files_available = false;
+
+// WiFiの接続管理（描画タスクが所有）
+WifiManager wifi_manager;
+
+// センサー記録（ファイルは描画タスクが所有）
+TraceConfig trace_config = {};
+FileHandle* trace_file = nullptr;
+TraceWriter trace_writer;
+TraceReader trace_reader;
+TraceReplaySensor replay_sensor;
+ReplayStore replay_store;
+
+// 測定履歴（描画タスクが所有）
+DataLogger data_logger;
+
+// 測定値を公開するHTTPサーバー（描画タスクが所有）
+HttpServer http_server;
+
+// MQTTでの送信（描画タスクが所有、切断中の測定はキューに溜める）
+ForwardQueue forward_queue;
+MqttPublisher mqtt_publisher;
+
+// 再起動直後に表示するグラフのデータ（描画タスクが所有）
+GraphSnapshot graph_snapshot;
+
+// 再起動をまたいだ測定と判定状態の引き継ぎ（区画ごとにセンサータスク・描画タスクが書き込む）
+RestartSnapshot restart_snapshot;
+unsigned long baseline_save_delay = SensorManager::BASELINE_AUTO_SAVE_INTERVAL;  // 最初のベースライン定期保存まで
+
+// 起動の各段階の時刻
+BootProfile boot_profile;
+
+// タスクの1周期の処理時間 (us)（各タスクが記録し、/metrics で公開）
+const uint32_t LOOP_BUCKETS_US[] = { 50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000 };
+MetricsHistogram sensor_loop_histogram(LOOP_BUCKETS_US, sizeof(LOOP_BUCKETS_US) / sizeof(LOOP_BUCKETS_US[0]));
+MetricsHistogram render_loop_histogram(LOOP_BUCKETS_US, sizeof(LOOP_BUCKETS_US) / sizeof(LOOP_BUCKETS_US[0]));
+
+// 処理時間を計測する区間（Serialの "prof" で出力）
+// 各タスクの1周期と、その中の主な処理（区間ごとに記録するタスクは1つ）
+enum LoopPhase : uint8_t {
+  LOOP_PHASE_SENSOR_STEP,   // センサータスクの1周期（待機を除く）
+  LOOP_PHASE_SAMPLE,        // 測定の開始・結果の読み取りと取り込み（sensor_manager.update）
+  LOOP_PHASE_RENDER_STEP,   // 描画タスクの1周期（待機を除く）
+  LOOP_PHASE_GRAPH,         // graph_manager.update
+  LOOP_PHASE_VALUES,        // ui_manager.updateValues
+  LOOP_PHASE_WIFI,          // checkWiFiStatus
+  LOOP_PHASE_BUTTONS,       // handleButtons
+  LOOP_PHASE_SERIAL,        // handleSerialCommands
+  LOOP_PHASE_COUNT
+};
+const char* const LOOP_PHASE_NAMES[LOOP_PHASE_COUNT] = {
+  "sensor_step", "sample", "render_step", "graph", "values", "wifi", "buttons", "serial"
+};
+LoopProfiler loop_profiler(LOOP_PHASE_NAMES, LOOP_PHASE_COUNT);
+
+// 測定に使うセンサーとベースラインの保存先（再生中は記録と揮発ストア、setupで決める）
+SensorDriver* sensor_driver = &sgp;
+KeyValueStore* baseline_store = &preferences;
+
+// 分割した測定で使うSGP30（センサータスクが所有、既定はマルチプレクサなしの1台、Adafruitのライブラリ・再生中は使わない）
+SensorArray sensor_array;
+uint8_t sensor_count = 1;
+bool sensors_connected[SensorArray::MAX_SENSORS] = {};
+SensorAggregate sensor_aggregate = SENSOR_AGGREGATE_MAX;
+bool raw_measurement = false;
+
+// タスク間キュー（いずれも単一生産者・単一消費者）
+SpscQueue<SensorSample, SAMPLE_QUEUE_SIZE> sample_queue;  // センサー → 描画
+SpscQueue<ButtonEvent, EVENT_QUEUE_SIZE> button_queue;    // 描画 → センサー
+SpscQueue<UiEvent, EVENT_QUEUE_SIZE> ui_event_queue;      // センサー → 描画
+SpscQueue<SensorPoint, POINT_QUEUE_SIZE> point_queue;     // センサー → 描画（複数のセンサーの場合のみ）
+SpscQueue<SensorStats, STATS_QUEUE_SIZE> stats_queue;     // センサー → 描画
+unsigned long warmup_end = 0;                             // これより前の測定は送らない（setupで設定）
+
+// 描画タスクが所有する測定履歴
+SensorHistory history;
+TrendPyramid trend;
+SensorSample latest_sample = {};
+SensorPointHistory sensor_histories[SensorArray::MAX_SENSORS];
+SensorPoint latest_points[SensorArray::MAX_SENSORS] = {};
+SensorStats sensor_stats = {};   // センサータスクの統計の最新の複製
+int8_t graph_sensor = -1;   // グラフ・ヘッダーに表示中のセンサー（-1: 全センサーの集計）
+
+// タスクごとのスケジューラ（各タスク内でのみ使用）
+TickScheduler sensor_scheduler(millis, micros);
+TickScheduler render_scheduler(millis, micros);
+
+// タスク関数（ネイティブ環境ではloop()から両方の1周期分を順に実行）
+void initSensorJobs();
+void initRenderJobs();
+unsigned long sensorStep();
+unsigned long renderStep();
+size_t encodeMetricsPage(char* buffer, size_t size, void* context);
+#ifdef ARDUINO
+TaskHandle_t sensor_task_handle = nullptr;
+TaskHandle_t render_task_handle = nullptr;
+void sensorTask(void* param);
+void renderTask(void* param);
+
+// 相手のタスクの起動前（ハンドルが null）は通知しない（起動後の最初の周期で処理される）
+void notifySensorTask() {
+  if (sensor_task_handle != nullptr) {
+    xTaskNotifyGive(sensor_task_handle);
+  }
+}
+void notifyRenderTask() {
+  if (render_task_handle != nullptr) {
+    xTaskNotifyGive(render_task_handle);
+  }
+}
+#else
+void notifySensorTask() {}
+void notifyRenderTask() {}
+#endif
+
+// 生信号の処理の設定（"off": 生信号を測定しない、読めなければ既定の設定）
+// 生信号を測定するなら true
+bool parseSignalConfig(const char* spec, SignalChainConfig &config) {
+  if (strcmp(spec, "off") == 0) {
+    Serial.println("Raw signal measurement off");
+    return false;
+  }
+  if (!parseSignalChain(spec, config)) {
+    Serial.printf("Invalid signal chain \"%s\", using the default\n", spec);
+    parseSignalChain(SIGNAL_CHAIN_DEFAULT, config);
+  }
+
+  char text[CONFIG_LINE_LENGTH];
+  formatSignalChain(config, text, sizeof(text));
+  Serial.printf("Signal chain: %s\n", text);
+  return true;
+}
+
+// 複数のSGP30の設定（mux: マルチプレクサのアドレス（16進）か none、channels: カンマ区切りのチャンネル、
+// aggregate: max / mean）。読めなければ false
+// false: Adafruitのライブラリで1台を使う（mux が adafruit の場合のみ）
+bool parseSensorConfig(const char* mux, const char* channels, const char* aggregate, SensorArrayConfig &config) {
+  // 測定のたびに結果を待つ（約12 ms + 生信号は約25 ms、切り分け用）
+  if (strcmp(mux, "adafruit") == 0) {
+    return false;
+  }
+
+  // マルチプレクサなしでSGP30を1台直接使う（分割した測定）
+  config.mux_address = 0;
+  config.channels[0] = 0;
+  config.count = 1;
+  config.aggregate = SENSOR_AGGREGATE_MAX;
+  if (strcmp(mux, "none") == 0) {
+    return true;
+  }
+
+  char* end = nullptr;
+  unsigned long address = strtoul(mux, &end, 16);
+  if (end == mux || address < 0x70 || address > 0x77) {
+    Serial.printf("Invalid multiplexer address \"%s\", using one SGP30 without a multiplexer\n", mux);
+    return true;
+  }
+  config.mux_address = (uint8_t)address;
+
+  config.count = 0;
+  const char* p = channels;
+  while (*p != '\0') {
+    unsigned long channel = strtoul(p, &end, 10);
+    if (end == p || channel >= I2cMux::CHANNEL_COUNT || config.count == SensorArray::MAX_SENSORS) {
+      Serial.printf("Invalid sensor channels \"%s\", using one SGP30 without a multiplexer\n", channels);
+      config.mux_address = 0;
+      config.channels[0] = 0;
+      config.count = 1;
+      return true;
+    }
+    config.channels[config.count++] = (uint8_t)channel;
+    p = *end == ',' ? end + 1 : end;
+  }
+
+  if (strcmp(aggregate, "mean") == 0) {
+    config.aggregate = SENSOR_AGGREGATE_MEAN;
+  } else {
+    if (aggregate[0] != '\0' && strcmp(aggregate, "max") != 0) {
+      Serial.printf("Invalid sensor aggregate \"%s\", using max\n", aggregate);
+    }
+    config.aggregate = SENSOR_AGGREGATE_MAX;
+  }
+  if (config.count == 0) {
+    Serial.println("No sensor channels, using one SGP30 without a multiplexer");
+    config.mux_address = 0;
+    config.channels[0] = 0;
+    config.count = 1;
+  }
+  return true;
+}
+
+#ifdef ARDUINO
 
 // SDカード初期化関数 - 診断テストで成功した方法を使用
 bool initSDCard() {
@@ -35,7 +385,7 @@ bool initSDCard() {
   // 方法2: 低速SPI
   Serial.println("Trying low-speed SPI method...");
   SD.end(); // 前回の初期化をリセット
-  delay(200);
+  delay(10);
 
   SPIClass spi = SPIClass(VSPI);
   spi.begin();
@@ -48,177 +398,1192 @@ bool initSDCard() {
   return false;
 }
 
-// WiFi設定を読み込む関数
-bool loadWifiConfig(String &ssid, String &password) {
+// 設定ファイルの1行を読み込む（前後の空白・改行を除く）
+void readConfigLine(File &file, char* line, size_t size) {
+  size_t length = file.readBytesUntil('\n', line, size - 1);
+  line[length] = '\0';
+
+  char* start = line;
+  while (*start != '\0' && isspace((unsigned char)*start)) {
+    start++;
+  }
+  length = strlen(start);
+  while (length > 0 && isspace((unsigned char)start[length - 1])) {
+    length--;
+  }
+  memmove(line, start, length);
+  line[length] = '\0';
+}
+
+// WiFi設定を読み込む関数（SSIDとパスワードの行の組、最大 WifiManager::MAX_NETWORKS 件）
+// 読み込んだ件数を返す
+uint8_t loadWifiConfig(WifiNetwork* networks) {
   // SDカードはすでに初期化されているはず
 
   File configFile = SD.open(WIFI_CONFIG_FILE, FILE_READ);
   if (!configFile) {
     Serial.println("Config file not found");
-    return false;
+    return 0;
   }
 
-  ssid = configFile.readStringUntil('\n');
-  ssid.trim();
-  password = configFile.readStringUntil('\n');
-  password.trim();
+  uint8_t count = 0;
+  while (count < WifiManager::MAX_NETWORKS && configFile.available()) {
+    WifiNetwork& network = networks[count];
+    readConfigLine(configFile, network.ssid, sizeof(network.ssid));
+    readConfigLine(configFile, network.password, sizeof(network.password));
+    if (network.ssid[0] != '\0') {
+      count++;
+    }
+  }
 
   configFile.close();
-  return (ssid.length() > 0);
+  return count;
 }
 
-// WiFiに接続する関数
-bool connectToWifi() {
-  String ssid, password;
+// センサー記録の設定を読み込む関数
+// 1行目: record / replay、2行目: ファイルのパス、3行目（再生時のみ）: 1x / max
+bool loadTraceConfig(TraceConfig &config) {
+  File configFile = SD.open(TRACE_CONFIG_FILE, FILE_READ);
+  if (!configFile) {
+    return false;
+  }
+
+  char mode[CONFIG_LINE_LENGTH];
+  char speed[CONFIG_LINE_LENGTH];
+  readConfigLine(configFile, mode, sizeof(mode));
+  readConfigLine(configFile, config.path, sizeof(config.path));
+  readConfigLine(configFile, speed, sizeof(speed));
+  configFile.close();
 
-  if (!loadWifiConfig(ssid, password)) {
-    Serial.println("WiFi config load failed");
+  if (strcmp(mode, "record") == 0) {
+    config.mode = TRACE_RECORD;
+  } else if (strcmp(mode, "replay") == 0) {
+    config.mode = TRACE_REPLAY;
+  } else {
+    config.mode = TRACE_OFF;
+  }
+  config.fast = (strcmp(speed, "max") == 0);
+  return config.mode != TRACE_OFF && config.path[0] != '\0';
+}
+
+// MQTTの設定を読み込む関数
+// 1行目: ブローカーのホスト、2行目: ポート（既定 1883）、3行目: トピック、
+// 4行目: 送信間隔（秒、既定 10）、5行目: クライアントID（既定 tvoc-monitor）
+bool loadMqttConfig(MqttConfig &config) {
+  File configFile = SD.open(MQTT_CONFIG_FILE, FILE_READ);
+  if (!configFile) {
     return false;
   }
 
-  Serial.printf("WiFi connecting: %s\n", ssid.c_str());
-  WiFi.begin(ssid.c_str(), password.c_str());
+  char port[CONFIG_LINE_LENGTH];
+  char interval[CONFIG_LINE_LENGTH];
+  readConfigLine(configFile, config.host, sizeof(config.host));
+  readConfigLine(configFile, port, sizeof(port));
+  readConfigLine(configFile, config.topic, sizeof(config.topic));
+  readConfigLine(configFile, interval, sizeof(interval));
+  readConfigLine(configFile, config.client_id, sizeof(config.client_id));
+  configFile.close();
 
-  // 接続待機（タイムアウト付き）
-  unsigned long startTime = millis();
-  while (WiFi.status() != WL_CONNECTED) {
-    if (millis() - startTime > WIFI_CONNECT_TIMEOUT) {
-      Serial.println("\nWiFi connection timeout");
-      return false;
+  config.port = port[0] != '\0' ? (uint16_t)atoi(port) : 1883;
+  config.publish_interval = interval[0] != '\0' ? (uint16_t)atoi(interval) : MQTT_PUBLISH_INTERVAL;
+  if (config.client_id[0] == '\0') {
+    strcpy(config.client_id, "tvoc-monitor");
+  }
+  return config.host[0] != '\0' && config.topic[0] != '\0';
+}
+
+// 生信号の処理の設定を読み込む（1行、設定ファイルがなければ既定の設定）
+bool loadSignalConfig(SignalChainConfig &config) {
+  char spec[CONFIG_LINE_LENGTH] = SIGNAL_CHAIN_DEFAULT;
+  if (files_available) {
+    File configFile = SD.open(SIGNAL_CONFIG_FILE, FILE_READ);
+    if (configFile) {
+      readConfigLine(configFile, spec, sizeof(spec));
+      configFile.close();
     }
-    delay(500);
-    Serial.print(".");
   }
+  return parseSignalConfig(spec, config);
+}
+
+// SGP30の設定を読み込む関数（設定ファイルがなければSGP30を1台、マルチプレクサなしで分割した測定で使う）
+// 1行目: マルチプレクサのアドレス（例 0x70、none: マルチプレクサなしの1台、adafruit: Adafruitのライブラリで1台）、
+// 2行目: チャンネル（例 0,1,2）、3行目: max / mean（既定 max）
+bool loadSensorConfig(SensorArrayConfig &config) {
+  char mux[CONFIG_LINE_LENGTH] = "none";
+  char channels[CONFIG_LINE_LENGTH] = "";
+  char aggregate[CONFIG_LINE_LENGTH] = "";
+  if (files_available) {
+    File configFile = SD.open(SENSOR_CONFIG_FILE, FILE_READ);
+    if (configFile) {
+      readConfigLine(configFile, mux, sizeof(mux));
+      readConfigLine(configFile, channels, sizeof(channels));
+      readConfigLine(configFile, aggregate, sizeof(aggregate));
+      configFile.close();
+    }
+  }
+  return parseSensorConfig(mux, channels, aggregate, config);
+}
+
+// 現在のUNIX時刻（未設定なら 0）
+uint32_t currentEpoch() {
+  time_t now = time(nullptr);
+  return now >= EPOCH_VALID_AFTER ? (uint32_t)now : 0;
+}
 
-  Serial.println("\nWiFi connected");
+// 接続するたびに時刻を合わせる（完了するまで測定履歴は時刻不明として記録）
+void onWifiConnected() {
   Serial.print("IP address: ");
   Serial.println(WiFi.localIP());
+  configTime(UTC_OFFSET, 0, NTP_SERVER);
+}
+#else
+// ネイティブ環境のSDカードとWiFiはシミュレーション（設定はコマンドラインで指定）
+uint8_t loadWifiConfig(WifiNetwork* networks) {
+  if (!sim_wifi.isEnabled()) {
+    return 0;
+  }
+
+  static const char* ssids[] = { "sim-home", "sim-office" };
+  for (uint8_t i = 0; i < 2; i++) {
+    strcpy(networks[i].ssid, ssids[i]);
+    strcpy(networks[i].password, "sim");
+  }
+  return 2;
+}
+
+void onWifiConnected() {}
+
+bool loadMqttConfig(MqttConfig &config) {
+  if (sim_mqtt_port == 0) {
+    return false;
+  }
+
+  strcpy(config.host, "127.0.0.1");
+  config.port = sim_mqtt_port;
+  strcpy(config.topic, "tvoc/sim");
+  strcpy(config.client_id, "tvoc-sim");
+  config.publish_interval = MQTT_PUBLISH_INTERVAL;
+  return true;
+}
+
+uint32_t currentEpoch() {
+  return SIM_EPOCH_START + millis() / 1000;
+}
+
+bool loadSignalConfig(SignalChainConfig &config) {
+  return parseSignalConfig(sim_signal_chain != nullptr ? sim_signal_chain : SIGNAL_CHAIN_DEFAULT, config);
+}
+
+bool loadSensorConfig(SensorArrayConfig &config) {
+  if (sim_sensor_blocking) {
+    return parseSensorConfig("adafruit", "", "", config);
+  }
+  if (sim_sensor_count == 0) {
+    return parseSensorConfig("none", "", "", config);
+  }
+
+  char channels[CONFIG_LINE_LENGTH] = "";
+  for (uint8_t i = 0; i < sim_sensor_count; i++) {
+    size_t used = strlen(channels);
+    snprintf(channels + used, sizeof(channels) - used, "%s%u", i > 0 ? "," : "", i);
+  }
+  return parseSensorConfig("0x70", channels, sim_sensor_aggregate != nullptr ? sim_sensor_aggregate : "max", config);
+}
+
+bool loadTraceConfig(TraceConfig &config) {
+  const char* path = sim_trace_replay != nullptr ? sim_trace_replay : sim_trace_record;
+  if (path == nullptr) {
+    return false;
+  }
+
+  config.mode = sim_trace_replay != nullptr ? TRACE_REPLAY : TRACE_RECORD;
+  strncpy(config.path, path, sizeof(config.path) - 1);
+  config.fast = sim_trace_fast;
   return true;
 }
+#endif
 
-// WiFi接続状態をチェックする関数
+// WiFiの接続管理を進め、接続状態の変化を反映する関数
 void checkWiFiStatus() {
-  // 接続が切れていれば再接続を試みる
-  if (wifi_connected && WiFi.status() != WL_CONNECTED) {
-    wifi_connected = false;
-    Serial.println("WiFi connection lost");
-  } else if (!wifi_connected && WiFi.status() == WL_CONNECTED) {
-    wifi_connected = true;
-    Serial.println("WiFi connected");
+  wifi_manager.poll();
+  power_manager.setRadioActive(wifi_manager.isRadioActive());
+  bool connected = wifi_manager.isConnected();
+  if (connected == wifi_connected) {
+    return;
+  }
+
+  wifi_connected = connected;
+  if (connected) {
+    onWifiConnected();
+    if (wifi_manager.reconnects() == 0) {
+      ui_manager.showMessage("WiFi connected!", 2000);
+    }
+  }
+}
+
+// センサー記録の開始（再生時は測定に使うセンサーを差し替える）
+bool initTrace() {
+  if (!files_available || !loadTraceConfig(trace_config)) {
+    trace_config.mode = TRACE_OFF;
+    return false;
+  }
+
+  if (trace_config.mode == TRACE_REPLAY) {
+    trace_file = files.open(trace_config.path, FILE_MODE_READ);
+    if (trace_file == nullptr || !trace_reader.begin(trace_file)) {
+      Serial.printf("Trace replay failed: %s\n", trace_config.path);
+      files.close(trace_file);
+      trace_file = nullptr;
+      trace_config.mode = TRACE_OFF;
+      return false;
+    }
+
+    replay_sensor.setFast(trace_config.fast);
+    replay_sensor.fill(trace_reader);
+    sensor_driver = &replay_sensor;
+    baseline_store = &replay_store;
+    Serial.printf("Replaying trace %s (%s)\n", trace_config.path, trace_config.fast ? "max speed" : "1x");
+    return true;
+  }
+
+  // 再起動をまたいで同じファイルに追記する
+  trace_file = files.open(trace_config.path, FILE_MODE_APPEND);
+  if (trace_file == nullptr ||
+      !trace_writer.begin(trace_file, SensorManager::SENSOR_UPDATE_INTERVAL, true)) {
+    Serial.printf("Trace recording failed: %s\n", trace_config.path);
+    files.close(trace_file);
+    trace_file = nullptr;
+    trace_config.mode = TRACE_OFF;
+    return false;
   }
+
+  Serial.printf("Recording trace to %s\n", trace_config.path);
+  return true;
+}
+
+// SGP30を分割した測定で使う初期化（1台直接かマルチプレクサの先の複数台、主センサーを0番に置き換え、暖機をやり直す）
+void initSensorArray(const SensorArrayConfig &config) {
+  sensor_array.init(&i2c_bus, config.mux_address, config.channels, config.count);
+  sensor_count = sensor_array.size();
+  sensor_aggregate = config.aggregate;
+  sensor_driver = &sensor_array.device(0);
+
+  sensor_connected = false;
+  for (uint8_t i = 0; i < sensor_count; i++) {
+    sensors_connected[i] = sensor_managers[i].init(&sensor_array.device(i), baseline_store, i);
+    sensor_connected = sensor_connected || sensors_connected[i];
+    Serial.printf("Sensor #%u on channel %u: %s\n", i, config.channels[i], sensors_connected[i] ? "OK" : "not found");
+  }
+  warmup_end = millis() + SENSOR_WARMUP_TIME;
+  if (config.mux_address == 0) {
+    Serial.println("SGP30 on the I2C bus without a multiplexer");
+  } else {
+    Serial.printf("%u sensors behind the multiplexer at 0x%02X (%s)\n",
+                  sensor_count, config.mux_address, sensorAggregateName(sensor_aggregate));
+  }
+}
+
+// 分割した測定をやめ、1台のセンサーを driver で直接使う（Adafruitのライブラリ・記録の再生）
+void useSingleSensor(SensorDriver* driver) {
+  sensor_array.init(&i2c_bus, 0, nullptr, 0);
+  sensor_count = 1;
+  sensor_driver = driver;
+  sensor_connected = sensor_manager.init(sensor_driver, baseline_store);
+}
+
+// i 番目のセンサー（0番は再生中なら記録）
+SensorDriver* sensorDriver(uint8_t index) {
+  return index == 0 ? sensor_driver : &sensor_array.device(index);
+}
+
+// 書きかけのチャンクを書き込んでファイルを閉じる
+void closeTrace() {
+  if (trace_writer.isRecording()) {
+    trace_writer.end();
+  }
+  files.close(trace_file);
+  trace_file = nullptr;
 }
 
+#ifdef ARDUINO
+// 計画的な再起動（ESP.restart()・OTA）の直前：RTCメモリの内容をNVSへ写す
+// どのタスクから呼ばれるか分からないので、各タスクが書き込み済みの内容のみを使う
+void onPlannedRestart() {
+  if (restart_snapshot.persist()) {
+    Serial.println("Restart snapshot saved to NVS");
+  }
+}
+#endif
+
 void setup() {
   Serial.begin(115200); // 通信速度を115200bpsに変更
   Serial.println("\n=== Air Quality Monitor Starting ===");
 
   // M5Stackの初期化
+#ifdef ARDUINO
   M5.begin(true, false, true, true);
-  M5.Lcd.fillScreen(BLACK);
+#endif
+
+  // 描画レイヤーの初期化（ヘッダーとY軸の目盛りの字形は先にキャッシュ）
+  lcd_renderer.init(&display);
+  if (glyph_cache.init(&display)) {
+    lcd_renderer.setGlyphCache(&glyph_cache);
+  }
+  lcd_renderer.fillRect(0, 0, display.width(), display.height(), BLACK);
 
   // UIマネージャの初期化
-  ui_manager.init();
+  ui_manager.init(&lcd_renderer);
 
   // グラフマネージャの初期化
-  graph_manager.init();
+  graph_manager.init(&lcd_renderer);
+  boot_profile.mark("display");
+
+  // センサーの初期化（SGP30の暖機を先に始め、以降の初期化と並行して待つ。ベースラインもここで復元）
+  // 温湿度センサーは1つなので、0番が読み、マルチプレクサの先の他のSGP30は0番の測定で補正する
+  sensor_manager.setEpochClock(currentEpoch);
+  sensor_manager.setEnvironmentSensor(&environment_sensor);
+  for (uint8_t i = 1; i < SensorArray::MAX_SENSORS; i++) {
+    sensor_managers[i].setHumiditySource(&sensor_manager);
+  }
+  // SDカードの設定を読む前なので、既定の構成（マルチプレクサなしの1台）で始める
+  SensorArrayConfig sensor_config = {};
+  parseSensorConfig("none", "", "", sensor_config);
+  initSensorArray(sensor_config);
+  boot_profile.mark("sensor");
 
+#ifdef ARDUINO
   // SDカードの初期化 - 改良版を使用
   Serial.println("Initializing SD card...");
   bool sdCardOK = initSDCard();
   if (!sdCardOK) {
     Serial.println("SD card initialization failed");
-    ui_manager.showMessage("SD Card Error!", 2000);
+    ui_manager.showMessage("SD Card Error!", 2000, MESSAGE_ERROR, RED);
     // SDカードエラーでも続行
   }
+  files_available = sdCardOK;
 
-  // WiFi接続（SDカード初期化成功時のみ）
-  if (sdCardOK) {
-    wifi_connected = connectToWifi();
-    ui_manager.showMessage(wifi_connected ? "WiFi connected!" : "WiFi connection failed", 2000);
-  } else {
-    wifi_connected = false;
+#else
+  files_available = true;
+#endif
+  boot_profile.mark("sd");
+
+  // WiFi接続（SDカードの設定がある場合のみ、接続は描画タスクのwifiJobで進める）
+  WifiNetwork wifi_networks[WifiManager::MAX_NETWORKS] = {};
+  uint8_t wifi_network_count = files_available ? loadWifiConfig(wifi_networks) : 0;
+  if (wifi_network_count > 0) {
+    wifi_manager.init(&wifi_driver, &wifi_store, wifi_networks, wifi_network_count);
   }
 
-  // センサーの初期化
-  sensor_connected = sensor_manager.init(&sgp, &preferences);
+  // センサー記録の設定（SDカード上の設定ファイルがある場合）
+  if (initTrace()) {
+    ui_manager.showMessage(trace_config.mode == TRACE_REPLAY ? "Replaying trace" : "Recording trace", 2000);
+  }
+  if (trace_config.mode == TRACE_REPLAY) {
+    // 記録を再生するセンサーに差し替える（記録済みの測定なので暖機・湿度補正は不要）
+    for (uint8_t i = 0; i < SensorArray::MAX_SENSORS; i++) {
+      sensor_managers[i].setEnvironmentSensor(nullptr);
+      sensor_managers[i].setHumiditySource(nullptr);
+    }
+    useSingleSensor(sensor_driver);
+    warmup_end = millis();
+  } else if (!loadSensorConfig(sensor_config)) {
+    // 明示的な指定のみ：Adafruitのライブラリで1台（測定を待つ）
+    Serial.println("SGP30 through the Adafruit library (blocking measurements)");
+    useSingleSensor(&sgp);
+    warmup_end = millis() + SENSOR_WARMUP_TIME;
+  } else if (sensor_config.mux_address != 0) {
+    // マルチプレクサの先の複数のSGP30に置き換える（SDカード上の設定ファイルがある場合）
+    initSensorArray(sensor_config);
+    if (sensor_count > 1) {
+      ui_manager.setValueLabel(sensorAggregateName(sensor_aggregate));
+    }
+  }
+  if (sensor_count == 1) {
+    sensors_connected[0] = sensor_connected;
+  }
   if (!sensor_connected) {
     ui_manager.showSensorError();
   }
 
-  // ボタン操作ガイドを表示
+  // 生信号の処理（センサー記録中は設定によらず生信号を記録する）
+  SignalChainConfig signal_config = {};
+  bool raw_enabled = loadSignalConfig(signal_config);
+  raw_measurement = raw_enabled || trace_config.mode == TRACE_RECORD;
+  for (uint8_t i = 0; i < sensor_count; i++) {
+    sensor_managers[i].setSignalChain(signal_config);
+    sensor_managers[i].setRawMeasurement(raw_measurement);
+  }
+  boot_profile.mark("config");
+
+#ifdef ARDUINO
+  const char* log_dir = LOG_DIR;
+#else
+  const char* log_dir = sim_log_dir;
+#endif
+
+  // 前回のグラフを復元して空白の画面を避ける（再生中は記録の測定のみ表示する）
+  if (files_available && log_dir != nullptr && trace_config.mode != TRACE_REPLAY) {
+    char path_a[GraphSnapshot::PATH_LENGTH];
+    char path_b[GraphSnapshot::PATH_LENGTH];
+    snprintf(path_a, sizeof(path_a), "%s/%s", log_dir, GRAPH_SNAPSHOT_A);
+    snprintf(path_b, sizeof(path_b), "%s/%s", log_dir, GRAPH_SNAPSHOT_B);
+    graph_snapshot.init(&files, path_a, path_b);
+    size_t restored = graph_snapshot.restore(history, trend, millis());
+    if (restored > 0) {
+      Serial.printf("Graph restored: %u samples\n", (unsigned)restored);
+    }
+  }
+
+  // リセット前の状態の引き継ぎ（RTCメモリ、なければ計画的な再起動の前にNVSへ写したもの）
+  // 測定はSDカードの5分ごとの保存より新しいので置き換える
+  if (trace_config.mode != TRACE_REPLAY) {
+    restart_snapshot.init(&retained_memory, &restart_store);
+    for (uint8_t i = 0; i < sensor_count; i++) {
+      SensorManagerState sensor_state;
+      if (!sensors_connected[i] || !restart_snapshot.restoreSensorState(i, sensor_state)) {
+        continue;
+      }
+      sensor_managers[i].restoreState(sensor_state);
+      // 定期保存はすべてのセンサーで同じジョブなので0番に合わせる
+      if (i == 0) {
+        unsigned long since = sensor_state.since_periodic_save;
+        baseline_save_delay = since < SensorManager::BASELINE_AUTO_SAVE_INTERVAL
+                                ? SensorManager::BASELINE_AUTO_SAVE_INTERVAL - since : 0;
+      }
+    }
+    size_t restored = restart_snapshot.restoreHistory(history, millis());
+    if (restored > 0) {
+      Serial.printf("Graph restored from the restart snapshot: %u samples\n", (unsigned)restored);
+    }
+  }
+  boot_profile.mark("restore");
+
+  // 測定履歴の保存（再生中は記録しない）
+  if (files_available && log_dir != nullptr && trace_config.mode != TRACE_REPLAY) {
+    data_logger.init(&files, log_dir, UTC_OFFSET);
+  }
+
+  // MQTTでの送信（切断中の測定はRAM、溢れたらSDカードに溜める。再生中は送らない）
+  MqttConfig mqtt_config = {};
+  if (trace_config.mode != TRACE_REPLAY && loadMqttConfig(mqtt_config)) {
+    forward_queue.init(files_available ? &files : nullptr, MQTT_SPOOL_FILE);
+    mqtt_publisher.init(&net_connector, &forward_queue, mqtt_config);
+  }
+
+  // HTTPサーバー（実機はWiFi接続後にhttpJobで起動、/history は復元した分を除く）
+  http_server.init(&net_server, &history, &trend);
+  http_server.markRestored();
+  http_server.setOpenMetrics(encodeMetricsPage, nullptr);
+#ifndef ARDUINO
+  if (sim_http_port != 0) {
+    http_server.begin(sim_http_port);
+  }
+#endif
+  boot_profile.mark("services");
+
+  // ボタン操作ガイドとグラフの枠を表示（復元したグラフは最初の描画で表示）
   ui_manager.showButtonGuide();
+  graph_manager.drawFrames();
+
+  // 動作モードの適用（CPUクロック・バックライト）
+  power_manager.init(&display, POWER_MODE_DEFAULT);
+
+  initSensorJobs();
+  initRenderJobs();
+
+  // 描画タスクとセンサータスクを別コアで起動
+  // （センサータスクは最初の周期から描画タスクへ通知するので、描画タスクを先に作る）
+#ifdef ARDUINO
+  esp_register_shutdown_handler(onPlannedRestart);
+  xTaskCreatePinnedToCore(renderTask, "render", RENDER_TASK_STACK, nullptr,
+                          RENDER_TASK_PRIORITY, &render_task_handle, RENDER_TASK_CORE);
+  xTaskCreatePinnedToCore(sensorTask, "sensor", SENSOR_TASK_STACK, nullptr,
+                          SENSOR_TASK_PRIORITY, &sensor_task_handle, SENSOR_TASK_CORE);
+#endif
+  boot_profile.mark("tasks");
+}
+
+// ボタンイベント処理（センサータスク）
+void handleButtonEvent(ButtonEvent event) {
+  UiEvent ui_event = {};
+  // 測定中のSGP30はコマンドに応答しないので、分割した測定の途中なら完了を待つ
+  sensor_array.finishCycle();
+
+  // 複数のセンサーの場合は全センサーに行い、主センサーの結果を表示する
+  switch (event) {
+    // ベースラインリセット
+    case BUTTON_RESET_BASELINE:
+      for (uint8_t i = 1; i < sensor_count; i++) {
+        if (sensors_connected[i]) {
+          sensor_managers[i].resetBaseline(sensorDriver(i));
+        }
+      }
+      if (!sensor_manager.resetBaseline(sensor_driver)) {
+        return;
+      }
+      ui_event.type = UI_BASELINE_RESET;
+      break;
+
+    // 手動ベースライン保存
+    case BUTTON_SAVE_BASELINE:
+      for (uint8_t i = 1; i < sensor_count; i++) {
+        if (sensors_connected[i]) {
+          sensor_managers[i].saveBaseline(sensorDriver(i), BASELINE_SOURCE_MANUAL);
+        }
+      }
+      if (sensor_manager.saveBaseline(sensor_driver, BASELINE_SOURCE_MANUAL)) {
+        ui_event.type = UI_BASELINE_SAVED;
+      } else if (sensor_manager.lastBaselineScore().verdict != BASELINE_ACCEPTED) {
+        ui_event.type = UI_BASELINE_REJECTED;
+        ui_event.verdict = sensor_manager.lastBaselineScore().verdict;
+      } else {
+        return;
+      }
+      break;
+
+    // 現在のベースライン値を取得
+    case BUTTON_SHOW_BASELINE:
+      if (!sensor_manager.getBaseline(sensor_driver, &ui_event.eco2_base, &ui_event.tvoc_base)) {
+        return;
+      }
+      ui_event.type = UI_BASELINE_VALUES;
+      break;
+  }
+
+  ui_event_queue.push(ui_event);
+}
+
+// SGP30の暖機が終わり、有効な測定が得られるか
+bool sensorWarmedUp() {
+  return (long)(millis() - warmup_end) >= 0;
+}
+
+// 各センサーの測定を取り込み、暖機後なら描画タスクへ送る
+// SGP30を直接使う場合は collectJob が読み取り済みの結果を取り込むのでI2Cを使わない
+void publishSamples() {
+  SensorPoint points[SensorArray::MAX_SENSORS];
+  bool updated = false;
+  for (uint8_t i = 0; i < sensor_count; i++) {
+    bool sensor_updated = sensor_managers[i].update(sensors_connected[i]);
+    points[i] = sensor_managers[i].getLatestPoint(sensors_connected[i] && sensor_updated);
+    updated = updated || sensor_updated;
+  }
+
+  if (updated && sensorWarmedUp()) {
+    SensorSample sample = sensor_manager.getLatestSample();
+    if (sensor_count > 1) {
+      // 表示・記録・送信する値は全センサーの集計（センサーごとの値は別のキューで送る）
+      aggregatePoints(points, sensor_count, sensor_aggregate, &sample.tvoc, &sample.eco2);
+      for (uint8_t i = 0; i < sensor_count; i++) {
+        point_queue.push(points[i]);
+      }
+    }
+    sample_queue.push(sample);
+    notifyRenderTask();
+  }
+}
+
+void collectJob(void* context);
+
+// 分割した測定を進める（結果が揃えば取り込み、揃っていなければ次の読み取りを予約する）
+void advanceCycle() {
+  unsigned long wait = sensor_array.poll();
+  // 登録できなければ周期の完了まで待つ
+  if (wait > 0 && sensor_scheduler.addOneShot("collect", wait, collectJob, nullptr) < 0) {
+    sensor_array.finishCycle();
+    wait = 0;
+  }
+  if (wait == 0) {
+    publishSamples();
+  }
+}
+
+// 測定結果の読み取りジョブ（SGP30を直接使う場合、測定コマンドの後に結果が揃うまで予約し直す）
+void collectJob(void* context) {
+  PROFILE_SCOPE(loop_profiler, LOOP_PHASE_SAMPLE);
+  unsigned long start_us = micros();
+  advanceCycle();
+  power_manager.addI2cTime(micros() - start_us);
+}
+
+// センサー読み取りジョブ（1秒ごと、最高速の再生中は REPLAY_FAST_INTERVAL ごと）
+// SGP30は起動直後から1秒ごとの測定が必要なので暖機中も測定し、結果は暖機後のみ送る
+void sampleJob(void* context) {
+  // 再生中は次の記録の時刻まで測定しない
+  if (sensor_driver == &replay_sensor && !replay_sensor.due()) {
+    return;
+  }
+
+  PROFILE_SCOPE(loop_profiler, LOOP_PHASE_SAMPLE);
+  unsigned long start_us = micros();
+  if (sensor_array.size() > 0 && sensor_connected) {
+    // SGP30を直接使う場合は測定コマンドを送るだけで戻り、測定時間の間はタスクを空ける（センサーがなければデモ表示のみ）
+    if (sensor_array.startCycle(raw_measurement)) {
+      advanceCycle();
+    }
+  } else {
+    publishSamples();
+  }
+  power_manager.addI2cTime(micros() - start_us);
+}
+
+// 自動ベースライン判定ジョブ
+void autoBaselineJob(void* context) {
+  sensor_array.finishCycle();
+  bool rolled_back = false;
+  for (uint8_t i = 0; i < sensor_count; i++) {
+    SensorManager& manager = sensor_managers[i];
+    if (!sensors_connected[i]) {
+      continue;
+    }
+    if (sensorWarmedUp()) {
+      manager.checkAutoBaseline();
+    }
+
+    // 保存後の測定が不自然なら保存前のベースラインへ戻す
+    if (manager.baselineRollbackDue() && manager.rollbackBaseline(sensorDriver(i))) {
+      rolled_back = true;
+    }
+  }
+
+  if (rolled_back) {
+    UiEvent ui_event = {};
+    ui_event.type = UI_BASELINE_ROLLED_BACK;
+    ui_event_queue.push(ui_event);
+  }
+}
+
+// ベースライン定期保存ジョブ
+void baselineSaveJob(void* context) {
+  sensor_array.finishCycle();
+  for (uint8_t i = 0; i < sensor_count; i++) {
+    if (sensors_connected[i]) {
+      sensor_managers[i].periodicBaselineSave();
+    }
+  }
+}
+
+// 湿度補正ジョブ（温湿度センサーがある場合のみ登録）
+void humidityJob(void* context) {
+  unsigned long start_us = micros();
+  sensor_array.finishCycle();
+  // 0番が温湿度センサーを読み、他のセンサーはその測定を設定する
+  sensor_manager.updateHumidity();
+  for (uint8_t i = 1; i < sensor_count; i++) {
+    if (sensors_connected[i]) {
+      sensor_managers[i].updateHumidity();
+    }
+  }
+  power_manager.addI2cTime(micros() - start_us);
+}
+
+// 再起動に備えた判定状態の書き込みジョブ
+void sensorRetainJob(void* context) {
+  SensorManagerState states[SensorArray::MAX_SENSORS];
+  for (uint8_t i = 0; i < sensor_count; i++) {
+    states[i] = sensor_managers[i].exportState();
+  }
+  restart_snapshot.saveSensorStates(states, sensor_count);
+}
+
+// /metrics 用の統計を複製して描画タスクへ送る（満杯なら次の周期に送る）
+void statsPublishJob(void* context) {
+  SensorStats stats = {
+    sensor_loop_histogram,
+    sensor_array.latency(false),
+    sensor_array.latency(true),
+    sensor_array.retries(),
+    sensor_array.lastCycleMicros(),
+    sensor_array.nackCount(),
+    sensor_array.crcErrorCount(),
+    sensor_array.failureCount()
+  };
+  stats_queue.push(stats);
+}
+
+void sensorStatsJob(void* context) {
+  sensor_scheduler.logStats("sensor");
+  power_manager.logStats();
+  for (uint8_t i = 0; i < sensor_count; i++) {
+    sensor_managers[i].baselineStore().logStats();
+  }
+  sensor_manager.logSignalStats();
+  sensor_array.logStats();
+}
+
+void initSensorJobs() {
+  // 最高速の再生中は記録上の時間に合わせて周期を縮める
+  unsigned long scale = 1;
+  if (trace_config.mode == TRACE_REPLAY && trace_config.fast) {
+    scale = SensorManager::SENSOR_UPDATE_INTERVAL / REPLAY_FAST_INTERVAL;
+  }
+
+  // 分割した測定の途中に他のコマンドを送ると測定の完了を待つことになるので、測定と重ならない時刻にずらす
+  unsigned long offset = sensor_array.size() > 0 ? SENSOR_COMMAND_OFFSET : 0;
+
+  sensor_scheduler.addPeriodic("sample", SensorManager::SENSOR_UPDATE_INTERVAL / scale, sampleJob, nullptr);
+  sensor_scheduler.addPeriodic("auto_base", SensorManager::AUTO_CHECK_INTERVAL / scale, autoBaselineJob, nullptr,
+                               SensorManager::AUTO_CHECK_INTERVAL / scale + offset);
+  sensor_scheduler.addPeriodic("base_save", SensorManager::BASELINE_AUTO_SAVE_INTERVAL / scale, baselineSaveJob, nullptr,
+                               baseline_save_delay / scale + offset);
+  if (sensor_manager.hasHumidityCompensation()) {
+    sensor_scheduler.addPeriodic("humidity", HumidityCompensation::MEASURE_INTERVAL, humidityJob, nullptr, offset);
+  }
+  if (restart_snapshot.isEnabled()) {
+    sensor_scheduler.addPeriodic("retain", RETAIN_INTERVAL, sensorRetainJob, nullptr, RETAIN_INTERVAL);
+  }
+  sensor_scheduler.addPeriodic("stats", STATS_LOG_INTERVAL, sensorStatsJob, nullptr, STATS_LOG_INTERVAL);
+  sensor_scheduler.addPeriodic("stats_pub", STATS_PUBLISH_INTERVAL, statsPublishJob, nullptr);
 }
 
-// ボタン処理関数
+// センサータスクの1周期分の処理（次の期限までの時間を返す）
+unsigned long sensorStep() {
+  PROFILE_SCOPE(loop_profiler, LOOP_PHASE_SENSOR_STEP);
+  unsigned long start_us = micros();
+  ButtonEvent event;
+  while (button_queue.pop(event)) {
+    handleButtonEvent(event);
+  }
+
+  unsigned long wait = sensor_scheduler.runDue();
+  sensor_loop_histogram.observe(micros() - start_us);
+  return wait;
+}
+
+#ifdef ARDUINO
+// センサータスク（I2Cアクセスはすべてこのタスクで行う）
+void sensorTask(void* param) {
+  for (;;) {
+    // 次の期限まで待機（ボタン操作の通知で起床、低消費電力モードではライトスリープ）
+    power_manager.idle(sensorStep());
+  }
+}
+#endif
+
+// グラフの表示の切り替え（5分/1時間/24時間/7日/生信号、複数のセンサーの場合は続けてセンサーごとの5分）
+void nextGraphView() {
+  int8_t sensor = graph_manager.getSensor();
+  if (sensor_count <= 1 || (sensor < 0 && graph_manager.getView() != GRAPH_VIEW_COUNT - 1)) {
+    graph_manager.nextView();
+    return;
+  }
+
+  // 最後のセンサーの次は全センサーの集計の5分に戻る
+  sensor++;
+  if (sensor < sensor_count) {
+    char label[8];
+    snprintf(label, sizeof(label), "#%d", sensor);
+    graph_manager.setSensor(&sensor_histories[sensor], sensor);
+    ui_manager.setValueLabel(label);
+  } else {
+    graph_manager.setSensor(nullptr, -1);
+    ui_manager.setValueLabel(sensorAggregateName(sensor_aggregate));
+  }
+}
+
+// ボタン処理関数（描画タスク）
 void handleButtons() {
-  M5.update();
+  static bool wake_press = false;
 
+  buttons.update();
+
+  // 減光中の操作は画面の復帰のみ（ボタンを離すまで無視）
+  bool any_pressed = buttons.isPressed(ButtonInput::BUTTON_A) ||
+                     buttons.isPressed(ButtonInput::BUTTON_B) ||
+                     buttons.isPressed(ButtonInput::BUTTON_C);
+  if (any_pressed && power_manager.wake()) {
+    wake_press = true;
+  }
+  if (wake_press) {
+    wake_press = any_pressed;
+    return;
+  }
+
+  // Aボタン長押し：動作モードの切り替え（通常/低消費電力）
+  if (buttons.wasReleasefor(ButtonInput::BUTTON_A, POWER_HOLD_TIME)) {
+    bool low = power_manager.getMode() != POWER_MODE_LOW;
+    power_manager.setMode(low ? POWER_MODE_LOW : POWER_MODE_NORMAL);
+    ui_manager.showMessage(low ? "Low power mode" : "Normal power mode", 2000);
+  }
   // Aボタン：ベースラインリセット
-  if (M5.BtnA.wasPressed() && sensor_connected) {
-    if (sensor_manager.resetBaseline(&sgp)) {
-      ui_manager.showBaselineReset();
-    }
+  else if (buttons.wasReleased(ButtonInput::BUTTON_A) && sensor_connected) {
+    button_queue.push(BUTTON_RESET_BASELINE);
+    notifySensorTask();
   }
 
   // Bボタン：手動ベースライン保存
-  if (M5.BtnB.wasPressed() && sensor_connected) {
-    bool isCleanAir = sensor_manager.isCleanAirCondition();
-    sensor_manager.saveBaseline(&sgp, &preferences);
-    ui_manager.showBaselineSaved(isCleanAir);
+  if (buttons.wasPressed(ButtonInput::BUTTON_B) && sensor_connected) {
+    button_queue.push(BUTTON_SAVE_BASELINE);
+    notifySensorTask();
   }
 
+  // Cボタン長押し：グラフ表示期間の切り替え（5分/1時間/24時間/7日/生信号/センサーごと）
+  if (buttons.wasReleasefor(ButtonInput::BUTTON_C, VIEW_HOLD_TIME)) {
+    nextGraphView();
+  }
   // Cボタン：現在のベースライン値を表示
-  if (M5.BtnC.wasPressed() && sensor_connected) {
-    uint16_t eco2_base, tvoc_base;
-    if (sensor_manager.getBaseline(&sgp, &eco2_base, &tvoc_base)) {
-      ui_manager.showBaselineValues(eco2_base, tvoc_base);
+  else if (buttons.wasReleased(ButtonInput::BUTTON_C) && sensor_connected) {
+    button_queue.push(BUTTON_SHOW_BASELINE);
+    notifySensorTask();
+  }
+}
+
+// センサータスクからの操作結果を表示
+void handleUiEvents() {
+  UiEvent event;
+  while (ui_event_queue.pop(event)) {
+    switch (event.type) {
+      case UI_BASELINE_RESET:
+        ui_manager.showBaselineReset();
+        break;
+      case UI_BASELINE_SAVED:
+        ui_manager.showBaselineSaved();
+        break;
+      case UI_BASELINE_REJECTED:
+        ui_manager.showBaselineRejected(event.verdict == BASELINE_REJECTED_NOT_CLEAN);
+        break;
+      case UI_BASELINE_ROLLED_BACK:
+        ui_manager.showBaselineRolledBack();
+        break;
+      case UI_BASELINE_VALUES:
+        ui_manager.showBaselineValues(event.eco2_base, event.tvoc_base);
+        break;
     }
   }
 }
 
-void loop() {
-  static int countdown = INIT_COUNTDOWN;
-  static bool initialized = false;
+// 暖機の残り時間の表示ジョブ（1秒ごと、暖機が終わったら表示を消して自身を解除）
+// 表示し続けるメッセージを1つだけ投稿し、残り時間はその文字列を書き換える
+// （ボタン操作などの表示し続けるメッセージに置き換えられたら、それ以降は表示しない）
+int countdown_job = -1;
+uint32_t countdown_message = 0;
+bool countdown_replaced = false;
 
-  // 初期化カウントダウン処理
-  if (countdown > 0) {
-    if (millis() - last_millis > 1000) {
-      last_millis = millis();
-      countdown--;
-      ui_manager.updateCountdown(countdown);
-    }
-    delay(LOOP_DELAY);
+void countdownJob(void* context) {
+  long remaining = (long)(warmup_end - millis());
+  if (remaining <= 0) {
+    render_scheduler.cancel(countdown_job);
+    ui_manager.removeMessage(countdown_message);
+    countdown_message = 0;
     return;
   }
+  if (countdown_replaced) {
+    return;
+  }
+
+  char message[StatusMessage::MAX_TEXT + 1];
+  snprintf(message, sizeof(message), "Sensor warming up... %ld s", (remaining + 999) / 1000);
+  if (countdown_message == 0) {
+    countdown_message = ui_manager.showMessage(message, 0);
+  } else if (!ui_manager.updateMessage(countdown_message, message)) {
+    countdown_message = 0;
+    countdown_replaced = true;
+  }
+}
+
+// Serialのコマンド（1行ずつ。prof: 区間ごとの処理時間、prof reset: 処理時間の集計のやり直し）
+void handleSerialCommands() {
+  static char line[SERIAL_COMMAND_LENGTH];
+  static uint8_t length = 0;
+
+  while (Serial.available() > 0) {
+    int c = Serial.read();
+    if (c == '\r') {
+      continue;
+    }
+    if (c != '\n') {
+      if (length + 1 < SERIAL_COMMAND_LENGTH) {
+        line[length++] = (char)c;
+      }
+      continue;
+    }
+    line[length] = '\0';
+    length = 0;
+
+    if (strcmp(line, "prof") == 0) {
+      loop_profiler.dump();
+    } else if (strcmp(line, "prof reset") == 0) {
+      loop_profiler.reset();
+      Serial.println("Loop profile reset");
+    } else if (line[0] != '\0') {
+      Serial.println("Commands: prof, prof reset");
+    }
+  }
+}
+
+// ボタン・操作結果の処理ジョブ
+void buttonJob(void* context) {
+  {
+    PROFILE_SCOPE(loop_profiler, LOOP_PHASE_BUTTONS);
+    handleButtons();
+  }
+  handleUiEvents();
+}
+
+// Serialのコマンドの処理ジョブ（"prof" の出力はボタンの読み取りとは別の区間で計測する）
+void serialJob(void* context) {
+  PROFILE_SCOPE(loop_profiler, LOOP_PHASE_SERIAL);
+  handleSerialCommands();
+}
+
+// ステータス行のメッセージ表示ジョブ（期限切れの消去を含む）
+void statusJob(void* context) {
+  ui_manager.updateStatus();
+}
+
+// WiFi接続状態の確認ジョブ
+void wifiJob(void* context) {
+  PROFILE_SCOPE(loop_profiler, LOOP_PHASE_WIFI);
+  checkWiFiStatus();
+}
+
+// 無操作時の減光ジョブ
+void backlightJob(void* context) {
+  power_manager.updateBacklight();
+}
+
+// センサー記録ジョブ（再生の先読み、記録の書き込み失敗の検出）
+void traceJob(void* context) {
+  static bool replay_end_shown = false;
+
+  if (trace_config.mode == TRACE_REPLAY) {
+    replay_sensor.fill(trace_reader);
+    if (replay_sensor.finished() && !replay_end_shown) {
+      Serial.printf("Trace replay finished: %lu samples, %u sessions\n",
+                    (unsigned long)trace_reader.sampleCount(), trace_reader.sessionCount());
+      ui_manager.showMessage("Trace replay finished", 3000);
+      replay_end_shown = true;
+    }
+  } else if (trace_file != nullptr && !trace_writer.isRecording()) {
+    closeTrace();
+    ui_manager.showMessage("Trace write failed!", 3000, MESSAGE_ERROR, RED);
+  }
+}
+
+// 測定履歴の書き込みジョブ（満杯のブロックのみ）
+void logJob(void* context) {
+  data_logger.service();
+}
+
+void renderStatsJob(void* context) {
+  data_logger.logStats();
+  wifi_manager.logStats();
+  http_server.logStats();
+  mqtt_publisher.logStats();
+  if (trace_writer.isRecording()) {
+    Serial.printf("Trace: %lu samples, %lu bytes\n",
+                  (unsigned long)trace_writer.sampleCount(), (unsigned long)trace_writer.byteCount());
+  }
+  lcd_renderer.logStats();
+  graph_manager.logFrameStats();
+  render_scheduler.logStats("render");
+}
+
+// OpenMetricsのページ（/metrics へのスクレイプ時に描画タスクで作成、センサータスクの値は sensor_stats の複製から）
+size_t encodeMetricsPage(char* buffer, size_t size, void* context) {
+  DeviceMetrics metrics = {
+    latest_sample,
+    sensor_connected,
+    (uint32_t)millis(),
+    boot_profile.firstReadingMillis(),
+    &sensor_stats.loop,
+    &render_loop_histogram,
+    wifi_connected,
+    wifi_manager.rssi(),
+    wifi_manager.reconnects(),
+    wifi_manager.offlineMillis(),
+    wifi_manager.isEnabled() ? &wifi_manager.connectTime() : nullptr,
+    mqtt_publisher.isEnabled() ? &mqtt_publisher.latency() : nullptr,
+    mqtt_publisher.isConnected(),
+    forward_queue.ramDepth(),
+    forward_queue.spoolDepth(),
+    forward_queue.dropped(),
+    mqtt_publisher.publishedSamples(),
+    sensor_count > 1 ? latest_points : nullptr,
+    sensor_count,
+    sensor_stats.cycle_us,
+    sensor_array.size() > 0 ? &sensor_stats.iaq_latency : nullptr,
+    &sensor_stats.raw_latency,
+    &sensor_stats.retries,
+    sensor_stats.i2c_nacks,
+    sensor_stats.crc_errors,
+    sensor_stats.failures
+  };
+  return encodeDeviceMetrics(metrics, buffer, size);
+}
+
+// HTTPジョブ（WiFi接続後にサーバーを起動し、1回に少しずつ送受信する）
+void httpJob(void* context) {
+#ifdef ARDUINO
+  if (wifi_connected && !http_server.isRunning()) {
+    http_server.begin(HttpServer::DEFAULT_PORT);
+  }
+#endif
+  http_server.poll();
+}
+
+// MQTTジョブ（WiFiの切断中は接続せずに待つ）
+void mqttJob(void* context) {
+  mqtt_publisher.poll(wifi_connected);
+}
+
+// グラフの表示データの保存ジョブ（再起動直後のグラフ表示用）
+void snapshotJob(void* context) {
+  if (!history.empty()) {
+    graph_snapshot.save(history, trend);
+  }
+}
+
+// 再起動に備えた測定の書き込みジョブ（RTCメモリ）
+void retainJob(void* context) {
+  restart_snapshot.saveHistory(history);
+}
+
+// 測定結果の取り込みと画面更新（新しいサンプルか表示期間の変更があった場合のみ描画）
+void refreshDisplay() {
+  // センサータスクからの測定結果を履歴に追加
+  SensorSample sample;
+  while (sample_queue.pop(sample)) {
+    boot_profile.firstReading();
+    uint16_t values[HISTORY_CHANNEL_COUNT] = {
+      sample.tvoc, sample.eco2, sample.raw_h2, sample.raw_ethanol, sample.h2_filtered, sample.ethanol_filtered
+    };
+    history.push(sample.timestamp, values);
+    trend.add(sample.timestamp, sample.tvoc, sample.eco2);
+    latest_sample = sample;
+
+    HttpMetrics metrics = { sample, currentEpoch(), sensor_connected };
+    http_server.setMetrics(metrics);
+
+    if (mqtt_publisher.isEnabled()) {
+      QueuedSample queued = { metrics.sample_epoch, sample.timestamp, sample.tvoc, sample.eco2 };
+      forward_queue.push(queued);
+    }
+
+    if (data_logger.isEnabled()) {
+      LogRecord record = { sample.timestamp, sample.tvoc, sample.eco2, sample.raw_h2, sample.raw_ethanol };
+      data_logger.append(record, currentEpoch());
+    }
+    if (trace_writer.isRecording()) {
+      TraceSample record = { sample.timestamp, sample.tvoc, sample.eco2, sample.raw_h2, sample.raw_ethanol };
+      trace_writer.append(record);
+    }
+  }
 
-  // 初期化完了後の一度だけの処理
-  if (!initialized) {
-    ui_manager.clearInitArea();
-    graph_manager.drawFrames();
-    initialized = true;
+  // センサーごとの測定（複数のセンサーの場合のみ）
+  SensorPoint point;
+  while (point_queue.pop(point)) {
+    sensor_histories[point.sensor].push(point.timestamp, point.tvoc, point.eco2);
+    latest_points[point.sensor] = point;
   }
 
-  // センサーデータ更新（1秒ごと）
-  sensor_manager.update(sensor_connected);
+  // センサータスクの統計（/metrics 用）
+  while (stats_queue.pop(sensor_stats)) {
+  }
 
-  // グラフ更新（1秒ごと）
-  graph_manager.update(sensor_manager.getTVOC(), sensor_manager.getECO2());
+  {
+    PROFILE_SCOPE(loop_profiler, LOOP_PHASE_GRAPH);
+    graph_manager.update(history, trend);
+  }
 
-  // 画面表示更新（1秒ごと）
+  // 最初の有効な測定までは値を表示しない（ステータス行に暖機の残り時間）
+  if (!boot_profile.hasFirstReading()) {
+    return;
+  }
+  // センサーごとのグラフの表示中はそのセンサーの値
+  int8_t sensor = graph_manager.getSensor();
+  PROFILE_SCOPE(loop_profiler, LOOP_PHASE_VALUES);
   ui_manager.updateValues(
-    sensor_manager.getTVOC(),
-    sensor_manager.getECO2(),
+    sensor >= 0 ? latest_points[sensor].tvoc : latest_sample.tvoc,
+    sensor >= 0 ? latest_points[sensor].eco2 : latest_sample.eco2,
     sensor_connected,
-    sensor_manager.isCleanAirDetected(),
-    sensor_manager.getCleanAirRemainingTime(),
+    latest_sample.clean_air_detected,
+    latest_sample.clean_air_remaining,
     wifi_connected
   );
+}
 
-  // WiFi接続状態をチェック
-  checkWiFiStatus();
+void initRenderJobs() {
+  if (!sensorWarmedUp()) {
+    countdown_job = render_scheduler.addPeriodic("countdown", 1000, countdownJob, nullptr);
+  }
+  render_scheduler.addPeriodic("buttons", BUTTON_POLL_INTERVAL, buttonJob, nullptr);
+  render_scheduler.addPeriodic("serial", SERIAL_POLL_INTERVAL, serialJob, nullptr);
+  render_scheduler.addPeriodic("status", STATUS_UPDATE_INTERVAL, statusJob, nullptr);
+  if (wifi_manager.isEnabled()) {
+    render_scheduler.addPeriodic("wifi", WIFI_CHECK_INTERVAL, wifiJob, nullptr);
+  }
+  render_scheduler.addPeriodic("backlight", BACKLIGHT_CHECK_INTERVAL, backlightJob, nullptr);
+  if (data_logger.isEnabled()) {
+    render_scheduler.addPeriodic("log", LOG_WRITE_INTERVAL, logJob, nullptr);
+  }
+  if (trace_config.mode != TRACE_OFF) {
+    render_scheduler.addPeriodic("trace", TRACE_FEED_INTERVAL, traceJob, nullptr);
+  }
+  // WiFiの設定はSDカードにあるので、SDカードがなければHTTPサーバーも起動しない
+#ifdef ARDUINO
+  bool http_enabled = files_available;
+#else
+  bool http_enabled = http_server.isRunning();
+#endif
+  if (http_enabled) {
+    render_scheduler.addPeriodic("http", HTTP_POLL_INTERVAL, httpJob, nullptr);
+  }
+  if (mqtt_publisher.isEnabled()) {
+    render_scheduler.addPeriodic("mqtt", MQTT_POLL_INTERVAL, mqttJob, nullptr);
+  }
+  if (graph_snapshot.isEnabled()) {
+    render_scheduler.addPeriodic("snapshot", SNAPSHOT_INTERVAL, snapshotJob, nullptr, SNAPSHOT_INTERVAL);
+  }
+  if (restart_snapshot.isEnabled()) {
+    render_scheduler.addPeriodic("retain", RETAIN_INTERVAL, retainJob, nullptr, RETAIN_INTERVAL);
+  }
+  render_scheduler.addPeriodic("stats", STATS_LOG_INTERVAL, renderStatsJob, nullptr, STATS_LOG_INTERVAL);
+}
+
+// 描画タスクの1周期分の処理（次の期限までの時間を返す）
+unsigned long renderStep() {
+  PROFILE_SCOPE(loop_profiler, LOOP_PHASE_RENDER_STEP);
+  unsigned long start_us = micros();
+  power_manager.beginRender();
+  lcd_renderer.beginFrame();
+  unsigned long wait = render_scheduler.runDue();
+  refreshDisplay();
+  lcd_renderer.endFrame();
+  power_manager.addSpiBytes(lcd_renderer.getFrameBytes());
+  power_manager.endRender();
+  render_loop_histogram.observe(micros() - start_us);
+  return wait;
+}
 
-  // ボタン処理
-  handleButtons();
+#ifdef ARDUINO
+// 描画タスク（LCD・ボタン・WiFi状態）
+void renderTask(void* param) {
+  for (;;) {
+    // 次の期限まで待機（新しいサンプルの通知で起床、待ち時間は TickScheduler::MAX_WAIT 以下）
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(renderStep()));
+  }
+}
 
-  delay(LOOP_DELAY);
-}
\ No newline at end of file
+void loop() {
+  // 処理はすべてタスクで行うため、Arduinoのループタスクは終了する
+  vTaskDelete(NULL);
+}
+#else
+void loop() {
+  // 両タスクの1周期分を実行し、早い方の期限まで仮想時計を進める
+  unsigned long sensor_wait = sensorStep();
+  unsigned long render_wait = renderStep();
+  power_manager.idle(sensor_wait < render_wait ? sensor_wait : render_wait);
+}
+
+bool simulationFinished() {
+  return trace_config.mode == TRACE_REPLAY && replay_sensor.finished();
+}
+
+void simulationEnd() {
+  snapshotJob(nullptr);
+  closeTrace();
+  data_logger.close();
+}
+#endif
@@ -0,0 +1,154 @@
+// BaselineQuality の数か月分の保存の判定（ドリフト・溶剤の夜・下限に張り付く測定・設置場所の変化）
+// （毎晩4時に1回保存する筋書き、ベースラインの変動は固定の系列の乱数、NVSは HalNative の MemoryStore）
+//   pio test -e native -f test_baseline_quality
+#include <unity.h>
+#include <BaselineQuality.h>
+#include <BaselineStore.h>
+#include <HalNative.h>
+
+// 1つの筋書きを再生した結果
+struct QualityRun {
+  uint32_t candidates;
+  uint32_t accepted;
+  uint32_t rejected;
+  uint32_t shifts;             // 新しい基準として受け入れた保存
+  uint32_t rollbacks;
+  bool rolled_back_to_previous;  // 戻した先が下限に張り付く前の記録だったか
+  int16_t eco2_drift;
+  BaselineRecord latest;
+};
+
+// その日の候補に shift を加える区間 [shift_from, shift_to)、floor_day: 保存後の測定が下限に張り付く日
+struct Scenario {
+  uint32_t days;
+  int eco2_trend;      // 1日あたりのドリフト
+  uint32_t shift_from;
+  uint32_t shift_to;
+  int shift;
+  uint32_t floor_day;
+};
+
+static MemoryStore nvs;
+
+// ベースラインの生の値のランダムウォーク（xorshift32）
+static uint16_t driftBaseline(uint16_t value, uint32_t& random_state, uint16_t step) {
+  random_state ^= random_state << 13;
+  random_state ^= random_state >> 17;
+  random_state ^= random_state << 5;
+  return (uint16_t)(value + (int)(random_state % (2 * step + 1)) - step);
+}
+
+static void replay(const Scenario& scenario, QualityRun& run) {
+  BaselineStore store;
+  BaselineQuality quality;
+  store.init(&nvs);
+  quality.init(&store);
+
+  run = QualityRun();
+  uint32_t random_state = 2463534242u;
+  uint16_t eco2_base = 35187;
+  uint16_t tvoc_base = 35553;
+  for (uint32_t day = 0; day < scenario.days; day++) {
+    eco2_base = driftBaseline((uint16_t)(eco2_base + scenario.eco2_trend), random_state, 40);
+    tvoc_base = driftBaseline(tvoc_base, random_state, 40);
+    bool shifted = day >= scenario.shift_from && day < scenario.shift_to;
+    uint16_t eco2_candidate = (uint16_t)(eco2_base + (shifted ? scenario.shift : 0));
+    uint16_t tvoc_candidate = (uint16_t)(tvoc_base + (shifted ? scenario.shift * 2 / 3 : 0));
+    unsigned long now = (unsigned long)day * 86400000UL + 4 * 3600000UL;
+    uint32_t epoch = SIM_EPOCH_START + (uint32_t)(now / 1000);
+    run.candidates++;
+
+    BaselineScore score = quality.evaluate(eco2_candidate, tvoc_candidate, true, epoch, now);
+    if (score.verdict != BASELINE_ACCEPTED) {
+      TEST_ASSERT_EQUAL_UINT8(BASELINE_REJECTED_OUTLIER, score.verdict);
+      TEST_ASSERT_TRUE(score.score > 100);
+      run.rejected++;
+      continue;
+    }
+    BaselineRecord previous;
+    bool has_previous = store.latest(previous);
+    BaselineSource source = score.shift ? BASELINE_SOURCE_SHIFT : BASELINE_SOURCE_CLEAN_AIR;
+    TEST_ASSERT_EQUAL_UINT8(BASELINE_WRITTEN, store.save(eco2_candidate, tvoc_candidate, source, epoch));
+    BaselineRecord saved;
+    store.latest(saved);
+    quality.onSaved(has_previous ? &previous : nullptr, saved, now);
+    run.accepted++;
+    run.shifts += score.shift ? 1 : 0;
+
+    // 保存後2時間の測定（通常は在室前の低い値と起床後の上昇、floor_day は下限に張り付く）
+    for (uint32_t s = 1; s <= BaselineQuality::PROBATION_TIME / 1000 + 60; s++) {
+      bool floor = day == scenario.floor_day || s < 1800;
+      quality.observe(floor ? 400 : (uint16_t)(420 + s % 300), floor ? 0 : (uint16_t)(15 + s % 40), now + s * 1000);
+    }
+    if (quality.rollbackDue()) {
+      const BaselineRecord& target = quality.rollbackTarget();
+      run.rolled_back_to_previous = has_previous && target.eco2_base == previous.eco2_base &&
+                                    target.tvoc_base == previous.tvoc_base;
+      store.save(target.eco2_base, target.tvoc_base, BASELINE_SOURCE_ROLLBACK, epoch + 7200);
+      quality.onRolledBack();
+      run.rollbacks++;
+    }
+  }
+  run.eco2_drift = quality.eco2DriftPerDay();
+  store.latest(run.latest);
+  TEST_ASSERT_EQUAL_UINT32(run.rejected, quality.rejectCount());
+  TEST_ASSERT_EQUAL_UINT32(run.rollbacks, quality.rollbackCount());
+}
+
+void setUp(void) {
+  // 筋書きごとに空のNVSから始める
+  nvs = MemoryStore();
+}
+
+void tearDown(void) {}
+
+// 毎日少しずつ下がるベースラインはすべて受け入れ、ドリフトとして追う
+void test_drift_is_accepted(void) {
+  QualityRun run;
+  replay({ 120, -12, 0, 0, 0, UINT32_MAX }, run);
+  TEST_ASSERT_EQUAL_UINT32(120, run.accepted);
+  TEST_ASSERT_EQUAL_UINT32(0, run.rejected);
+  TEST_ASSERT_EQUAL_UINT32(0, run.rollbacks);
+  TEST_ASSERT_TRUE(run.eco2_drift < 0);
+}
+
+// 溶剤を使った夜の1回だけ大きくずれた候補は保存しない
+void test_solvent_night_is_rejected(void) {
+  QualityRun run;
+  replay({ 60, 0, 30, 31, 2500, UINT32_MAX }, run);
+  TEST_ASSERT_EQUAL_UINT32(59, run.accepted);
+  TEST_ASSERT_EQUAL_UINT32(1, run.rejected);
+  TEST_ASSERT_EQUAL_UINT32(0, run.shifts);
+  TEST_ASSERT_EQUAL_UINT32(0, run.rollbacks);
+}
+
+// 許容値内でも保存後の測定が下限に張り付いたら前の記録へ戻す
+void test_floored_readings_roll_back(void) {
+  QualityRun run;
+  replay({ 60, 0, 30, 31, 300, 30 }, run);
+  TEST_ASSERT_EQUAL_UINT32(60, run.accepted);
+  TEST_ASSERT_EQUAL_UINT32(0, run.rejected);
+  TEST_ASSERT_EQUAL_UINT32(1, run.rollbacks);
+  TEST_ASSERT_TRUE(run.rolled_back_to_previous);
+}
+
+// 外れ値が3日続いたら設置場所の変化として受け入れ、以降はその基準で判定する
+void test_relocation_is_accepted_as_shift(void) {
+  QualityRun run;
+  replay({ 60, 0, 30, 60, 1500, UINT32_MAX }, run);
+  TEST_ASSERT_EQUAL_UINT32(57, run.accepted);
+  TEST_ASSERT_EQUAL_UINT32(3, run.rejected);
+  TEST_ASSERT_EQUAL_UINT32(1, run.shifts);
+  TEST_ASSERT_EQUAL_UINT32(0, run.rollbacks);
+  TEST_ASSERT_EQUAL_UINT8(BASELINE_SOURCE_CLEAN_AIR, run.latest.source);
+}
+
+int main(int argc, char** argv) {
+  Serial.setQuiet(true);
+  UNITY_BEGIN();
+  RUN_TEST(test_drift_is_accepted);
+  RUN_TEST(test_solvent_night_is_rejected);
+  RUN_TEST(test_floored_readings_roll_back);
+  RUN_TEST(test_relocation_is_accepted_as_shift);
+  return UNITY_END();
+}
@@ -0,0 +1,146 @@
+// BaselineStore のスロットの順送り・許容値内の書き込みの省略・壊れた最新の記録からの復帰
+// （NVSは HalNative の MemoryStore、起動し直しは同じNVSで新しい BaselineStore を init() する）
+//   pio test -e native -f test_baseline_store
+#include <unity.h>
+#include <BaselineStore.h>
+#include <HalNative.h>
+
+static const uint32_t EPOCH = SIM_EPOCH_START;
+
+static MemoryStore nvs;
+
+// n 番目の保存の値（互いに許容値より離す）
+static uint16_t eco2For(uint32_t n) {
+  return (uint16_t)(35000 + n * 100);
+}
+
+static uint16_t tvocFor(uint32_t n) {
+  return (uint16_t)(36000 - n * 100);
+}
+
+static void saveRecords(BaselineStore& store, uint32_t first, uint32_t count) {
+  for (uint32_t n = first; n < first + count; n++) {
+    TEST_ASSERT_EQUAL_UINT8(BASELINE_WRITTEN,
+                            store.save(eco2For(n), tvocFor(n), BASELINE_SOURCE_CLEAN_AIR, EPOCH + n * 3600));
+  }
+}
+
+// 新しい順に通し番号 newest, newest - 1, ... が count 件（値は通し番号 n の保存のもの）
+static void expectHistory(const BaselineStore& store, uint32_t newest, uint8_t count) {
+  TEST_ASSERT_EQUAL_UINT8(count, store.count());
+  for (uint8_t i = 0; i < count; i++) {
+    BaselineRecord record;
+    TEST_ASSERT_TRUE(store.history(i, record));
+    TEST_ASSERT_EQUAL_UINT32(newest - i, record.sequence);
+    TEST_ASSERT_EQUAL_UINT16(eco2For(newest - i - 1), record.eco2_base);
+    TEST_ASSERT_EQUAL_UINT16(tvocFor(newest - i - 1), record.tvoc_base);
+  }
+  BaselineRecord record;
+  TEST_ASSERT_FALSE(store.history(count, record));
+}
+
+// NVSのスロットの内容を書き換える（length: 書き込む長さ、壊れた書き込みの再現）
+static void corruptSlot(const char* key, size_t offset, size_t length) {
+  BaselineRecord record;
+  TEST_ASSERT_TRUE(nvs.begin("baseline", false));
+  TEST_ASSERT_EQUAL_size_t(sizeof(record), nvs.getBytes(key, &record, sizeof(record)));
+  reinterpret_cast<uint8_t*>(&record)[offset] ^= 0x10;
+  nvs.putBytes(key, &record, length);
+  nvs.end();
+}
+
+void setUp(void) {
+  nvs = MemoryStore();
+}
+
+void tearDown(void) {}
+
+// 書き込みは slot0〜7 を順に回り、残っている8件が履歴になる（起動し直しても同じ）
+void test_slots_rotate(void) {
+  BaselineStore store;
+  store.init(&nvs);
+  TEST_ASSERT_EQUAL_UINT8(0, store.count());
+  saveRecords(store, 0, 11);
+  TEST_ASSERT_EQUAL_UINT32(11, store.writeCount());
+  TEST_ASSERT_EQUAL_UINT32(11, nvs.writeCount());
+  expectHistory(store, 11, BaselineStore::SLOT_COUNT);
+
+  // 通し番号 % SLOT_COUNT 番目のスロット、9番目のキーは作らない
+  BaselineRecord record;
+  TEST_ASSERT_TRUE(nvs.begin("baseline", true));
+  TEST_ASSERT_EQUAL_size_t(sizeof(record), nvs.getBytes("slot3", &record, sizeof(record)));
+  TEST_ASSERT_EQUAL_UINT32(11, record.sequence);
+  TEST_ASSERT_EQUAL_size_t(0, nvs.getBytes("slot8", &record, sizeof(record)));
+  nvs.end();
+
+  BaselineStore restarted;
+  restarted.init(&nvs);
+  expectHistory(restarted, 11, BaselineStore::SLOT_COUNT);
+  saveRecords(restarted, 11, 1);
+  expectHistory(restarted, 12, BaselineStore::SLOT_COUNT);
+}
+
+// 直近の記録との差が TOLERANCE 以内なら REFRESH_AGE が過ぎるまで書き込まない
+void test_tolerance_skips_writes(void) {
+  BaselineStore store;
+  store.init(&nvs);
+  TEST_ASSERT_EQUAL_UINT8(BASELINE_WRITTEN, store.save(30000, 32000, BASELINE_SOURCE_CLEAN_AIR, EPOCH));
+  const uint16_t t = BaselineStore::TOLERANCE;
+  TEST_ASSERT_EQUAL_UINT8(BASELINE_UNCHANGED, store.save(30000 + t, 32000 - t, BASELINE_SOURCE_PERIODIC, EPOCH + 60));
+  TEST_ASSERT_EQUAL_UINT8(BASELINE_UNCHANGED, store.save(30000 - t, 32000, BASELINE_SOURCE_PERIODIC, 0));
+  TEST_ASSERT_EQUAL_UINT8(BASELINE_UNCHANGED,
+                          store.save(30000, 32000, BASELINE_SOURCE_PERIODIC, EPOCH + BaselineStore::REFRESH_AGE - 1));
+  TEST_ASSERT_EQUAL_UINT32(3, store.skipCount());
+  TEST_ASSERT_EQUAL_UINT32(1, nvs.writeCount());
+
+  // 片方でも許容値を超えれば書き込む
+  TEST_ASSERT_EQUAL_UINT8(BASELINE_WRITTEN, store.save(30000, 32000 + t + 1, BASELINE_SOURCE_CLEAN_AIR, EPOCH + 120));
+  BaselineRecord record;
+  TEST_ASSERT_TRUE(store.latest(record));
+  TEST_ASSERT_EQUAL_UINT16(32000 + t + 1, record.tvoc_base);
+
+  // 差がなくても古くなれば書き直す
+  TEST_ASSERT_EQUAL_UINT8(BASELINE_WRITTEN,
+                          store.save(30000, 32000 + t + 1, BASELINE_SOURCE_PERIODIC, EPOCH + 120 + BaselineStore::REFRESH_AGE));
+  TEST_ASSERT_EQUAL_UINT32(3, store.writeCount());
+  TEST_ASSERT_EQUAL_UINT32(3, nvs.writeCount());
+  TEST_ASSERT_EQUAL_UINT8(3, store.count());
+}
+
+// 最新のスロットがCRC違い・書きかけなら1つ前の記録を使い、次の保存でそのスロットを書き直す
+void test_corrupt_newest_falls_back(void) {
+  BaselineStore store;
+  store.init(&nvs);
+  saveRecords(store, 0, 5);
+
+  corruptSlot("slot5", offsetof(BaselineRecord, eco2_base), sizeof(BaselineRecord));
+  BaselineStore restarted;
+  restarted.init(&nvs);
+  expectHistory(restarted, 4, 4);
+
+  // 書き込みの途中で電源が切れた（短い記録）場合も同じ
+  corruptSlot("slot4", 0, sizeof(BaselineRecord) / 2);
+  BaselineStore again;
+  again.init(&nvs);
+  expectHistory(again, 3, 3);
+
+  saveRecords(again, 3, 1);
+  BaselineRecord record;
+  TEST_ASSERT_TRUE(nvs.begin("baseline", true));
+  TEST_ASSERT_EQUAL_size_t(sizeof(record), nvs.getBytes("slot4", &record, sizeof(record)));
+  nvs.end();
+  TEST_ASSERT_EQUAL_UINT32(4, record.sequence);
+
+  BaselineStore recovered;
+  recovered.init(&nvs);
+  expectHistory(recovered, 4, 4);
+}
+
+int main(int argc, char** argv) {
+  Serial.setQuiet(true);
+  UNITY_BEGIN();
+  RUN_TEST(test_slots_rotate);
+  RUN_TEST(test_tolerance_skips_writes);
+  RUN_TEST(test_corrupt_newest_falls_back);
+  return UNITY_END();
+}
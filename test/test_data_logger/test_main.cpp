@@ -0,0 +1,149 @@
+// DataLogger の書きかけのブロックの後の追記と、LogReader の壊れたブロック・欠けたブロックの検出
+// （ファイルは HalNative の MemoryFileSystem、1ブロック = LOG_RECORDS_PER_BLOCK 件）
+//   pio test -e native -f test_data_logger
+#include <unity.h>
+#include <DataLogger.h>
+#include <HalNative.h>
+
+static const int32_t UTC_OFFSET = 9 * 3600;
+static const char* const PATH = "/log/20260101.tvl";   // SIM_EPOCH_START の日本時間の日付
+
+static MemoryFileSystem* fs;
+
+// i 番目の記録（1秒ごと）
+static LogRecord makeRecord(uint32_t i) {
+  LogRecord record = { i * 1000, (uint16_t)(i % 500), (uint16_t)(400 + i), (uint16_t)(13000 + i), (uint16_t)(18000 + i) };
+  return record;
+}
+
+static void writeRecords(uint32_t from, uint32_t count) {
+  DataLogger logger;
+  TEST_ASSERT_TRUE(logger.init(fs, "/log", UTC_OFFSET));
+  for (uint32_t i = from; i < from + count; i++) {
+    logger.append(makeRecord(i), SIM_EPOCH_START + i);
+    logger.service();
+  }
+  logger.close();
+}
+
+// 読めた記録の番号（内容と時刻も確かめる）
+static void readRecords(LogReader& reader, std::vector<uint32_t>& indexes) {
+  FileHandle* file = fs->open(PATH, FILE_MODE_READ);
+  TEST_ASSERT_TRUE(reader.begin(file));
+  LogRecord record;
+  uint32_t epoch;
+  while (reader.next(record, epoch)) {
+    uint32_t i = record.timestamp / 1000;
+    LogRecord expected = makeRecord(i);
+    TEST_ASSERT_EQUAL_MEMORY(&expected, &record, sizeof(record));
+    TEST_ASSERT_EQUAL_UINT32(SIM_EPOCH_START + i, epoch);
+    indexes.push_back(i);
+  }
+  fs->close(file);
+}
+
+// [from, to) が順に並んでいるか
+static void expectRange(const std::vector<uint32_t>& indexes, size_t offset, uint32_t from, uint32_t to) {
+  TEST_ASSERT_TRUE(offset + (to - from) <= indexes.size());
+  for (uint32_t i = from; i < to; i++) {
+    TEST_ASSERT_EQUAL_UINT32(i, indexes[offset + i - from]);
+  }
+}
+
+static uint32_t sequenceAt(uint32_t block) {
+  const std::vector<uint8_t>& data = *fs->contents(PATH);
+  const uint8_t* p = data.data() + block * LOG_BLOCK_SIZE + 4;
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+void setUp(void) {
+  fs = new MemoryFileSystem();
+}
+
+void tearDown(void) {
+  delete fs;
+}
+
+// 書きかけのブロックも閉じるときに書き、すべて読み戻せる
+void test_round_trip(void) {
+  writeRecords(0, 2 * LOG_RECORDS_PER_BLOCK + 18);
+  TEST_ASSERT_NOT_NULL(fs->contents(PATH));
+  TEST_ASSERT_EQUAL_size_t(3 * LOG_BLOCK_SIZE, fs->contents(PATH)->size());
+
+  LogReader reader;
+  std::vector<uint32_t> indexes;
+  readRecords(reader, indexes);
+  TEST_ASSERT_EQUAL_size_t(2 * LOG_RECORDS_PER_BLOCK + 18, indexes.size());
+  expectRange(indexes, 0, 0, 2 * LOG_RECORDS_PER_BLOCK + 18);
+  TEST_ASSERT_EQUAL_UINT32(3, reader.validBlocks());
+  TEST_ASSERT_EQUAL_UINT32(0, reader.badBlocks());
+  TEST_ASSERT_EQUAL_UINT32(0, reader.missingBlocks());
+}
+
+// 電源断で最後のブロックが途中まで → 開き直すと境界まで0で埋め、最後の正しいブロックの続きの番号で追記する
+void test_truncated_final_block(void) {
+  writeRecords(0, 3 * LOG_RECORDS_PER_BLOCK);
+  fs->contents(PATH)->resize(2 * LOG_BLOCK_SIZE + 300);
+
+  writeRecords(3 * LOG_RECORDS_PER_BLOCK, LOG_RECORDS_PER_BLOCK);
+  const std::vector<uint8_t>& data = *fs->contents(PATH);
+  TEST_ASSERT_EQUAL_size_t(4 * LOG_BLOCK_SIZE, data.size());
+  for (uint32_t offset = 2 * LOG_BLOCK_SIZE + 300; offset < 3 * LOG_BLOCK_SIZE; offset++) {
+    TEST_ASSERT_EQUAL_UINT8(0, data[offset]);
+  }
+  TEST_ASSERT_EQUAL_UINT32(2, sequenceAt(3));
+
+  // 書きかけのブロックは壊れたブロックとして飛ばし、番号は続いている
+  LogReader reader;
+  std::vector<uint32_t> indexes;
+  readRecords(reader, indexes);
+  TEST_ASSERT_EQUAL_size_t(3 * LOG_RECORDS_PER_BLOCK, indexes.size());
+  expectRange(indexes, 0, 0, 2 * LOG_RECORDS_PER_BLOCK);
+  expectRange(indexes, 2 * LOG_RECORDS_PER_BLOCK, 3 * LOG_RECORDS_PER_BLOCK, 4 * LOG_RECORDS_PER_BLOCK);
+  TEST_ASSERT_EQUAL_UINT32(3, reader.validBlocks());
+  TEST_ASSERT_EQUAL_UINT32(1, reader.badBlocks());
+  TEST_ASSERT_EQUAL_UINT32(0, reader.missingBlocks());
+}
+
+// 記録の1ビットが反転したブロックはCRCで捨て、その分は番号の飛びにもなる
+void test_corrupted_crc(void) {
+  writeRecords(0, 3 * LOG_RECORDS_PER_BLOCK);
+  (*fs->contents(PATH))[LOG_BLOCK_SIZE + 100] ^= 0x04;
+
+  LogReader reader;
+  std::vector<uint32_t> indexes;
+  readRecords(reader, indexes);
+  TEST_ASSERT_EQUAL_size_t(2 * LOG_RECORDS_PER_BLOCK, indexes.size());
+  expectRange(indexes, 0, 0, LOG_RECORDS_PER_BLOCK);
+  expectRange(indexes, LOG_RECORDS_PER_BLOCK, 2 * LOG_RECORDS_PER_BLOCK, 3 * LOG_RECORDS_PER_BLOCK);
+  TEST_ASSERT_EQUAL_UINT32(2, reader.validBlocks());
+  TEST_ASSERT_EQUAL_UINT32(1, reader.badBlocks());
+  TEST_ASSERT_EQUAL_UINT32(1, reader.missingBlocks());
+}
+
+// ブロックが丸ごと欠けると、壊れたブロックはなく番号の飛びだけで分かる
+void test_skipped_sequence(void) {
+  writeRecords(0, 4 * LOG_RECORDS_PER_BLOCK);
+  std::vector<uint8_t>& data = *fs->contents(PATH);
+  data.erase(data.begin() + LOG_BLOCK_SIZE, data.begin() + 2 * LOG_BLOCK_SIZE);
+
+  LogReader reader;
+  std::vector<uint32_t> indexes;
+  readRecords(reader, indexes);
+  TEST_ASSERT_EQUAL_size_t(3 * LOG_RECORDS_PER_BLOCK, indexes.size());
+  expectRange(indexes, 0, 0, LOG_RECORDS_PER_BLOCK);
+  expectRange(indexes, LOG_RECORDS_PER_BLOCK, 2 * LOG_RECORDS_PER_BLOCK, 4 * LOG_RECORDS_PER_BLOCK);
+  TEST_ASSERT_EQUAL_UINT32(3, reader.validBlocks());
+  TEST_ASSERT_EQUAL_UINT32(0, reader.badBlocks());
+  TEST_ASSERT_EQUAL_UINT32(1, reader.missingBlocks());
+}
+
+int main(int argc, char** argv) {
+  Serial.setQuiet(true);
+  UNITY_BEGIN();
+  RUN_TEST(test_round_trip);
+  RUN_TEST(test_truncated_final_block);
+  RUN_TEST(test_corrupted_crc);
+  RUN_TEST(test_skipped_sequence);
+  return UNITY_END();
+}
@@ -0,0 +1,125 @@
+// EnergyMeter の状態ごとの滞在時間・バスの稼働時間・電荷の積算の確認
+// （時計は fake_us を進める関数に差し替える）
+//   pio test -e native -f test_energy_meter
+#include <unity.h>
+#include <EnergyMeter.h>
+
+static unsigned long fake_us = 0;
+
+static unsigned long fakeClock() {
+  return fake_us;
+}
+
+// 32ビットの micros() と同じく一周させる
+static void advance(uint32_t us) {
+  fake_us = (uint32_t)(fake_us + us);
+}
+
+void setUp(void) {
+  fake_us = 0;
+}
+
+void tearDown(void) {}
+
+void test_awake_only(void) {
+  EnergyMeter meter(fakeClock);
+  meter.setCpuCurrent(50000);
+  meter.setBacklightCurrent(10000);
+  advance(1000000);
+
+  EnergyReport report = meter.report();
+  TEST_ASSERT_EQUAL_UINT32(1000, report.elapsed_ms);
+  TEST_ASSERT_EQUAL_UINT32(1000, report.awake_ms);
+  TEST_ASSERT_EQUAL_UINT32(0, report.sleep_ms);
+  TEST_ASSERT_EQUAL_UINT32(1000, report.duty_permille);
+  TEST_ASSERT_EQUAL_UINT32(50000 + 10000 + EnergyMeter::SENSOR_UA, report.average_ua);
+}
+
+void test_sleep_time(void) {
+  EnergyMeter meter(fakeClock);
+  meter.setCpuCurrent(20000);
+  advance(300000);
+  meter.enterSleep();
+  TEST_ASSERT_TRUE(meter.isSleeping());
+  advance(700000);
+  meter.exitSleep();
+
+  // スリープ中はCPUの電流の代わりに SLEEP_UA（センサーは加熱を続ける）
+  EnergyReport report = meter.report();
+  TEST_ASSERT_EQUAL_UINT32(1000, report.elapsed_ms);
+  TEST_ASSERT_EQUAL_UINT32(300, report.awake_ms);
+  TEST_ASSERT_EQUAL_UINT32(700, report.sleep_ms);
+  TEST_ASSERT_EQUAL_UINT32(300, report.duty_permille);
+  TEST_ASSERT_EQUAL_UINT32(20000 * 3 / 10 + EnergyMeter::SLEEP_UA * 7 / 10 + EnergyMeter::SENSOR_UA,
+                           report.average_ua);
+}
+
+void test_current_change_splits_interval(void) {
+  EnergyMeter meter(fakeClock);
+  meter.setCpuCurrent(20000);
+  advance(400000);
+  meter.setCpuCurrent(50000);
+  advance(600000);
+
+  EnergyReport report = meter.report();
+  TEST_ASSERT_EQUAL_UINT32(8000 + 30000 + EnergyMeter::SENSOR_UA, report.average_ua);
+}
+
+void test_bus_time(void) {
+  EnergyMeter meter(fakeClock);
+  meter.addBusyTime(ENERGY_BUS_SPI, 100000);
+  meter.addBusyTime(ENERGY_BUS_I2C, 50000);
+  meter.addBusyTime(ENERGY_BUS_COUNT, 50000);   // 範囲外は無視
+  advance(1000000);
+
+  EnergyReport report = meter.report();
+  TEST_ASSERT_EQUAL_UINT32(100, report.spi_busy_ms);
+  TEST_ASSERT_EQUAL_UINT32(50, report.i2c_busy_ms);
+  TEST_ASSERT_EQUAL_UINT32(EnergyMeter::SENSOR_UA + EnergyMeter::SPI_BUS_UA / 10 + EnergyMeter::I2C_BUS_UA / 20,
+                           report.average_ua);
+}
+
+void test_reset_keeps_total(void) {
+  EnergyMeter meter(fakeClock);
+  meter.setCpuCurrent(100000 - EnergyMeter::SENSOR_UA);
+  advance(1800000000UL);
+  advance(1800000000UL);
+  TEST_ASSERT_EQUAL_UINT32(100000, meter.report().total_uah);
+
+  // 集計区間のみ空になる
+  meter.reset();
+  EnergyReport report = meter.report();
+  TEST_ASSERT_EQUAL_UINT32(0, report.elapsed_ms);
+  TEST_ASSERT_EQUAL_UINT32(0, report.average_ua);
+  TEST_ASSERT_EQUAL_UINT32(100000, report.total_uah);
+
+  advance(1800000000UL);
+  report = meter.report();
+  TEST_ASSERT_EQUAL_UINT32(1800000, report.elapsed_ms);
+  TEST_ASSERT_EQUAL_UINT32(100000, report.average_ua);
+  TEST_ASSERT_EQUAL_UINT32(150000, report.total_uah);
+}
+
+void test_clock_wraparound(void) {
+  fake_us = 0xFFFFFFFFUL - 500000;
+  EnergyMeter meter(fakeClock);
+  meter.setCpuCurrent(20000);
+  advance(400000);
+  meter.enterSleep();
+  advance(600000);   // スリープ中に時計が一周する
+
+  EnergyReport report = meter.report();
+  TEST_ASSERT_EQUAL_UINT32(1000, report.elapsed_ms);
+  TEST_ASSERT_EQUAL_UINT32(600, report.sleep_ms);
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_awake_only);
+  RUN_TEST(test_sleep_time);
+  RUN_TEST(test_current_change_splits_interval);
+  RUN_TEST(test_bus_time);
+  RUN_TEST(test_reset_keeps_total);
+  RUN_TEST(test_clock_wraparound);
+  return UNITY_END();
+}
@@ -0,0 +1,170 @@
+// HistoryBuffer の折り返し・連続区間・チャンネルの位置の確認
+//   pio test -e native -f test_history_buffer
+#include <unity.h>
+#include <HistoryBuffer.h>
+
+typedef HistoryBuffer<8> TestHistory;
+typedef HistoryBuffer<8, HISTORY_ECO2 + 1> TestPointHistory;
+
+// サンプル i のチャンネル channel の値（チャンネルごとに別の値）
+static uint16_t sampleValue(uint32_t i, int channel) {
+  return (uint16_t)(i * 10 + channel);
+}
+
+static void pushSamples(TestHistory& history, uint32_t first, uint32_t count) {
+  for (uint32_t i = first; i < first + count; i++) {
+    uint16_t values[HISTORY_CHANNEL_COUNT];
+    for (int channel = 0; channel < HISTORY_CHANNEL_COUNT; channel++) {
+      values[channel] = sampleValue(i, channel);
+    }
+    history.push(i * 1000, values);
+  }
+}
+
+// 2つの区間をつなげると古い順に oldest から size() 個のサンプルになる
+static void checkSpans(const TestHistory& history, uint32_t oldest) {
+  HistorySpan spans[2];
+  history.spans(spans[0], spans[1]);
+  TEST_ASSERT_EQUAL_size_t(history.size(), spans[0].length + spans[1].length);
+
+  uint32_t i = oldest;
+  for (int s = 0; s < 2; s++) {
+    for (size_t k = 0; k < spans[s].length; k++, i++) {
+      TEST_ASSERT_EQUAL_UINT32(i * 1000, spans[s].timestamp[k]);
+      for (int channel = 0; channel < HISTORY_CHANNEL_COUNT; channel++) {
+        TEST_ASSERT_EQUAL_UINT16(sampleValue(i, channel), spans[s].values((HistoryChannel)channel)[k]);
+      }
+    }
+  }
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_empty(void) {
+  TestHistory history;
+  TEST_ASSERT_TRUE(history.empty());
+  TEST_ASSERT_EQUAL_size_t(8, history.capacity());
+  HistorySpan spans[2];
+  history.spans(spans[0], spans[1]);
+  TEST_ASSERT_EQUAL_size_t(0, spans[0].length);
+  TEST_ASSERT_EQUAL_size_t(0, spans[1].length);
+}
+
+void test_partial_fill_is_one_span(void) {
+  TestHistory history;
+  pushSamples(history, 0, 5);
+  TEST_ASSERT_EQUAL_size_t(5, history.size());
+  TEST_ASSERT_FALSE(history.full());
+
+  HistorySpan spans[2];
+  history.spans(spans[0], spans[1]);
+  TEST_ASSERT_EQUAL_size_t(5, spans[0].length);
+  TEST_ASSERT_EQUAL_size_t(0, spans[1].length);
+  checkSpans(history, 0);
+}
+
+void test_full_without_wrap(void) {
+  TestHistory history;
+  pushSamples(history, 0, 8);
+  TEST_ASSERT_TRUE(history.full());
+
+  HistorySpan spans[2];
+  history.spans(spans[0], spans[1]);
+  TEST_ASSERT_EQUAL_size_t(8, spans[0].length);
+  TEST_ASSERT_EQUAL_size_t(0, spans[1].length);
+  checkSpans(history, 0);
+}
+
+void test_wrap_around_overwrites_oldest(void) {
+  TestHistory history;
+  pushSamples(history, 0, 11);
+  TEST_ASSERT_EQUAL_size_t(8, history.size());
+  TEST_ASSERT_EQUAL_UINT32(11, history.sequence());
+
+  // 最古は 3 番目、物理位置 3〜7 と 0〜2 の2区間
+  HistorySpan spans[2];
+  history.spans(spans[0], spans[1]);
+  TEST_ASSERT_EQUAL_size_t(5, spans[0].length);
+  TEST_ASSERT_EQUAL_size_t(3, spans[1].length);
+  checkSpans(history, 3);
+
+  TEST_ASSERT_EQUAL_UINT16(sampleValue(3, HISTORY_TVOC), history.tvocAt(0));
+  TEST_ASSERT_EQUAL_UINT16(sampleValue(10, HISTORY_ECO2), history.eco2At(7));
+  TEST_ASSERT_EQUAL_UINT32(10000, history.timestampAt(7));
+}
+
+void test_every_head_position(void) {
+  // 書き込み位置がどこにあっても区間と添字が一致する
+  for (uint32_t pushed = 1; pushed <= 3 * 8; pushed++) {
+    TestHistory history;
+    pushSamples(history, 0, pushed);
+    uint32_t oldest = pushed > 8 ? pushed - 8 : 0;
+    checkSpans(history, oldest);
+    for (size_t k = 0; k < history.size(); k++) {
+      TEST_ASSERT_EQUAL_UINT16(sampleValue(oldest + k, HISTORY_ETHANOL_FILTERED),
+                               history.valueAt(HISTORY_ETHANOL_FILTERED, k));
+    }
+  }
+}
+
+void test_channel_indexing(void) {
+  TestHistory history;
+  uint16_t values[HISTORY_CHANNEL_COUNT] = { 1, 2, 3, 4, 5, 6 };
+  history.push(500, values);
+  TEST_ASSERT_EQUAL_UINT16(1, history.valueAt(HISTORY_TVOC, 0));
+  TEST_ASSERT_EQUAL_UINT16(2, history.valueAt(HISTORY_ECO2, 0));
+  TEST_ASSERT_EQUAL_UINT16(3, history.valueAt(HISTORY_H2, 0));
+  TEST_ASSERT_EQUAL_UINT16(4, history.valueAt(HISTORY_ETHANOL, 0));
+  TEST_ASSERT_EQUAL_UINT16(5, history.valueAt(HISTORY_H2_FILTERED, 0));
+  TEST_ASSERT_EQUAL_UINT16(6, history.valueAt(HISTORY_ETHANOL_FILTERED, 0));
+
+  // TVOC・eCO2だけの push は生信号を 0 にする
+  history.push(1500, 7, 8);
+  TEST_ASSERT_EQUAL_UINT16(7, history.tvocAt(1));
+  TEST_ASSERT_EQUAL_UINT16(8, history.eco2At(1));
+  TEST_ASSERT_EQUAL_UINT16(0, history.valueAt(HISTORY_H2, 1));
+  TEST_ASSERT_EQUAL_UINT16(0, history.valueAt(HISTORY_ETHANOL_FILTERED, 1));
+}
+
+void test_missing_channels(void) {
+  // 持たないチャンネルは 0 として読め、区間は nullptr
+  TestPointHistory history;
+  uint16_t values[HISTORY_CHANNEL_COUNT] = { 11, 12, 13, 14, 15, 16 };
+  history.push(0, values);
+  TEST_ASSERT_EQUAL_size_t(8 * (2 * 2 + 4), TestPointHistory::BYTES);
+  TEST_ASSERT_EQUAL_UINT16(11, history.valueAt(HISTORY_TVOC, 0));
+  TEST_ASSERT_EQUAL_UINT16(12, history.valueAt(HISTORY_ECO2, 0));
+  TEST_ASSERT_EQUAL_UINT16(0, history.valueAt(HISTORY_H2, 0));
+
+  HistorySpan spans[2];
+  history.spans(spans[0], spans[1]);
+  TEST_ASSERT_NOT_NULL(spans[0].values(HISTORY_ECO2));
+  TEST_ASSERT_NULL(spans[0].values(HISTORY_H2));
+  TEST_ASSERT_NULL(spans[1].values(HISTORY_ETHANOL));
+}
+
+void test_clear_resets_sequence(void) {
+  TestHistory history;
+  pushSamples(history, 0, 13);
+  history.clear();
+  TEST_ASSERT_TRUE(history.empty());
+  TEST_ASSERT_EQUAL_UINT32(0, history.sequence());
+
+  pushSamples(history, 100, 3);
+  TEST_ASSERT_EQUAL_UINT32(3, history.sequence());
+  checkSpans(history, 100);
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_empty);
+  RUN_TEST(test_partial_fill_is_one_span);
+  RUN_TEST(test_full_without_wrap);
+  RUN_TEST(test_wrap_around_overwrites_oldest);
+  RUN_TEST(test_every_head_position);
+  RUN_TEST(test_channel_indexing);
+  RUN_TEST(test_missing_channels);
+  RUN_TEST(test_clear_resets_sequence);
+  return UNITY_END();
+}
@@ -0,0 +1,411 @@
+// HttpServer をループバックのソケットで動かし、同時の /metrics・/history の応答と since= による続きの取得を確認する
+// （サーバーは HalNative の PosixNetServer、クライアントはテスト内のブロックしないソケット）
+//   pio test -e native -f test_http_server
+#include <unity.h>
+#include <HalNative.h>
+#include <HttpServer.h>
+#include <OpenMetrics.h>
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <string>
+
+static const uint16_t FIRST_PORT = 18080;
+static const uint8_t PORT_ATTEMPTS = 100;
+static const uint8_t MAX_CLIENTS = 8;
+static const int MAX_POLLS = 5000;
+
+// 受信したもの全体と、直前の poll() の間に受信したバイト数
+struct TestClient {
+  int fd;
+  std::string received;
+  size_t last_bytes;
+  size_t max_bytes;    // 1回の poll() の間に受信した最大
+  bool closed;
+};
+
+static PosixNetServer* net;
+static HttpServer* server;
+static SensorHistory history;
+static TrendPyramid* trend;
+static uint16_t port;
+static uint32_t next_timestamp;
+static TestClient clients[MAX_CLIENTS];
+static uint8_t client_count;
+
+// /metrics のページ（8台分のセンサーとヒストグラムで POLL_BUDGET の数倍）
+static const uint32_t LOOP_BOUNDS[] = { 100, 1000, 10000, 100000 };
+static size_t encodePage(char* buffer, size_t size, void* context) {
+  static MetricsHistogram loop(LOOP_BOUNDS, 4);
+  static MetricsHistogram latency(LOOP_BOUNDS, 4);
+  static SensorPoint points[8];
+  DeviceMetrics metrics = {};
+  metrics.sample.tvoc = history.tvocAt(history.size() - 1);
+  metrics.sample.eco2 = history.eco2At(history.size() - 1);
+  metrics.sensor_connected = true;
+  metrics.uptime_ms = millis();
+  metrics.sensor_loop = &loop;
+  metrics.render_loop = &loop;
+  metrics.iaq_latency = &latency;
+  metrics.raw_latency = &latency;
+  metrics.measure_retries = &latency;
+  metrics.sensor_points = points;
+  metrics.sensor_count = 8;
+  return encodeDeviceMetrics(metrics, buffer, size);
+}
+
+// 1秒ごとの測定を1件追加する
+static void pushSample() {
+  uint16_t tvoc = (uint16_t)(next_timestamp / 1000 % 500);
+  history.push(next_timestamp, tvoc, tvoc + 400);
+  trend->add(next_timestamp, tvoc, tvoc + 400);
+  next_timestamp += 1000;
+}
+
+static void connectClient(const char* request) {
+  TEST_ASSERT_TRUE(client_count < MAX_CLIENTS);
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  TEST_ASSERT_TRUE(fd >= 0);
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = htons(port);
+  TEST_ASSERT_EQUAL_INT(0, connect(fd, (sockaddr*)&address, sizeof(address)));
+  size_t length = strlen(request);
+  TEST_ASSERT_EQUAL_INT((int)length, (int)::send(fd, request, length, 0));
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+  TestClient& client = clients[client_count++];
+  client.fd = fd;
+  client.received.clear();
+  client.last_bytes = 0;
+  client.max_bytes = 0;
+  client.closed = false;
+}
+
+// 届いているものをすべて読む
+static void drain(TestClient& client) {
+  client.last_bytes = 0;
+  while (!client.closed) {
+    char buffer[4096];
+    ssize_t n = recv(client.fd, buffer, sizeof(buffer), 0);
+    if (n > 0) {
+      client.received.append(buffer, n);
+      client.last_bytes += n;
+    } else if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+      client.closed = true;
+    } else {
+      break;
+    }
+  }
+  if (client.last_bytes > client.max_bytes) {
+    client.max_bytes = client.last_bytes;
+  }
+}
+
+// 全クライアントの応答が終わるまで poll() を繰り返す（polls: 回数、push: poll() ごとに測定を追加）
+static void pollUntilClosed(bool push, int& polls) {
+  for (polls = 1; polls <= MAX_POLLS; polls++) {
+    if (push) {
+      pushSample();
+    }
+    server->poll();
+    VirtualClock::advance(20000);
+    bool all_closed = true;
+    for (uint8_t i = 0; i < client_count; i++) {
+      drain(clients[i]);
+      all_closed = all_closed && clients[i].closed;
+    }
+    if (all_closed) {
+      return;
+    }
+  }
+  TEST_FAIL_MESSAGE("responses did not finish");
+}
+
+// ヘッダーと本文に分ける
+static bool splitResponse(const std::string& response, std::string& headers, std::string& body) {
+  size_t end = response.find("\r\n\r\n");
+  if (end == std::string::npos) {
+    return false;
+  }
+  headers = response.substr(0, end + 2);
+  body = response.substr(end + 4);
+  return true;
+}
+
+static bool headerValue(const std::string& headers, const char* name, std::string& value) {
+  size_t start = headers.find(std::string("\r\n") + name + ": ");
+  if (start == std::string::npos) {
+    return false;
+  }
+  start += strlen(name) + 4;
+  value = headers.substr(start, headers.find("\r\n", start) - start);
+  return true;
+}
+
+// チャンク形式を復号する（長さの行・CRLF・終端チャンクがそろっていれば true）
+static bool decodeChunked(const std::string& body, std::string& decoded) {
+  size_t position = 0;
+  decoded.clear();
+  for (;;) {
+    size_t line_end = body.find("\r\n", position);
+    if (line_end == std::string::npos || line_end == position) {
+      return false;
+    }
+    char* end;
+    unsigned long length = strtoul(body.c_str() + position, &end, 16);
+    if (end != body.c_str() + line_end) {
+      return false;
+    }
+    position = line_end + 2;
+    if (length == 0) {
+      return body.compare(position, std::string::npos, "\r\n") == 0;
+    }
+    if (position + length + 2 > body.size() || body.compare(position + length, 2, "\r\n") != 0) {
+      return false;
+    }
+    decoded.append(body, position, length);
+    position += length + 2;
+  }
+}
+
+// OpenMetricsの応答（長さが Content-Length と一致し、各行が見出しか "名前 値"、最後が # EOF）
+static void expectOpenMetrics(const TestClient& client) {
+  std::string headers, body, length;
+  TEST_ASSERT_TRUE(splitResponse(client.received, headers, body));
+  TEST_ASSERT_EQUAL_INT(0, headers.compare(0, 17, "HTTP/1.1 200 OK\r\n"));
+  TEST_ASSERT_TRUE(headerValue(headers, "Content-Length", length));
+  TEST_ASSERT_EQUAL_UINT32(strtoul(length.c_str(), nullptr, 10), body.size());
+  TEST_ASSERT_TRUE(body.size() > HttpServer::POLL_BUDGET);
+  TEST_ASSERT_EQUAL_INT(0, body.compare(body.size() - 6, 6, "# EOF\n"));
+
+  size_t position = 0;
+  while (position < body.size()) {
+    size_t line_end = body.find('\n', position);
+    TEST_ASSERT_TRUE(line_end != std::string::npos && line_end > position);
+    std::string line = body.substr(position, line_end - position);
+    if (line[0] != '#') {
+      size_t space = line.rfind(' ');
+      TEST_ASSERT_TRUE(space != std::string::npos && space > 0 && space + 1 < line.size());
+      TEST_ASSERT_TRUE(line.find_first_not_of("+-.0123456789", space + 1) == std::string::npos);
+    }
+    position = line_end + 1;
+  }
+}
+
+// /history のJSONの応答（next は X-Next-Since と同じ、first・last は最初と最後の測定の時刻）
+struct HistoryJson {
+  uint32_t next;
+  int count;
+  unsigned long first;
+  unsigned long last;
+};
+
+// /history のJSONの応答の測定を数える（時刻は1秒ごとに連続、値は pushSample() のとおり）
+static void expectHistoryJson(const TestClient& client, HistoryJson& result) {
+  std::string headers, body, json, next_since;
+  TEST_ASSERT_TRUE(splitResponse(client.received, headers, body));
+  TEST_ASSERT_EQUAL_INT(0, headers.compare(0, 17, "HTTP/1.1 200 OK\r\n"));
+  TEST_ASSERT_TRUE(headerValue(headers, "X-Next-Since", next_since));
+  TEST_ASSERT_TRUE(decodeChunked(body, json));
+
+  const char* prefix = "{\"source\":\"raw\",\"period\":1000,\"next\":";
+  TEST_ASSERT_EQUAL_INT(0, json.compare(0, strlen(prefix), prefix));
+  result.next = strtoul(next_since.c_str(), nullptr, 10);
+  TEST_ASSERT_EQUAL_UINT32(result.next, strtoul(json.c_str() + strlen(prefix), nullptr, 10));
+  size_t samples = json.find("\"samples\":[");
+  TEST_ASSERT_TRUE(samples != std::string::npos);
+  TEST_ASSERT_EQUAL_INT(0, json.compare(json.size() - 3, 3, "]}\n"));
+
+  const char* p = json.c_str() + samples + 11;
+  result.count = 0;
+  result.first = 0;
+  result.last = 0;
+  while (*p == '[') {
+    unsigned long timestamp;
+    unsigned tvoc, eco2;
+    int used;
+    TEST_ASSERT_EQUAL_INT(3, sscanf(p, "[%lu,%u,%u]%n", &timestamp, &tvoc, &eco2, &used));
+    TEST_ASSERT_TRUE(result.count == 0 || timestamp == result.last + 1000);   // 1秒ごとに抜けなく
+    TEST_ASSERT_EQUAL_UINT32(timestamp / 1000 % 500, tvoc);
+    TEST_ASSERT_EQUAL_UINT32(tvoc + 400, eco2);
+    result.first = result.count == 0 ? timestamp : result.first;
+    result.last = timestamp;
+    result.count++;
+    p += used;
+    if (*p == ',') {
+      p++;
+    }
+  }
+  TEST_ASSERT_EQUAL_STRING("]}\n", p);
+}
+
+static void expectHistoryCsv(const TestClient& client, int& count) {
+  std::string headers, body, csv;
+  TEST_ASSERT_TRUE(splitResponse(client.received, headers, body));
+  TEST_ASSERT_TRUE(headers.find("Content-Type: text/csv\r\n") != std::string::npos);
+  TEST_ASSERT_TRUE(decodeChunked(body, csv));
+  TEST_ASSERT_EQUAL_INT(0, csv.compare(0, 20, "timestamp,tvoc,eco2\n"));
+
+  count = 0;
+  unsigned long last = 0;
+  size_t position = 20;
+  while (position < csv.size()) {
+    unsigned long timestamp;
+    unsigned tvoc, eco2;
+    TEST_ASSERT_EQUAL_INT(3, sscanf(csv.c_str() + position, "%lu,%u,%u\n", &timestamp, &tvoc, &eco2));
+    TEST_ASSERT_TRUE(count == 0 || timestamp == last + 1000);   // 1秒ごとに抜けなく
+    TEST_ASSERT_EQUAL_UINT32(tvoc + 400, eco2);
+    last = timestamp;
+    count++;
+    position = csv.find('\n', position) + 1;
+  }
+}
+
+void setUp(void) {
+  VirtualClock::reset();
+  history.clear();
+  trend = new TrendPyramid();
+  next_timestamp = 0;
+  for (int i = 0; i < 600; i++) {
+    pushSample();
+  }
+
+  net = new PosixNetServer();
+  server = new HttpServer();
+  server->init(net, &history, trend);
+  server->setOpenMetrics(encodePage, nullptr);
+  for (port = FIRST_PORT; port < FIRST_PORT + PORT_ATTEMPTS; port++) {
+    if (server->begin(port)) {
+      break;
+    }
+  }
+  TEST_ASSERT_TRUE(server->isRunning());
+  client_count = 0;
+}
+
+void tearDown(void) {
+  for (uint8_t i = 0; i < client_count; i++) {
+    close(clients[i].fd);
+  }
+  delete server;
+  delete net;
+  delete trend;
+}
+
+// 接続数の上限を超える同時のスクレイプと履歴の取得（poll() ごとに測定を追加しながら）
+void test_concurrent_scrapes_under_load(void) {
+  const char* openmetrics = "GET /metrics HTTP/1.1\r\nAccept: application/openmetrics-text\r\n\r\n";
+  for (int i = 0; i < 4; i++) {
+    connectClient(openmetrics);
+  }
+  connectClient("GET /history HTTP/1.1\r\n\r\n");
+  connectClient("GET /history?format=csv HTTP/1.1\r\n\r\n");
+  connectClient("GET /history?step=60000 HTTP/1.1\r\n\r\n");
+  connectClient("GET /metrics HTTP/1.1\r\n\r\n");
+
+  int polls = 0;
+  pollUntilClosed(true, polls);
+  TEST_ASSERT_TRUE(polls > 2);   // ページ・履歴は複数回の poll() に分けて送る
+
+  for (uint8_t i = 0; i < 4; i++) {
+    expectOpenMetrics(clients[i]);
+  }
+  HistoryJson json_history;
+  expectHistoryJson(clients[4], json_history);
+  // 送信中に上書きされた古い測定は飛ばす
+  TEST_ASSERT_TRUE(json_history.count > 0 && json_history.count <= (int)SensorHistory::SAMPLES);
+  int count = 0;
+  expectHistoryCsv(clients[5], count);
+  TEST_ASSERT_TRUE(count > 0);
+
+  std::string headers, body, json;
+  TEST_ASSERT_TRUE(splitResponse(clients[6].received, headers, body));
+  TEST_ASSERT_TRUE(decodeChunked(body, json));
+  TEST_ASSERT_EQUAL_INT(0, json.compare(0, 20, "{\"source\":\"minute\",\""));
+  TEST_ASSERT_TRUE(splitResponse(clients[7].received, headers, body));
+  TEST_ASSERT_EQUAL_INT(0, body.compare(0, 12, "{\"uptime_ms\""));
+
+  // 1回の poll() で1接続に送るのは予算まで
+  for (uint8_t i = 0; i < client_count; i++) {
+    TEST_ASSERT_TRUE(clients[i].max_bytes <= HttpServer::POLL_BUDGET);
+  }
+}
+
+// /history を1つ取得する（push: 送信中も poll() ごとに測定を追加）
+static void fetchHistory(const char* request, bool push, HistoryJson& result) {
+  connectClient(request);
+  int polls = 0;
+  pollUntilClosed(push, polls);
+  expectHistoryJson(clients[client_count - 1], result);
+}
+
+// 前回の next から取得を続けると、送信中に追加された測定も含めて重複・抜けなくつながる
+void test_history_since_resumes(void) {
+  HistoryJson first;
+  fetchHistory("GET /history HTTP/1.1\r\n\r\n", true, first);
+  // リクエスト時点までに追加されたもの（最初の poll() の前に1件追加する）
+  TEST_ASSERT_EQUAL_UINT32(601, first.next);
+  TEST_ASSERT_EQUAL_UINT32(600000, first.last);
+
+  unsigned long last = first.last;
+  uint32_t next = first.next;
+  for (int i = 0; i < 3; i++) {
+    char request[64];
+    snprintf(request, sizeof(request), "GET /history?since=%lu HTTP/1.1\r\n\r\n", (unsigned long)next);
+    // 前回の応答の送信中と、このリクエストの最初の poll() の前に追加された測定
+    uint32_t pushed = next_timestamp / 1000 - next + 1;
+    HistoryJson resumed;
+    fetchHistory(request, true, resumed);
+    TEST_ASSERT_TRUE(pushed > 1);
+    TEST_ASSERT_EQUAL_INT((int)pushed, resumed.count);
+    TEST_ASSERT_EQUAL_UINT32(last + 1000, resumed.first);
+    TEST_ASSERT_EQUAL_UINT32(next + pushed, resumed.next);
+    last = resumed.last;
+    next = resumed.next;
+  }
+
+  // 最後の応答の送信中に追加された分を取得すれば、次は空（通し番号より先の since も末尾に揃える）
+  HistoryJson rest;
+  char request[64];
+  snprintf(request, sizeof(request), "GET /history?since=%lu HTTP/1.1\r\n\r\n", (unsigned long)next);
+  fetchHistory(request, false, rest);
+  TEST_ASSERT_EQUAL_INT((int)(next_timestamp / 1000 - next), rest.count);
+  TEST_ASSERT_EQUAL_UINT32(last + 1000, rest.first);
+  next = rest.next;
+
+  HistoryJson empty;
+  snprintf(request, sizeof(request), "GET /history?since=%lu HTTP/1.1\r\n\r\n", (unsigned long)next);
+  fetchHistory(request, false, empty);
+  TEST_ASSERT_EQUAL_INT(0, empty.count);
+  TEST_ASSERT_EQUAL_UINT32(next, empty.next);
+  fetchHistory("GET /history?since=999999 HTTP/1.1\r\n\r\n", false, empty);
+  TEST_ASSERT_EQUAL_INT(0, empty.count);
+  TEST_ASSERT_EQUAL_UINT32(next, empty.next);
+}
+
+// 上書きされた通し番号の since は残っている最も古い測定から返す
+void test_history_since_overwritten(void) {
+  for (uint32_t i = 0; i < SensorHistory::SAMPLES; i++) {
+    pushSample();
+  }
+  HistoryJson result;
+  fetchHistory("GET /history?since=100 HTTP/1.1\r\n\r\n", false, result);
+  TEST_ASSERT_EQUAL_INT((int)SensorHistory::SAMPLES, result.count);
+  TEST_ASSERT_EQUAL_UINT32(next_timestamp - SensorHistory::SAMPLES * 1000, result.first);
+  TEST_ASSERT_EQUAL_UINT32(next_timestamp - 1000, result.last);
+  TEST_ASSERT_EQUAL_UINT32(next_timestamp / 1000, result.next);
+}
+
+int main(int argc, char** argv) {
+  Serial.setQuiet(true);
+  UNITY_BEGIN();
+  RUN_TEST(test_concurrent_scrapes_under_load);
+  RUN_TEST(test_history_since_resumes);
+  RUN_TEST(test_history_since_overwritten);
+  return UNITY_END();
+}
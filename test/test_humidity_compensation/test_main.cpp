@@ -0,0 +1,74 @@
+// absoluteHumidity()（飽和水蒸気量の表の補間）と浮動小数点の式の比較
+// （-40〜85 ℃を0.01 ℃刻み、0〜100 %RHを1 %刻み）
+//   pio test -e native -f test_humidity_compensation
+#include <unity.h>
+#include <HumidityCompensation.h>
+
+// SGP30の分解能（1/256 g/m³ = 3.9 mg/m³）か 0.5 % の大きい方まで
+static const double MAX_ERROR = 3.9;
+static const double MAX_RELATIVE = 0.005;
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void test_matches_reference(void) {
+  uint32_t over_limit = 0;
+  int32_t first_temperature = 0;
+  uint32_t first_humidity = 0;
+  for (int32_t temperature = -4000; temperature <= 8500; temperature++) {
+    for (uint32_t humidity = 0; humidity <= 10000; humidity += 100) {
+      double reference = absoluteHumidityReference(temperature / 100.0, humidity / 100.0);
+      double error = fabs(absoluteHumidity((int16_t)temperature, (uint16_t)humidity) - reference);
+      if (error > MAX_ERROR && error > reference * MAX_RELATIVE) {
+        if (over_limit == 0) {
+          first_temperature = temperature;
+          first_humidity = humidity;
+        }
+        over_limit++;
+      }
+    }
+  }
+  TEST_ASSERT_EQUAL_INT_MESSAGE(0, first_temperature, "first temperature over the limit (0.01 C)");
+  TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, first_humidity, "first humidity over the limit (0.01 %RH)");
+  TEST_ASSERT_EQUAL_UINT32(0, over_limit);
+}
+
+// 室内の典型値（25 ℃・50 %RH で約 11.5 g/m³）
+void test_typical_room(void) {
+  TEST_ASSERT_UINT32_WITHIN(100, 11500, absoluteHumidity(2500, 5000));
+  TEST_ASSERT_EQUAL_UINT32(0, absoluteHumidity(2500, 0));
+}
+
+// 湿度・温度が上がれば減らない
+void test_monotonic(void) {
+  for (int32_t temperature = -4000; temperature <= 8500; temperature += 7) {
+    uint32_t previous = 0;
+    for (uint32_t humidity = 0; humidity <= 10000; humidity += 50) {
+      uint32_t value = absoluteHumidity((int16_t)temperature, (uint16_t)humidity);
+      TEST_ASSERT_TRUE(value >= previous);
+      previous = value;
+    }
+  }
+  uint32_t previous = 0;
+  for (int32_t temperature = -4000; temperature <= 8500; temperature++) {
+    uint32_t value = absoluteHumidity((int16_t)temperature, 5000);
+    TEST_ASSERT_TRUE(value >= previous);
+    previous = value;
+  }
+}
+
+// 範囲外の温度は端の値
+void test_out_of_range_is_clamped(void) {
+  TEST_ASSERT_EQUAL_UINT32(absoluteHumidity(-4000, 5000), absoluteHumidity(-6000, 5000));
+  TEST_ASSERT_EQUAL_UINT32(absoluteHumidity(8500, 5000), absoluteHumidity(12000, 5000));
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_matches_reference);
+  RUN_TEST(test_typical_room);
+  RUN_TEST(test_monotonic);
+  RUN_TEST(test_out_of_range_is_clamped);
+  return UNITY_END();
+}
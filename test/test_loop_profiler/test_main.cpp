@@ -0,0 +1,81 @@
+// LoopProfiler の分布・百分位数と、別のタスクからの reset() の確認
+// （ネイティブ環境の cycles() は ns なので、record() には ns をそのまま渡す）
+//   pio test -e native -f test_loop_profiler
+#include <unity.h>
+#include <LoopProfiler.h>
+#include <atomic>
+#include <thread>
+
+static const char* const NAMES[] = { "sensor", "render" };
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void test_percentiles(void) {
+  LoopProfiler profiler(NAMES, 2);
+  for (uint32_t i = 1; i <= 100; i++) {
+    profiler.record(0, i * 1000);
+  }
+  TEST_ASSERT_EQUAL_UINT32(100, profiler.count(0));
+  TEST_ASSERT_EQUAL_UINT32(0, profiler.count(1));
+  TEST_ASSERT_EQUAL_UINT32(100000, profiler.maxNanos(0));
+  // バケットの上限なので実際より最大25%大きい
+  uint32_t p50 = profiler.percentile(0, 50);
+  TEST_ASSERT_TRUE(p50 >= 50000 && p50 <= 62500);
+  TEST_ASSERT_EQUAL_UINT32(100000, profiler.percentile(0, 100));
+  profiler.record(2, 1000);   // 範囲外は無視
+}
+
+// reset() の後は次の record() まで空、記録したタスクが消去してから数え直す
+void test_reset_is_applied_by_recorder(void) {
+  LoopProfiler profiler(NAMES, 2);
+  profiler.record(0, 500000);
+  profiler.record(1, 700000);
+  profiler.reset();
+  TEST_ASSERT_EQUAL_UINT32(0, profiler.count(0));
+  TEST_ASSERT_EQUAL_UINT32(0, profiler.maxNanos(1));
+  TEST_ASSERT_EQUAL_UINT32(0, profiler.percentile(1, 99));
+
+  profiler.record(0, 2000);
+  TEST_ASSERT_EQUAL_UINT32(1, profiler.count(0));
+  TEST_ASSERT_EQUAL_UINT32(2000, profiler.maxNanos(0));
+  TEST_ASSERT_EQUAL_UINT32(0, profiler.count(1));   // まだ記録していない区間は空のまま
+  profiler.record(1, 3000);
+  TEST_ASSERT_EQUAL_UINT32(1, profiler.count(1));
+  TEST_ASSERT_EQUAL_UINT32(3000, profiler.maxNanos(1));
+}
+
+// 記録中のスレッドがある間に別のスレッドから reset() を繰り返しても、件数・最大が壊れない
+void test_reset_from_other_thread(void) {
+  LoopProfiler profiler(NAMES, 2);
+  std::atomic<bool> stop(false);
+  std::atomic<uint32_t> recorded(0);
+  std::thread recorder([&]() {
+    while (!stop.load()) {
+      profiler.record(0, 1000);
+      recorded++;
+    }
+  });
+  for (int i = 0; i < 2000; i++) {
+    profiler.reset();
+    std::this_thread::yield();
+  }
+  stop.store(true);
+  recorder.join();
+
+  // 最後の reset() の後の記録のみ（消去と数え直しが重ならない）
+  TEST_ASSERT_TRUE(profiler.count(0) <= recorded.load());
+  TEST_ASSERT_TRUE(profiler.maxNanos(0) == 0 || profiler.maxNanos(0) == 1000);
+  profiler.reset();
+  profiler.record(0, 1000);
+  TEST_ASSERT_EQUAL_UINT32(1, profiler.count(0));
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_percentiles);
+  RUN_TEST(test_reset_is_applied_by_recorder);
+  RUN_TEST(test_reset_from_other_thread);
+  return UNITY_END();
+}
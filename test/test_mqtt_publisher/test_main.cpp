@@ -0,0 +1,284 @@
+// MqttPublisher の ForwardQueue の滞留分の送信と、ブローカーの切断後の送り直し
+// （ブローカーはテスト内のメモリ上のスタブ、時刻は VirtualClock を10 msずつ進める）
+//   pio test -e native -f test_mqtt_publisher
+#include <unity.h>
+#include <MqttPublisher.h>
+#include <ForwardQueue.h>
+#include <HalNative.h>
+#include <vector>
+
+static const unsigned long POLL_MS = 10;
+static const uint16_t PUBLISH_INTERVAL = 10;   // (s)
+
+// 接続1本分の送受信（ブローカーが close() するまで有効）
+class StubClient : public NetClient {
+public:
+  int read(uint8_t* buffer, size_t length) override {
+    if (closed && inbound.empty()) {
+      return -1;
+    }
+    size_t n = length < inbound.size() ? length : inbound.size();
+    memcpy(buffer, inbound.data(), n);
+    inbound.erase(inbound.begin(), inbound.begin() + n);
+    return (int)n;
+  }
+
+  size_t write(const uint8_t* data, size_t length) override {
+    if (closed) {
+      return 0;
+    }
+    outbound.insert(outbound.end(), data, data + length);
+    return length;
+  }
+
+  bool connected() override { return !closed; }
+
+  std::vector<uint8_t> inbound;    // ブローカー → 機器
+  std::vector<uint8_t> outbound;   // 機器 → ブローカー
+  bool closed = false;
+};
+
+// CONNECT・PUBLISH（QoS 1）・PINGREQ に応答する最小限のブローカー
+class StubBroker : public NetConnector {
+public:
+  NetClient* connect(const char* host, uint16_t port) override {
+    connects++;
+    client = new StubClient();
+    return client;
+  }
+
+  NetConnectStatus pollConnect(NetClient* pending) override {
+    return available ? NET_CONNECT_DONE : NET_CONNECT_FAILED;
+  }
+
+  void close(NetClient* closing) override {
+    if (closing == client) {
+      client = nullptr;
+    }
+    delete closing;
+  }
+
+  // 届いたパケットを処理する
+  void service() {
+    if (client == nullptr || client->closed) {
+      return;
+    }
+    std::vector<uint8_t>& data = client->outbound;
+    while (data.size() >= 2) {
+      size_t header = 2;
+      size_t remaining = data[1] & 0x7F;
+      if (data[1] & 0x80) {
+        if (data.size() < 3) {
+          return;
+        }
+        remaining |= (size_t)data[2] << 7;
+        header = 3;
+      }
+      if (data.size() < header + remaining) {
+        return;
+      }
+      handle(data[0], data.data() + header, remaining);
+      data.erase(data.begin(), data.begin() + header + remaining);
+      if (client == nullptr || client->closed) {
+        return;
+      }
+    }
+  }
+
+  // 接続を切る（機器側は次の read() で切断を知る）
+  void drop() {
+    if (client != nullptr) {
+      client->closed = true;
+      client->inbound.clear();
+    }
+  }
+
+  bool available = true;          // false なら接続を拒否する
+  bool ack = true;                // false なら PUBLISH を受け取っても PUBACK を返さない
+  uint32_t drop_after = 0;        // この件数の PUBLISH を受け取ったら PUBACK を返さずに切る（0: 切らない）
+  uint32_t connects = 0;
+  uint32_t publishes = 0;
+  std::vector<QueuedSample> received;
+  std::vector<unsigned long> publish_times;
+
+private:
+  StubClient* client = nullptr;
+
+  void reply(uint8_t type, const uint8_t* body, size_t length) {
+    client->inbound.push_back(type);
+    client->inbound.push_back((uint8_t)length);
+    client->inbound.insert(client->inbound.end(), body, body + length);
+  }
+
+  void handle(uint8_t type, const uint8_t* body, size_t length) {
+    if (type == 0x10) {
+      const uint8_t accepted[2] = { 0, 0 };
+      reply(0x20, accepted, sizeof(accepted));
+    } else if (type == 0x32) {
+      size_t topic_length = (body[0] << 8) | body[1];
+      const uint8_t* packet_id = body + 2 + topic_length;
+      QueuedSample samples[MqttPublisher::MAX_BATCH];
+      int count = decodeSampleBatch(packet_id + 2, length - 2 - topic_length - 2, samples, MqttPublisher::MAX_BATCH);
+      TEST_ASSERT_TRUE(count > 0);
+      received.insert(received.end(), samples, samples + count);
+      publish_times.push_back(millis());
+      publishes++;
+      if (drop_after != 0 && publishes == drop_after) {
+        drop();
+      } else if (ack) {
+        reply(0x40, packet_id, 2);
+      }
+    } else if (type == 0xC0) {
+      reply(0xD0, nullptr, 0);
+    }
+  }
+};
+
+static StubBroker* broker;
+static ForwardQueue* queue;
+static MqttPublisher* publisher;
+
+static QueuedSample makeSample(uint32_t i) {
+  QueuedSample sample = { SIM_EPOCH_START + i, i * 1000, (uint16_t)(i % 500), (uint16_t)(400 + i) };
+  return sample;
+}
+
+static void pushSamples(uint32_t from, uint32_t count) {
+  for (uint32_t i = from; i < from + count; i++) {
+    queue->push(makeSample(i));
+  }
+}
+
+// ms の間 poll() とブローカーの処理を繰り返す
+static void run(unsigned long ms, bool network_up) {
+  unsigned long end = millis() + ms;
+  while ((long)(millis() - end) < 0) {
+    publisher->poll(network_up);
+    broker->service();
+    VirtualClock::advance(POLL_MS * 1000);
+  }
+}
+
+// 受け取った測定が 0〜count-1 の順に1回ずつ（duplicates: 送り直しで重複した件数）
+static void expectReceived(uint32_t count, uint32_t& duplicates) {
+  std::vector<bool> seen(count, false);
+  duplicates = 0;
+  uint32_t next = 0;
+  for (const QueuedSample& sample : broker->received) {
+    uint32_t i = sample.timestamp / 1000;
+    TEST_ASSERT_TRUE(i < count);
+    QueuedSample expected = makeSample(i);
+    TEST_ASSERT_EQUAL_MEMORY(&expected, &sample, sizeof(sample));
+    if (seen[i]) {
+      duplicates++;
+      continue;
+    }
+    // 初めて受け取るものは古い順
+    TEST_ASSERT_EQUAL_UINT32(next, i);
+    seen[i] = true;
+    next++;
+  }
+  TEST_ASSERT_EQUAL_UINT32(count, next);
+}
+
+void setUp(void) {
+  VirtualClock::reset();
+  broker = new StubBroker();
+  queue = new ForwardQueue();
+  queue->init(nullptr, "");
+  publisher = new MqttPublisher();
+  MqttConfig config = {};
+  strcpy(config.host, "broker.local");
+  config.port = 1883;
+  strcpy(config.topic, "tvoc/test");
+  strcpy(config.client_id, "tvoc-test");
+  config.publish_interval = PUBLISH_INTERVAL;
+  publisher->init(broker, queue, config);
+}
+
+void tearDown(void) {
+  delete publisher;
+  delete queue;
+  delete broker;
+}
+
+// 切断中に溜まった分は MAX_BATCH 件ずつ DRAIN_INTERVAL ごとに送り、端数は通常の間隔で送る
+void test_backlog_drains_in_batches(void) {
+  const uint32_t backlog = 3 * MqttPublisher::MAX_BATCH + 5;
+  pushSamples(0, backlog);
+  run(1000, false);
+  TEST_ASSERT_EQUAL_UINT32(0, broker->connects);
+
+  run(2000, true);
+  TEST_ASSERT_TRUE(publisher->isConnected());
+  TEST_ASSERT_EQUAL_UINT32(3, broker->publishes);
+  TEST_ASSERT_EQUAL_UINT32(5, queue->size());
+  for (size_t i = 1; i < broker->publish_times.size(); i++) {
+    TEST_ASSERT_UINT32_WITHIN(POLL_MS, MqttPublisher::DRAIN_INTERVAL,
+                              broker->publish_times[i] - broker->publish_times[i - 1]);
+  }
+
+  run(PUBLISH_INTERVAL * 1000UL, true);
+  TEST_ASSERT_EQUAL_UINT32(4, broker->publishes);
+  TEST_ASSERT_EQUAL_UINT32(0, queue->size());
+  TEST_ASSERT_EQUAL_UINT32(backlog, publisher->publishedSamples());
+  uint32_t duplicates;
+  expectReceived(backlog, duplicates);
+  TEST_ASSERT_EQUAL_UINT32(0, duplicates);
+}
+
+// PUBACK の前に切られたまとめはキューに残り、再接続後に同じ内容から送り直す
+void test_disconnect_before_puback_is_resent(void) {
+  const uint32_t backlog = 4 * MqttPublisher::MAX_BATCH;
+  pushSamples(0, backlog);
+  broker->drop_after = 2;
+  run(1000, true);
+  TEST_ASSERT_FALSE(publisher->isConnected());
+  TEST_ASSERT_EQUAL_UINT32(1, broker->connects);
+  TEST_ASSERT_EQUAL_UINT32(backlog - MqttPublisher::MAX_BATCH, queue->size());
+  TEST_ASSERT_EQUAL_UINT32(MqttPublisher::MAX_BATCH, publisher->publishedSamples());
+
+  // RETRY_MIN の後に再接続し、残りをすべて送る
+  run(MqttPublisher::RETRY_MIN + 1000, true);
+  TEST_ASSERT_EQUAL_UINT32(2, broker->connects);
+  TEST_ASSERT_EQUAL_UINT32(0, queue->size());
+  TEST_ASSERT_EQUAL_UINT32(backlog, publisher->publishedSamples());
+  uint32_t duplicates;
+  expectReceived(backlog, duplicates);
+  TEST_ASSERT_EQUAL_UINT32(MqttPublisher::MAX_BATCH, duplicates);
+}
+
+// 接続は保ったまま PUBACK が来なければ RESPONSE_TIMEOUT で切断して送り直す。拒否が続く間は間隔を倍にする
+void test_puback_timeout_and_refused_reconnect(void) {
+  pushSamples(0, MqttPublisher::MAX_BATCH);
+  broker->ack = false;
+  run(MqttPublisher::RESPONSE_TIMEOUT + 1000, true);
+  TEST_ASSERT_FALSE(publisher->isConnected());
+  TEST_ASSERT_EQUAL_UINT32(1, broker->publishes);
+  TEST_ASSERT_EQUAL_UINT32(MqttPublisher::MAX_BATCH, queue->size());
+
+  // 2 s・4 s・8 s の間隔で3回拒否（最初の切断の後の間隔は RETRY_MIN）
+  broker->available = false;
+  broker->ack = true;
+  run(2000 + 4000 + 8000, true);
+  TEST_ASSERT_EQUAL_UINT32(1 + 3, broker->connects);
+  TEST_ASSERT_EQUAL_UINT32(MqttPublisher::MAX_BATCH, queue->size());
+
+  broker->available = true;
+  run(16000 + 1000, true);
+  TEST_ASSERT_EQUAL_UINT32(1 + 4, broker->connects);
+  TEST_ASSERT_TRUE(publisher->isConnected());
+  TEST_ASSERT_EQUAL_UINT32(0, queue->size());
+  uint32_t duplicates;
+  expectReceived(MqttPublisher::MAX_BATCH, duplicates);
+  TEST_ASSERT_EQUAL_UINT32(MqttPublisher::MAX_BATCH, duplicates);
+}
+
+int main(int argc, char** argv) {
+  Serial.setQuiet(true);
+  UNITY_BEGIN();
+  RUN_TEST(test_backlog_drains_in_batches);
+  RUN_TEST(test_disconnect_before_puback_is_resent);
+  RUN_TEST(test_puback_timeout_and_refused_reconnect);
+  return UNITY_END();
+}
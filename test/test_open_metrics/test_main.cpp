@@ -0,0 +1,146 @@
+// OpenMetricsWriter の出力の形式と、バッファが足りない場合に途中で切れた出力を返さないことの確認
+//   pio test -e native -f test_open_metrics
+#include <unity.h>
+#include <OpenMetrics.h>
+#include <string.h>
+
+static const uint32_t LATENCY_BOUNDS[] = { 1000, 10000, 100000 };
+static char buffer[16384];
+
+void setUp(void) {
+  memset(buffer, 0, sizeof(buffer));
+}
+
+void tearDown(void) {}
+
+void test_samples(void) {
+  OpenMetricsWriter writer(buffer, sizeof(buffer));
+  writer.family("tvoc_ppb", "gauge", "TVOC.", "ppb");
+  writer.sample("tvoc_ppb", nullptr, 123);
+  writer.family("saves", "counter", "Saves.");
+  writer.sample("saves", "_total", 4, "result", "success");
+  writer.sampleSigned("rate", nullptr, -17, "gas", "h2");
+  writer.sampleDecimal("uptime_seconds", nullptr, 61500, 3);
+  writer.sampleDecimal("whole_seconds", nullptr, 2000, 3);
+  writer.sampleSignedDecimal("temperature_celsius", nullptr, -525, 2);
+  size_t length = writer.finish();
+
+  const char* expected =
+    "# TYPE tvoc_ppb gauge\n"
+    "# UNIT tvoc_ppb ppb\n"
+    "# HELP tvoc_ppb TVOC.\n"
+    "tvoc_ppb 123\n"
+    "# TYPE saves counter\n"
+    "# HELP saves Saves.\n"
+    "saves_total{result=\"success\"} 4\n"
+    "rate{gas=\"h2\"} -17\n"
+    "uptime_seconds 61.5\n"
+    "whole_seconds 2\n"
+    "temperature_celsius -5.25\n"
+    "# EOF\n";
+  TEST_ASSERT_EQUAL_UINT32(strlen(expected), length);
+  TEST_ASSERT_EQUAL_STRING_LEN(expected, buffer, length);
+  TEST_ASSERT_FALSE(writer.overflowed());
+}
+
+void test_histogram(void) {
+  MetricsHistogram latency(LATENCY_BOUNDS, 3);
+  latency.observe(500);
+  latency.observe(1000);      // 境界と同じ値はそのバケットに入る
+  latency.observe(25000);
+  latency.observe(2000000);   // 上限超え
+
+  OpenMetricsWriter writer(buffer, sizeof(buffer));
+  writer.family("latency_seconds", "histogram", "Latency.", "seconds");
+  writer.histogram("latency_seconds", latency, "command", "iaq");
+  writer.histogram("plain", latency, nullptr, nullptr, 0);
+  size_t length = writer.finish();
+
+  // バケットは累積、件数は +Inf と同じ、合計は us を秒で
+  const char* expected =
+    "# TYPE latency_seconds histogram\n"
+    "# UNIT latency_seconds seconds\n"
+    "# HELP latency_seconds Latency.\n"
+    "latency_seconds_bucket{command=\"iaq\",le=\"0.001\"} 2\n"
+    "latency_seconds_bucket{command=\"iaq\",le=\"0.01\"} 2\n"
+    "latency_seconds_bucket{command=\"iaq\",le=\"0.1\"} 3\n"
+    "latency_seconds_bucket{command=\"iaq\",le=\"+Inf\"} 4\n"
+    "latency_seconds_count{command=\"iaq\"} 4\n"
+    "latency_seconds_sum{command=\"iaq\"} 2.0265\n"
+    "plain_bucket{le=\"1000\"} 2\n"
+    "plain_bucket{le=\"10000\"} 2\n"
+    "plain_bucket{le=\"100000\"} 3\n"
+    "plain_bucket{le=\"+Inf\"} 4\n"
+    "plain_count 4\n"
+    "plain_sum 2026500\n"
+    "# EOF\n";
+  TEST_ASSERT_EQUAL_UINT32(strlen(expected), length);
+  TEST_ASSERT_EQUAL_STRING_LEN(expected, buffer, length);
+}
+
+// どの長さで足りなくなっても 0 を返す（"# EOF" だけが収まる場合も含む）
+void test_small_buffer_is_detected(void) {
+  MetricsHistogram latency(LATENCY_BOUNDS, 3);
+  latency.observe(25000);
+  char full[512];
+  OpenMetricsWriter reference(full, sizeof(full));
+  reference.family("latency_seconds", "histogram", "Latency.", "seconds");
+  reference.histogram("latency_seconds", latency);
+  size_t needed = reference.finish();
+  TEST_ASSERT_TRUE(needed > 0);
+
+  for (size_t size = 0; size < needed; size++) {
+    OpenMetricsWriter writer(buffer, size);
+    writer.family("latency_seconds", "histogram", "Latency.", "seconds");
+    writer.histogram("latency_seconds", latency);
+    TEST_ASSERT_EQUAL_UINT32(0, writer.finish());
+    TEST_ASSERT_TRUE(writer.overflowed());
+    TEST_ASSERT_TRUE(writer.length() <= size);
+  }
+
+  OpenMetricsWriter exact(buffer, needed);
+  exact.family("latency_seconds", "histogram", "Latency.", "seconds");
+  exact.histogram("latency_seconds", latency);
+  TEST_ASSERT_EQUAL_UINT32(needed, exact.finish());
+  TEST_ASSERT_EQUAL_STRING_LEN(full, buffer, needed);
+}
+
+void test_device_metrics(void) {
+  MetricsHistogram sensor_loop(LATENCY_BOUNDS, 3);
+  MetricsHistogram render_loop(LATENCY_BOUNDS, 3);
+  sensor_loop.observe(2500);
+  DeviceMetrics metrics = {};
+  metrics.sample.tvoc = 42;
+  metrics.sample.eco2 = 450;
+  metrics.sensor_connected = true;
+  metrics.uptime_ms = 90250;
+  metrics.sensor_loop = &sensor_loop;
+  metrics.render_loop = &render_loop;
+
+  size_t length = encodeDeviceMetrics(metrics, buffer, sizeof(buffer));
+  TEST_ASSERT_TRUE(length > 0);
+  buffer[length] = '\0';
+  TEST_ASSERT_NOT_NULL(strstr(buffer, "\ntvoc_ppb 42\n"));
+  TEST_ASSERT_NOT_NULL(strstr(buffer, "\neco2_ppm 450\n"));
+  TEST_ASSERT_NOT_NULL(strstr(buffer, "\nloop_duration_seconds_bucket{task=\"sensor\",le=\"0.01\"} 1\n"));
+  TEST_ASSERT_NOT_NULL(strstr(buffer, "\nloop_duration_seconds_count{task=\"render\"} 0\n"));
+  TEST_ASSERT_NOT_NULL(strstr(buffer, "\nloop_duration_seconds_sum{task=\"sensor\"} 0.0025\n"));
+  // 無効な項目は出力しない
+  TEST_ASSERT_NULL(strstr(buffer, "mqtt_"));
+  TEST_ASSERT_NULL(strstr(buffer, "sensor_tvoc_ppb"));
+  // 最後の行は "# EOF"
+  TEST_ASSERT_EQUAL_STRING("uptime_seconds 90.25\n# EOF\n", buffer + length - strlen("uptime_seconds 90.25\n# EOF\n"));
+
+  // 1バイト足りなくても途中で切れた出力を返さない
+  TEST_ASSERT_EQUAL_UINT32(0, encodeDeviceMetrics(metrics, buffer, length - 1));
+  TEST_ASSERT_EQUAL_UINT32(length, encodeDeviceMetrics(metrics, buffer, length));
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_samples);
+  RUN_TEST(test_histogram);
+  RUN_TEST(test_small_buffer_is_detected);
+  RUN_TEST(test_device_metrics);
+  return UNITY_END();
+}
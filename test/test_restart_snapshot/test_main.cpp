@@ -0,0 +1,254 @@
+// RestartSnapshot の引き継ぎと、壊れた・途中で切れた内容を使わないことの確認
+// （保持メモリ・NVSはテスト内の実装、壊す位置は固定の系列の乱数）
+//   pio test -e native -f test_restart_snapshot
+#include <unity.h>
+#include <RestartSnapshot.h>
+#include <string.h>
+#include <vector>
+
+// リセットの理由を指定できる保持メモリ
+class TestRetainedMemory : public RetainedMemory {
+public:
+  uint8_t* data() override { return memory; }
+  ResetReason resetReason() const override { return reason; }
+
+  uint8_t memory[SIZE];
+  ResetReason reason = RESET_POWER_ON;
+};
+
+// 1件のバイト列のみを保存するNVS
+class TestStore : public KeyValueStore {
+public:
+  bool begin(const char* name, bool read_only) override { return true; }
+  void end() override {}
+  uint16_t getUShort(const char* key, uint16_t default_value) override { return default_value; }
+  size_t putUShort(const char* key, uint16_t value) override { return 0; }
+  size_t getBytes(const char* key, void* buffer, size_t length) override {
+    size_t copied = blob.size() < length ? blob.size() : length;
+    memcpy(buffer, blob.data(), copied);
+    return copied;
+  }
+  size_t putBytes(const char* key, const void* value, size_t length) override {
+    const uint8_t* bytes = static_cast<const uint8_t*>(value);
+    blob.assign(bytes, bytes + length);
+    return length;
+  }
+  bool remove(const char* key) override {
+    blob.clear();
+    return true;
+  }
+
+  std::vector<uint8_t> blob;
+};
+
+static TestRetainedMemory retained;
+static TestStore store;
+static SensorHistory history;   // 約5 KB、スタックに載せない
+static uint8_t saved[RetainedMemory::SIZE];
+static uint32_t random_state;
+
+static const size_t SENSOR_END = RestartSnapshot::SENSOR_OFFSET + RestartSnapshot::HEADER_SIZE + RestartSnapshot::SENSOR_SIZE;
+
+static uint32_t nextRandom() {
+  random_state = random_state * 1664525 + 1013904223;
+  return random_state >> 8;
+}
+
+static SensorManagerState makeState(uint8_t index) {
+  SensorManagerState state = {};
+  state.clean_air_elapsed = 1000 + index;
+  state.since_periodic_save = 3600000 * (index + 1);
+  state.clean_air_detected = index & 1;
+  return state;
+}
+
+static void fillHistory(SensorHistory& target, uint16_t count, uint16_t value) {
+  target.clear();
+  for (uint16_t i = 0; i < count; i++) {
+    target.push(i * 1000, value, value + 400);
+  }
+}
+
+// 3台の状態と測定を書き込み、保持メモリの内容を saved に残す
+static void saveSnapshot() {
+  RestartSnapshot writer;
+  retained.reason = RESET_POWER_ON;
+  writer.init(&retained, nullptr);
+  SensorManagerState states[3] = { makeState(0), makeState(1), makeState(2) };
+  writer.saveSensorStates(states, 3);
+  fillHistory(history, 120, 50);
+  writer.saveHistory(history);
+  memcpy(saved, retained.memory, sizeof(saved));
+}
+
+// 1台目の状態を引き継げるか（拒否した場合は一部だけ書き込んでいないかも確かめる）
+static void expectSensorRestored(RestartSnapshot& snapshot, bool restored) {
+  SensorManagerState state;
+  memset(&state, 0xA5, sizeof(state));
+  TEST_ASSERT_EQUAL(restored, snapshot.restoreSensorState(0, state));
+  SensorManagerState expected = makeState(0);
+  if (!restored) {
+    memset(&expected, 0xA5, sizeof(expected));
+  }
+  TEST_ASSERT_EQUAL_MEMORY(&expected, &state, sizeof(state));
+}
+
+// 測定を引き継げるか（拒否した場合は前の測定のまま）
+static void expectHistoryRestored(RestartSnapshot& snapshot, bool restored) {
+  fillHistory(history, 10, 999);
+  size_t count = snapshot.restoreHistory(history, 200000);
+  if (!restored) {
+    TEST_ASSERT_EQUAL_UINT32(0, count);
+    TEST_ASSERT_EQUAL_UINT32(10, history.size());
+    TEST_ASSERT_EQUAL_UINT16(999, history.tvocAt(9));
+    return;
+  }
+  TEST_ASSERT_EQUAL_UINT32(120, count);
+  TEST_ASSERT_EQUAL_UINT32(120, history.size());
+  TEST_ASSERT_EQUAL_UINT16(50, history.tvocAt(119));
+  TEST_ASSERT_EQUAL_UINT32(200000 - SensorManager::SENSOR_UPDATE_INTERVAL, history.timestampAt(119));
+}
+
+// 壊したバイトが区画の間の未使用の領域か
+static bool inGap(size_t offset) {
+  return offset >= SENSOR_END && offset < RestartSnapshot::HISTORY_OFFSET;
+}
+
+void setUp(void) {
+  memset(retained.memory, 0, sizeof(retained.memory));
+  store.blob.clear();
+  random_state = 12345;
+  saveSnapshot();
+}
+
+void tearDown(void) {}
+
+void test_round_trip(void) {
+  RestartSnapshot snapshot;
+  retained.reason = RESET_CRASH;
+  snapshot.init(&retained, &store);
+  TEST_ASSERT_EQUAL_UINT8(RestartSnapshot::ORIGIN_RTC, snapshot.origin());
+
+  for (uint8_t i = 0; i < 3; i++) {
+    SensorManagerState state;
+    TEST_ASSERT_TRUE(snapshot.restoreSensorState(i, state));
+    SensorManagerState expected = makeState(i);
+    TEST_ASSERT_EQUAL_MEMORY(&expected, &state, sizeof(state));
+  }
+  SensorManagerState unused;
+  TEST_ASSERT_FALSE(snapshot.restoreSensorState(3, unused));
+  expectHistoryRestored(snapshot, true);
+}
+
+void test_power_on_ignores_rtc(void) {
+  RestartSnapshot snapshot;
+  retained.reason = RESET_POWER_ON;
+  snapshot.init(&retained, &store);
+  TEST_ASSERT_EQUAL_UINT8(RestartSnapshot::ORIGIN_NONE, snapshot.origin());
+  expectSensorRestored(snapshot, false);
+  expectHistoryRestored(snapshot, false);
+}
+
+// 保持メモリの1バイトを壊すと、その区画だけを使わない
+void test_corrupted_rtc_is_rejected(void) {
+  for (int trial = 0; trial < 400; trial++) {
+    memcpy(retained.memory, saved, sizeof(saved));
+    size_t offset = nextRandom() % RestartSnapshot::TOTAL_SIZE;
+    if (inGap(offset)) {
+      continue;
+    }
+    retained.memory[offset] ^= (uint8_t)(1 + nextRandom() % 255);
+
+    RestartSnapshot snapshot;
+    retained.reason = RESET_CRASH;
+    snapshot.init(&retained, nullptr);
+    bool in_sensor = offset < SENSOR_END;
+    expectSensorRestored(snapshot, !in_sensor);
+    expectHistoryRestored(snapshot, in_sensor);
+  }
+}
+
+// 書き込みの途中でリセットされた区画（マジックを消した後、本体の途中まで新しい内容）
+void test_interrupted_write_is_rejected(void) {
+  RestartSnapshot writer;
+  retained.reason = RESET_POWER_ON;
+  writer.init(&retained, nullptr);
+  fillHistory(history, 200, 70);
+  writer.saveHistory(history);
+  uint8_t updated[RetainedMemory::SIZE];
+  memcpy(updated, retained.memory, sizeof(updated));
+
+  for (int trial = 0; trial < 100; trial++) {
+    size_t written = nextRandom() % (RestartSnapshot::HEADER_SIZE + RestartSnapshot::HISTORY_SIZE);
+    memcpy(retained.memory, saved, sizeof(saved));
+    memset(retained.memory + RestartSnapshot::HISTORY_OFFSET, 0, 4);
+    memcpy(retained.memory + RestartSnapshot::HISTORY_OFFSET + 4,
+           updated + RestartSnapshot::HISTORY_OFFSET + 4, written > 4 ? written - 4 : 0);
+
+    RestartSnapshot snapshot;
+    retained.reason = RESET_BROWNOUT;
+    snapshot.init(&retained, nullptr);
+    expectSensorRestored(snapshot, true);
+    expectHistoryRestored(snapshot, false);
+  }
+}
+
+void test_nvs_copy_round_trip(void) {
+  RestartSnapshot writer;
+  retained.reason = RESET_CRASH;
+  writer.init(&retained, &store);
+  TEST_ASSERT_TRUE(writer.persist());
+  TEST_ASSERT_EQUAL_UINT32(RestartSnapshot::TOTAL_SIZE, store.blob.size());
+
+  // 電源投入扱いの起動（保持メモリは不定）でもNVSの写しを使い、一度読んだら消す
+  memset(retained.memory, 0xFF, sizeof(retained.memory));
+  RestartSnapshot snapshot;
+  retained.reason = RESET_POWER_ON;
+  snapshot.init(&retained, &store);
+  TEST_ASSERT_EQUAL_UINT8(RestartSnapshot::ORIGIN_NVS, snapshot.origin());
+  expectSensorRestored(snapshot, true);
+  expectHistoryRestored(snapshot, true);
+  TEST_ASSERT_EQUAL_UINT32(0, store.blob.size());
+}
+
+// NVSの写しが途中で切れている・壊れている場合は使わない
+void test_truncated_or_corrupted_nvs_is_rejected(void) {
+  std::vector<uint8_t> copy(saved, saved + RestartSnapshot::TOTAL_SIZE);
+
+  for (int trial = 0; trial < 200; trial++) {
+    store.blob = copy;
+    bool truncate = trial % 2 == 0;
+    size_t offset = nextRandom() % RestartSnapshot::TOTAL_SIZE;
+    if (truncate) {
+      store.blob.resize(offset);
+    } else if (inGap(offset)) {
+      continue;
+    } else {
+      store.blob[offset] ^= (uint8_t)(1 + nextRandom() % 255);
+    }
+
+    memset(retained.memory, 0xFF, sizeof(retained.memory));
+    RestartSnapshot snapshot;
+    retained.reason = RESET_POWER_ON;
+    snapshot.init(&retained, &store);
+    // 切れた写しは全体を使わない、壊れた写しは無傷の区画だけを使う
+    if (truncate) {
+      TEST_ASSERT_EQUAL_UINT8(RestartSnapshot::ORIGIN_NONE, snapshot.origin());
+    }
+    bool in_sensor = offset < SENSOR_END;
+    expectSensorRestored(snapshot, !truncate && !in_sensor);
+    expectHistoryRestored(snapshot, !truncate && in_sensor);
+    TEST_ASSERT_EQUAL_UINT32(0, store.blob.size());
+  }
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_round_trip);
+  RUN_TEST(test_power_on_ignores_rtc);
+  RUN_TEST(test_corrupted_rtc_is_rejected);
+  RUN_TEST(test_interrupted_write_is_rejected);
+  RUN_TEST(test_nvs_copy_round_trip);
+  RUN_TEST(test_truncated_or_corrupted_nvs_is_rejected);
+  return UNITY_END();
+}
@@ -0,0 +1,216 @@
+// SensorArray の1つのチャンネルの障害（コマンドのNACK・周期の途中で外れたセンサー・読み取りのCRCエラー・測定の遅い個体）
+// 他のチャンネルは測定を続け、障害のチャンネルは再試行する
+// （TCA9548A の先に4台の HalNative の SimulatedSgp30Device、障害はテスト内のラッパーで決まった回数だけ起こす）
+//   pio test -e native -f test_sensor_array
+#include <unity.h>
+#include <SensorArray.h>
+#include <HalNative.h>
+
+static const uint8_t MUX_ADDRESS = 0x70;
+static const uint8_t SENSORS = 4;
+static const uint8_t CHANNELS[SENSORS] = { 0, 1, 2, 3 };
+
+// 指定した回数だけ転送を失敗させるSGP30
+class FaultySgp30 : public SimulatedI2cDevice {
+public:
+  explicit FaultySgp30(uint8_t placement) : device(placement) {}
+
+  bool write(const uint8_t* data, size_t length) override {
+    commands++;
+    if (nack_writes > 0) {
+      nack_writes--;
+      return false;
+    }
+    bool accepted = device.write(data, length);
+    if (accepted) {
+      raw_command = length == 2 && data[0] == 0x20 && data[1] == 0x50;
+    }
+    return accepted;
+  }
+
+  size_t read(uint8_t* data, size_t length) override {
+    size_t received = device.read(data, length);
+    if (received > 0 && corrupt_reads > 0) {
+      corrupt_reads--;
+      data[1] ^= 0x01;
+    } else if (received == 2 * 3) {
+      uint16_t* words = raw_command ? last_raw : last_iaq;
+      words[0] = (uint16_t)((data[0] << 8) | data[1]);
+      words[1] = (uint16_t)((data[3] << 8) | data[4]);
+    }
+    return received;
+  }
+
+  SimulatedSgp30& model() { return device.model(); }
+  void setExtraDelay(uint32_t extra_us) { device.setExtraDelay(extra_us); }
+
+  uint32_t commands = 0;         // 届いたコマンド（NACKにしたものを含む）
+  uint32_t nack_writes = 0;      // 次のコマンドからNACKにする回数
+  uint32_t corrupt_reads = 0;    // 次の読み取りから1ビット反転させる回数
+  uint16_t last_iaq[2] = {};     // 最後に読み取られた measure_iaq の結果（eCO2・TVOC）
+  uint16_t last_raw[2] = {};     // 最後に読み取られた measure_raw の結果（H2・エタノール）
+
+private:
+  SimulatedSgp30Device device;
+  bool raw_command = false;      // 最後に受け付けたコマンドが measure_raw か
+};
+
+static SimulatedI2cBus* bus;
+static FaultySgp30* sensors[SENSORS];
+static SensorArray* array;
+
+// 周期の結果を各センサーが返し、値は最後に読み取った測定のもの
+static void expectMeasured(uint8_t index, bool raw) {
+  Sgp30Device& device = array->device(index);
+  TEST_ASSERT_TRUE(device.IAQmeasure());
+  TEST_ASSERT_EQUAL_UINT16(sensors[index]->last_iaq[0], device.eco2());
+  TEST_ASSERT_EQUAL_UINT16(sensors[index]->last_iaq[1], device.tvoc());
+  if (raw) {
+    TEST_ASSERT_TRUE(device.IAQmeasureRaw());
+    TEST_ASSERT_EQUAL_UINT16(sensors[index]->last_raw[0], device.rawH2());
+    TEST_ASSERT_EQUAL_UINT16(sensors[index]->last_raw[1], device.rawEthanol());
+  }
+}
+
+void setUp(void) {
+  VirtualClock::reset();
+  bus = new SimulatedI2cBus();
+  bus->setMux(MUX_ADDRESS);
+  for (uint8_t i = 0; i < SENSORS; i++) {
+    sensors[i] = new FaultySgp30(i);
+    bus->attach(Sgp30Device::ADDRESS, sensors[i], (int8_t)CHANNELS[i]);
+  }
+  array = new SensorArray();
+  array->init(bus, MUX_ADDRESS, CHANNELS, SENSORS);
+}
+
+void tearDown(void) {
+  delete array;
+  for (FaultySgp30* sensor : sensors) {
+    delete sensor;
+  }
+  delete bus;
+}
+
+// 障害がなければ全センサーへコマンドを1回ずつ送り、再試行しない
+void test_all_channels_sample(void) {
+  array->measure(true);
+  for (uint8_t i = 0; i < SENSORS; i++) {
+    expectMeasured(i, true);
+    TEST_ASSERT_EQUAL_UINT32(2, sensors[i]->commands);
+  }
+  TEST_ASSERT_EQUAL_UINT32(0, array->nackCount());
+  TEST_ASSERT_EQUAL_UINT32(0, array->failureCount());
+  TEST_ASSERT_EQUAL_UINT32(SENSORS * 2, array->retries().bucket(0));
+}
+
+// コマンドがNACKになったチャンネルは送り直して測定でき、他のチャンネルは1回で終わる
+void test_command_nack_is_retried(void) {
+  sensors[1]->nack_writes = 2;
+  array->measure(false);
+  for (uint8_t i = 0; i < SENSORS; i++) {
+    expectMeasured(i, false);
+    TEST_ASSERT_EQUAL_UINT32(i == 1 ? 3 : 1, sensors[i]->commands);
+    TEST_ASSERT_EQUAL_UINT32(i == 1 ? 2 : 0, array->device(i).nackCount());
+  }
+  TEST_ASSERT_EQUAL_UINT32(0, array->failureCount());
+  TEST_ASSERT_EQUAL_UINT32(1, array->retries().count() - array->retries().bucket(0));
+}
+
+// 周期の途中でセンサーが外れたら、そのチャンネルだけ MAX_RETRIES 回やり直して諦め、つながれば次の周期から戻る
+void test_sensor_lost_mid_cycle(void) {
+  TEST_ASSERT_TRUE(array->startCycle(true));
+  sensors[2]->model().setConnected(false);
+  array->finishCycle();
+
+  for (uint8_t i = 0; i < SENSORS; i++) {
+    if (i == 2) {
+      continue;
+    }
+    expectMeasured(i, true);
+    TEST_ASSERT_EQUAL_UINT32(0, array->device(i).nackCount());
+  }
+  // measure_iaq の読み取り、measure_raw の送信がともに 1 + MAX_RETRIES 回NACK
+  TEST_ASSERT_FALSE(array->device(2).IAQmeasure());
+  TEST_ASSERT_FALSE(array->device(2).IAQmeasureRaw());
+  TEST_ASSERT_EQUAL_UINT32(2 * (1 + SensorArray::MAX_RETRIES), array->device(2).nackCount());
+  TEST_ASSERT_EQUAL_UINT32(1 + (1 + SensorArray::MAX_RETRIES), sensors[2]->commands);
+  TEST_ASSERT_EQUAL_UINT32(2, array->failureCount());
+
+  sensors[2]->model().setConnected(true);
+  array->measure(true);
+  for (uint8_t i = 0; i < SENSORS; i++) {
+    expectMeasured(i, true);
+  }
+  TEST_ASSERT_EQUAL_UINT32(2, array->failureCount());
+}
+
+// 読み取りがCRCエラーなら結果は失われているので、そのチャンネルだけコマンドから送り直す
+void test_crc_error_resends_command(void) {
+  sensors[3]->corrupt_reads = 1;
+  array->measure(false);
+  for (uint8_t i = 0; i < SENSORS; i++) {
+    expectMeasured(i, false);
+    TEST_ASSERT_EQUAL_UINT32(i == 3 ? 2 : 1, sensors[i]->commands);
+    TEST_ASSERT_EQUAL_UINT32(i == 3 ? 1 : 0, array->device(i).crcErrorCount());
+  }
+  TEST_ASSERT_EQUAL_UINT32(0, array->nackCount());
+  TEST_ASSERT_EQUAL_UINT32(0, array->failureCount());
+}
+
+// CRCエラーが続けば各段階 1 + MAX_RETRIES 回送って諦め、次の周期は通常どおり
+void test_persistent_crc_error_gives_up(void) {
+  sensors[3]->corrupt_reads = UINT32_MAX;
+  array->measure(true);
+  for (uint8_t i = 0; i < 3; i++) {
+    expectMeasured(i, true);
+  }
+  TEST_ASSERT_FALSE(array->device(3).IAQmeasure());
+  TEST_ASSERT_FALSE(array->device(3).IAQmeasureRaw());
+  TEST_ASSERT_EQUAL_UINT32(2 * (1 + SensorArray::MAX_RETRIES), sensors[3]->commands);
+  TEST_ASSERT_EQUAL_UINT32(2 * (1 + SensorArray::MAX_RETRIES), array->crcErrorCount());
+  TEST_ASSERT_EQUAL_UINT32(2, array->failureCount());
+
+  sensors[3]->corrupt_reads = 0;
+  array->measure(true);
+  for (uint8_t i = 0; i < SENSORS; i++) {
+    expectMeasured(i, true);
+  }
+  TEST_ASSERT_EQUAL_UINT32(2, array->failureCount());
+}
+
+// 測定時間を過ぎても終わらない個体は読み取りがNACKになり、コマンドを送り直さずに少し後に読み直す
+void test_slow_sensor_is_reread(void) {
+  sensors[0]->setExtraDelay(SensorArray::RETRY_INTERVAL_US);
+  TEST_ASSERT_TRUE(array->startCycle(false));
+  unsigned long wait;
+  bool others_first = false;
+  while ((wait = array->poll()) > 0) {
+    // 他のチャンネルは遅い個体を待たずに読み取る
+    if (sensors[SENSORS - 1]->last_iaq[0] != 0 && sensors[0]->last_iaq[0] == 0) {
+      others_first = true;
+    }
+    delay(wait);
+  }
+  TEST_ASSERT_TRUE(others_first);
+  for (uint8_t i = 0; i < SENSORS; i++) {
+    expectMeasured(i, false);
+    TEST_ASSERT_EQUAL_UINT32(1, sensors[i]->commands);
+  }
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(1, array->device(0).nackCount());
+  TEST_ASSERT_EQUAL_UINT32(array->device(0).nackCount(), array->nackCount());
+  TEST_ASSERT_EQUAL_UINT32(0, array->failureCount());
+  TEST_ASSERT_EQUAL_UINT32(SENSORS - 1, array->retries().bucket(0));
+}
+
+int main(int argc, char** argv) {
+  Serial.setQuiet(true);
+  UNITY_BEGIN();
+  RUN_TEST(test_all_channels_sample);
+  RUN_TEST(test_command_nack_is_retried);
+  RUN_TEST(test_sensor_lost_mid_cycle);
+  RUN_TEST(test_crc_error_resends_command);
+  RUN_TEST(test_persistent_crc_error_gives_up);
+  RUN_TEST(test_slow_sensor_is_reread);
+  return UNITY_END();
+}
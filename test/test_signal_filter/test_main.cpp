@@ -0,0 +1,220 @@
+// SignalFilter・SignalChain・SignalRate の固定の出力と、素直な実装（並べ替え・浮動小数点）との比較
+// （入力はゆっくりした変化・ノイズ・スパイク・ガスの急な変化、乱数は固定の系列）
+//   pio test -e native -f test_signal_filter
+#include <unity.h>
+#include <SignalFilter.h>
+#include <stdlib.h>
+
+static const uint32_t REFERENCE_SAMPLES = 100000;
+
+// ゆっくりした変化 + ±4 のノイズ + 97サンプルごとのスパイク
+// + 2000サンプルごとの急な低下（60サンプルで600下がり、500サンプル後に同じ速さで戻る）
+static uint16_t signalInput(uint32_t i, uint32_t& random_state) {
+  random_state ^= random_state << 13;
+  random_state ^= random_state >> 17;
+  random_state ^= random_state << 5;
+  double base = 13500 + 300 * sin(i * 2 * M_PI / 600);
+  uint32_t phase = i % 2000;
+  if (phase >= 1000 && phase < 1060) {
+    base -= (phase - 1000) * 10.0;
+  } else if (phase >= 1060 && phase < 1500) {
+    base -= 600;
+  } else if (phase >= 1500 && phase < 1560) {
+    base -= (1560 - phase) * 10.0;
+  }
+  uint16_t value = (uint16_t)lround(base);
+  value = (uint16_t)(value + (int)(random_state % 9) - 4);
+  if (i % 97 == 50) {
+    value = (uint16_t)(value + (i % 2 == 0 ? 400 : -400));
+  }
+  return value;
+}
+
+static void sortValues(uint16_t* values, size_t count) {
+  for (size_t i = 1; i < count; i++) {
+    for (size_t j = i; j > 0 && values[j - 1] > values[j]; j--) {
+      uint16_t value = values[j];
+      values[j] = values[j - 1];
+      values[j - 1] = value;
+    }
+  }
+}
+
+// 窓の値を並べ替えて中央値を求める（SignalFilter と同じく偶数個なら上側）
+static uint16_t referenceMedian(const uint16_t* window, size_t count, uint16_t* deviation) {
+  uint16_t sorted[SignalFilter::MAX_WINDOW];
+  memcpy(sorted, window, count * sizeof(uint16_t));
+  sortValues(sorted, count);
+  uint16_t center = sorted[count / 2];
+  uint16_t deviations[SignalFilter::MAX_WINDOW];
+  for (size_t i = 0; i < count; i++) {
+    deviations[i] = (uint16_t)abs((int)window[i] - center);
+  }
+  sortValues(deviations, count);
+  *deviation = deviations[count / 2];
+  return center;
+}
+
+// 処理段1つを素直な実装と比べる（違ったサンプルの数と最初の位置）
+static void compareWithReference(const SignalFilterConfig& config, uint32_t& mismatches, uint32_t& first) {
+  SignalFilter filter;
+  filter.configure(config);
+  uint16_t window[SignalFilter::MAX_WINDOW];
+  size_t count = 0;
+  double ema = 0;
+  uint32_t random_state = 88172645;
+  mismatches = 0;
+  first = 0;
+
+  for (uint32_t i = 0; i < REFERENCE_SAMPLES; i++) {
+    uint16_t value = signalInput(i, random_state);
+    uint16_t actual = filter.apply(value);
+    int expected = value;
+    int tolerance = 0;
+
+    if (config.type == SIGNAL_FILTER_MEDIAN || config.type == SIGNAL_FILTER_HAMPEL) {
+      if (count == config.window) {
+        memmove(window, window + 1, (count - 1) * sizeof(uint16_t));
+        count--;
+      }
+      window[count++] = value;
+      uint16_t deviation;
+      uint16_t center = referenceMedian(window, count, &deviation);
+      if (config.type == SIGNAL_FILTER_MEDIAN) {
+        expected = center;
+      } else {
+        double limit = deviation * config.param / 10.0 * 759 / 512;
+        limit = limit > SignalFilter::HAMPEL_MIN_LIMIT ? floor(limit) : SignalFilter::HAMPEL_MIN_LIMIT;
+        // 窓の時間的な中央のサンプルを判定する
+        int candidate = window[(count - 1) / 2];
+        expected = abs(candidate - center) > limit ? center : candidate;
+      }
+    } else if (config.type == SIGNAL_FILTER_EMA) {
+      ema = i == 0 ? value : ema + (value - ema) / (1 << config.param);
+      expected = (int)lround(ema);
+      tolerance = 1;   // 固定小数点の切り捨て
+    }
+
+    if (abs(actual - expected) > tolerance) {
+      if (mismatches == 0) {
+        first = i;
+      }
+      mismatches++;
+    }
+  }
+}
+
+// 固定の入力に対する出力（変更したら意図した変化か確認して更新する）
+static const uint16_t INPUT[] = {
+  13500, 13502, 13498, 13501, 13900, 13499, 13503, 13500, 13497, 13100,
+  13502, 13400, 13390, 13385, 13380, 13382, 13379, 13381, 13378, 13380
+};
+static const size_t LENGTH = sizeof(INPUT) / sizeof(INPUT[0]);
+
+static void expectGolden(const char* spec, const uint16_t* output) {
+  SignalChainConfig config = {};
+  SignalChain chain;
+  TEST_ASSERT_TRUE(parseSignalChain(spec, config));
+  TEST_ASSERT_TRUE(chain.configure(config));
+  for (size_t i = 0; i < LENGTH; i++) {
+    TEST_ASSERT_EQUAL_UINT16(output[i], chain.apply((uint32_t)i * 1000, INPUT[i]));
+  }
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void test_golden_hampel(void) {
+  static const uint16_t output[LENGTH] = {
+    13500, 13500, 13502, 13502, 13498, 13501, 13501, 13499, 13503, 13500,
+    13497, 13497, 13502, 13400, 13390, 13385, 13380, 13382, 13379, 13381
+  };
+  expectGolden("hampel:5:30", output);
+}
+
+void test_golden_median(void) {
+  static const uint16_t output[LENGTH] = {
+    13500, 13502, 13500, 13501, 13501, 13501, 13501, 13501, 13500, 13499,
+    13500, 13497, 13400, 13390, 13390, 13385, 13382, 13381, 13380, 13380
+  };
+  expectGolden("median:5", output);
+}
+
+void test_golden_ema(void) {
+  static const uint16_t output[LENGTH] = {
+    13500, 13501, 13500, 13500, 13600, 13575, 13557, 13543, 13531, 13423,
+    13443, 13432, 13422, 13413, 13404, 13399, 13394, 13391, 13387, 13386
+  };
+  expectGolden("ema:2", output);
+}
+
+void test_golden_chain(void) {
+  static const uint16_t output[LENGTH] = {
+    13500, 13500, 13501, 13501, 13500, 13500, 13501, 13500, 13501, 13501,
+    13500, 13499, 13500, 13475, 13454, 13436, 13422, 13412, 13404, 13398
+  };
+  expectGolden("hampel:5:30,ema:2", output);
+}
+
+// 長い入力で素直な実装と比べる
+void test_matches_reference(void) {
+  static const SignalFilterConfig references[] = {
+    { SIGNAL_FILTER_MEDIAN, 3, 0 }, { SIGNAL_FILTER_MEDIAN, 9, 0 },
+    { SIGNAL_FILTER_HAMPEL, 5, 30 }, { SIGNAL_FILTER_HAMPEL, 9, 20 },
+    { SIGNAL_FILTER_EMA, 0, 1 }, { SIGNAL_FILTER_EMA, 0, 8 },
+  };
+  for (const SignalFilterConfig& config : references) {
+    uint32_t mismatches;
+    uint32_t first;
+    compareWithReference(config, mismatches, first);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, first, "first mismatching sample");
+    TEST_ASSERT_EQUAL_UINT32(0, mismatches);
+  }
+}
+
+// 1秒ごとに一定の傾きで下がる入力では傾きそのもの、検出は1回だけ
+void test_rate_of_change(void) {
+  SignalRate rate;
+  rate.configure(30, 300);
+  for (uint32_t i = 0; i < 200; i++) {
+    uint16_t value = (uint16_t)(i < 100 ? 15000 - i * 10 : 14000);
+    int expected = i < 30 ? 0 : (i < 100 ? -600 : (i < 130 ? -(int)(130 - i) * 20 : 0));
+    TEST_ASSERT_EQUAL_INT(expected, rate.update(i * 1000, value));
+  }
+  TEST_ASSERT_EQUAL_UINT32(1, rate.events());
+  TEST_ASSERT_FALSE(rate.active());
+}
+
+// 設定の文字列（有効なものは書式化して読み直すと同じ設定）
+void test_chain_specs(void) {
+  static const struct { const char* spec; bool valid; } specs[] = {
+    { SIGNAL_CHAIN_DEFAULT, true }, { "none", true }, { "", true }, { "median:9,ema:8,rate:60:1", true },
+    { "median:4", false }, { "median:11", false }, { "hampel:7", false }, { "ema:0", false }, { "ema:9", false },
+    { "rate:61:300", false }, { "median:3,median:3,median:3,median:3,median:3", false }, { "spline:3", false },
+  };
+  for (const auto& spec : specs) {
+    SignalChainConfig config = {};
+    TEST_ASSERT_EQUAL_MESSAGE(spec.valid, parseSignalChain(spec.spec, config), spec.spec);
+    if (!spec.valid) {
+      continue;
+    }
+    char text[64];
+    formatSignalChain(config, text, sizeof(text));
+    SignalChainConfig again = {};
+    TEST_ASSERT_TRUE(parseSignalChain(text, again));
+    TEST_ASSERT_EQUAL_MEMORY(&config, &again, sizeof(config));
+  }
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_golden_hampel);
+  RUN_TEST(test_golden_median);
+  RUN_TEST(test_golden_ema);
+  RUN_TEST(test_golden_chain);
+  RUN_TEST(test_matches_reference);
+  RUN_TEST(test_rate_of_change);
+  RUN_TEST(test_chain_specs);
+  return UNITY_END();
+}
@@ -0,0 +1,191 @@
+// SpscQueue を2つのスレッドから同時に使い、全件が一度ずつ順番どおりに届くことの確認
+// （センサータスク・描画タスク間の sample / button / ui_event / point キューと同じ型・容量）
+//   pio test -e native -f test_spsc_queue
+#include <unity.h>
+#include <SpscQueue.h>
+#include <SensorManager.h>
+#include <atomic>
+#include <thread>
+
+static const uint32_t ITEMS = 200000;
+
+// ボタン操作・操作結果の表示のイベント（main.cpp の ButtonEvent / UiEvent と同じ大きさ）
+struct TestButtonEvent {
+  uint8_t value;
+};
+
+struct TestUiEvent {
+  uint8_t type;
+  uint8_t verdict;
+  uint16_t eco2_base;
+  uint16_t tvoc_base;
+};
+
+// 通し番号 seq からすべてのフィールドを決め、途中で書き換わった（ちぎれた）要素を検出する
+static void makeItem(uint32_t seq, SensorSample& item) {
+  memset(&item, 0, sizeof(item));
+  item.timestamp = seq;
+  item.tvoc = (uint16_t)seq;
+  item.eco2 = (uint16_t)~seq;
+  item.raw_ethanol = (uint16_t)(seq >> 3);
+  item.signal_spikes = seq * 3;
+  item.clean_air_remaining = (uint16_t)(seq >> 16);
+}
+
+static bool matches(uint32_t seq, const SensorSample& item) {
+  return item.timestamp == seq && item.tvoc == (uint16_t)seq && item.eco2 == (uint16_t)~seq &&
+         item.raw_ethanol == (uint16_t)(seq >> 3) && item.signal_spikes == seq * 3 &&
+         item.clean_air_remaining == (uint16_t)(seq >> 16);
+}
+
+static void makeItem(uint32_t seq, SensorPoint& item) {
+  memset(&item, 0, sizeof(item));
+  item.timestamp = seq;
+  item.sensor = (uint8_t)(seq % 8);
+  item.connected = (seq & 1) != 0;
+  item.tvoc = (uint16_t)seq;
+  item.tvoc_base = (uint16_t)~seq;
+}
+
+static bool matches(uint32_t seq, const SensorPoint& item) {
+  return item.timestamp == seq && item.sensor == (uint8_t)(seq % 8) && item.connected == ((seq & 1) != 0) &&
+         item.tvoc == (uint16_t)seq && item.tvoc_base == (uint16_t)~seq;
+}
+
+static void makeItem(uint32_t seq, TestButtonEvent& item) {
+  item.value = (uint8_t)seq;
+}
+
+static bool matches(uint32_t seq, const TestButtonEvent& item) {
+  return item.value == (uint8_t)seq;
+}
+
+static void makeItem(uint32_t seq, TestUiEvent& item) {
+  item.type = (uint8_t)seq;
+  item.verdict = (uint8_t)(seq >> 8);
+  item.eco2_base = (uint16_t)seq;
+  item.tvoc_base = (uint16_t)(seq >> 16);
+}
+
+static bool matches(uint32_t seq, const TestUiEvent& item) {
+  return item.type == (uint8_t)seq && item.verdict == (uint8_t)(seq >> 8) && item.eco2_base == (uint16_t)seq &&
+         item.tvoc_base == (uint16_t)(seq >> 16);
+}
+
+// 生産者は満杯なら空くまで待って ITEMS 件を送り、消費者は ITEMS 件を受け取るまで読み続ける
+template <typename T, size_t CAPACITY>
+static void checkLossless() {
+  static SpscQueue<T, CAPACITY> queue;
+  uint32_t received = 0;
+  uint32_t mismatches = 0;
+
+  std::thread producer([]() {
+    T item;
+    for (uint32_t seq = 0; seq < ITEMS; seq++) {
+      makeItem(seq, item);
+      while (!queue.push(item)) {
+        std::this_thread::yield();
+      }
+    }
+  });
+  std::thread consumer([&received, &mismatches]() {
+    T item;
+    while (received < ITEMS) {
+      if (!queue.pop(item)) {
+        std::this_thread::yield();
+        continue;
+      }
+      if (!matches(received, item)) {
+        mismatches++;
+      }
+      received++;
+    }
+  });
+  producer.join();
+  consumer.join();
+
+  TEST_ASSERT_EQUAL_UINT32(ITEMS, received);
+  TEST_ASSERT_EQUAL_UINT32(0, mismatches);
+  TEST_ASSERT_TRUE(queue.empty());
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_sample_queue(void) {
+  checkLossless<SensorSample, 16>();
+}
+
+void test_button_queue(void) {
+  checkLossless<TestButtonEvent, 8>();
+}
+
+void test_ui_event_queue(void) {
+  checkLossless<TestUiEvent, 8>();
+}
+
+void test_point_queue(void) {
+  checkLossless<SensorPoint, 32>();
+}
+
+void test_full_queue_drops_newest(void) {
+  // 生産者は待たずに送る（センサータスクと同じ）：届いた要素は順番どおりで、欠けた分は droppedCount() と一致する
+  static SpscQueue<SensorSample, 16> queue;
+  std::atomic<bool> done(false);
+  uint32_t accepted = 0;
+  uint32_t received = 0;
+  uint32_t out_of_order = 0;
+  uint32_t torn = 0;
+
+  std::thread producer([&accepted, &done]() {
+    SensorSample item;
+    for (uint32_t seq = 0; seq < ITEMS; seq++) {
+      makeItem(seq, item);
+      if (queue.push(item)) {
+        accepted++;
+      }
+    }
+    done.store(true, std::memory_order_release);
+  });
+  std::thread consumer([&received, &out_of_order, &torn, &done]() {
+    SensorSample item;
+    int64_t last = -1;
+    for (;;) {
+      // 終了を確認してから読むので、終了後に残った要素も読み切る
+      bool finished = done.load(std::memory_order_acquire);
+      if (!queue.pop(item)) {
+        if (finished) {
+          break;
+        }
+        std::this_thread::yield();
+        continue;
+      }
+      if (!matches(item.timestamp, item)) {
+        torn++;
+      }
+      if ((int64_t)item.timestamp <= last) {
+        out_of_order++;
+      }
+      last = item.timestamp;
+      received++;
+    }
+  });
+  producer.join();
+  consumer.join();
+
+  TEST_ASSERT_EQUAL_UINT32(0, torn);
+  TEST_ASSERT_EQUAL_UINT32(0, out_of_order);
+  TEST_ASSERT_EQUAL_UINT32(accepted, received);
+  TEST_ASSERT_EQUAL_UINT32(ITEMS, accepted + queue.droppedCount());
+  TEST_ASSERT_TRUE(queue.empty());
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_sample_queue);
+  RUN_TEST(test_button_queue);
+  RUN_TEST(test_ui_event_queue);
+  RUN_TEST(test_point_queue);
+  RUN_TEST(test_full_queue_drops_newest);
+  return UNITY_END();
+}
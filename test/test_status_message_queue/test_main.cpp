@@ -0,0 +1,145 @@
+// StatusMessageQueue の優先度の順番・表示期限・表示し続けるメッセージの置き換えの確認
+// （時刻は current() に渡す値で進める）
+//   pio test -e native -f test_status_message_queue
+#include <unity.h>
+#include <StatusMessageQueue.h>
+
+static StatusMessageQueue queue;
+
+static const char* textAt(unsigned long now) {
+  const StatusMessage* message = queue.current(now);
+  return message ? message->text : "";
+}
+
+void setUp(void) {
+  queue.clear();
+}
+
+void tearDown(void) {}
+
+void test_priority_order(void) {
+  queue.post("info", 0, MESSAGE_INFO, 1000);
+  queue.post("error", 0, MESSAGE_ERROR, 1000);
+  queue.post("warning", 0, MESSAGE_WARNING, 1000);
+
+  // 優先度の高い順に、それぞれ表示され始めてから1秒
+  TEST_ASSERT_EQUAL_STRING("error", textAt(0));
+  TEST_ASSERT_EQUAL_STRING("error", textAt(999));
+  TEST_ASSERT_EQUAL_STRING("warning", textAt(1000));
+  TEST_ASSERT_EQUAL_STRING("info", textAt(2000));
+  TEST_ASSERT_EQUAL_STRING("", textAt(3000));
+}
+
+void test_same_priority_is_fifo(void) {
+  queue.post("first", 0, MESSAGE_INFO, 500);
+  queue.post("second", 0, MESSAGE_INFO, 500);
+  TEST_ASSERT_EQUAL_STRING("first", textAt(100));
+  TEST_ASSERT_EQUAL_STRING("second", textAt(600));
+  TEST_ASSERT_EQUAL_STRING("", textAt(1100));
+}
+
+void test_duration_starts_when_shown(void) {
+  queue.post("error", 0, MESSAGE_ERROR, 2000);
+  queue.post("later", 0, MESSAGE_INFO, 1000);
+  TEST_ASSERT_EQUAL_STRING("error", textAt(0));
+
+  // 待っている間は期限が進まない
+  TEST_ASSERT_EQUAL_STRING("later", textAt(5000));
+  TEST_ASSERT_EQUAL_STRING("later", textAt(5999));
+  TEST_ASSERT_EQUAL_STRING("", textAt(6000));
+}
+
+void test_persistent_waits_behind_timed(void) {
+  queue.post("persistent", 0, MESSAGE_INFO, 0);
+  queue.post("toast", 0, MESSAGE_INFO, 1000);
+  TEST_ASSERT_EQUAL_STRING("toast", textAt(0));
+  TEST_ASSERT_EQUAL_STRING("persistent", textAt(1000));
+  TEST_ASSERT_EQUAL_STRING("persistent", textAt(100000));
+}
+
+void test_persistent_replaces_persistent(void) {
+  uint32_t first = queue.post("first", 0, MESSAGE_INFO, 0);
+  TEST_ASSERT_EQUAL_STRING("first", textAt(0));
+  uint32_t second = queue.post("second", 0, MESSAGE_WARNING, 0);
+  TEST_ASSERT_NOT_EQUAL(first, second);
+  TEST_ASSERT_EQUAL_STRING("second", textAt(10));
+
+  // 置き換えられたメッセージは書き換え・削除できない
+  TEST_ASSERT_FALSE(queue.replace(first, "stale"));
+  queue.remove(first);
+  TEST_ASSERT_EQUAL_STRING("second", textAt(20));
+}
+
+void test_replace_in_place(void) {
+  uint32_t id = queue.post("count 3", 0, MESSAGE_INFO, 0);
+  const StatusMessage* message = queue.current(0);
+  TEST_ASSERT_EQUAL_UINT32(id, message->id);
+  TEST_ASSERT_EQUAL_UINT16(0, message->revision);
+
+  // 番号はそのままで版が進む（同じ文字列なら進まない）
+  TEST_ASSERT_TRUE(queue.replace(id, "count 2"));
+  message = queue.current(1000);
+  TEST_ASSERT_EQUAL_UINT32(id, message->id);
+  TEST_ASSERT_EQUAL_UINT16(1, message->revision);
+  TEST_ASSERT_EQUAL_STRING("count 2", message->text);
+  TEST_ASSERT_TRUE(queue.replace(id, "count 2"));
+  TEST_ASSERT_EQUAL_UINT16(1, queue.current(1500)->revision);
+
+  // 1秒ごとに書き換えてもキューは1件のまま（時間指定のメッセージは満杯にならずに入る）
+  for (int i = 0; i < 2 * StatusMessageQueue::CAPACITY; i++) {
+    TEST_ASSERT_TRUE(queue.replace(id, i % 2 ? "odd" : "even"));
+  }
+  for (int i = 0; i < StatusMessageQueue::CAPACITY - 1; i++) {
+    TEST_ASSERT_NOT_EQUAL(0, queue.post("toast", 0, MESSAGE_INFO, 100));
+  }
+}
+
+void test_remove(void) {
+  uint32_t countdown = queue.post("countdown", 0, MESSAGE_INFO, 0);
+  queue.post("toast", 0, MESSAGE_INFO, 1000);
+  TEST_ASSERT_EQUAL_STRING("toast", textAt(0));
+  queue.remove(countdown);
+  TEST_ASSERT_EQUAL_STRING("toast", textAt(500));
+  TEST_ASSERT_EQUAL_STRING("", textAt(1000));
+  TEST_ASSERT_FALSE(queue.replace(countdown, "gone"));
+}
+
+void test_full_queue_evicts_lowest_oldest(void) {
+  for (int i = 0; i < StatusMessageQueue::CAPACITY; i++) {
+    TEST_ASSERT_NOT_EQUAL(0, queue.post(i == 0 ? "oldest" : "info", 0, MESSAGE_INFO, 1000));
+  }
+  // 満杯でも優先度の高いメッセージは最も古い低い優先度のメッセージを置き換える
+  TEST_ASSERT_NOT_EQUAL(0, queue.post("error", 0, MESSAGE_ERROR, 1000));
+  TEST_ASSERT_EQUAL_STRING("error", textAt(0));
+  TEST_ASSERT_EQUAL_STRING("info", textAt(1000));
+
+  // 低い優先度のメッセージは高い優先度のメッセージを置き換えない
+  queue.clear();
+  for (int i = 0; i < StatusMessageQueue::CAPACITY; i++) {
+    queue.post("error", 0, MESSAGE_ERROR, 1000);
+  }
+  TEST_ASSERT_EQUAL_UINT32(0, queue.post("info", 0, MESSAGE_INFO, 1000));
+}
+
+void test_wraparound_clock(void) {
+  // millis() の折り返しをまたいでも表示時間を守る
+  const unsigned long start = (unsigned long)-500;
+  queue.post("wrap", 0, MESSAGE_INFO, 1000);
+  TEST_ASSERT_EQUAL_STRING("wrap", textAt(start));
+  TEST_ASSERT_EQUAL_STRING("wrap", textAt(start + 999));
+  TEST_ASSERT_EQUAL_STRING("", textAt(start + 1000));
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_priority_order);
+  RUN_TEST(test_same_priority_is_fifo);
+  RUN_TEST(test_duration_starts_when_shown);
+  RUN_TEST(test_persistent_waits_behind_timed);
+  RUN_TEST(test_persistent_replaces_persistent);
+  RUN_TEST(test_replace_in_place);
+  RUN_TEST(test_remove);
+  RUN_TEST(test_full_queue_evicts_lowest_oldest);
+  RUN_TEST(test_wraparound_clock);
+  return UNITY_END();
+}
@@ -0,0 +1,166 @@
+// TickScheduler の周期のずれ・遅延時の飛ばし・待ち時間の上限の確認
+// （時計は仮想時刻、runDue() の返す待ち時間だけ進める）
+//   pio test -e native -f test_tick_scheduler
+#include <unity.h>
+#include <TickScheduler.h>
+
+static unsigned long fake_us = 0;
+static unsigned long millis_offset = 0;   // millis() の一周を試す場合のずれ
+
+static unsigned long fakeMillis() {
+  return millis_offset + fake_us / 1000;
+}
+
+static unsigned long fakeMicros() {
+  return fake_us;
+}
+
+// ジョブの処理時間と実行の記録
+struct JobLog {
+  unsigned long work_us;      // 実行するたびに時計を進める
+  uint32_t runs;
+  unsigned long first_ms;
+  unsigned long last_ms;
+};
+
+static void recordJob(void* context) {
+  JobLog* log = static_cast<JobLog*>(context);
+  if (log->runs == 0) {
+    log->first_ms = fakeMillis();
+  }
+  log->last_ms = fakeMillis();
+  log->runs++;
+  fake_us += log->work_us;
+}
+
+// end_ms まで runDue() を繰り返す（待ち時間は上限を超えない）
+static void runUntil(TickScheduler& scheduler, unsigned long end_ms) {
+  while (fakeMillis() < end_ms) {
+    unsigned long wait = scheduler.runDue();
+    TEST_ASSERT_TRUE(wait <= TickScheduler::MAX_WAIT);
+    unsigned long remaining = end_ms - fakeMillis();
+    fake_us += (wait < remaining ? wait : remaining) * 1000;
+  }
+}
+
+void setUp(void) {
+  fake_us = 0;
+  millis_offset = 0;
+}
+
+void tearDown(void) {}
+
+void test_24h_without_drift(void) {
+  TickScheduler scheduler(fakeMillis, fakeMicros);
+  JobLog sample = { 3000, 0, 0, 0 };      // 1秒ごと、3 ms かかる
+  JobLog buttons = { 100, 0, 0, 0 };      // 20 ms ごと
+  JobLog check = { 11000, 0, 0, 0 };      // 1分ごと、500 ms ずらして開始
+  JobLog snapshot = { 0, 0, 0, 0 };       // 5分ごと、最初は5分後
+  scheduler.addPeriodic("sample", 1000, recordJob, &sample);
+  scheduler.addPeriodic("buttons", 20, recordJob, &buttons);
+  scheduler.addPeriodic("check", 60000, recordJob, &check, 500);
+  scheduler.addPeriodic("snapshot", 300000, recordJob, &snapshot, 300000);
+
+  const unsigned long day_ms = 24UL * 3600 * 1000;
+  runUntil(scheduler, day_ms);
+
+  // 処理時間があっても予定時刻から数えるので回数・最後の時刻がずれない
+  TEST_ASSERT_EQUAL_UINT32(86400, sample.runs);
+  TEST_ASSERT_EQUAL_UINT32(0, sample.first_ms);
+  TEST_ASSERT_TRUE(day_ms - 1000 <= sample.last_ms && sample.last_ms < day_ms - 1000 + 20);
+  TEST_ASSERT_EQUAL_UINT32(day_ms / 20, buttons.runs);
+  TEST_ASSERT_EQUAL_UINT32(1440, check.runs);
+  TEST_ASSERT_EQUAL_UINT32(500, check.first_ms);
+  TEST_ASSERT_EQUAL_UINT32(287, snapshot.runs);
+  TEST_ASSERT_TRUE(snapshot.first_ms - 300000 <= 15);
+
+  // 遅れは同じ時刻の他のジョブの処理時間の分だけ
+  for (int id = 0; id < 4; id++) {
+    const JobStats* stats = scheduler.stats(id);
+    TEST_ASSERT_EQUAL_UINT32(0, stats->skipped);
+    TEST_ASSERT_TRUE(stats->max_jitter_ms <= 15);
+  }
+  TEST_ASSERT_EQUAL_UINT32(3000, scheduler.stats(0)->max_us);
+}
+
+void test_overrun_skips_periods(void) {
+  TickScheduler scheduler(fakeMillis, fakeMicros);
+  JobLog slow = { 0, 0, 0, 0 };
+  int id = scheduler.addPeriodic("slow", 100, recordJob, &slow);
+  runUntil(scheduler, 1000);
+  TEST_ASSERT_EQUAL_UINT32(10, slow.runs);
+
+  // 1回だけ 250 ms かかると、過ぎた周期は続けて実行せずに飛ばす
+  slow.work_us = 250000;
+  scheduler.runDue();
+  slow.work_us = 0;
+  TEST_ASSERT_EQUAL_UINT32(2, scheduler.stats(id)->skipped);
+  TEST_ASSERT_EQUAL_UINT32(1300, fakeMillis() + scheduler.runDue());   // 次は予定時刻どおり
+  runUntil(scheduler, 2000);
+  TEST_ASSERT_EQUAL_UINT32(18, slow.runs);
+}
+
+void test_one_shot_and_cancel(void) {
+  TickScheduler scheduler(fakeMillis, fakeMicros);
+  JobLog once = { 0, 0, 0, 0 };
+  JobLog cancelled = { 0, 0, 0, 0 };
+  scheduler.addOneShot("once", 250, recordJob, &once);
+  int id = scheduler.addPeriodic("cancelled", 100, recordJob, &cancelled);
+  runUntil(scheduler, 350);
+  scheduler.cancel(id);
+  runUntil(scheduler, 2000);
+
+  TEST_ASSERT_EQUAL_UINT32(1, once.runs);
+  TEST_ASSERT_EQUAL_UINT32(250, once.first_ms);
+  TEST_ASSERT_EQUAL_UINT32(4, cancelled.runs);
+}
+
+void test_wait_is_capped(void) {
+  TickScheduler scheduler(fakeMillis, fakeMicros);
+  // ジョブがなくても上限で戻る（以前は 0xFFFFFFFF を返し、ティックへの変換で桁あふれした）
+  TEST_ASSERT_EQUAL_UINT32(TickScheduler::MAX_WAIT, scheduler.runDue());
+
+  JobLog hourly = { 0, 0, 0, 0 };
+  scheduler.addPeriodic("hourly", 3600000, recordJob, &hourly, 3600000);
+  TEST_ASSERT_EQUAL_UINT32(TickScheduler::MAX_WAIT, scheduler.runDue());
+  runUntil(scheduler, 3600000 - 100);
+  TEST_ASSERT_EQUAL_UINT32(100, scheduler.runDue());
+  TEST_ASSERT_EQUAL_UINT32(0, hourly.runs);
+  runUntil(scheduler, 3600000 + 1);
+  TEST_ASSERT_EQUAL_UINT32(1, hourly.runs);
+}
+
+void test_full_scheduler(void) {
+  TickScheduler scheduler(fakeMillis, fakeMicros);
+  JobLog log = { 0, 0, 0, 0 };
+  for (int i = 0; i < TickScheduler::MAX_JOBS; i++) {
+    TEST_ASSERT_EQUAL_INT(i, scheduler.addPeriodic("job", 1000, recordJob, &log));
+  }
+  TEST_ASSERT_EQUAL_INT(-1, scheduler.addPeriodic("extra", 1000, recordJob, &log));
+  TEST_ASSERT_EQUAL_INT(-1, scheduler.addOneShot("extra", 1000, recordJob, &log));
+}
+
+void test_clock_wraparound(void) {
+  millis_offset = (unsigned long)-5000;   // 5秒後に millis() が一周する
+  TickScheduler scheduler(fakeMillis, fakeMicros);
+  JobLog sample = { 0, 0, 0, 0 };
+  scheduler.addPeriodic("sample", 1000, recordJob, &sample);
+  for (int i = 0; i < 10; i++) {
+    unsigned long wait = scheduler.runDue();
+    TEST_ASSERT_TRUE(wait <= 1000);
+    fake_us += wait * 1000;
+  }
+  TEST_ASSERT_EQUAL_UINT32(10, sample.runs);
+  TEST_ASSERT_EQUAL_UINT32(0, scheduler.stats(0)->skipped);
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_24h_without_drift);
+  RUN_TEST(test_overrun_skips_periods);
+  RUN_TEST(test_one_shot_and_cancel);
+  RUN_TEST(test_wait_is_capped);
+  RUN_TEST(test_full_scheduler);
+  RUN_TEST(test_clock_wraparound);
+  return UNITY_END();
+}
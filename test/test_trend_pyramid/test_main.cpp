@@ -0,0 +1,125 @@
+// TrendPyramid の分 → 15分 → 時間 の伝搬とバケットの確定の確認
+//   pio test -e native -f test_trend_pyramid
+#include <unity.h>
+#include <TrendPyramid.h>
+
+// 1秒ごとのサンプル i の値（バケットごとに最小・最大・平均が変わる）
+static uint16_t tvocAt(uint32_t i) {
+  return (uint16_t)(100 + (i * 37) % 251);
+}
+
+static uint16_t eco2At(uint32_t i) {
+  return (uint16_t)(400 + i / 7);
+}
+
+static void addSeconds(TrendPyramid& pyramid, uint32_t first, uint32_t count) {
+  for (uint32_t i = first; i < first + count; i++) {
+    pyramid.add(i * 1000, tvocAt(i), eco2At(i));
+  }
+}
+
+// サンプル first から count 個を直接集計した値とバケットを比べる
+static void checkBucket(const TrendBucket& bucket, uint32_t first, uint32_t count) {
+  uint16_t tvoc_min = UINT16_MAX, tvoc_max = 0, eco2_min = UINT16_MAX, eco2_max = 0;
+  uint32_t tvoc_sum = 0, eco2_sum = 0;
+  for (uint32_t i = first; i < first + count; i++) {
+    uint16_t tvoc = tvocAt(i);
+    uint16_t eco2 = eco2At(i);
+    tvoc_min = tvoc < tvoc_min ? tvoc : tvoc_min;
+    tvoc_max = tvoc > tvoc_max ? tvoc : tvoc_max;
+    eco2_min = eco2 < eco2_min ? eco2 : eco2_min;
+    eco2_max = eco2 > eco2_max ? eco2 : eco2_max;
+    tvoc_sum += tvoc;
+    eco2_sum += eco2;
+  }
+  TEST_ASSERT_EQUAL_UINT32(first * 1000, bucket.timestamp);
+  TEST_ASSERT_EQUAL_UINT16(tvoc_min, bucket.tvoc_min);
+  TEST_ASSERT_EQUAL_UINT16(tvoc_max, bucket.tvoc_max);
+  TEST_ASSERT_EQUAL_UINT16(tvoc_sum / count, bucket.tvoc_mean);
+  TEST_ASSERT_EQUAL_UINT16(eco2_min, bucket.eco2_min);
+  TEST_ASSERT_EQUAL_UINT16(eco2_max, bucket.eco2_max);
+  TEST_ASSERT_EQUAL_UINT16(eco2_sum / count, bucket.eco2_mean);
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_minute_rollover(void) {
+  static TrendPyramid pyramid;   // 約5 KB、スタックに載せない
+  const TrendLevel& minutes = pyramid.level(TrendPyramid::LEVEL_MINUTE);
+
+  // 60秒目のサンプルまでは集計中
+  addSeconds(pyramid, 0, 60);
+  TEST_ASSERT_EQUAL_size_t(0, minutes.size());
+  TEST_ASSERT_EQUAL_UINT32(60, minutes.pendingBucket().count);
+
+  // 次の分の最初のサンプルで確定
+  addSeconds(pyramid, 60, 1);
+  TEST_ASSERT_EQUAL_size_t(1, minutes.size());
+  TEST_ASSERT_EQUAL_UINT32(1, minutes.sequence());
+  TEST_ASSERT_EQUAL_UINT32(1, minutes.pendingBucket().count);
+  checkBucket(minutes.at(0), 0, 60);
+}
+
+void test_cascade_quarter_and_hour(void) {
+  static TrendPyramid pyramid;   // 約5 KB、スタックに載せない
+  const TrendLevel& minutes = pyramid.level(TrendPyramid::LEVEL_MINUTE);
+  const TrendLevel& quarters = pyramid.level(TrendPyramid::LEVEL_QUARTER);
+  const TrendLevel& hours = pyramid.level(TrendPyramid::LEVEL_HOUR);
+
+  // 2時間と少し（15分のバケットは16分目の分のバケットが確定したときに確定する）
+  const uint32_t seconds = 2 * 3600 + 16 * 60 + 1;
+  addSeconds(pyramid, 0, seconds);
+
+  TEST_ASSERT_EQUAL_UINT32(seconds / 60, minutes.sequence());
+  TEST_ASSERT_EQUAL_size_t(TrendPyramid::MINUTE_CAPACITY, minutes.size());
+  TEST_ASSERT_EQUAL_UINT32(9, quarters.sequence());
+  TEST_ASSERT_EQUAL_UINT32(2, hours.sequence());
+
+  for (size_t k = 0; k < quarters.size(); k++) {
+    checkBucket(quarters.at(k), k * 900, 900);
+  }
+  for (size_t k = 0; k < hours.size(); k++) {
+    checkBucket(hours.at(k), k * 3600, 3600);
+  }
+
+  // 分のリングバッファは最新の60個（古いものは上書き）
+  uint32_t oldest_minute = seconds / 60 - TrendPyramid::MINUTE_CAPACITY;
+  for (size_t k = 0; k < minutes.size(); k += 7) {
+    checkBucket(minutes.at(k), (oldest_minute + k) * 60, 60);
+  }
+}
+
+void test_gap_closes_bucket(void) {
+  // 測定の途切れ（再起動など）の後の最初のサンプルで、途切れる前のバケットを確定する
+  static TrendPyramid pyramid;   // 約5 KB、スタックに載せない
+  const TrendLevel& minutes = pyramid.level(TrendPyramid::LEVEL_MINUTE);
+  addSeconds(pyramid, 0, 30);
+  addSeconds(pyramid, 500, 1);
+  TEST_ASSERT_EQUAL_size_t(1, minutes.size());
+  checkBucket(minutes.at(0), 0, 30);
+  TEST_ASSERT_EQUAL_UINT32(500000, minutes.pendingBucket().timestamp);
+}
+
+void test_restore_keeps_order(void) {
+  TrendBucket storage[4];
+  TrendLevel level(storage, 4, 60000UL);
+  for (uint32_t k = 0; k < 6; k++) {
+    TrendBucket bucket = { k * 60000, 0, 0, (uint16_t)k, 0, 0, 0 };
+    level.restore(bucket);
+  }
+  TEST_ASSERT_EQUAL_size_t(4, level.size());
+  TEST_ASSERT_EQUAL_UINT32(6, level.sequence());
+  for (size_t k = 0; k < level.size(); k++) {
+    TEST_ASSERT_EQUAL_UINT16(k + 2, level.at(k).tvoc_mean);
+  }
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_minute_rollover);
+  RUN_TEST(test_cascade_quarter_and_hour);
+  RUN_TEST(test_gap_closes_bucket);
+  RUN_TEST(test_restore_keeps_order);
+  return UNITY_END();
+}
@@ -0,0 +1,155 @@
+// WifiManager の失敗が続いた場合のやり直しの間隔（ジッター付きの指数バックオフと上限）と、接続後の初期化
+// （WiFiは HalNative の SimulatedWifi、時刻は VirtualClock を10 msずつ進める）
+//   pio test -e native -f test_wifi_manager
+#include <unity.h>
+#include <WifiManager.h>
+#include <HalNative.h>
+
+static const unsigned long POLL_MS = 10;
+static const WifiNetwork NETWORKS[] = { { "sim-home", "password" } };
+
+// 1回の待機（失敗した時刻と、次の接続を始めるまでの時間）
+struct Backoff {
+  unsigned long start;
+  unsigned long wait;
+};
+
+// poll() する WifiManager と記録した待機
+struct Watch {
+  WifiManager* manager;
+  unsigned long backoff_start;   // 待機に入った時刻（待機中でなければ 0）
+  std::vector<Backoff> backoffs;
+};
+
+static SimulatedWifi* wifi;
+static SimulatedWifi* other_wifi;
+
+// end_ms まで poll() し、待機の始まりと終わりを記録する
+static void runUntil(unsigned long end_ms, Watch* watches, size_t count) {
+  while (millis() < end_ms) {
+    for (size_t i = 0; i < count; i++) {
+      Watch& watch = watches[i];
+      watch.manager->poll();
+      bool waiting = !watch.manager->isRadioActive();
+      if (waiting && watch.backoff_start == 0) {
+        watch.backoff_start = millis();
+      } else if (!waiting && watch.backoff_start != 0) {
+        watch.backoffs.push_back({ watch.backoff_start, millis() - watch.backoff_start });
+        watch.backoff_start = 0;
+      }
+    }
+    VirtualClock::advance(POLL_MS * 1000);
+  }
+}
+
+// n 回目（0から）の失敗の後の待ち時間は [delay / 2, delay]、delay は RETRY_MIN から倍にして RETRY_MAX まで
+static void expectBackoff(const Backoff& backoff, uint32_t n) {
+  unsigned long delay = WifiManager::RETRY_MIN;
+  for (uint32_t i = 0; i < n && delay < WifiManager::RETRY_MAX; i++) {
+    delay = delay * 2 < WifiManager::RETRY_MAX ? delay * 2 : WifiManager::RETRY_MAX;
+  }
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(delay / 2, backoff.wait);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(delay + POLL_MS, backoff.wait);
+}
+
+void setUp(void) {
+  VirtualClock::reset();
+  VirtualClock::advance(1000);   // 0 は「待機中でない」の印
+  wifi = new SimulatedWifi();
+  other_wifi = new SimulatedWifi();
+}
+
+void tearDown(void) {
+  delete wifi;
+  delete other_wifi;
+}
+
+// アクセスポイントが見つからない間は検索のたびに失敗し、待ち時間は倍になって上限で止まる
+void test_backoff_doubles_up_to_cap(void) {
+  WifiManager manager;
+  manager.init(wifi, nullptr, NETWORKS, 1);
+  Watch watch = { &manager, 0, {} };
+  runUntil(20 * 60 * 1000, &watch, 1);
+
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(20, (uint32_t)watch.backoffs.size());
+  for (size_t i = 0; i < watch.backoffs.size(); i++) {
+    expectBackoff(watch.backoffs[i], (uint32_t)i);
+    // 待機の後は検索（SCAN_MS）してから次の失敗
+    if (i > 0) {
+      const Backoff& previous = watch.backoffs[i - 1];
+      TEST_ASSERT_UINT32_WITHIN(2 * POLL_MS, previous.wait + SimulatedWifi::SCAN_MS,
+                                watch.backoffs[i].start - previous.start);
+    }
+  }
+
+  // 上限に達した後もジッターで毎回ばらつく
+  unsigned long low = WifiManager::RETRY_MAX;
+  unsigned long high = 0;
+  for (size_t i = 6; i < watch.backoffs.size(); i++) {
+    low = watch.backoffs[i].wait < low ? watch.backoffs[i].wait : low;
+    high = watch.backoffs[i].wait > high ? watch.backoffs[i].wait : high;
+  }
+  TEST_ASSERT_GREATER_THAN_UINT32(WifiManager::RETRY_MAX / 10, high - low);
+}
+
+// 同時に切れた2台は起動時刻で乱数が変わり、やり直しの時刻が揃わない
+void test_jitter_differs_between_devices(void) {
+  WifiManager first;
+  WifiManager second;
+  first.init(wifi, nullptr, NETWORKS, 1);
+  VirtualClock::advance(1234);
+  second.init(other_wifi, nullptr, NETWORKS, 1);
+  Watch watches[] = { { &first, 0, {} }, { &second, 0, {} } };
+  runUntil(5 * 60 * 1000, watches, 2);
+
+  size_t count = watches[0].backoffs.size() < watches[1].backoffs.size() ?
+                 watches[0].backoffs.size() : watches[1].backoffs.size();
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(6, (uint32_t)count);
+  uint32_t different = 0;
+  for (size_t i = 0; i < count; i++) {
+    expectBackoff(watches[1].backoffs[i], (uint32_t)i);
+    different += watches[0].backoffs[i].wait != watches[1].backoffs[i].wait ? 1 : 0;
+  }
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32((uint32_t)count - 1, different);
+}
+
+// 圏外の間は前回のアクセスポイント・検索とも失敗して待ち時間が伸び、接続できたら最初の間隔に戻る
+void test_connect_resets_backoff(void) {
+  MemoryStore nvs;
+  wifi->enable();
+  wifi->addOutage(60000, 240000);
+  wifi->addOutage(600000, 20000);
+  WifiManager manager;
+  manager.init(wifi, &nvs, NETWORKS, 1);
+  Watch watch = { &manager, 0, {} };
+
+  runUntil(60000, &watch, 1);
+  TEST_ASSERT_TRUE(manager.isConnected());
+  TEST_ASSERT_EQUAL_size_t(0, watch.backoffs.size());
+
+  runUntil(600000, &watch, 1);
+  TEST_ASSERT_TRUE(manager.isConnected());
+  TEST_ASSERT_EQUAL_UINT32(1, manager.reconnects());
+  size_t first_outage = watch.backoffs.size();
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(5, (uint32_t)first_outage);
+  for (size_t i = 0; i < first_outage; i++) {
+    expectBackoff(watch.backoffs[i], (uint32_t)i);
+  }
+
+  runUntil(700000, &watch, 1);
+  TEST_ASSERT_TRUE(manager.isConnected());
+  TEST_ASSERT_EQUAL_UINT32(2, manager.reconnects());
+  TEST_ASSERT_GREATER_THAN_UINT32((uint32_t)first_outage, (uint32_t)watch.backoffs.size());
+  for (size_t i = first_outage; i < watch.backoffs.size(); i++) {
+    expectBackoff(watch.backoffs[i], (uint32_t)(i - first_outage));
+  }
+}
+
+int main(int argc, char** argv) {
+  Serial.setQuiet(true);
+  UNITY_BEGIN();
+  RUN_TEST(test_backoff_doubles_up_to_cap);
+  RUN_TEST(test_jitter_differs_between_devices);
+  RUN_TEST(test_connect_resets_backoff);
+  return UNITY_END();
+}